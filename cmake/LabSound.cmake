@@ -19,6 +19,10 @@ elseif (UNIX)
     set(third_rtaudio "${LABSOUND_ROOT}/third_party/rtaudio/src/RtAudio.cpp")
 endif()
 
+# the headless backends are available on every platform
+file(GLOB labsnd_backend_null "${LABSOUND_ROOT}/src/backends/null/*")
+list(APPEND labsnd_backend ${labsnd_backend_null})
+
 add_library(LabSound STATIC
     ${labsnd_core_h}     ${labsnd_core}
     ${labsnd_extended_h} ${labsnd_extended}
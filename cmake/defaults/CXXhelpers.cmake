@@ -44,7 +44,7 @@ function(_set_compile_options proj)
         endif()
         if(LABSOUND_ASOUND)
             target_link_libraries(${proj} asound)
-            target_compile_definitions(${proj} PRIVATE __LINUX_ASOUND__=1 LABSOUND_ASOUND=1)
+            target_compile_definitions(${proj} PRIVATE __LINUX_ALSA__=1 LABSOUND_ASOUND=1)
         endif()
         # TODO: These vars are for libniquist and should be set in the find libynquist script.
         # TODO: libnyquist's loadabc calls getenv and setenv. That's undesirable.
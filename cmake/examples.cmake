@@ -25,5 +25,21 @@ set_target_properties(LabSoundExample PROPERTIES
 
 set_property(TARGET LabSoundExample PROPERTY FOLDER "examples")
 
-install(TARGETS LabSoundExample
+# Offline DSP benchmarks; the kernel benchmarks use LabSound's internal headers.
+
+add_executable(LabSoundBenchmarks "${LABSOUND_ROOT}/examples/src/BenchmarksMain.cpp")
+
+set_cxx_version(LabSoundBenchmarks)
+_set_compile_options(LabSoundBenchmarks)
+
+target_include_directories(LabSoundBenchmarks PRIVATE ${LABSOUND_ROOT}/src)
+
+target_link_libraries(LabSoundBenchmarks LabSound ${DARWIN_LIBS})
+
+set_target_properties(LabSoundBenchmarks PROPERTIES
+                      RUNTIME_OUTPUT_DIRECTORY ${PROJECT_BINARY_DIR}/bin)
+
+set_property(TARGET LabSoundBenchmarks PROPERTY FOLDER "examples")
+
+install(TARGETS LabSoundExample LabSoundBenchmarks
     RUNTIME DESTINATION ${PROJECT_BINARY_DIR}/bin)
@@ -0,0 +1,637 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+    #define _CRT_SECURE_NO_WARNINGS
+#endif
+
+// LabSoundBenchmarks renders graphs in offline contexts as fast as possible and reports their throughput,
+// so that changes in CPU cost can be tracked from one build to the next.
+//
+//   LabSoundBenchmarks [--assets dir] [--seconds n] [--repeat n] [--filter text] [--json file] [--profile]
+//
+// Every benchmark is rendered --repeat times and the fastest run is reported, as frames rendered per second
+// of wall-clock time and as a multiple of realtime. Graph construction, file loading and impulse response
+// preparation happen before the clock starts. Kernel benchmarks time the FFT and direct convolution code
+// underneath the convolution nodes on their own, and report the samples they transform per second.
+//
+// A graph benchmark fails if its render had to allocate a bus because the context's bus pool had none to offer,
+// and the program then exits with an error.
+//
+// Like the examples, file paths are relative to the assets directory, which defaults to the working directory.
+
+#include "LabSound/extended/LabSound.h"
+#include "LabSound/core/AudioBusPool.h"
+#include "LabSound/core/RenderProfiler.h"
+
+#include "internal/DirectConvolver.h"
+#include "internal/FFTBackend.h"
+#include "internal/FFTFrame.h"
+#include "internal/HRTFDatabaseLoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace lab;
+
+namespace
+{
+
+const float SampleRate = LABSOUND_DEFAULT_SAMPLERATE;
+
+struct Options
+{
+    std::string assets;
+    float seconds = 10.f;
+    int repeat = 3;
+    std::string filter;
+    std::string json;
+    bool profile = false;
+};
+
+Options g_options;
+
+struct Result
+{
+    std::string name;
+    std::string group;
+    double frames = 0;      // audio frames (or transformed samples) processed per run
+    double wallSeconds = 0; // fastest run
+    double maxQuantumSeconds = 0;
+    uint64_t deadlineMisses = 0;
+    std::string slowestNode;
+    uint64_t busAllocations = 0; // by the render thread, in the worst run
+
+    double samplesPerSecond() const { return wallSeconds > 0 ? frames / wallSeconds : 0; }
+    double realtimeFactor() const { return samplesPerSecond() / SampleRate; }
+};
+
+std::string assetPath(const std::string & relative)
+{
+    return g_options.assets.empty() ? relative : g_options.assets + "/" + relative;
+}
+
+std::shared_ptr<AudioBus> loadAsset(const std::string & relative, bool mixToMono)
+{
+    std::shared_ptr<AudioBus> bus = MakeBusFromFile(assetPath(relative).c_str(), mixToMono);
+    if (!bus)
+        std::cerr << "Couldn't load " << assetPath(relative) << std::endl;
+    return bus;
+}
+
+bool selected(const std::string & name)
+{
+    return g_options.filter.empty() || name.find(g_options.filter) != std::string::npos;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+////////////////////
+//  Graph runner  //
+////////////////////
+
+// A graph under construction. Connections don't own the nodes they connect, so every node of the graph
+// is created through make(), which keeps it alive until the render has finished.
+struct Graph
+{
+    AudioContext & context;
+    ContextRenderLock & r;
+    std::vector<std::shared_ptr<AudioNode>> nodes;
+
+    Graph(AudioContext & context, ContextRenderLock & r) : context(context), r(r) {}
+
+    template<typename T, typename... Args>
+    std::shared_ptr<T> make(Args &&... args)
+    {
+        std::shared_ptr<T> node = std::make_shared<T>(std::forward<Args>(args)...);
+        nodes.push_back(node);
+        return node;
+    }
+};
+
+// Builds a graph, connecting its output to the destination.
+typedef std::function<void(Graph &)> GraphBuilder;
+
+void runGraph(std::vector<Result> & results, const std::string & group, const std::string & name, GraphBuilder build)
+{
+    if (!selected(name))
+        return;
+
+    Result result;
+    result.name = name;
+    result.group = group;
+    result.frames = std::floor(g_options.seconds * SampleRate / AudioNode::ProcessingSizeInFrames) * AudioNode::ProcessingSizeInFrames;
+    result.wallSeconds = 1e30;
+
+    for (int run = 0; run < g_options.repeat; ++run)
+    {
+        std::unique_ptr<AudioContext> context = MakeOfflineAudioContext(Channels::Stereo, g_options.seconds * 1000.f, SampleRate);
+        std::vector<std::shared_ptr<AudioNode>> nodes; // released before the context
+        {
+            ContextRenderLock r(context.get(), "LabSoundBenchmarks");
+            Graph graph(*context, r);
+            build(graph);
+            nodes.swap(graph.nodes);
+        }
+
+        if (HRTFDatabaseLoader::loader())
+            HRTFDatabaseLoader::loader()->waitForLoaderThreadCompletion();
+
+        context->profiler().setEnabled(g_options.profile);
+
+        const auto start = std::chrono::steady_clock::now();
+        context->startRendering();
+        const double elapsed = secondsSince(start);
+
+        result.busAllocations = std::max(result.busAllocations, context->busPool().allocationCount());
+
+        if (elapsed < result.wallSeconds)
+        {
+            result.wallSeconds = elapsed;
+
+            const RenderProfile profile = context->profiler().snapshot();
+            result.maxQuantumSeconds = profile.quanta.maxTime;
+            result.deadlineMisses = profile.quanta.deadlineMisses;
+
+            double slowest = 0;
+            for (const NodeProfile & node : profile.nodes)
+            {
+                if (node.totalTime > slowest)
+                {
+                    slowest = node.totalTime;
+                    result.slowestNode = node.typeName;
+                }
+            }
+        }
+    }
+
+    printf("%-40s %12.0f samples/s %9.1fx realtime\n", name.c_str(), result.samplesPerSecond(), result.realtimeFactor());
+    if (result.busAllocations)
+        std::cerr << name << " allocated " << result.busAllocations << " buses while rendering" << std::endl;
+    results.push_back(result);
+}
+
+std::shared_ptr<OscillatorNode> makeOscillator(Graph & g, float frequency, OscillatorType type = OscillatorType::SAWTOOTH)
+{
+    std::shared_ptr<OscillatorNode> oscillator = g.make<OscillatorNode>(g.context.sampleRate());
+    oscillator->setType(type);
+    oscillator->frequency()->setValue(frequency);
+    oscillator->start(0);
+    return oscillator;
+}
+
+// Runs a single node fed by a sawtooth, so that it is never skipped as silent.
+void runNode(std::vector<Result> & results, const std::string & name, std::function<std::shared_ptr<AudioNode>(Graph &)> make)
+{
+    runGraph(results, "node", "node/" + name, [&](Graph & g)
+    {
+        std::shared_ptr<AudioNode> node = make(g);
+        g.context.connect(node, makeOscillator(g, 220.f), 0, 0);
+        if (node->numberOfOutputs() > 0)
+            g.context.connect(g.context.destination(), node, 0, 0);
+        else
+            g.context.addAutomaticPullNode(node);
+    });
+}
+
+// Runs a source node on its own.
+void runSource(std::vector<Result> & results, const std::string & name, std::function<std::shared_ptr<AudioNode>(Graph &)> make)
+{
+    runGraph(results, "node", "node/" + name, [&](Graph & g)
+    {
+        g.context.connect(g.context.destination(), make(g), 0, 0);
+    });
+}
+
+////////////////////////
+//  Kernel benchmarks //
+////////////////////////
+
+void runKernel(std::vector<Result> & results, const std::string & name, double samplesPerIteration, std::function<void()> iteration)
+{
+    if (!selected(name))
+        return;
+
+    Result result;
+    result.name = name;
+    result.group = "kernel";
+    result.wallSeconds = 1e30;
+
+    // Calibrate the iteration count to roughly a tenth of the requested duration per run.
+    size_t iterations = 1;
+    for (;;)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+            iteration();
+        if (secondsSince(start) > 0.01 || iterations > (size_t(1) << 30))
+            break;
+        iterations *= 2;
+    }
+    iterations = std::max<size_t>(1, size_t(iterations * (g_options.seconds * 0.1 / 0.01)));
+    iterations = std::min<size_t>(iterations, size_t(1) << 32);
+
+    result.frames = samplesPerIteration * iterations;
+    for (int run = 0; run < g_options.repeat; ++run)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+            iteration();
+        result.wallSeconds = std::min(result.wallSeconds, secondsSince(start));
+    }
+
+    printf("%-40s %12.0f samples/s %9.1fx realtime\n", name.c_str(), result.samplesPerSecond(), result.realtimeFactor());
+    results.push_back(result);
+}
+
+const char * backendName(FFTBackend backend)
+{
+    return backend == FFTBackend::KissFFT ? "kissfft" : "vectorized";
+}
+
+void runKernels(std::vector<Result> & results)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> noise(-1.f, 1.f);
+
+    // Forward and inverse real FFTs of each size the convolvers use, with each backend.
+    for (size_t size = 256; size <= 32768; size *= 2)
+    {
+        std::vector<float> input(size), output(size), real(size / 2), imag(size / 2);
+        for (float & x : input)
+            x = noise(random);
+
+        for (FFTBackend backend : { FFTBackend::KissFFT, FFTBackend::Vectorized })
+        {
+            const FFTPlan * plan = FFTPlan::forSize(size, backend);
+            if (!plan)
+                continue;
+
+            runKernel(results, std::string("kernel/fft/") + backendName(backend) + "/" + std::to_string(size), double(size), [&]()
+            {
+                plan->forward(input.data(), real.data(), imag.data());
+                plan->inverse(real.data(), imag.data(), output.data());
+            });
+        }
+    }
+
+    // Time-domain convolution of one render quantum, as used by FIRFilterNode and the head of the
+    // partitioned convolver.
+    const size_t block = AudioNode::ProcessingSizeInFrames;
+    for (size_t kernelSize : { 16, 32, 64, 128, 256, 512, 1024 })
+    {
+        DirectConvolver convolver(block, kernelSize);
+        std::vector<float> kernel(kernelSize), source(block), destination(block);
+        for (float & x : kernel)
+            x = noise(random) / kernelSize;
+        for (float & x : source)
+            x = noise(random);
+
+        runKernel(results, "kernel/direct-convolver/" + std::to_string(kernelSize), double(block), [&]()
+        {
+            convolver.process(kernel.data(), kernelSize, source.data(), destination.data(), block);
+        });
+    }
+}
+
+/////////////////////
+//  Node and graphs //
+/////////////////////
+
+void runNodes(std::vector<Result> & results)
+{
+    runSource(results, "OscillatorNode", [](Graph & g) { return makeOscillator(g, 220.f); });
+
+    runSource(results, "NoiseNode", [](Graph & g)
+    {
+        std::shared_ptr<NoiseNode> noise = g.make<NoiseNode>();
+        noise->start(0);
+        return noise;
+    });
+
+    runSource(results, "SupersawNode", [](Graph & g)
+    {
+        std::shared_ptr<SupersawNode> saw = g.make<SupersawNode>(g.r);
+        saw->noteOn(0);
+        return saw;
+    });
+
+    runNode(results, "GainNode", [](Graph & g) { return g.make<GainNode>(); });
+
+    runNode(results, "BiquadFilterNode", [](Graph & g)
+    {
+        std::shared_ptr<BiquadFilterNode> filter = g.make<BiquadFilterNode>();
+        filter->setType(BiquadFilterNode::LOWPASS);
+        filter->frequency()->setValue(1000.f);
+        return filter;
+    });
+
+    runNode(results, "DelayNode", [](Graph & g)
+    {
+        std::shared_ptr<DelayNode> delay = g.make<DelayNode>(g.context.sampleRate(), 2.0);
+        delay->delayTime()->setValue(0.25f);
+        return delay;
+    });
+
+    runNode(results, "DynamicsCompressorNode", [](Graph & g) { return g.make<DynamicsCompressorNode>(); });
+
+    runNode(results, "WaveShaperNode", [](Graph & g)
+    {
+        std::vector<float> curve(1024);
+        for (size_t i = 0; i < curve.size(); ++i)
+            curve[i] = std::tanh(4.f * (2.f * i / (curve.size() - 1) - 1.f));
+        std::shared_ptr<WaveShaperNode> shaper = g.make<WaveShaperNode>();
+        shaper->setCurve(curve);
+        return shaper;
+    });
+
+    runNode(results, "StereoPannerNode", [](Graph & g)
+    {
+        std::shared_ptr<StereoPannerNode> panner = g.make<StereoPannerNode>(g.context.sampleRate());
+        panner->pan()->setValue(0.3f);
+        return panner;
+    });
+
+    runNode(results, "PannerNode/equalpower", [](Graph & g)
+    {
+        std::shared_ptr<PannerNode> panner = g.make<PannerNode>(g.context.sampleRate());
+        panner->setPanningModel(PanningMode::EQUALPOWER);
+        panner->setPosition(1.f, 0.f, 1.f);
+        return panner;
+    });
+
+    runNode(results, "PannerNode/hrtf", [](Graph & g)
+    {
+        std::shared_ptr<PannerNode> panner = g.make<PannerNode>(g.context.sampleRate(), assetPath("hrtf"));
+        panner->setPanningModel(PanningMode::HRTF);
+        panner->setPosition(1.f, 0.f, 1.f);
+        return panner;
+    });
+
+    runNode(results, "AnalyserNode", [](Graph & g) { return g.make<AnalyserNode>(2048); });
+
+    for (size_t kernelSize : { 64, 256, 1024 })
+    {
+        runNode(results, "FIRFilterNode/" + std::to_string(kernelSize), [kernelSize](Graph & g)
+        {
+            std::vector<float> kernel(kernelSize);
+            for (size_t i = 0; i < kernelSize; ++i)
+                kernel[i] = std::exp(-8.f * i / kernelSize) / kernelSize;
+            std::shared_ptr<FIRFilterNode> fir = g.make<FIRFilterNode>();
+            fir->setKernel(kernel);
+            return fir;
+        });
+    }
+
+    runNode(results, "ADSRNode", [](Graph & g)
+    {
+        std::shared_ptr<ADSRNode> adsr = g.make<ADSRNode>();
+        adsr->set(0.01f, 1.f, 0.1f, 0.5f, 0.2f);
+        adsr->noteOn(0);
+        return adsr;
+    });
+
+    runNode(results, "ClipNode", [](Graph & g) { return g.make<ClipNode>(); });
+    runNode(results, "PeakCompNode", [](Graph & g) { return g.make<PeakCompNode>(); });
+    runNode(results, "PowerMonitorNode", [](Graph & g) { return g.make<PowerMonitorNode>(); });
+    runNode(results, "SpectralMonitorNode", [](Graph & g) { return g.make<SpectralMonitorNode>(); });
+}
+
+void runGraphs(std::vector<Result> & results)
+{
+    // A sampler playing 100 looping voices, each through its own gain.
+    std::shared_ptr<AudioBus> clip = loadAsset("samples/stereo-music-clip.wav", false);
+    if (clip)
+    {
+        runGraph(results, "graph", "graph/sampler-100-voices", [&](Graph & g)
+        {
+            std::shared_ptr<GainNode> mix = g.make<GainNode>();
+            mix->gain()->setValue(0.01f);
+            g.context.connect(g.context.destination(), mix, 0, 0);
+
+            for (int i = 0; i < 100; ++i)
+            {
+                std::shared_ptr<SampledAudioNode> voice = g.make<SampledAudioNode>();
+                voice->setBus(g.r, clip);
+                voice->setLoop(true);
+                voice->playbackRate()->setValue(0.5f + 0.01f * i);
+
+                std::shared_ptr<GainNode> gain = g.make<GainNode>();
+                gain->gain()->setValue(0.5f + 0.005f * i);
+
+                g.context.connect(gain, voice, 0, 0);
+                g.context.connect(mix, gain, 0, 0);
+                voice->start(0.001 * i);
+            }
+        });
+    }
+
+    // Convolution reverb with each impulse response, and with each FFT backend where the convolver uses them.
+    std::shared_ptr<AudioBus> voice = loadAsset("samples/voice.ogg", false);
+    for (const char * impulse : { "cardiod-rear-levelled", "filter-telephone" })
+    {
+        std::shared_ptr<AudioBus> response = loadAsset(std::string("impulse/") + impulse + ".wav", false);
+        if (!response || !voice)
+            continue;
+
+#if USE_ACCELERATE_FFT
+        const FFTBackend backends[] = { fftBackend() };
+#else
+        const FFTBackend backends[] = { FFTBackend::KissFFT, FFTBackend::Vectorized };
+#endif
+        const FFTBackend defaultBackend = fftBackend();
+        for (FFTBackend backend : backends)
+        {
+            std::string name = std::string("graph/convolver/") + impulse;
+#if !USE_ACCELERATE_FFT
+            name += std::string("/") + backendName(backend);
+#endif
+            setFFTBackend(backend);
+            runGraph(results, "graph", name, [&](Graph & g)
+            {
+                std::shared_ptr<SampledAudioNode> source = g.make<SampledAudioNode>();
+                source->setBus(g.r, voice);
+                source->setLoop(true);
+
+                std::shared_ptr<ConvolverNode> convolver = g.make<ConvolverNode>();
+                convolver->setImpulse(response);
+
+                g.context.connect(convolver, source, 0, 0);
+                g.context.connect(g.context.destination(), convolver, 0, 0);
+                source->start(0);
+            });
+        }
+        setFFTBackend(defaultBackend);
+    }
+
+    // Eight moving sources spatialized with HRTFs.
+    std::shared_ptr<AudioBus> train = loadAsset("samples/trainrolling.wav", true);
+    if (train)
+    {
+        runGraph(results, "graph", "graph/hrtf-8-sources", [&](Graph & g)
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                std::shared_ptr<SampledAudioNode> source = g.make<SampledAudioNode>();
+                source->setBus(g.r, train);
+                source->setLoop(true);
+
+                std::shared_ptr<PannerNode> panner = g.make<PannerNode>(g.context.sampleRate(), assetPath("hrtf"));
+                panner->setPanningModel(PanningMode::HRTF);
+
+                // Each source sweeps through a different arc, so the HRTF kernels keep changing.
+                const float angle = 6.2831853f * i / 8.f;
+                panner->positionX()->setValueAtTime(std::cos(angle), 0);
+                panner->positionX()->linearRampToValueAtTime(-std::cos(angle), g_options.seconds);
+                panner->positionZ()->setValueAtTime(std::sin(angle), 0);
+                panner->positionZ()->linearRampToValueAtTime(-std::sin(angle), g_options.seconds);
+                panner->positionY()->setValue(0.1f);
+
+                g.context.connect(panner, source, 0, 0);
+                g.context.connect(g.context.destination(), panner, 0, 0);
+                source->start(0);
+            }
+        });
+    }
+
+    // A long chain of biquads, alternating types so that every coefficient path is exercised.
+    for (int length : { 16, 64 })
+    {
+        runGraph(results, "graph", "graph/biquad-chain-" + std::to_string(length), [length](Graph & g)
+        {
+            std::shared_ptr<AudioNode> previous = makeOscillator(g, 110.f);
+            for (int i = 0; i < length; ++i)
+            {
+                std::shared_ptr<BiquadFilterNode> filter = g.make<BiquadFilterNode>();
+                filter->setType(static_cast<unsigned short>(i % 8));
+                filter->frequency()->setValue(200.f + 150.f * (i % 32));
+                filter->q()->setValue(0.7f);
+                g.context.connect(filter, previous, 0, 0);
+                previous = filter;
+            }
+            g.context.connect(g.context.destination(), previous, 0, 0);
+        });
+    }
+}
+
+//////////////
+//  Output  //
+//////////////
+
+void writeJsonString(std::ostream & out, const std::string & s)
+{
+    out << '"';
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out << '\\';
+        out << c;
+    }
+    out << '"';
+}
+
+bool writeJson(const std::string & path, const std::vector<Result> & results)
+{
+    std::ofstream out(path);
+    if (!out)
+        return false;
+
+    out.precision(9);
+    out << "{\n  \"sampleRate\": " << SampleRate
+        << ",\n  \"quantum\": " << AudioNode::ProcessingSizeInFrames
+        << ",\n  \"seconds\": " << g_options.seconds
+        << ",\n  \"repeat\": " << g_options.repeat
+        << ",\n  \"fftBackend\": \"" << backendName(fftBackend()) << "\""
+        << ",\n  \"results\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result & result = results[i];
+        out << (i ? ",\n" : "\n") << "    { \"name\": ";
+        writeJsonString(out, result.name);
+        out << ", \"group\": ";
+        writeJsonString(out, result.group);
+        out << ", \"samples\": " << result.frames
+            << ", \"wallSeconds\": " << result.wallSeconds
+            << ", \"samplesPerSecond\": " << result.samplesPerSecond()
+            << ", \"xRealtime\": " << result.realtimeFactor();
+
+        if (result.group != "kernel")
+            out << ", \"busAllocations\": " << result.busAllocations;
+
+        if (g_options.profile && result.group != "kernel")
+        {
+            out << ", \"maxQuantumSeconds\": " << result.maxQuantumSeconds
+                << ", \"deadlineMisses\": " << result.deadlineMisses
+                << ", \"slowestNode\": ";
+            writeJsonString(out, result.slowestNode);
+        }
+        out << " }";
+    }
+
+    out << "\n  ]\n}\n";
+    return bool(out);
+}
+
+bool parseOptions(int argc, char * argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (arg == "--assets" && hasValue) g_options.assets = argv[++i];
+        else if (arg == "--seconds" && hasValue) g_options.seconds = std::max(0.1f, float(atof(argv[++i])));
+        else if (arg == "--repeat" && hasValue) g_options.repeat = std::max(1, atoi(argv[++i]));
+        else if (arg == "--filter" && hasValue) g_options.filter = argv[++i];
+        else if (arg == "--json" && hasValue) g_options.json = argv[++i];
+        else if (arg == "--profile") g_options.profile = true;
+        else
+        {
+            std::cerr << "usage: LabSoundBenchmarks [--assets dir] [--seconds n] [--repeat n] [--filter text] [--json file] [--profile]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+int main(int argc, char * argv[]) try
+{
+    if (!parseOptions(argc, argv))
+        return 1;
+
+    std::vector<Result> results;
+    runKernels(results);
+    runNodes(results);
+    runGraphs(results);
+
+    if (!g_options.json.empty() && !writeJson(g_options.json, results))
+    {
+        std::cerr << "Couldn't write " << g_options.json << std::endl;
+        return 1;
+    }
+
+    for (const Result & result : results)
+        if (result.busAllocations)
+            return 1;
+
+    return 0;
+}
+catch (const std::exception & e)
+{
+    std::cerr << "Uncaught fatal exception: " << e.what() << std::endl;
+    return 1;
+}
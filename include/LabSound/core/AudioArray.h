@@ -8,9 +8,22 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <atomic>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
 
 namespace lab {
 
+    // Counts every AudioArray allocation made by the process. Sampling it before and after a
+    // render quantum is a cheap way to verify that rendering did not touch the heap.
+    inline std::atomic<uint64_t> & audioArrayAllocationCount()
+    {
+        static std::atomic<uint64_t> count{ 0 };
+        return count;
+    }
+
     template<typename T>
     class AudioArray {
     public:
@@ -22,44 +35,23 @@ namespace lab {
 
         ~AudioArray()
         {
-            free(m_allocation);
+            alignedFree(m_allocation);
         }
 
         // It's OK to call allocate() multiple times, but data will *not* be copied from an initial allocation
-        // if re-allocated. Allocations are zero-initialized.
+        // if re-allocated. Allocations are zero-initialized and aligned to a cache line, which also satisfies
+        // the widest SIMD loads used by VectorMath.
         void allocate(size_t n)
         {
-            size_t initialSize = sizeof(T) * n;
-            
-            const size_t alignment = 16;
-            
             if (m_allocation)
-                free(m_allocation);
-
-            bool isAllocationGood = false;
-
-            while (!isAllocationGood) {
-                // Initially we try to allocate the exact size, but if it's not aligned
-                // then we'll have to reallocate and from then on allocate extra.
-                static size_t extraAllocationBytes = 0;
-
-                T* allocation = static_cast<T*>(malloc(initialSize + extraAllocationBytes));
-                if (!allocation) {
-                    //CRASH(); // dimitri
-                }
-                T* alignedData = alignedAddress(allocation, alignment);
-
-                if (alignedData == allocation || extraAllocationBytes == alignment) {
-                    m_allocation = allocation;
-                    m_alignedData = alignedData;
-                    m_size = n;
-                    isAllocationGood = true;
-                    zero();
-                } else {
-                    extraAllocationBytes = alignment; // always allocate extra after the first alignment failure.
-                    free(allocation);
-                }
-            }
+                alignedFree(m_allocation);
+
+            m_allocation = alignedAllocate(sizeof(T) * n);
+            m_alignedData = m_allocation;
+            m_size = m_allocation ? n : 0;
+
+            audioArrayAllocationCount().fetch_add(1, std::memory_order_relaxed);
+            zero();
         }
 
         T* data() { return m_alignedData; }
@@ -104,12 +96,29 @@ namespace lab {
         }
         
     private:
-        static T* alignedAddress(T* address, intptr_t alignment)
+        static const size_t Alignment = 64;
+
+        static T* alignedAllocate(size_t bytes)
         {
-            intptr_t value = reinterpret_cast<intptr_t>(address);
-            return reinterpret_cast<T*>((value + alignment - 1) & ~(alignment - 1));
+#if defined(_MSC_VER)
+            return static_cast<T*>(_aligned_malloc(bytes ? bytes : Alignment, Alignment));
+#else
+            void * allocation = nullptr;
+            if (posix_memalign(&allocation, Alignment, bytes ? bytes : Alignment) != 0)
+                return nullptr;
+            return static_cast<T*>(allocation);
+#endif
         }
-        
+
+        static void alignedFree(T* allocation)
+        {
+#if defined(_MSC_VER)
+            _aligned_free(allocation);
+#else
+            free(allocation);
+#endif
+        }
+
         T* m_allocation;
         T* m_alignedData;
         size_t m_size;
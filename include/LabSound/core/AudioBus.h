@@ -101,12 +101,24 @@ public:
     // Our own internal gain m_busGain is ignored.
     void sumFrom(const AudioBus & sourceBus, ChannelInterpretation = ChannelInterpretation::Speakers);
 
+    // Sums sourceCount buses with unity gain, as if each were passed to sumFrom() in turn. Buses with as many
+    // channels as this one are summed in a single pass over each of our channels.
+    void sumFrom(const AudioBus * const * sourceBuses, size_t sourceCount, ChannelInterpretation = ChannelInterpretation::Speakers);
+
     // Copy each channel from sourceBus into our corresponding channel.
     // We scale by targetGain (and our own internal gain m_busGain), performing "de-zippering" to smoothly change from *lastMixGain to (targetGain*m_busGain).
     // The caller is responsible for setting up lastMixGain to point to storage which is unique for every "stream" which will be applied to this bus.
-    // This represents the dezippering memory.
+    // This represents the dezippering memory; on return it holds the gain for the frame following this quantum.
     void copyWithGainFrom(const AudioBus &sourceBus, float* lastMixGain, float targetGain);
 
+    // Sums sourceCount buses with as many channels as this one, each scaled by its own gain, de-zippered as copyWithGainFrom() does:
+    // lastMixGains[i] ramps toward targetGains[i], and on return holds the gain for the frame following this quantum. The caller snaps
+    // lastMixGains to the target gains the first time. Our own internal gain m_busGain is ignored, as it is by sumFrom().
+    void sumWithGainFrom(const AudioBus * const * sourceBuses, float * lastMixGains, const float * targetGains, size_t sourceCount);
+
+    // Sums a sourceBus with the same topology, scaled by sample-accurate gain values.
+    void sumWithSampleAccurateGainValuesFrom(const AudioBus & sourceBus, const float * gainValues, size_t numberOfGainValues);
+
     // Copies the sourceBus by scaling with sample-accurate gain values.
     void copyWithSampleAccurateGainValuesFrom(const AudioBus & sourceBus, float* gainValues, size_t numberOfGainValues);
 
@@ -137,8 +149,6 @@ protected:
 
     float m_busGain = 1.0f;
 
-    std::unique_ptr<AudioFloatArray> m_dezipperGainValues;
-
     bool m_isFirstTime = true;
     float m_sampleRate = 0.0f;
 
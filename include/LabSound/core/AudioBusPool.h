@@ -0,0 +1,68 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef AudioBusPool_h
+#define AudioBusPool_h
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace lab
+{
+
+class AudioBus;
+
+// AudioBusPool recycles quantum-sized AudioBus objects so that the render thread can change the
+// channel count of node inputs and outputs without calling into the heap. Each AudioContext owns one.
+//
+// Buses are grouped by channel count into fixed-size slot arrays. Acquiring and releasing are
+// lock-free: a slot is claimed by atomically exchanging its pointer, so the render thread and the
+// main thread (which may reserve() buses ahead of time) never block one another.
+class AudioBusPool
+{
+    AudioBusPool(const AudioBusPool&); // noncopyable
+
+public:
+
+    // Number of buses retained per channel count.
+    enum { SlotsPerChannelCount = 16 };
+
+    explicit AudioBusPool(size_t framesPerBus);
+    ~AudioBusPool();
+
+    // Returns a zeroed bus with numberOfChannels channels. Falls back to allocating a new bus if
+    // the pool has none to offer, which is recorded in allocationCount().
+    AudioBus * acquire(size_t numberOfChannels);
+
+    // Returns a bus to the pool. Buses whose length doesn't match the pool, or that don't fit because
+    // the pool is full, are deleted and recorded in deallocationCount().
+    void release(AudioBus * bus);
+
+    // Preallocates buses with numberOfChannels channels until the pool holds count of them, or as many
+    // as it keeps. Called from the main thread, as the context initializes and as connections are made.
+    void reserve(size_t numberOfChannels, size_t count);
+
+    size_t framesPerBus() const { return m_framesPerBus; }
+
+    // Number of times acquire() or release() had to touch the heap.
+    uint64_t allocationCount() const { return m_allocationCount.load(std::memory_order_relaxed); }
+    uint64_t deallocationCount() const { return m_deallocationCount.load(std::memory_order_relaxed); }
+
+private:
+
+    std::atomic<AudioBus*> * slotsFor(size_t numberOfChannels);
+    bool tryStore(AudioBus * bus);
+
+    size_t m_framesPerBus;
+    size_t m_maxChannels;
+    std::unique_ptr<std::atomic<AudioBus*>[]> m_slots;
+
+    std::atomic<uint64_t> m_allocationCount{ 0 };
+    std::atomic<uint64_t> m_deallocationCount{ 0 };
+};
+
+} // namespace lab
+
+#endif // AudioBusPool_h
@@ -49,8 +49,18 @@ public:
         m_rawPointer = storage;
         m_length = length;
         m_silent = false;
+        m_isBorrowed = false;
     }
 
+    // Reference the samples of sourceChannel instead of copying them. The view is read-only
+    // and only valid for the current render quantum. Managed storage is retained, and the first
+    // call to mutableData() or zero() copies out of the view and back into it.
+    // Channels which don't manage their own storage fall back to a copy.
+    void borrow(const AudioChannel* sourceChannel);
+
+    // True if this channel is currently a view onto another channel's samples.
+    bool isBorrowed() const { return m_isBorrowed; }
+
     // How many sample-frames do we contain?
     size_t length() const { return m_length; }
 
@@ -61,22 +71,16 @@ public:
     // Direct access to PCM sample data. Non-const accessor clears silent flag.
     float * mutableData()
     {
+        if (m_isBorrowed) releaseBorrow(true);
         clearSilentFlag();
         return m_rawPointer ? m_rawPointer : m_memBuffer->data(); 
     }
 
     const float* data() const { return m_rawPointer ? m_rawPointer : m_memBuffer->data(); }
 
-    // Zeroes out all sample values in buffer.
-    void zero()
-    {
-        if (m_silent) return;
-
-        m_silent = true;
-
-        if (m_memBuffer.get()) m_memBuffer->zero();
-        else memset(m_rawPointer, 0, sizeof(float) * m_length);
-    }
+    // Zeroes out all sample values in buffer. Channels that manage their own storage don't memset;
+    // they become a read-only view of a shared buffer of zeroes until they are next written.
+    void zero();
 
     // Clears the silent flag.
     void clearSilentFlag() { m_silent = false; }
@@ -95,15 +99,34 @@ public:
     // Sums (with unity gain) from the source channel.
     void sumFrom(const AudioChannel* sourceChannel);
 
+    // Sums sourceCount channels into this one in a single pass over it. Silent sources are skipped.
+    void sumFrom(const AudioChannel * const * sourceChannels, size_t sourceCount);
+
+    // Sums sourceCount channels into this one in a single pass, each scaled by an exponential gain ramp from
+    // gains[i] toward targetGains[i] (see VectorMath::vrampsum). The ramps are advanced past this quantum,
+    // including those of silent sources.
+    void sumFrom(const AudioChannel * const * sourceChannels, float * gains, const float * targetGains, size_t sourceCount, float ratio);
+
+    // Sums from the source channel, scaled by one gain value per frame.
+    void sumFrom(const AudioChannel * sourceChannel, const float * gainValues);
+
     // Returns maximum absolute value (useful for normalization).
     float maxAbsValue() const;
 
 private:
 
+    // Prepares the whole channel to be summed into. Returns false if it is silent, in which case its samples
+    // are to be overwritten, so that a view of the shared zeroes is dropped without copying it.
+    bool prepareToSum();
+
+    // Returns to managed storage, optionally copying the borrowed samples into it first.
+    void releaseBorrow(bool copySamples);
+
     size_t m_length;
     float * m_rawPointer = nullptr;
     std::unique_ptr<AudioFloatArray> m_memBuffer;
     bool m_silent;
+    bool m_isBorrowed = false;
 };
 
 } // lab
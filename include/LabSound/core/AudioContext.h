@@ -7,6 +7,7 @@
 #define AUDIO_CONTEXT_H
 
 #include "LabSound/core/ConcurrentQueue.h"
+#include "LabSound/core/AudioEventQueue.h"
 #include "LabSound/core/AudioScheduledSourceNode.h"
 
 #include <set>
@@ -22,6 +23,8 @@
 namespace lab
 {
 
+class AudioBusPool;
+class RenderProfiler;
 class AudioDestinationNode;
 class AudioListener;
 class AudioNode;
@@ -37,6 +40,7 @@ class AudioContext
 
     friend class ContextGraphLock;
     friend class ContextRenderLock;
+    friend class AudioNode;
 
 public:
 
@@ -70,16 +74,28 @@ public:
 
     AudioListener & listener();
 
+    // Quantum-sized buses recycled by node inputs and outputs when their channel count changes,
+    // so that the render thread doesn't allocate.
+    AudioBusPool & busPool();
+
+    // Opt-in timing of nodes and render quanta; see RenderProfiler.
+    RenderProfiler & profiler();
+
     unsigned long activeSourceCount() const;
 
     void incrementActiveSourceCount();
     void decrementActiveSourceCount();
 
+    // Number of nodes whose processing was skipped during the most recently rendered quantum
+    // because their inputs were silent and their tails had expired. Can be read from any thread.
+    uint32_t skippedNodeCount() const { return m_skippedNodesLastQuantum.load(std::memory_order_relaxed); }
+
     void handlePreRenderTasks(ContextRenderLock &); // Called at the start of each render quantum.
     void handlePostRenderTasks(ContextRenderLock &); // Called at the end of each render quantum.
 
     // AudioContext can pull node(s) at the end of each render quantum even when they are not connected to any downstream nodes.
     // These two methods are called by the nodes who want to add/remove themselves into/from the automatic pull lists.
+    // To observe a node that is rendered anyway, an AudioTap on its output is cheaper; see AudioNodeOutput::addTap().
     void addAutomaticPullNode(std::shared_ptr<AudioNode>);
     void removeAutomaticPullNode(std::shared_ptr<AudioNode>);
 
@@ -90,20 +106,45 @@ public:
     void connect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, uint32_t destIdx = 0, uint32_t srcIdx = 0);
     void disconnect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, uint32_t destIdx = 0, uint32_t srcidx = 0);
 
+    // Connects like connect(), with the connection scaled by a gain as the destination's input sums it. A fader in front of
+    // a summing input then costs a fused multiply-add rather than a GainNode with a bus of its own. The gain is de-zippered,
+    // unless it is automated or driven by connectParam(), in which case it is applied sample-accurately. One gain can be
+    // shared by several connections, and connecting again with another gain replaces it. Returns the created gain.
+    std::shared_ptr<AudioParam> connectWithGain(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, float gain = 1.f, uint32_t destIdx = 0, uint32_t srcIdx = 0);
+    void connectWithGain(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, std::shared_ptr<AudioParam> gain, uint32_t destIdx = 0, uint32_t srcIdx = 0);
+
     void connectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, uint32_t index);
 
+    // Keeps node alive until it has finished playing, then disconnects it. For many short sounds, a OneShotNode
+    // plays them from a pool of voices without creating a node for each.
     void holdSourceNodeUntilFinished(std::shared_ptr<AudioScheduledSourceNode> node);
 
     // Necessary to call when using an OfflineAudioDestinationNode
     void startRendering();
     std::function<void()> offlineRenderCompleteCallback;
 
+    // Number of events the queue holds before postEvent() starts dropping them.
+    enum { EventQueueCapacity = 1024 };
+
     // event dispatching will be called automatically, depending on constructor
     // argument. If not automatically dispatching, it is the user's responsibility
     // to call dispatchEvents often enough to satisfy the user's needs.
+    //
+    // postEvent() is safe to call from the render thread: fn is stored inline in the event queue (see
+    // AudioEventQueue), and the update thread is woken at most once per render quantum for everything
+    // posted during it. Returns false, and counts the event as dropped, if the queue is full.
+    template<typename F>
+    bool postEvent(F && fn) { return m_events.post(std::forward<F>(fn)); }
+
+    // Copies fn, which allocates if its target doesn't fit std::function's own small buffer. Prefer postEvent().
     void enqueueEvent(std::function<void()>&);
     void dispatchEvents();
 
+    // Events posted and dispatched so far, and events dropped because the queue was full.
+    uint64_t postedEventCount() const { return m_events.postedCount(); }
+    uint64_t dispatchedEventCount() const { return m_events.dispatchedCount(); }
+    uint64_t droppedEventCount() const { return m_events.droppedCount(); }
+
 private:
 
     std::mutex m_graphLock;
@@ -120,68 +161,47 @@ private:
     bool m_isInitialized = false;
     bool m_isAudioThreadFinished = false;
     bool m_isOfflineContext = false;
-    bool m_automaticPullNodesNeedUpdating = false; // keeps track if m_automaticPullNodes is modified.
+    std::atomic<bool> m_automaticPullNodesNeedUpdating{ false }; // keeps track if m_automaticPullNodes is modified.
 
     // Number of SampledAudioNode that are active (playing).
     std::atomic<int> m_activeSourceCount;
 
+    // Silent nodes skipped by AudioNode::processIfNecessary. Counted on the audio thread and published once per quantum.
+    uint32_t m_skippedNodesThisQuantum = 0;
+    std::atomic<uint32_t> m_skippedNodesLastQuantum{ 0 };
+
     void uninitialize();
 
     void handleAutomaticSources();
+    void wakeForPostedEvents();
     void updateAutomaticPullNodes();
+    void releaseRetiredAutomaticPullNodes();
+
+    // Graph edits made through connect() and disconnect() are handed to the audio thread, which applies
+    // them at the start of the render quantum containing their scheduled frame. Applied edits are released
+    // by the update thread.
+    enum class ConnectionType : int;
+    void scheduleGraphEdit(ConnectionType, std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, uint32_t destIdx, uint32_t srcIdx, std::shared_ptr<AudioParam> gain = nullptr);
+    void applyScheduledGraphEdits(ContextRenderLock &);
+    void applyDueGraphEdits(ContextGraphLock &);
+    void releaseRetiredGraphEdits();
 
     std::shared_ptr<AudioDestinationNode> m_destinationNode;
     std::shared_ptr<AudioListener> m_listener;
 
-    // @TODO migrate most of the internal datastructures such as PendingConnection
+    AudioEventQueue m_events{ EventQueueCapacity };
+
+    // @TODO migrate the remaining internal datastructures such as pendingParamConnections
     // into Internals as there's no need to expose these at all.
     struct Internals;
     std::unique_ptr<Internals> m_internal;
 
     std::set<std::shared_ptr<AudioNode>> m_automaticPullNodes; // queue for added pull nodes
     std::vector<std::shared_ptr<AudioNode>> m_renderingAutomaticPullNodes; // vector of known pull nodes
+    std::vector<std::shared_ptr<AudioNode>> m_pendingAutomaticPullNodes; // the next m_renderingAutomaticPullNodes, or the last one swapped out
 
     std::vector<std::shared_ptr<AudioScheduledSourceNode>> automaticSources;
 
-    enum class ConnectionType : int
-    {
-        Disconnect = 0,
-        Connect,
-        FinishDisconnect
-    };
-
-    struct PendingConnection
-    {
-        ConnectionType type;
-        std::shared_ptr<AudioNode> destination;
-        std::shared_ptr<AudioNode> source;
-        uint32_t destIndex;
-        uint32_t srcIndex;
-        float duration = 0.1f;
-        
-        PendingConnection(
-            std::shared_ptr<AudioNode> destination,
-            std::shared_ptr<AudioNode> source,
-            ConnectionType t,
-            uint32_t destIndex = 0,
-            uint32_t srcIndex = 0)
-        : type(t), destination(destination), source(source), destIndex(destIndex), srcIndex(srcIndex) { }
-    };
-
-    struct CompareScheduledTime
-    {
-        bool operator()(const PendingConnection & p1, const PendingConnection & p2)
-        {
-            if (!p1.destination || !p2.destination) return false;
-            if (!p2.destination->isScheduledNode()) return false; // src cannot be compared
-            if (!p1.destination->isScheduledNode()) return false; // dest cannot be compared
-            AudioScheduledSourceNode * ap2 = static_cast<AudioScheduledSourceNode*>(p2.destination.get());
-            AudioScheduledSourceNode * ap1 = static_cast<AudioScheduledSourceNode*>(p1.destination.get());
-            return ap2->startTime() < ap1->startTime();
-        }
-    };
-
-    std::priority_queue<PendingConnection, std::deque<PendingConnection>, CompareScheduledTime> pendingNodeConnections;
     std::queue<std::tuple<std::shared_ptr<AudioParam>, std::shared_ptr<AudioNode>, uint32_t>> pendingParamConnections;
 };
 
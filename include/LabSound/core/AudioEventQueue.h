@@ -0,0 +1,111 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef AudioEventQueue_h
+#define AudioEventQueue_h
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+
+namespace lab
+{
+
+// AudioEventQueue carries events from the render thread to the thread that dispatches them, which is the
+// context's update thread unless events are dispatched by hand. Each AudioContext owns one.
+//
+// An event is any callable of up to MaxEventSize bytes, for example a lambda capturing a few values or a
+// shared_ptr. It is moved into a preallocated slot, so posting never allocates, locks or makes a system call;
+// when every slot is taken the event is dropped and counted in droppedCount(). Any thread may post, and
+// events are dispatched in the order their slots were claimed.
+class AudioEventQueue
+{
+    AudioEventQueue(const AudioEventQueue&); // noncopyable
+
+public:
+
+    enum { MaxEventSize = 64 };
+
+    // The capacity is rounded up to a power of two.
+    explicit AudioEventQueue(size_t capacity);
+
+    // Events that were never dispatched are destroyed without being run.
+    ~AudioEventQueue();
+
+    template<typename F>
+    bool post(F && fn)
+    {
+        typedef typename std::decay<F>::type Event;
+        static_assert(sizeof(Event) <= MaxEventSize, "Event is too large to store inline; capture a pointer to shared state instead");
+        static_assert(alignof(Event) <= alignof(std::max_align_t), "Event is over-aligned");
+
+        size_t position;
+        Slot * slot = claim(position);
+        if (!slot)
+        {
+            m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        new (slot->storage) Event(std::forward<F>(fn));
+        slot->invoke = &invokeEvent<Event>;
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Runs and destroys the events posted before the call. Events posted by the handlers themselves wait for
+    // the next call. Returns the number of events run.
+    size_t dispatch();
+
+    size_t capacity() const { return m_mask + 1; }
+
+    // True if there are posted events that haven't been dispatched yet.
+    bool hasPendingEvents() const
+    {
+        return m_enqueuePosition.load(std::memory_order_acquire) != m_dequeuePosition.load(std::memory_order_acquire);
+    }
+
+    // Counters can be read from any thread. postedCount() only grows, so a reader can tell whether
+    // anything was posted since it last looked.
+    uint64_t postedCount() const { return m_enqueuePosition.load(std::memory_order_acquire); }
+    uint64_t dispatchedCount() const { return m_dequeuePosition.load(std::memory_order_acquire); }
+    uint64_t droppedCount() const { return m_droppedCount.load(std::memory_order_relaxed); }
+
+private:
+
+    // A slot's sequence tells who may touch it: position when it is free for the producer of that position,
+    // position + 1 once its event is published, and position + capacity once the event has been dispatched.
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        void (*invoke)(void * storage, bool run);
+        alignas(std::max_align_t) unsigned char storage[MaxEventSize];
+    };
+
+    template<typename Event>
+    static void invokeEvent(void * storage, bool run)
+    {
+        Event & event = *static_cast<Event*>(storage);
+        if (run)
+            event();
+        event.~Event();
+    }
+
+    Slot * claim(size_t & position);
+    size_t drain(bool run);
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask;
+
+    alignas(64) std::atomic<size_t> m_enqueuePosition{ 0 };
+    alignas(64) std::atomic<size_t> m_dequeuePosition{ 0 };
+    std::atomic<uint64_t> m_droppedCount{ 0 };
+};
+
+} // namespace lab
+
+#endif // AudioEventQueue_h
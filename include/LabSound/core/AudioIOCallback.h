@@ -16,6 +16,9 @@ struct AudioIOCallback
     // render() is called periodically to get the next render quantum of audio into destinationBus.
     // Optional audio input is given in sourceBus (if it's not 0).
     virtual void render(AudioBus * sourceBus, AudioBus * destinationBus, size_t framesToProcess) = 0;
+
+    // Called by the device when it reports that audio was dropped or repeated (an underrun or overrun).
+    virtual void deviceXRun() {}
     virtual ~AudioIOCallback() {}
 };
 
@@ -99,6 +99,7 @@ public:
 
     // propagatesSilence() should return true if the node will generate silent output when given silent input. By default, AudioNode
     // will take tailTime() and latencyTime() into account when determining whether the node will propagate silence.
+    // Nodes which propagate silence are not processed at all while their inputs are silent.
     virtual bool propagatesSilence(ContextRenderLock & r) const;
 
     bool inputsAreSilent(ContextRenderLock&);
@@ -143,6 +144,9 @@ private:
     double m_lastProcessingTime{ -1.0 };
     double m_lastNonSilentTime{ -1.0 };
 
+    // Set by the default propagatesSilence() once the tail has expired, cleared by non-silent input.
+    mutable bool m_tailExpired{ false };
+
     float audibleThreshold() const { return 0.05f; }
 
     // starts an immediate ramp to zero in preparation for disconnection
@@ -163,6 +167,13 @@ private:
         m_connectSchedule = 0.f;
     }
 
+    // connects without a ramp, for a source that is silent until it plays from its first frame
+    void scheduleConnectWithoutRamp()
+    {
+        m_disconnectSchedule = -1.f;
+        m_connectSchedule = 1.f;
+    }
+
     // returns true if the connection has ramped to unity
     // This is intended to signal when the danger of possible popping artifacts has passed
     bool connectionReady() const { return m_connectSchedule > (1.f - audibleThreshold()); }
@@ -170,6 +181,10 @@ private:
     std::atomic<float> m_disconnectSchedule{ -1.f };
     std::atomic<float> m_connectSchedule{ 0.f };
 
+    // Where the context's RenderProfiler keeps this node's statistics. Only touched on the audio thread.
+    uint32_t m_profileIndex{ 0 };
+    uint32_t m_profileEpoch{ 0 };
+
 protected:
 
     std::vector<std::shared_ptr<AudioParam>> m_params;
@@ -15,9 +15,11 @@ namespace lab {
 class AudioNode;
 class AudioNodeOutput;
 class AudioBus;
+class AudioParam;
 
 // An AudioNodeInput represents an input to an AudioNode and can be connected from one or more AudioNodeOutputs.
-// In the case of multiple connections, the input will act as a unity-gain summing junction, mixing all the outputs.
+// In the case of multiple connections, the input will act as a summing junction, mixing all the outputs at unity gain
+// unless a connection was made with a gain of its own, which is applied as the connection is summed.
 // The number of channels of the input's bus is the maximum of the number of channels of all its connections.
 class AudioNodeInput : public AudioSummingJunction 
 {
@@ -33,7 +35,13 @@ public:
     AudioNode* node() const { return m_node; }
 
     // Must be called with the context's graph lock. Static because a shared pointer to this is required
-    static void connect(ContextGraphLock &, std::shared_ptr<AudioNodeInput> fromInput, std::shared_ptr<AudioNodeOutput> toOutput);
+    // If gain is not null, the connection is scaled by it when it is summed; a fader in front of a summing input
+    // then needs neither a GainNode nor a bus of its own. Connecting again with a gain replaces the connection's gain.
+    static void connect(ContextGraphLock &, std::shared_ptr<AudioNodeInput> fromInput, std::shared_ptr<AudioNodeOutput> toOutput, std::shared_ptr<AudioParam> gain = nullptr);
+
+    // As above, with the connection's gain state made in advance, so that connecting doesn't allocate once the input
+    // and output have reserved room for the connection; see AudioSummingJunction::reserveConnection().
+    static void connect(ContextGraphLock &, std::shared_ptr<AudioNodeInput> fromInput, std::shared_ptr<AudioNodeOutput> toOutput, std::shared_ptr<ConnectionGain> gain);
     static void disconnect(ContextGraphLock &, std::shared_ptr<AudioNodeInput> fromInput, std::shared_ptr<AudioNodeOutput> toOutput);
 
     // pull() processes all of the AudioNodes connected to this NodeInput.
@@ -7,8 +7,10 @@
 
 #include "LabSound/core/AudioNode.h"
 #include "LabSound/core/AudioParam.h"
+#include "LabSound/core/AudioTap.h"
 
 #include <set>
+#include <vector>
 
 namespace lab {
 
@@ -51,9 +53,21 @@ public:
 
     bool isConnected() { return fanOutCount() > 0 || paramFanOutCount() > 0; }
     
+    // Taps observe the rendered bus each quantum, read-only, without being connected; see AudioTap. Any number of them can
+    // observe an output, at the cost of a call each. They are held by the output until removed.
+    void addTap(ContextRenderLock &, std::shared_ptr<AudioTap>);
+    void removeTap(ContextRenderLock &, std::shared_ptr<AudioTap>);
+    bool hasTaps() const { return !m_taps.empty(); }
+
+    // Called by our AudioNode on the audio thread once it has rendered the quantum, or silenced it.
+    void notifyTaps(ContextRenderLock &, size_t framesToProcess);
+
     // updateRenderingState() is called in the audio thread at the start or end of the render quantum to handle any recent changes to the graph state.
     void updateRenderingState(ContextRenderLock&);
 
+    // Makes room for one more input, so that connecting it later, on the audio thread, doesn't allocate.
+    void reserveInput(ContextGraphLock &);
+
     // Must be called within the context's graph lock.
     static void disconnectAll(ContextGraphLock &, std::shared_ptr<AudioNodeOutput>);
     static void disconnectAllInputs(ContextGraphLock&, std::shared_ptr<AudioNodeOutput>);
@@ -84,8 +98,11 @@ private:
     size_t paramFanOutCount();
 
     // updateInternalBus() updates m_internalBus appropriately for the number of channels.
-    // It is called in the constructor or in the audio thread with the context's graph lock.
-    void updateInternalBus();
+    // It is called in the audio thread with the context's render lock.
+    void updateInternalBus(ContextRenderLock&);
+
+    // Swaps m_internalBus for a pooled bus with the given number of channels.
+    void replaceInternalBus(ContextRenderLock&, size_t numberOfChannels);
 
     // Announce to any nodes we're connected to that we changed our channel count for its input.
     void propagateChannelCount(ContextRenderLock&);
@@ -103,6 +120,7 @@ private:
     AudioBus* m_inPlaceBus;
     
     std::vector<std::shared_ptr<AudioNodeInput>> m_inputs;
+    size_t m_reservedInputs = 0; // by reserveInput(), and not yet connected
     
 private:    
     // For the purposes of rendering, keeps track of the number of inputs and AudioParams we're connected to.
@@ -111,6 +129,9 @@ private:
     size_t m_renderingParamFanOutCount;
 
     std::set<std::shared_ptr<AudioParam>> m_params;
+
+    // Only changed with the context's render lock, so the audio thread reads it without one.
+    std::vector<std::shared_ptr<AudioTap>> m_taps;
     typedef std::set<AudioParam*>::iterator ParamsIterator;
 };
 
@@ -7,6 +7,8 @@
 
 #include "LabSound/core/AudioSourceNode.h"
 
+#include <functional>
+
 namespace lab {
 
 class AudioBus;
@@ -48,7 +50,10 @@ public:
     // This is to save the cost of a dynamic_cast when scheduling nodes.
     virtual bool isScheduledNode() const override { return true; }
 
-    void setOnEnded(std::function<void()> fn) { m_onEnded = fn; }
+    void setOnEnded(std::function<void()> fn)
+    {
+        m_onEnded = fn ? std::make_shared<std::function<void()>>(std::move(fn)) : nullptr;
+    }
 
 protected:
 
@@ -79,7 +84,8 @@ protected:
     // has been reached.
     double m_endTime; // in seconds
 
-    std::function<void()> m_onEnded;
+    // Held by pointer so that finish() can post it to the context without copying the function.
+    std::shared_ptr<std::function<void()>> m_onEnded;
 };
 
 } // namespace lab
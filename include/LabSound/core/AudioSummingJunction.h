@@ -13,9 +13,24 @@ namespace lab {
 class AudioContext;
 class AudioNodeOutput;
 class AudioBus;
+class AudioParam;
 class ContextGraphLock;
 class ContextRenderLock;
 
+// The gain applied to one connection of a summing junction as the junction sums it, in place of a GainNode.
+struct ConnectionGain
+{
+    explicit ConnectionGain(std::shared_ptr<AudioParam> param);
+    ~ConnectionGain();
+
+    std::shared_ptr<AudioParam> param;
+
+    // De-zippering state and sample-accurate gain values, owned by the audio thread.
+    float lastGain = 1.f;
+    bool isFirstTime = true;
+    std::vector<float> values;
+};
+
 // An AudioSummingJunction represents a point where zero, one, or more AudioNodeOutputs connect.
 
 class AudioSummingJunction {
@@ -41,12 +56,26 @@ public:
     
     const std::shared_ptr<AudioNodeOutput> renderingOutput(ContextRenderLock&, unsigned i) const {
         return i < m_renderingOutputs.size() ? m_renderingOutputs[i].lock() : nullptr; }
+
+    // The gain of the rendering connection at index i, or null if it is summed at unity gain.
+    ConnectionGain * renderingGain(ContextRenderLock&, unsigned i) const {
+        return i < m_renderingGains.size() ? m_renderingGains[i].get() : nullptr; }
     
     bool isConnected() const { return numberOfConnections() > 0; }
 
     virtual void didUpdate(ContextRenderLock&) = 0;
 
-    void junctionConnectOutput(std::shared_ptr<AudioNodeOutput>);
+    // If gain is not null, the connection is scaled by it, replacing the gain of an existing connection
+    // unless that already has the same parameter.
+    void junctionConnectOutput(std::shared_ptr<AudioNodeOutput>, std::shared_ptr<ConnectionGain> gain = nullptr);
+
+    // Makes room for one more connection, so that making it later, on the audio thread, doesn't allocate.
+    void reserveConnection();
+
+    // Releases the gains of connections that have been removed or replaced, and are no longer rendered. The
+    // connections may change on the audio thread, so this is left to another thread to call.
+    void releaseRetiredGains();
+
     void junctionDisconnectOutput(std::shared_ptr<AudioNodeOutput>);
 	void junctionDisconnectAllOutputs();
     void setDirty() { m_renderingStateNeedUpdating = true; }
@@ -67,6 +96,22 @@ protected:
     // Most of the time, m_renderingOutputs is identical to m_outputs.
     std::vector<std::weak_ptr<AudioNodeOutput>> m_renderingOutputs;
 
+    // The gains of the connections, parallel to m_connectedOutputs and m_renderingOutputs. Null for unity gain.
+    std::vector<std::shared_ptr<ConnectionGain>> m_connectedGains;
+    std::vector<std::shared_ptr<ConnectionGain>> m_renderingGains;
+
+    // Gains removed from m_connectedGains are kept here until m_renderingGains has let go of them, so that none is
+    // destroyed on the audio thread. The first m_releasableGainCount of them are no longer rendered, and are
+    // released by releaseRetiredGains(), or with the junction.
+    std::vector<std::shared_ptr<ConnectionGain>> m_retiredGains;
+    size_t m_releasableGainCount = 0;
+
+    // Connections reserved by reserveConnection() and not yet made.
+    size_t m_reservedConnections = 0;
+
+    // Called with the junction's lock held, by the thread changing the connections.
+    void retireGain(std::shared_ptr<ConnectionGain> gain);
+
     // m_renderingStateNeedUpdating indicates outputs were changed
     bool m_renderingStateNeedUpdating;
 };
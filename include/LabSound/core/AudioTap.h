@@ -0,0 +1,30 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef AudioTap_h
+#define AudioTap_h
+
+#include <stddef.h>
+
+namespace lab
+{
+
+class AudioBus;
+class AudioNodeOutput;
+class ContextRenderLock;
+
+// An AudioTap observes the audio rendered by an AudioNodeOutput, without being connected to it. It adds no edge to the
+// graph, so it neither pulls the node nor holds it in the graph: it only hears outputs that are rendered anyway.
+// See AudioNodeOutput::addTap().
+struct AudioTap
+{
+    // Called on the audio thread, right after the output's node has processed, with the bus it rendered. The bus is
+    // only valid during the call. Like process(), rendered() must not block or allocate.
+    virtual void rendered(ContextRenderLock &, const AudioNodeOutput &, const AudioBus & bus, size_t framesToProcess) = 0;
+
+    virtual ~AudioTap() {}
+};
+
+} // lab
+
+#endif // AudioTap_h
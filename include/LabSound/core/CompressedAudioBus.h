@@ -0,0 +1,71 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef CompressedAudioBus_h
+#define CompressedAudioBus_h
+
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+namespace lab {
+
+class AudioBus;
+
+// A CompressedAudioBus holds sample data for playback in less memory than an AudioBus, which stores 32 bit floats.
+// It isn't processed in place, but decoded a run of frames at a time, as SampledAudioNode does for the frames it
+// reads each render quantum; see SampledAudioNode::setCompressedBus().
+//
+// Int16 and Int24 store samples as integers, at a half and three quarters of the size of floats. ImaAdpcm stores
+// four bits a sample, an eighth of the size, with the loss of quality usual for IMA ADPCM; it suits effects and
+// ambiences better than music. Its samples are coded in blocks of ImaAdpcmBlockLength frames, each of which starts
+// with its own decoder state, so any run of frames can be decoded by starting at the block that contains it.
+class CompressedAudioBus
+{
+    CompressedAudioBus(const CompressedAudioBus&); // noncopyable
+
+public:
+
+    enum class Format { Int16, Int24, ImaAdpcm };
+
+    enum { ImaAdpcmBlockLength = 256 };
+
+    // Allocates storage for numberOfChannels channels of length frames, to be filled by encodeChannel().
+    CompressedAudioBus(Format format, size_t numberOfChannels, size_t length, float sampleRate);
+
+    // Encodes every channel of sourceBus.
+    static std::shared_ptr<CompressedAudioBus> create(const AudioBus & sourceBus, Format format);
+
+    // Encodes length() floats into a channel, each stride floats after the last, so that an interleaved source can
+    // be encoded without deinterleaving it first. Samples are clipped to [-1, 1].
+    void encodeChannel(size_t channel, const float * source, size_t stride = 1);
+
+    Format format() const { return m_format; }
+    size_t numberOfChannels() const { return m_channels.size(); }
+    size_t length() const { return m_length; }
+    float sampleRate() const { return m_sampleRate; }
+
+    // The encoded size of all channels.
+    size_t sizeInBytes() const;
+
+    // Runs of frames are cheapest to decode when they start on a multiple of the block length.
+    size_t blockLength() const { return m_format == Format::ImaAdpcm ? ImaAdpcmBlockLength : 1; }
+
+    // Decodes frames [startFrame, startFrame + frameCount) of a channel into destination. The range must lie within
+    // the bus. Doesn't allocate, so it may be called on the audio thread.
+    void decode(size_t channel, size_t startFrame, size_t frameCount, float * destination) const;
+
+    // Decodes the whole bus, for processing that needs floats.
+    std::unique_ptr<AudioBus> createDecodedBus() const;
+
+private:
+
+    Format m_format;
+    size_t m_length;
+    float m_sampleRate;
+    std::vector<std::vector<uint8_t>> m_channels;
+};
+
+} // namespace lab
+
+#endif // CompressedAudioBus_h
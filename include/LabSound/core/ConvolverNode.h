@@ -28,7 +28,8 @@ public:
     virtual void initialize() override;
     virtual void uninitialize() override;
 
-    // Impulse responses
+    // Impulse responses. Mono, stereo and four channel (true-stereo) responses render stereo; a response of five
+    // to eight channels renders one output channel per response channel.
     void setImpulse(std::shared_ptr<AudioBus> bus);
     std::shared_ptr<AudioBus> getImpulse();
 
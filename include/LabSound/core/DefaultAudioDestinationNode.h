@@ -7,28 +7,74 @@
 
 #include "LabSound/core/AudioDestinationNode.h"
 
+#include <functional>
+
 namespace lab {
 
+class AudioBus;
 class AudioContext;
 struct AudioDestination;
-    
+
+// Where a DefaultAudioDestinationNode sends the audio it renders.
+enum class AudioDestinationBackend
+{
+    Platform,    // the default audio device of the platform
+    Null,        // no device: a timer renders one quantum at a time at real-time pace
+    FreeRunning, // no device: a thread renders quanta back to back as fast as the graph allows
+};
+
+// Settings for the audio device opened by the Platform backend. Backends that can't honor a setting
+// ignore it; currently only the Linux backend honors them all.
+struct AudioDeviceConfiguration
+{
+    // Frames per device callback, which the device may round. Zero asks for one render quantum. Larger
+    // buffers, holding several quanta, trade latency for resilience against scheduling hiccups.
+    unsigned bufferFrames = 0;
+
+    // Number of device buffers queued ahead of playback. Zero lets the device decide.
+    unsigned numberOfBuffers = 0;
+
+    // Whether to open an input stream for AudioHardwareSourceNode. Output-only streams don't need a
+    // microphone and avoid the latency of synchronizing input with output.
+    bool enableInput = true;
+    unsigned inputChannels = 1;
+};
+
+// Receives each rendered quantum from the Null and FreeRunning backends, on their render thread. The bus
+// is only valid for the duration of the call.
+typedef std::function<void(const AudioBus & output, size_t framesToProcess)> HeadlessRenderCallback;
+
 class DefaultAudioDestinationNode final : public AudioDestinationNode 
 {
     std::unique_ptr<AudioDestination> m_destination;
+    AudioDestinationBackend m_backend;
+    HeadlessRenderCallback m_headlessCallback;
+    AudioDeviceConfiguration m_deviceConfiguration;
 
     void createDestination();
     
 public:
 
-    DefaultAudioDestinationNode(AudioContext* context, unsigned channelCount, const float sampleRate);
+    // The headless backends need no audio device, so they can drive a realtime context on machines
+    // without one. headlessCallback is ignored by the Platform backend.
+    DefaultAudioDestinationNode(AudioContext* context, unsigned channelCount, const float sampleRate,
+        AudioDestinationBackend backend = AudioDestinationBackend::Platform, HeadlessRenderCallback headlessCallback = {});
+
+    DefaultAudioDestinationNode(AudioContext* context, unsigned channelCount, const float sampleRate, const AudioDeviceConfiguration & deviceConfiguration);
     virtual ~DefaultAudioDestinationNode();
     
     virtual void initialize() override;
     virtual void uninitialize() override;
     virtual void startRendering() override;
     
+    AudioDestinationBackend backend() const { return m_backend; }
+
     unsigned maxChannelCount() const;
     virtual void setChannelCount(ContextGraphLock &, size_t) override;
+
+    // Reopens the device with the new configuration if it is already running.
+    const AudioDeviceConfiguration & deviceConfiguration() const { return m_deviceConfiguration; }
+    void setDeviceConfiguration(ContextGraphLock &, const AudioDeviceConfiguration &);
 };
 
 } // namespace lab
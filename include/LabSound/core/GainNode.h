@@ -15,6 +15,7 @@ class AudioContext;
     
 // GainNode is an AudioNode with one input and one output which applies a gain (volume) change to the audio signal.
 // De-zippering (smoothing) is applied when the gain value is changed dynamically.
+// A GainNode in front of a summing input is better made a connection gain (see AudioContext::connectWithGain).
 class GainNode : public AudioNode 
 {
     
@@ -10,6 +10,8 @@
 #include "LabSound/core/AudioParam.h"
 #include "LabSound/core/FloatPoint3D.h"
 
+#include <atomic>
+
 namespace lab {
 
 // PannerNode is an AudioNode with one input and one output.
@@ -140,6 +142,14 @@ protected:
     std::unique_ptr<ConeEffect> m_coneEffect;
 
     float m_lastGain = -1.0f;
+
+    // The cone gain of the last quantum, and what it was computed from. It is only recomputed when one of them changes.
+    FloatPoint3D m_conePosition;
+    FloatPoint3D m_coneOrientation;
+    FloatPoint3D m_coneListenerPosition;
+    double m_cachedConeGain = 1.0;
+    std::atomic<bool> m_coneGainIsValid{ false }; // cleared by the cone setters, on any thread
+
     float m_sampleRate;
 };
 
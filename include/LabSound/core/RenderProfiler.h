@@ -0,0 +1,149 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef RenderProfiler_h
+#define RenderProfiler_h
+
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace lab
+{
+
+class AudioNode;
+
+// Statistics for one node, as of a RenderProfiler::snapshot(). Times are in seconds and only count the
+// node's own processing, not the nodes it pulled its input from.
+struct NodeProfile
+{
+    const AudioNode * node = nullptr; // identifies the node; it may have been destroyed since
+    std::string typeName;
+    uint64_t processCount = 0;
+    double totalTime = 0;
+    double maxTime = 0;
+    double lastTime = 0;
+};
+
+// Statistics for whole render quanta, measured in AudioDestinationNode::render() against the time the
+// quantum represents (its budget).
+struct QuantumProfile
+{
+    uint64_t count = 0;
+    double budget = 0;    // of the most recent quantum
+    double lastTime = 0;
+    double maxTime = 0;
+    double totalTime = 0;
+
+    // Quanta that took longer to render than they last, and xruns reported by the audio device. A device
+    // xrun is counted whether or not profiling is enabled.
+    uint64_t deadlineMisses = 0;
+    uint64_t deviceXRuns = 0;
+
+    // The node that took longest during the most recent missed deadline.
+    const AudioNode * lastMissWorstNode = nullptr;
+    std::string lastMissWorstTypeName;
+    double lastMissWorstTime = 0;
+
+    double load() const { return budget > 0 ? lastTime / budget : 0; }
+};
+
+struct RenderProfile
+{
+    QuantumProfile quanta;
+    std::vector<NodeProfile> nodes;
+    uint64_t untrackedNodes = 0;     // node process() calls not counted because the table of MaxNodes was full
+    uint64_t droppedTraceEvents = 0; // trace events that didn't fit because the trace wasn't read often enough
+};
+
+// RenderProfiler is the opt-in render instrumentation of an AudioContext. While enabled, the audio thread
+// times each node's process() and each render quantum; with tracing also enabled, it records every one of
+// those spans so that they can be exported in the Chrome trace event format (chrome://tracing, Perfetto).
+//
+// Recording never allocates or locks: statistics are kept in a table of relaxed atomics and trace spans in a
+// fixed-size ring, so snapshot() and writeChromeTrace() can be called from any thread while rendering
+// continues. Each value of a snapshot is exact, but values may come from adjacent quanta. The table and the
+// ring are allocated by the thread that first enables profiling or tracing, so a context that is never
+// profiled doesn't pay for them.
+class RenderProfiler
+{
+    RenderProfiler(const RenderProfiler&); // noncopyable
+
+public:
+
+    enum
+    {
+        MaxNodes = 1024,
+        TraceCapacity = 1 << 16 // spans
+    };
+
+    RenderProfiler();
+    ~RenderProfiler();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled.load(std::memory_order_acquire); }
+
+    // Tracing records individual spans, and has no effect unless profiling is enabled as well.
+    void setTracing(bool tracing);
+    bool isTracing() const { return m_tracing.load(std::memory_order_acquire); }
+
+    // Clears all statistics at the start of the next render quantum.
+    void reset() { m_resetRequested.store(true, std::memory_order_release); }
+
+    RenderProfile snapshot() const;
+
+    // Writes the spans recorded since the previous call as a Chrome trace JSON document, and
+    // returns the number of spans written. Only one thread should read the trace at a time.
+    size_t writeChromeTrace(std::ostream & out);
+
+    // Called on the audio thread by AudioDestinationNode and AudioNode.
+    uint64_t now() const;
+    uint64_t beginQuantum();
+    void endQuantum(uint64_t start, double budget);
+    void recordNode(const AudioNode * node, uint32_t & index, uint32_t & epoch, uint64_t start, uint64_t end);
+
+    // May be called from the device thread whether or not profiling is enabled.
+    void recordDeviceXRun() { m_deviceXRuns.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+
+    struct NodeStats;
+    struct Trace;
+
+    void applyReset();
+    void trace(const AudioNode * node, uint64_t start, uint64_t end);
+
+    std::atomic<bool> m_enabled{ false };
+    std::atomic<bool> m_tracing{ false };
+    std::atomic<bool> m_resetRequested{ false };
+
+    std::atomic<NodeStats*> m_nodes{ nullptr }; // MaxNodes of them, once profiling has been enabled
+    std::atomic<uint32_t> m_nodeCount{ 0 };
+    std::atomic<uint64_t> m_untrackedNodes{ 0 };
+    uint32_t m_epoch = 1; // nodes holding an older epoch are assigned a fresh entry
+
+    // The slowest node of the quantum being rendered. Owned by the audio thread.
+    const AudioNode * m_worstNode = nullptr;
+    uint64_t m_worstNodeTime = 0;
+
+    std::atomic<uint64_t> m_quantumCount{ 0 };
+    std::atomic<uint64_t> m_quantumLastTime{ 0 };
+    std::atomic<uint64_t> m_quantumMaxTime{ 0 };
+    std::atomic<uint64_t> m_quantumTotalTime{ 0 };
+    std::atomic<double> m_quantumBudget{ 0 };
+    std::atomic<uint64_t> m_deadlineMisses{ 0 };
+    std::atomic<uint64_t> m_deviceXRuns{ 0 };
+
+    std::atomic<const AudioNode*> m_lastMissWorstNode{ nullptr };
+    std::atomic<const char*> m_lastMissWorstTypeName{ nullptr };
+    std::atomic<uint64_t> m_lastMissWorstTime{ 0 };
+
+    std::atomic<Trace*> m_trace{ nullptr }; // once tracing has been enabled
+};
+
+} // namespace lab
+
+#endif // RenderProfiler_h
@@ -15,6 +15,7 @@ namespace lab {
 
 class AudioContext;
 class AudioBus;
+class CompressedAudioBus;
 
 // This should  be used for short sounds which require a high degree of scheduling flexibility (can playback in rhythmically perfect ways).
 class SampledAudioNode final : public AudioScheduledSourceNode
@@ -32,6 +33,11 @@ public:
     bool setBus(ContextRenderLock &, std::shared_ptr<AudioBus> sourceBus);
     std::shared_ptr<AudioBus> getBus() const { return m_sourceBus; }
 
+    // Plays a compressed bus in place of a bus of floats, decoding only the frames read each render quantum.
+    // Setting either kind of bus clears the other.
+    bool setCompressedBus(ContextRenderLock &, std::shared_ptr<CompressedAudioBus> sourceBus);
+    std::shared_ptr<CompressedAudioBus> getCompressedBus() const { return m_compressedBus; }
+
     // numberOfChannels() returns the number of output channels. This value equals the number of channels from the buffer.
     // If a new buffer is set with a different number of channels, then this value will dynamically change.
     unsigned numberOfChannels(ContextRenderLock & r);
@@ -72,9 +78,25 @@ private:
     // Render silence starting from "index" frame in AudioBus.
     bool renderSilenceAndFinishIfNotLooping(ContextRenderLock & r, AudioBus *, unsigned index, size_t framesToProcess);
 
+    // The channel count, length, and sample rate of whichever bus is set.
+    bool hasSource() const { return m_sourceBus || m_compressedBus; }
+    size_t sourceChannelCount() const;
+    size_t sourceLength() const;
+    float sourceSampleRate() const;
+
+    // Decodes the run of compressed frames holding frame, and the frame after it if there is one, into m_decodeWindow.
+    void fillDecodeWindow(size_t frame);
+
     // m_buffer holds the sample data which this node outputs.
     std::shared_ptr<AudioBus> m_sourceBus;
 
+    // Or m_compressedBus does. Playback that interpolates reads each frame more than once, so it reads from frames
+    // decoded a window at a time.
+    std::shared_ptr<CompressedAudioBus> m_compressedBus;
+    std::unique_ptr<AudioBus> m_decodeWindow;
+    size_t m_decodeWindowStart{ 0 };
+    size_t m_decodeWindowLength{ 0 };
+
     // Used for the "gain" and "playbackRate" attributes.
     std::shared_ptr<AudioParam> m_gain;
     std::shared_ptr<AudioParam> m_playbackRate;
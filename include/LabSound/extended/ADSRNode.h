@@ -24,10 +24,12 @@ namespace lab
         ADSRNode();
         virtual ~ADSRNode();
         
-        // If noteOn is called before noteOff has finished, a pop can occur. Polling
-        // finished and avoiding noteOn while finished is true can avoid the popping.
-        void noteOn(double when);
-        void noteOff(ContextRenderLock&, double when);
+        // Notes start and stop at the sample frame of when, in context time; a time that has passed takes effect
+        // immediately. The envelope is rendered by an EnvelopeGenerator, so a noteOn before the release has finished
+        // restarts the attack from the current level without popping. Up to 64 notes may wait to start or stop; past
+        // that, the note is dropped and false is returned.
+        bool noteOn(double when);
+        bool noteOff(ContextRenderLock&, double when);
         
         bool finished(ContextRenderLock&); // if a noteOff has been issued, finished will be true after the release period
 
@@ -38,6 +40,11 @@ namespace lab
         std::shared_ptr<AudioParam> decayTime() const; // Duration in ms
         std::shared_ptr<AudioParam> sustainLevel() const; // Level 0-10
         std::shared_ptr<AudioParam> releaseTime() const; // Duration in ms
+
+        // Segment shapes, from -32 to 32: 0 is linear, negative curves are exponential-like (see EnvelopeSettings).
+        std::shared_ptr<AudioParam> attackCurve() const;
+        std::shared_ptr<AudioParam> decayCurve() const;
+        std::shared_ptr<AudioParam> releaseCurve() const;
     };
     
 }
@@ -40,7 +40,17 @@ namespace lab
             }
 #endif
         }
-        
+
+        // Non-blocking variant for the audio thread. context() returns nullptr if the lock is held elsewhere.
+        ContextGraphLock(AudioContext * context, const std::string & lockSuitor, std::try_to_lock_t) : m_context(nullptr)
+        {
+            if (context && context->m_graphLock.try_lock())
+            {
+                m_context = context;
+                m_context->m_graphLocker = lockSuitor;
+            }
+        }
+
         ~ContextGraphLock()
         {
             if (m_context)
@@ -5,6 +5,7 @@
 #define AudioFileReader_H
 
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/CompressedAudioBus.h"
 
 #include <memory>
 #include <vector>
@@ -13,8 +14,13 @@
 
 namespace lab
 {
+    // Each call decodes the file afresh, into a new bus. To share decoded samples between loads, see SampleCache.
     std::shared_ptr<AudioBus> MakeBusFromFile(const char * filePath, bool mixToMono);
     std::shared_ptr<AudioBus> MakeBusFromMemory(const std::vector<uint8_t> & buffer, std::string extension, bool mixToMono);
+
+    // Decodes the file straight into a compressed bus, for playback by SampledAudioNode::setCompressedBus(), without
+    // holding a planar float copy of it.
+    std::shared_ptr<CompressedAudioBus> MakeCompressedBusFromFile(const char * filePath, bool mixToMono, CompressedAudioBus::Format format);
 }
 
 #endif
@@ -0,0 +1,123 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef EnvelopeGenerator_h
+#define EnvelopeGenerator_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace lab
+{
+
+// The levels and segment times, in seconds, of an ADSR envelope. The curves shape the attack, decay and release
+// segments: 0 is linear, negative curves move quickly at first and settle slowly like the exponential segments of an
+// analog envelope, and positive curves do the opposite. Magnitudes around 4 to 8 are typical.
+struct EnvelopeSettings
+{
+    float attackTime = 0.05f;
+    float attackLevel = 1.f;
+    float decayTime = 0.05f;
+    float sustainLevel = 0.75f;
+    float releaseTime = 0.0625f;
+    float attackCurve = 0.f;
+    float decayCurve = 0.f;
+    float releaseCurve = 0.f;
+};
+
+// EnvelopeGenerator renders ADSR envelopes for a fixed number of voices. Its state is kept as a structure of arrays,
+// with one array per field indexed by voice. Each envelope is rendered a segment at a time from the segment's closed form
+// by the vector generators of VectorMath, rather than stepped one sample at a time.
+//
+// Gates open and close at a frame offset into the next call to process(), so that notes start and stop sample-accurately.
+// Opening the gate of a sounding voice restarts its attack from the current level, and closing it releases from the current
+// level, so retriggering doesn't pop. Everything is allocated by the constructor, and process() never allocates. Gates and
+// settings must be changed on the thread that calls process().
+class EnvelopeGenerator
+{
+    EnvelopeGenerator(const EnvelopeGenerator&); // noncopyable
+
+public:
+
+    enum class Stage : uint8_t { Idle, Attack, Decay, Sustain, Release };
+
+    // maxPendingGates bounds the gate events waiting for process(); zero allows four per voice.
+    EnvelopeGenerator(size_t voiceCount, float sampleRate, size_t maxPendingGates = 0);
+    ~EnvelopeGenerator();
+
+    size_t voiceCount() const { return m_stage.size(); }
+
+    float sampleRate() const { return m_sampleRate; }
+    void setSampleRate(float sampleRate) { m_sampleRate = sampleRate; }
+
+    // Settings are read as each segment begins, except for the sustain level, which a sustaining voice follows immediately.
+    void setSettings(size_t voice, const EnvelopeSettings &);
+    EnvelopeSettings settings(size_t voice) const;
+
+    // Opens or closes the gate of a voice frameOffset frames into the next call to process(). Offsets past the end of
+    // that call carry over to the calls that follow. Returns false if too many gate events are pending.
+    bool gateOn(size_t voice, size_t frameOffset = 0);
+    bool gateOff(size_t voice, size_t frameOffset = 0);
+
+    // Renders framesToProcess frames of each voice's envelope into outputs[voice]. A null outputs, or a null entry,
+    // advances the voices without rendering them.
+    void process(float * const * outputs, size_t framesToProcess);
+
+    Stage stage(size_t voice) const { return m_stage[voice]; }
+
+    // The level of the frame following the last one rendered.
+    float level(size_t voice) const { return m_level[voice]; }
+
+    // True if the voice is silent and has no gate waiting to open.
+    bool isIdle(size_t voice) const;
+
+    // Silences every voice and drops pending gate events.
+    void reset();
+
+private:
+
+    struct GateEvent
+    {
+        uint32_t voice;
+        uint32_t sequence; // submission order, preserved for events at the same offset
+        size_t offset;
+        bool on;
+    };
+
+    bool addGate(size_t voice, size_t frameOffset, bool on);
+    void applyGate(size_t voice, bool on);
+    void beginSegment(size_t voice, Stage stage, float endLevel, float time, float curve);
+    void finishSegment(size_t voice);
+    float segmentLevel(size_t voice, uint32_t position) const;
+    void renderVoice(size_t voice, float * output, size_t framesToProcess);
+
+    float m_sampleRate;
+
+    // Settings, per voice.
+    std::vector<float> m_attackTime;
+    std::vector<float> m_attackLevel;
+    std::vector<float> m_decayTime;
+    std::vector<float> m_sustainLevel;
+    std::vector<float> m_releaseTime;
+    std::vector<float> m_attackCurve;
+    std::vector<float> m_decayCurve;
+    std::vector<float> m_releaseCurve;
+
+    // State, per voice. A segment moves from its start level to its end level over its length in frames.
+    std::vector<Stage> m_stage;
+    std::vector<float> m_level;
+    std::vector<float> m_segmentStart;
+    std::vector<float> m_segmentEnd;
+    std::vector<float> m_segmentCurve;
+    std::vector<uint32_t> m_segmentPosition;
+    std::vector<uint32_t> m_segmentLength;
+
+    std::vector<GateEvent> m_events; // capacity is the maximum number of pending gates
+    size_t m_eventCount = 0;
+    uint32_t m_eventSequence = 0;
+};
+
+} // namespace lab
+
+#endif // EnvelopeGenerator_h
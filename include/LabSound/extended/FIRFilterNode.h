@@ -0,0 +1,36 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef FIR_FILTER_NODE_H
+#define FIR_FILTER_NODE_H
+
+#include "LabSound/core/AudioBasicProcessorNode.h"
+
+#include <vector>
+
+namespace lab
+{
+
+// Applies a finite impulse response to each channel by direct convolution, with no latency.
+// The cost grows with the kernel length, so this is meant for short kernels such as EQ, crossover or
+// fractional-delay filters; longer responses are cheaper through ConvolverNode.
+class FIRFilterNode : public AudioBasicProcessorNode
+{
+    class FIRFilterNodeInternal;
+    FIRFilterNodeInternal * internalNode; // We do not own this!
+
+public:
+
+    static const size_t MaxKernelSize = 1024;
+
+    FIRFilterNode();
+    virtual ~FIRFilterNode();
+
+    // The kernel is picked up at the start of a later render quantum. Taps beyond MaxKernelSize are dropped,
+    // and an empty kernel passes the input through unchanged.
+    void setKernel(const std::vector<float> & kernel);
+};
+
+} // namespace lab
+
+#endif
@@ -12,6 +12,7 @@
 #include "LabSound/core/StereoPannerNode.h"
 #include "LabSound/core/OscillatorNode.h"
 #include "LabSound/core/OfflineAudioDestinationNode.h"
+#include "LabSound/core/DefaultAudioDestinationNode.h"
 #include "LabSound/core/AudioHardwareSourceNode.h"
 #include "LabSound/core/GainNode.h"
 #include "LabSound/core/DynamicsCompressorNode.h"
@@ -23,12 +24,14 @@
 #include "LabSound/core/AudioScheduledSourceNode.h"
 #include "LabSound/core/AudioParam.h"
 #include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioTap.h"
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNode.h"
 #include "LabSound/core/AudioListener.h"
 #include "LabSound/core/AudioDestinationNode.h"
 #include "LabSound/core/AudioContext.h"
 #include "LabSound/core/SampledAudioNode.h"
+#include "LabSound/core/CompressedAudioBus.h"
 #include "LabSound/core/AudioBasicProcessorNode.h"
 #include "LabSound/core/AudioBasicInspectorNode.h"
 #include "LabSound/core/AnalyserNode.h"
@@ -36,10 +39,14 @@
 // LabSound Extended Public API
 #include "LabSound/extended/RealtimeAnalyser.h"
 #include "LabSound/extended/ADSRNode.h"
+#include "LabSound/extended/EnvelopeGenerator.h"
 #include "LabSound/extended/ClipNode.h"
 #include "LabSound/extended/DiodeNode.h"
+#include "LabSound/extended/FIRFilterNode.h"
 #include "LabSound/extended/FunctionNode.h"
+#include "LabSound/extended/LoudnessMeterNode.h"
 #include "LabSound/extended/NoiseNode.h"
+#include "LabSound/extended/OneShotNode.h"
 #include "LabSound/extended/PdNode.h"
 #include "LabSound/extended/PeakCompNode.h"
 #include "LabSound/extended/PowerMonitorNode.h"
@@ -47,6 +54,8 @@
 #include "LabSound/extended/SupersawNode.h"
 #include "LabSound/extended/SpatializationNode.h"
 #include "LabSound/extended/SpectralMonitorNode.h"
+#include "LabSound/extended/STFTAnalyserNode.h"
+#include "LabSound/extended/SampleCache.h"
 #include "LabSound/extended/SampledInstrumentNode.h"
 #include "LabSound/extended/RecorderNode.h"
 #include "LabSound/extended/AudioFileReader.h"
@@ -64,6 +73,11 @@ namespace lab
     std::shared_ptr<AudioHardwareSourceNode> MakeHardwareSourceNode(ContextRenderLock & r);
 
     std::unique_ptr<AudioContext> MakeRealtimeAudioContext(uint32_t numChannels, float sample_rate = LABSOUND_DEFAULT_SAMPLERATE);
+    std::unique_ptr<AudioContext> MakeRealtimeAudioContext(const AudioDeviceConfiguration & device, uint32_t numChannels, float sample_rate = LABSOUND_DEFAULT_SAMPLERATE);
+
+    // A realtime context rendered by one of the backends that need no audio device. See AudioDestinationBackend.
+    std::unique_ptr<AudioContext> MakeHeadlessAudioContext(uint32_t numChannels, AudioDestinationBackend backend,
+        HeadlessRenderCallback output = {}, float sample_rate = LABSOUND_DEFAULT_SAMPLERATE);
     std::unique_ptr<AudioContext> MakeOfflineAudioContext(uint32_t numChannels, float recordTimeMilliseconds);
     std::unique_ptr<AudioContext> MakeOfflineAudioContext(uint32_t numChannels, float recordTimeMilliseconds, float sample_rate);
 }
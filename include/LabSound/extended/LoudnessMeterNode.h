@@ -0,0 +1,102 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#pragma once
+
+#ifndef LOUDNESS_METER_NODE_H
+#define LOUDNESS_METER_NODE_H
+
+#include "LabSound/core/AudioBasicInspectorNode.h"
+#include "LabSound/core/AudioTap.h"
+
+#include <memory>
+
+namespace lab {
+
+    // A reading of a LoudnessMeter. Loudness is in LUFS, peaks and RMS in dBFS, and true peaks in dBTP. A level that
+    // hasn't been measured yet, or is silent, reads as -infinity.
+    struct LoudnessMeasurement
+    {
+        enum { MaxChannels = 8 };
+
+        float momentary;        // 400 ms window
+        float shortTerm;        // 3 s window
+        float integrated;       // gated, since reset
+        float maxMomentary;     // since reset
+        float maxShortTerm;     // since reset
+        float truePeak;         // highest of the channels' true peaks
+
+        size_t channelCount;
+        float channelTruePeak[MaxChannels]; // since reset
+        float channelPeak[MaxChannels];     // instantaneous rise, falling at the meter's peak fall rate
+        float channelRms[MaxChannels];      // averaged with the meter's RMS time constant
+
+        double duration;        // seconds measured since reset
+    };
+
+    // LoudnessMeter measures loudness as specified by ITU-R BS.1770-4 and EBU R 128: K-weighted momentary, short-term
+    // and gated integrated loudness, and true peak, from 4x oversampling. Alongside, it keeps a peak and RMS meter per
+    // channel. Six or more channels are taken to be in the L R C LFE Ls Rs order; the LFE is not measured, and the
+    // surround channels are weighted by +1.5 dB. Channels past MaxChannels are ignored.
+    //
+    // A LoudnessMeter is an AudioTap, so it can be added to any node's output (see AudioNodeOutput::addTap), or it can
+    // be fed a bus at a time by process(). It never allocates or locks on the audio thread. Every process() publishes a
+    // measurement, which read() fetches without blocking the audio thread.
+    class LoudnessMeter : public AudioTap
+    {
+    public:
+
+        LoudnessMeter();
+        virtual ~LoudnessMeter();
+
+        // Audio thread.
+        void process(const AudioBus & bus, size_t framesToProcess, float sampleRate);
+        virtual void rendered(ContextRenderLock &, const AudioNodeOutput &, const AudioBus & bus, size_t framesToProcess) override;
+
+        // Any thread. read() returns the most recently published measurement.
+        void read(LoudnessMeasurement & measurement) const;
+
+        // Restarts the integrated loudness, maxima and true peaks from the next render quantum.
+        void reset();
+
+        // Ballistics of the per channel meters. Peaks fall at 20 dB/s, and RMS is averaged over 300 ms, by default.
+        void setPeakFallRate(float decibelsPerSecond);
+        void setRmsTime(float seconds);
+
+    private:
+
+        struct Internals;
+        std::unique_ptr<Internals> m_internal;
+    };
+
+    // LoudnessMeterNode passes its input through unchanged, and measures it with a LoudnessMeter. To measure a node
+    // without adding one to the graph, add a LoudnessMeter to its output as a tap instead.
+    class LoudnessMeterNode : public AudioBasicInspectorNode
+    {
+    public:
+
+        LoudnessMeterNode();
+        virtual ~LoudnessMeterNode();
+
+        virtual void process(ContextRenderLock &, size_t framesToProcess) override;
+        virtual void reset(ContextRenderLock &) override;
+
+        void read(LoudnessMeasurement & measurement) const { m_meter->read(measurement); }
+        void resetMeasurement() { m_meter->reset(); }
+
+        std::shared_ptr<LoudnessMeter> meter() const { return m_meter; }
+
+    private:
+
+        // Silence is measured too, so that the loudness falls when the input stops.
+        virtual bool propagatesSilence(ContextRenderLock &) const override { return false; }
+
+        virtual double tailTime(ContextRenderLock &) const override { return 0; }
+        virtual double latencyTime(ContextRenderLock &) const override { return 0; }
+
+        std::shared_ptr<LoudnessMeter> m_meter;
+    };
+
+} // namespace lab
+
+#endif // LOUDNESS_METER_NODE_H
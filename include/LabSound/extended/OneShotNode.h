@@ -0,0 +1,65 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#pragma once
+
+#ifndef ONE_SHOT_NODE_H
+#define ONE_SHOT_NODE_H
+
+#include "LabSound/core/AudioSourceNode.h"
+
+#include <memory>
+
+namespace lab {
+
+    class AudioBus;
+
+    // OneShotNode plays fire-and-forget sounds, such as footsteps and gunshots, from a fixed pool of voices that are mixed
+    // into its output. Playing a sound needs no new node, no graph edit, and no call to holdSourceNodeUntilFinished.
+    //
+    // play() hands the sound to the audio thread through a lock-free queue, and it starts on the exact frame of when. A
+    // finished voice is handed back through another queue, and its bus is released by the next call to play() or
+    // releaseFinishedVoices(), so the audio thread never drops the last reference to a bus. Once every voice is busy,
+    // play() fails until one finishes.
+    //
+    // play(), stopAll() and releaseFinishedVoices() may be called from any thread other than the audio thread.
+    class OneShotNode : public AudioSourceNode
+    {
+    public:
+
+        OneShotNode(size_t voiceCount = 64, size_t channelCount = 2);
+        virtual ~OneShotNode();
+
+        virtual void process(ContextRenderLock &, size_t framesToProcess) override;
+        virtual void reset(ContextRenderLock &) override;
+
+        // Plays bus from its start at context time when, or as soon as possible if when has passed. The bus is resampled
+        // to the context's sample rate, and its channels are mixed to the node's. Returns false if no voice is free.
+        bool play(std::shared_ptr<AudioBus> bus, double when = 0, float gain = 1.f, float playbackRate = 1.f);
+
+        // Silences every voice at the start of the next render quantum.
+        void stopAll();
+
+        // Releases the buses of voices that have finished since the last call to play() or releaseFinishedVoices().
+        void releaseFinishedVoices();
+
+        size_t voiceCount() const;
+
+        // Voices playing or waiting to start, as of the last render quantum.
+        size_t activeVoiceCount() const;
+
+        // Calls to play() that failed because every voice was busy.
+        uint64_t droppedCount() const;
+
+    private:
+
+        // Silent and skipped while no voice is playing or about to.
+        virtual bool propagatesSilence(ContextRenderLock & r) const override;
+
+        struct Internals;
+        std::unique_ptr<Internals> m_internal;
+    };
+
+} // namespace lab
+
+#endif // ONE_SHOT_NODE_H
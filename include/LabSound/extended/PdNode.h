@@ -1,44 +1,75 @@
 // Copyright (c) 2003-2013 Nick Porcino, All rights reserved.
 // License is MIT: http://opensource.org/licenses/MIT
 
-// PureDataNode wraps an instance of pure-data as a signal processing node
+// PdNode wraps an instance of pure-data as a signal processing node
 
 #pragma once
 
+#ifndef PD_NODE_H
+#define PD_NODE_H
+
 #ifdef PD
 
-#include "LabSound/core/AudioBasicProcessorNode.h"
+#include "LabSound/core/AudioNode.h"
 
-namespace pd
-{
-    class PdBase;
-    class PdMidiReceiver;
-    class PdReceiver;
-}
+#include <memory>
+#include <string>
 
 namespace lab
 {
 
-class PureDataNode : public AudioBasicProcessorNode
+// Every PdNode runs its own Pd instance, so patches opened in one node don't see the
+// receivers, arrays or DSP state of another. This requires libpd to be built with
+// multiple instance support (PDINSTANCE and PDTHREADS, libpd's PD_MULTI option).
+//
+// The input is mixed to inputChannels channels, which the patch reads from its adc~
+// objects, and the output has outputChannels channels, written by its dac~ objects.
+//
+// With runOnWorkerThread, the instance renders on a thread of its own, one render
+// quantum behind the graph: each quantum hands the input to the worker and plays
+// what it rendered from the previous quantum's input. The extra quantum is reported
+// by latencyTime(). Many instances can then render in parallel, rather than one after
+// the other on the audio thread. If a worker hasn't finished in time, its output is
+// silent for that quantum, and lateQuantumCount() counts it.
+class PdNode : public AudioNode
 {
-    
+
 public:
-    
-    PureDataNode(AudioContext *, float sampleRate);
-    virtual ~PureDataNode();
-    
-    pd::PdBase & pd() const;
-    
-    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
-    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
-    
+
+    PdNode(float sampleRate, unsigned inputChannels = 2, unsigned outputChannels = 2, bool runOnWorkerThread = false);
+    virtual ~PdNode();
+
+    // AudioNode
+    virtual void process(ContextRenderLock &, size_t framesToProcess) override;
+    virtual void reset(ContextRenderLock &) override;
+
+    // Patches and messages. These may be called from any thread other than the audio
+    // thread; each briefly excludes the instance from rendering. openPatch returns false
+    // if the patch could not be opened.
+    bool openPatch(const std::string & file, const std::string & directory);
+    void closePatch();
+    void addToSearchPath(const std::string & path);
+    void sendBang(const std::string & receiver);
+    void sendFloat(const std::string & receiver, float value);
+    void sendSymbol(const std::string & receiver, const std::string & symbol);
+
+    bool runsOnWorkerThread() const;
+    uint64_t lateQuantumCount() const;
+
 private:
-    
-    class PureDataNodeInternal;
-    PureDataNodeInternal * data;
-    
+
+    // A generator patch makes sound from silent input, so a PdNode is never skipped.
+    virtual bool propagatesSilence(ContextRenderLock &) const override { return false; }
+
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override;
+
+    class PdNodeInternal;
+    std::unique_ptr<PdNodeInternal> data;
 };
 
 } // end namespace lab
 
-#endif
+#endif // PD
+
+#endif // PD_NODE_H
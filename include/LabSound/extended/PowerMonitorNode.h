@@ -7,8 +7,7 @@
 #define POWER_MONITOR_NODE_H
 
 #include "LabSound/core/AudioBasicInspectorNode.h"
-#include <vector>
-#include <mutex>
+#include <atomic>
 
 namespace lab {
     
@@ -23,8 +22,8 @@ namespace lab {
         virtual void process(ContextRenderLock&, size_t framesToProcess) override;
         virtual void reset(ContextRenderLock&) override;
 
-        // instantaneous estimation of power
-        float db() const { return _db; }
+        // instantaneous estimation of power, no lower than -120 dB; may be read from any thread
+        float db() const { return _db.load(std::memory_order_relaxed); }
 
         // Could be better. Power is computed on the most recent frame. If the framesize is greater
         // than the windowSize, then power is returned for the windowed end-of-frame. If framesize
@@ -37,16 +36,18 @@ namespace lab {
         // The intent of the power monitor node is to provide levels that can be used for a VU meter
         // or a ducking algorithm.
         //
-        void windowSize(size_t ws) { _windowSize = ws; }
-        size_t windowSize() const { return _windowSize; }
+        // For loudness, true peak, or steadier levels than a quantum's, see LoudnessMeterNode.
+        //
+        void windowSize(size_t ws) { _windowSize.store(ws, std::memory_order_relaxed); }
+        size_t windowSize() const { return _windowSize.load(std::memory_order_relaxed); }
         
     private:
 
         virtual double tailTime(ContextRenderLock & r) const override { return 0; }      // required for BasicInspector
         virtual double latencyTime(ContextRenderLock & r) const override { return 0; }   // required for BasicInspector
 
-        float _db;
-        size_t _windowSize;
+        std::atomic<float> _db;
+        std::atomic<size_t> _windowSize;
 
     };
 
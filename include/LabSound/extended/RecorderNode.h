@@ -6,48 +6,73 @@
 
 #include "LabSound/core/AudioBasicInspectorNode.h"
 #include "LabSound/core/AudioContext.h"
+#include <atomic>
+#include <memory>
+#include <string>
 #include <vector>
-#include <mutex>
 
 namespace lab
 {
-    
+
+    // RecorderNode captures the audio passing through it. The audio thread only copies each quantum into a
+    // fixed-size lock-free ring; a background thread drains the ring either into memory (startRecording)
+    // or straight to a 32-bit float WAV file (startRecordingToFile), so memory stays bounded and the
+    // render path never locks or allocates. If the background thread falls behind, the frames that don't
+    // fit are dropped and counted in droppedFrameCount().
     class RecorderNode : public AudioBasicInspectorNode
     {
-        
+
     public:
-        
+
         RecorderNode();
         virtual ~RecorderNode();
-        
+
         // AudioNode
         virtual void process(ContextRenderLock &, size_t framesToProcess) override;
         virtual void reset(ContextRenderLock &) override;
-        
-        void startRecording() { m_recording = true; }
-        void stopRecording() { m_recording = false; }
-        
+
+        // Records into memory, retrievable with getData() or writeRecordingToWav().
+        void startRecording();
+
+        // Streams the recording to disk as it is captured. Returns false if the file can't be opened.
+        // Recordings that outgrow the 4GB limit of RIFF are finalized as RF64.
+        bool startRecordingToFile(const std::string & filenameWithWavExtension);
+
+        // Stops capturing. A file recording is flushed and finalized before this returns.
+        void stopRecording();
+
         void mixToMono(bool m) { m_mixToMono = m; }
 
         // replaces result with the currently recorded data.
         // saved data is cleared.
         void getData(std::vector<float> & result);
-        
+
         void writeRecordingToWav(int channels, const std::string & filenameWithWavExtension);
-        
+
+        // Sample rate of the context the recording was captured from.
+        float recordedSampleRate() const { return m_sampleRate; }
+
+        // Frames discarded because the background thread could not keep up.
+        uint64_t droppedFrameCount() const { return m_droppedFrames; }
+
     private:
-        
+
         virtual double tailTime(ContextRenderLock & r) const override { return 0; }
         virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
 
-        bool m_mixToMono{ false };
-        bool m_recording{ false };
+        std::atomic<bool> m_mixToMono{ false };
+        std::atomic<bool> m_recording{ false };
+        std::atomic<bool> m_capturing{ false }; // while the audio thread writes a quantum into the ring
 
-        std::vector<float> m_data; // interleaved
-        mutable std::recursive_mutex m_mutex;
+        // Channel count of the interleaved stream, latched from the first quantum after recording starts.
+        std::atomic<uint32_t> m_recordingChannels{ 0 };
+        std::atomic<float> m_sampleRate{ 44100.f };
+        std::atomic<uint64_t> m_droppedFrames{ 0 };
 
+        class RecorderNodeInternal;
+        std::unique_ptr<RecorderNodeInternal> m_internal;
     };
-    
+
 } // end namespace lab
 
 #endif
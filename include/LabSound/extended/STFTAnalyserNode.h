@@ -0,0 +1,95 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#pragma once
+
+#ifndef STFT_ANALYSER_NODE_H
+#define STFT_ANALYSER_NODE_H
+
+#include "LabSound/core/AudioBasicInspectorNode.h"
+#include "LabSound/core/WindowFunctions.h"
+
+#include <memory>
+#include <vector>
+
+namespace lab {
+
+    // One analysis frame of an STFTAnalyserNode, holding binCount bins, from DC up to and including Nyquist, for each
+    // channel. Magnitudes are scaled so that a sinusoid of amplitude A centred on a bin reads A; phases are in radians.
+    struct STFTFrame
+    {
+        uint64_t index = 0;         // frames analysed before this one, since the node was created
+        uint64_t position = 0;      // input frame at which the window starts, counted from the first frame analysed
+        float sampleRate = 0;
+        size_t channelCount = 0;
+        size_t binCount = 0;
+
+        // channelCount runs of binCount values.
+        std::vector<float> magnitude;
+        std::vector<float> phase;
+
+        const float * magnitudes(size_t channel) const { return magnitude.data() + channel * binCount; }
+        const float * phases(size_t channel) const { return phase.data() + channel * binCount; }
+        float binFrequency(size_t bin, size_t fftSize) const { return bin * sampleRate / fftSize; }
+    };
+
+    // STFTAnalyserNode computes a short-time Fourier transform of its input, which it passes through unchanged. A new
+    // frame starts every hopSize input frames, and windows windowSize of them, zero padded to fftSize.
+    //
+    // Rendering only copies the input to lock-free rings; the frames are computed on a worker thread of the node's
+    // own, and the latest historyLength of them are kept. Readers copy frames out without locking, and without
+    // holding up the worker, from any number of threads. A frame that the worker overwrites while it's being read is
+    // left out, so a reader that falls more than historyLength frames behind misses the oldest.
+    //
+    // The first channelCount input channels are analysed; if the input has fewer, the rest are silent.
+    class STFTAnalyserNode : public AudioBasicInspectorNode
+    {
+    public:
+
+        // The FFT size must be a power of two. windowSize defaults to the FFT size, and is at most the FFT size.
+        // hopSize defaults to a quarter of the window, and is at most the window size.
+        STFTAnalyserNode(size_t fftSize = 1024, size_t windowSize = 0, size_t hopSize = 0,
+                         WindowType window = window_hanning, size_t historyLength = 32, size_t channelCount = 2);
+        virtual ~STFTAnalyserNode();
+
+        virtual void process(ContextRenderLock &, size_t framesToProcess) override;
+
+        // Starts the next frame afresh, rather than overlapping the input that came before.
+        virtual void reset(ContextRenderLock &) override;
+
+        size_t fftSize() const;
+        size_t windowSize() const;
+        size_t hopSize() const;
+        size_t historyLength() const;
+        size_t channelCount() const;
+        size_t binCount() const { return fftSize() / 2 + 1; }
+
+        // Frames analysed so far; the latest frame's index is one less.
+        uint64_t frameCount() const;
+
+        // Copies the frames whose index is at least firstIndex, up to the latest historyLength, into frames, oldest
+        // first, and returns how many were copied. The frames' storage is reused. To read each frame once, pass the
+        // index after the last one read.
+        size_t readFrames(std::vector<STFTFrame> & frames, uint64_t firstIndex = 0) const;
+
+        // Copies the latest frame; returns false if there is none yet.
+        bool readLatestFrame(STFTFrame & frame) const;
+
+        // Input frames dropped because the worker fell behind, leaving no room in the rings.
+        uint64_t droppedInputCount() const;
+
+    private:
+
+        // Silence is analysed too, so that the spectrum decays when the input stops.
+        virtual bool propagatesSilence(ContextRenderLock &) const override { return false; }
+
+        virtual double tailTime(ContextRenderLock &) const override { return 0; }
+        virtual double latencyTime(ContextRenderLock &) const override { return 0; }
+
+        struct Internals;
+        std::unique_ptr<Internals> m_internal;
+    };
+
+} // namespace lab
+
+#endif // STFT_ANALYSER_NODE_H
@@ -0,0 +1,68 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#pragma once
+
+#ifndef SAMPLE_CACHE_H
+#define SAMPLE_CACHE_H
+
+#include <memory>
+#include <string>
+#include <stdint.h>
+
+namespace lab {
+
+    class AudioBus;
+
+    // SampleCache decodes each sample once, and shares the bus with everyone who loads it. Unlike MakeBusFromFile(),
+    // which decodes afresh on every call, it keys the decoded audio by a hash of the file's contents and the form it
+    // was decoded to, so the same sound is decoded once however many paths or nodes refer to it.
+    //
+    // The buses it returns are shared, and must be treated as immutable.
+    //
+    // Decoded audio is kept in memory up to the memory budget, least recently loaded first out. An evicted bus that
+    // is still referenced elsewhere lives on, and is found again by the next load rather than decoded twice.
+    //
+    // With a disk cache directory, decoded audio is also written there as planar float PCM. Later loads of the same
+    // content, in this run or a later one, map that file into memory instead of decoding it again. The directory can
+    // be deleted at any time.
+    //
+    // A SampleCache may be used from any thread other than the audio thread.
+    class SampleCache
+    {
+    public:
+
+        struct Stats
+        {
+            uint64_t hits = 0;          // found in memory
+            uint64_t diskHits = 0;      // mapped from the disk cache
+            uint64_t misses = 0;        // decoded
+            uint64_t evictions = 0;
+            size_t residentBytes = 0;   // PCM held by the cache
+            size_t entryCount = 0;
+        };
+
+        explicit SampleCache(size_t memoryBudget = size_t(512) << 20, const std::string & diskCacheDirectory = std::string());
+        ~SampleCache();
+
+        // Loads the file at path, mixed to mono if mixToMono, and converted to sampleRate unless it is 0. Returns
+        // nullptr if the file can't be read or decoded.
+        std::shared_ptr<AudioBus> load(const std::string & path, bool mixToMono = false, float sampleRate = 0);
+
+        void setMemoryBudget(size_t bytes);
+        size_t memoryBudget() const;
+
+        // Drops every entry held in memory. Buses still referenced elsewhere are not freed.
+        void clear();
+
+        Stats stats() const;
+
+    private:
+
+        struct Internals;
+        std::unique_ptr<Internals> m_internal;
+    };
+
+} // namespace lab
+
+#endif // SAMPLE_CACHE_H
@@ -8,6 +8,8 @@
 
 #include "LabSound/core/PannerNode.h"
 #include <map>
+#include <memory>
+#include <mutex>
 
 namespace lab {
 
@@ -38,20 +40,53 @@ namespace lab {
             return *this; }
     };
     
+    class SpatializationNode;
+
+    // Occluders attenuate sounds that pass near them on their way to the listener. They are kept in a bounding volume
+    // hierarchy, so a sound only tests the occluders near its path rather than every occluder in the scene.
+    //
+    // An Occluders can be shared by many SpatializationNodes. Each render quantum, the first of them to be processed
+    // evaluates the distance, cone and occlusion gains of all of them in one pass over their positions and orientations,
+    // which it gathers into arrays. Editing the occluders never blocks the audio thread: a node that finds them being
+    // edited keeps the gains of the previous quantum.
     class Occluders 
     {
 
     public:
+
+        Occluders();
+        ~Occluders();
+
         void setOccluder(int id, float x, float y, float z, float radius);
         
         void removeOccluder(int id);
         
         float occlusion(const FloatPoint3D & sourcePos, const FloatPoint3D & listenerPos) const;
 
+        // Writes the occlusion of count sources, whose positions are given as arrays of coordinates, into result.
+        void occlusion(const float * sourceX, const float * sourceY, const float * sourceZ, size_t count,
+                       const FloatPoint3D & listenerPos, float * result) const;
+
     private:
 
+        friend class SpatializationNode;
+
+        struct Index;
+        struct EmitterBatch;
+
+        void addEmitter(SpatializationNode *);
+        void removeEmitter(SpatializationNode *);
+
+        // These must be called with m_mutex held.
+        void updateIndex() const;
+        void occlusionLocked(const float * sourceX, const float * sourceY, const float * sourceZ, size_t count,
+                             const FloatPoint3D & listenerPos, float * result) const;
+
         std::map<int, Occluder> occluders;
 
+        mutable std::mutex m_mutex;
+        std::unique_ptr<Index> m_index; // rebuilt from occluders when next queried after an edit
+        std::unique_ptr<EmitterBatch> m_emitters;
     };
     
     typedef std::shared_ptr<Occluders> OccludersPtr;
@@ -61,14 +96,27 @@ namespace lab {
     public:
 
         SpatializationNode(float sampleRate);
-        virtual ~SpatializationNode() = default;
+        virtual ~SpatializationNode();
 
         void setOccluders(OccludersPtr ptr);
         
     private:
 
-        virtual float distanceConeGain(ContextRenderLock& r);
+        friend class Occluders;
+
+        virtual float distanceConeGain(ContextRenderLock& r) override;
+
+        // Computes the gains of every node sharing the occluders, for the quantum starting at frame.
+        static void evaluateEmitters(ContextRenderLock & r, Occluders & occluders, size_t frame);
+
         std::shared_ptr<Occluders> occluders;
+
+        // Written by evaluateEmitters.
+        size_t m_evaluatedFrame = static_cast<size_t>(-1);
+        bool m_hasEvaluatedGains = false;
+        float m_evaluatedDistanceGain = 1.f;
+        float m_evaluatedConeGain = 1.f;
+        float m_evaluatedOcclusion = 1.f;
     };
     
 }
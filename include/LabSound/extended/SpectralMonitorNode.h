@@ -14,6 +14,8 @@
 
 namespace lab 
 {
+    // SpectralMonitorNode gathers one window of the channels' sum, and transforms it on the thread that asks for its
+    // spectrum. For overlapped, multichannel analysis computed off the audio thread, see STFTAnalyserNode.
     class SpectralMonitorNode : public AudioBasicInspectorNode 
     {
         class SpectralMonitorNodeInternal;
@@ -26,6 +28,7 @@ namespace lab
         virtual void process(ContextRenderLock&, size_t framesToProcess) override;
         virtual void reset(ContextRenderLock&) override;
 
+        // Magnitudes of the windowSize() / 2 bins from DC up to, but not including, Nyquist.
         void spectralMag(std::vector<float>& result);
         void windowSize(size_t ws);
         size_t windowSize() const;
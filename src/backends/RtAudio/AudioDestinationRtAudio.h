@@ -7,6 +7,7 @@
 
 #include "LabSound/core/AudioNode.h"
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioIOCallback.h"
 
 #include "internal/AudioDestination.h"
 
@@ -31,6 +32,9 @@ public:
 
     void render(int numberOfFrames, void * outputBuffer, void * inputBuffer);
 
+    // Forwards an underrun or overflow reported by RtAudio.
+    void xrun() { m_callback.deviceXRun(); }
+
 private:
 
     void configure();
@@ -163,7 +163,7 @@ public:
 };
 //LabSound end
 
-AudioDestination* AudioDestination::MakePlatformAudioDestination(AudioIOCallback& callback, unsigned numberOfOutputChannels, float sampleRate)
+AudioDestination* AudioDestination::MakePlatformAudioDestination(AudioIOCallback& callback, unsigned numberOfOutputChannels, float sampleRate, const AudioDeviceConfiguration &)
 {
     return new AudioDestinationMac(callback, numberOfOutputChannels, sampleRate);
 }
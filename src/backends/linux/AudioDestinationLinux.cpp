@@ -11,6 +11,9 @@
 
 #include <rtaudio/RtAudio.h>
 
+#include <algorithm>
+#include <cstring>
+
 namespace lab
 {
 
@@ -35,9 +38,9 @@ static int NumDefaultOutputChannels()
 const float kLowThreshold = -1.0f;
 const float kHighThreshold = 1.0f;
 
-AudioDestination * AudioDestination::MakePlatformAudioDestination(AudioIOCallback & callback, unsigned numberOfOutputChannels, float sampleRate)
+AudioDestination * AudioDestination::MakePlatformAudioDestination(AudioIOCallback & callback, unsigned numberOfOutputChannels, float sampleRate, const AudioDeviceConfiguration & configuration)
 {
-    return new AudioDestinationLinux(callback, numberOfOutputChannels, sampleRate);
+    return new AudioDestinationLinux(callback, numberOfOutputChannels, sampleRate, configuration);
 }
 
 unsigned long AudioDestination::maxChannelCount()
@@ -45,35 +48,37 @@ unsigned long AudioDestination::maxChannelCount()
     return NumDefaultOutputChannels();
 }
 
-AudioDestinationLinux::AudioDestinationLinux(AudioIOCallback & callback, unsigned numChannels, float sampleRate)
+AudioDestinationLinux::AudioDestinationLinux(AudioIOCallback & callback, unsigned numChannels, float sampleRate, const AudioDeviceConfiguration & configuration)
 : m_callback(callback)
-, m_renderBus(numChannels, AudioNode::ProcessingSizeInFrames, false)
-, m_inputBus(1, AudioNode::ProcessingSizeInFrames, false)
+, m_renderBus(numChannels, AudioNode::ProcessingSizeInFrames)
+, m_inputBus(std::max(1u, configuration.inputChannels), AudioNode::ProcessingSizeInFrames)
+, dac(new RtAudio())
 {
     m_numChannels = numChannels;
     m_sampleRate = sampleRate;
     m_renderBus.setSampleRate(m_sampleRate);
-    configure();
+    m_inputBus.setSampleRate(m_sampleRate);
+    configure(configuration);
 }
 
 AudioDestinationLinux::~AudioDestinationLinux()
 {
-    dac.release(); // XXX
-    /* if (dac.isStreamOpen())
-        dac.closeStream(); */
+    if (dac->isStreamOpen())
+        dac->closeStream();
 }
 
-void AudioDestinationLinux::configure()
+void AudioDestinationLinux::configure(const AudioDeviceConfiguration & configuration)
 {
-    if (dac.getDeviceCount() < 1)
+    if (dac->getDeviceCount() < 1)
     {
         LOG_ERROR("No audio devices available");
+        return;
     }
 
-    dac.showWarnings(true);
+    dac->showWarnings(true);
 
     RtAudio::StreamParameters outputParams;
-    outputParams.deviceId = dac.getDefaultOutputDevice();
+    outputParams.deviceId = dac->getDefaultOutputDevice();
     outputParams.nChannels = m_numChannels;
     outputParams.firstChannel = 0;
 
@@ -81,30 +86,61 @@ void AudioDestinationLinux::configure()
     LOG("Using Default Audio Device: %s", deviceInfo.name.c_str());
 
     RtAudio::StreamParameters inputParams;
-    inputParams.deviceId = dac.getDefaultInputDevice();
-    inputParams.nChannels = 1;
+    inputParams.deviceId = dac->getDefaultInputDevice();
+    inputParams.nChannels = configuration.enableInput ? std::max(1u, configuration.inputChannels) : 0;
     inputParams.firstChannel = 0;
 
-    unsigned int bufferFrames = AudioNode::ProcessingSizeInFrames;
+    if (inputParams.nChannels && dac->getDeviceInfo(inputParams.deviceId).inputChannels < inputParams.nChannels)
+    {
+        LOG("The default input device doesn't have %d channels; opening an output-only stream", inputParams.nChannels);
+        inputParams.nChannels = 0;
+    }
+
+    unsigned int bufferFrames = configuration.bufferFrames ? configuration.bufferFrames : static_cast<unsigned>(AudioNode::ProcessingSizeInFrames);
 
     RtAudio::StreamOptions options;
     options.flags |= RTAUDIO_NONINTERLEAVED;
+    options.numberOfBuffers = configuration.numberOfBuffers;
 
     try
     {
-        dac.openStream(&outputParams, &inputParams, RTAUDIO_FLOAT32, (unsigned int) m_sampleRate, &bufferFrames, &outputCallback, this, &options);
+        dac->openStream(&outputParams, inputParams.nChannels ? &inputParams : nullptr, RTAUDIO_FLOAT32, (unsigned int) m_sampleRate, &bufferFrames, &outputCallback, this, &options);
     }
     catch (RtAudioError & e)
     {
         e.printMessage();
+        return;
     }
+
+    LOG("Opened %s stream with %d frame buffers", inputParams.nChannels ? "duplex" : "output-only", bufferFrames);
+
+    m_bufferFrames = bufferFrames;
+    m_inputChannels = inputParams.nChannels;
+    if (m_inputChannels)
+        allocateInputFifo(bufferFrames);
+}
+
+void AudioDestinationLinux::allocateInputFifo(unsigned bufferFrames)
+{
+    // Input is queued a whole device buffer at a time and drained a quantum at a time, so the queue never
+    // holds more than a buffer and a quantum. Twice that leaves room for devices that vary their buffers.
+    m_inputFifoCapacity = 2 * (bufferFrames + AudioNode::ProcessingSizeInFrames);
+    m_inputFifo.assign(m_inputFifoCapacity * m_inputChannels, 0.f);
+    m_inputFifoRead = 0;
+
+    // When buffers aren't whole quanta, output is rendered up to a quantum ahead of the device, so input
+    // starts a quantum late (with silence) to always be there when a quantum is rendered.
+    m_inputFifoCount = bufferFrames % AudioNode::ProcessingSizeInFrames ? AudioNode::ProcessingSizeInFrames : 0;
 }
 
 void AudioDestinationLinux::start()
 {
+    if (!dac->isStreamOpen())
+        return;
+
     try
     {
-        dac.startStream();
+        dac->startStream();
     }
     catch (RtAudioError & e)
     {
@@ -114,9 +150,12 @@ void AudioDestinationLinux::start()
 
 void AudioDestinationLinux::stop()
 {
+    if (!dac->isStreamOpen() || !dac->isStreamRunning())
+        return;
+
     try
     {
-        dac.stopStream();
+        dac->stopStream();
     }
     catch (RtAudioError & e)
     {
@@ -124,48 +163,108 @@ void AudioDestinationLinux::stop()
     }
 }
 
-// Pulls on our provider to get rendered audio stream.
-void AudioDestinationLinux::render(int numberOfFrames, void * outputBuffer, void * inputBuffer)
+void AudioDestinationLinux::renderQuantum()
 {
-    float *myOutputBufferOfFloats = (float*) outputBuffer;
-    float *myInputBufferOfFloats = (float*) inputBuffer;
+    const size_t quantum = AudioNode::ProcessingSizeInFrames;
+    AudioBus * inputBus = nullptr;
 
-    // Inform bus to use an externally allocated buffer from rtaudio
-    if (m_renderBus.isFirstTime())
+    if (m_inputChannels)
     {
-        for (uint32_t i = 0; i < m_numChannels; ++i)
+        if (m_inputFifoCount >= quantum)
         {
-            m_renderBus.setChannelMemory(i, myOutputBufferOfFloats + i * numberOfFrames, numberOfFrames);
+            const size_t first = std::min(quantum, m_inputFifoCapacity - m_inputFifoRead);
+            for (unsigned i = 0; i < m_inputChannels; ++i)
+            {
+                const float * ring = m_inputFifo.data() + i * m_inputFifoCapacity;
+                float * destination = m_inputBus.channel(i)->mutableData();
+                memcpy(destination, ring + m_inputFifoRead, first * sizeof(float));
+                memcpy(destination + first, ring, (quantum - first) * sizeof(float));
+            }
+
+            m_inputFifoRead = (m_inputFifoRead + quantum) % m_inputFifoCapacity;
+            m_inputFifoCount -= quantum;
+        }
+        else
+        {
+            m_inputBus.zero(); // the device delivered less than it negotiated
         }
-    }
 
-    if (m_inputBus.isFirstTime())
-    {
-        m_inputBus.setChannelMemory(0, myInputBufferOfFloats, numberOfFrames);
+        inputBus = &m_inputBus;
     }
 
     // Source Bus :: Destination Bus
-    m_callback.render(&m_inputBus, &m_renderBus, numberOfFrames);
+    m_callback.render(inputBus, &m_renderBus, quantum);
 
     // Clamp values at 0db (i.e., [-1.0, 1.0])
     for (unsigned i = 0; i < m_renderBus.numberOfChannels(); ++i)
     {
         AudioChannel * channel = m_renderBus.channel(i);
-        VectorMath::vclip(channel->data(), 1, &kLowThreshold, &kHighThreshold, channel->mutableData(), 1, numberOfFrames);
+        VectorMath::vclip(channel->data(), 1, &kLowThreshold, &kHighThreshold, channel->mutableData(), 1, quantum);
     }
 }
 
-int outputCallback(void * outputBuffer, void * inputBuffer, unsigned int nBufferFrames, double streamTime, RtAudioStreamStatus status, void * userData)
+// Pulls on our provider to get rendered audio stream.
+void AudioDestinationLinux::render(int numberOfFrames, void * outputBuffer, void * inputBuffer)
 {
-    float *fBufOut = (float*) outputBuffer;
+    const size_t quantum = AudioNode::ProcessingSizeInFrames;
+    const size_t frames = static_cast<size_t>(numberOfFrames);
 
-    // Buffer is nBufferFrames * channels
-    // NB: channel count should be set in a principled way
-    memset(fBufOut, 0, sizeof(float) * nBufferFrames * 2);
+    float * output = static_cast<float*>(outputBuffer);
+    const float * input = static_cast<const float*>(inputBuffer);
 
+    // Queue the device input.
+    if (m_inputChannels && input)
+    {
+        if (frames > m_inputFifoCapacity - m_inputFifoCount)
+        {
+            // The device delivered more than it negotiated; drop the oldest input to make room.
+            const size_t excess = std::min(m_inputFifoCount, frames - (m_inputFifoCapacity - m_inputFifoCount));
+            m_inputFifoRead = (m_inputFifoRead + excess) % m_inputFifoCapacity;
+            m_inputFifoCount -= excess;
+            xrun();
+        }
+
+        const size_t toQueue = std::min(frames, m_inputFifoCapacity - m_inputFifoCount);
+        const size_t write = (m_inputFifoRead + m_inputFifoCount) % m_inputFifoCapacity;
+        const size_t first = std::min(toQueue, m_inputFifoCapacity - write);
+        for (unsigned i = 0; i < m_inputChannels; ++i)
+        {
+            float * ring = m_inputFifo.data() + i * m_inputFifoCapacity;
+            const float * source = input + i * frames;
+            memcpy(ring + write, source, first * sizeof(float));
+            memcpy(ring, source + first, (toQueue - first) * sizeof(float));
+        }
+        m_inputFifoCount += toQueue;
+    }
+
+    // Fill the device buffer from rendered quanta, starting with what is left of the previous one.
+    size_t written = 0;
+    while (written < frames)
+    {
+        if (m_renderOffset == quantum)
+        {
+            renderQuantum();
+            m_renderOffset = 0;
+        }
+
+        const size_t count = std::min(quantum - m_renderOffset, frames - written);
+        for (unsigned i = 0; i < m_numChannels; ++i)
+            memcpy(output + i * frames + written, m_renderBus.channel(i)->data() + m_renderOffset, count * sizeof(float));
+
+        m_renderOffset += count;
+        written += count;
+    }
+}
+
+int outputCallback(void * outputBuffer, void * inputBuffer, unsigned int nBufferFrames, double streamTime, RtAudioStreamStatus status, void * userData)
+{
     AudioDestinationLinux * audioDestination = static_cast<AudioDestinationLinux*>(userData);
 
-    audioDestination->render(nBufferFrames, fBufOut, inputBuffer);
+    if (status)
+        audioDestination->xrun();
+
+    // Every frame of every output channel is written, so the buffer needn't be cleared first.
+    audioDestination->render(nBufferFrames, outputBuffer, inputBuffer);
 
     return 0;
 }
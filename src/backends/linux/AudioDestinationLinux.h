@@ -7,21 +7,30 @@
 
 #include "LabSound/core/AudioNode.h"
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioIOCallback.h"
+#include "LabSound/core/DefaultAudioDestinationNode.h"
 
 #include "internal/AudioDestination.h"
 
 #include "rtaudio/RtAudio.h"
 #include <iostream>
 #include <cstdlib>
+#include <vector>
 
 namespace lab {
 
+// Plays through RtAudio, which is built for ALSA, PulseAudio or JACK depending on the LABSOUND_ASOUND,
+// LABSOUND_PULSE and LABSOUND_JACK options, and for RtAudio's dummy API if none of them is set.
+//
+// The device buffer can be any size. Each callback is filled from whole rendered quanta: what a quantum
+// has left over when the buffer is full is played at the start of the next callback, and device input is
+// queued until there is a quantum's worth of it to render with.
 class AudioDestinationLinux : public AudioDestination
 {
 
 public:
 
-    AudioDestinationLinux(AudioIOCallback &, float sampleRate);
+    AudioDestinationLinux(AudioIOCallback &, unsigned numChannels, float sampleRate, const AudioDeviceConfiguration &);
     virtual ~AudioDestinationLinux();
 
     virtual void start() override;
@@ -29,25 +38,47 @@ public:
 
     float sampleRate() const override { return m_sampleRate; }
 
+    // Frames per device callback, as negotiated with the device. Zero if no stream could be opened.
+    unsigned bufferFrames() const { return m_bufferFrames; }
+    bool hasInput() const { return m_inputChannels > 0; }
+
+    // Fills numberOfFrames frames of the non-interleaved outputBuffer, consuming as many frames of the
+    // non-interleaved inputBuffer, which may be null.
     void render(int numberOfFrames, void * outputBuffer, void * inputBuffer);
 
+    // Forwards an underrun or overflow reported by RtAudio.
+    void xrun() { m_callback.deviceXRun(); }
+
 private:
 
-    void configure();
+    void configure(const AudioDeviceConfiguration &);
+    void allocateInputFifo(unsigned bufferFrames);
+    void renderQuantum();
 
     AudioIOCallback & m_callback;
 
-    AudioBus m_renderBus = {2, AudioNode::ProcessingSizeInFrames, false};
-    AudioBus m_inputBus = {1, AudioNode::ProcessingSizeInFrames, false};
+    AudioBus m_renderBus;
+    AudioBus m_inputBus;
 
+    unsigned m_numChannels;
+    unsigned m_inputChannels = 0;
+    unsigned m_bufferFrames = 0;
     float m_sampleRate;
 
-    std::unique_ptr<RtAudio> dac; // XXX
+    // Frames of m_renderBus already copied to the device; a quantum is rendered when it reaches the end.
+    size_t m_renderOffset = AudioNode::ProcessingSizeInFrames;
+
+    // Device input waiting to be rendered, one ring of m_inputFifoCapacity frames per channel.
+    std::vector<float> m_inputFifo;
+    size_t m_inputFifoCapacity = 0;
+    size_t m_inputFifoRead = 0;
+    size_t m_inputFifoCount = 0;
+
+    std::unique_ptr<RtAudio> dac;
 };
 
 int outputCallback(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames, double streamTime, RtAudioStreamStatus status, void *userData );
 
 } // namespace lab
 
-#endif // AudioDestinationWin_h
-
+#endif // AudioDestinationLinux_h
@@ -0,0 +1,84 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "AudioDestinationNull.h"
+
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/extended/Logging.h"
+
+#include <chrono>
+
+namespace lab
+{
+
+AudioDestinationNull::AudioDestinationNull(AudioIOCallback & callback, unsigned numChannels, float sampleRate, bool paced, HeadlessRenderCallback output)
+: m_callback(callback)
+, m_output(std::move(output))
+, m_renderBus(numChannels, AudioNode::ProcessingSizeInFrames, true)
+, m_sampleRate(sampleRate)
+, m_paced(paced)
+{
+    m_renderBus.setSampleRate(m_sampleRate);
+}
+
+AudioDestinationNull::~AudioDestinationNull()
+{
+    stop();
+}
+
+void AudioDestinationNull::start()
+{
+    if (m_running.exchange(true))
+        return;
+
+    LOG("Starting %s null audio destination", m_paced ? "paced" : "free-running");
+    m_thread = std::thread(&AudioDestinationNull::run, this);
+}
+
+void AudioDestinationNull::stop()
+{
+    m_running.store(false);
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void AudioDestinationNull::run()
+{
+    typedef std::chrono::steady_clock clock;
+
+    const size_t framesToProcess = AudioNode::ProcessingSizeInFrames;
+
+    // Deadlines are computed from the frame count rather than accumulated, so that they don't drift.
+    clock::time_point start = clock::now();
+    uint64_t framesRendered = 0;
+
+    while (m_running.load(std::memory_order_relaxed))
+    {
+        m_callback.render(nullptr, &m_renderBus, framesToProcess);
+
+        if (m_output)
+            m_output(m_renderBus, framesToProcess);
+
+        if (!m_paced)
+            continue;
+
+        framesRendered += framesToProcess;
+        const clock::time_point deadline = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(framesRendered / m_sampleRate));
+        const clock::time_point now = clock::now();
+
+        if (now < deadline)
+        {
+            std::this_thread::sleep_until(deadline);
+        }
+        else if (now - deadline > std::chrono::duration<double>(framesToProcess / m_sampleRate))
+        {
+            // More than a quantum behind: a device would have dropped audio here. Report it like a device
+            // xrun, and start again from now rather than rendering in a burst to catch up.
+            m_callback.deviceXRun();
+            start = now;
+            framesRendered = 0;
+        }
+    }
+}
+
+} // namespace lab
@@ -0,0 +1,52 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef AudioDestinationNull_h
+#define AudioDestinationNull_h
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioIOCallback.h"
+#include "LabSound/core/DefaultAudioDestinationNode.h"
+
+#include "internal/AudioDestination.h"
+
+#include <atomic>
+#include <thread>
+
+namespace lab {
+
+// A destination without an audio device. Its thread renders one quantum at a time, either paced by the
+// clock so that the graph runs in real time, or back to back as fast as the graph can be rendered.
+// Each quantum is handed to the HeadlessRenderCallback, if there is one, and otherwise discarded.
+class AudioDestinationNull : public AudioDestination
+{
+
+public:
+
+    AudioDestinationNull(AudioIOCallback &, unsigned numChannels, float sampleRate, bool paced, HeadlessRenderCallback output);
+    virtual ~AudioDestinationNull();
+
+    virtual void start() override;
+    virtual void stop() override;
+
+    float sampleRate() const override { return m_sampleRate; }
+
+private:
+
+    void run();
+
+    AudioIOCallback & m_callback;
+    HeadlessRenderCallback m_output;
+
+    AudioBus m_renderBus;
+
+    float m_sampleRate;
+    bool m_paced;
+
+    std::atomic<bool> m_running{ false };
+    std::thread m_thread;
+};
+
+} // namespace lab
+
+#endif // AudioDestinationNull_h
@@ -35,7 +35,7 @@ static int NumDefaultOutputChannels()
 const float kLowThreshold = -1.0f;
 const float kHighThreshold = 1.0f;
 
-AudioDestination * AudioDestination::MakePlatformAudioDestination(AudioIOCallback & callback, unsigned numberOfOutputChannels, float sampleRate)
+AudioDestination * AudioDestination::MakePlatformAudioDestination(AudioIOCallback & callback, unsigned numberOfOutputChannels, float sampleRate, const AudioDeviceConfiguration &)
 {
     return new AudioDestinationWin(callback, numberOfOutputChannels, sampleRate);
 }
@@ -165,6 +165,9 @@ int outputCallback(void * outputBuffer, void * inputBuffer, unsigned int nBuffer
 
     AudioDestinationWin * audioDestination = static_cast<AudioDestinationWin*>(userData);
 
+    if (status)
+        audioDestination->xrun();
+
     audioDestination->render(nBufferFrames, fBufOut, inputBuffer);
 
     return 0;
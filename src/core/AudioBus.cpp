@@ -3,7 +3,6 @@
 // Copyright (C) 2015+, The LabSound Authors. All rights reserved.
 
 #include "LabSound/core/AudioBus.h"
-#include "internal/DenormalDisabler.h"
 #include "internal/SincResampler.h"
 #include "internal/VectorMath.h"
 #include "internal/Assertions.h"
@@ -18,6 +17,12 @@ using namespace VectorMath;
 
 const unsigned MaxBusChannels = 32;
 
+// Gains are de-zippered by a one pole smoother with this coefficient, and snap to their target once within
+// DezipperEpsilon of it. Ramping costs no more than a constant gain, so the snap is kept small enough to be
+// inaudible even at low gains.
+const float DezipperRate = 0.005f;
+const float DezipperEpsilon = 1e-6f;
+
 AudioBus::AudioBus(size_t numberOfChannels, size_t length, bool allocate) : m_length(length)
 {
     ASSERT(numberOfChannels <= MaxBusChannels);
@@ -262,6 +267,44 @@ void AudioBus::sumFrom(const AudioBus &sourceBus, ChannelInterpretation channelI
     }
 }
 
+void AudioBus::sumFrom(const AudioBus * const * sourceBuses, size_t sourceCount, ChannelInterpretation channelInterpretation)
+{
+    const size_t numberOfChannels = m_channels.size();
+    ASSERT(numberOfChannels <= MaxBusChannels);
+    if (numberOfChannels > MaxBusChannels) return;
+
+    // Channels of matching buses are gathered a block at a time on the stack, and each of our channels
+    // sums a whole block at once.
+    const size_t MaxBusesPerPass = 64;
+    const AudioChannel * sources[MaxBusesPerPass];
+
+    for (size_t start = 0; start < sourceCount; start += MaxBusesPerPass)
+    {
+        const size_t end = std::min(sourceCount, start + MaxBusesPerPass);
+
+        for (size_t channelIndex = 0; channelIndex < numberOfChannels; ++channelIndex)
+        {
+            size_t count = 0;
+            for (size_t i = start; i < end; ++i)
+            {
+                const AudioBus * sourceBus = sourceBuses[i];
+                if (sourceBus && sourceBus != this && sourceBus->numberOfChannels() == numberOfChannels)
+                    sources[count++] = sourceBus->channel(channelIndex);
+            }
+
+            channel(channelIndex)->sumFrom(sources, count);
+        }
+    }
+
+    // Buses that need up or down mixing are summed one at a time.
+    for (size_t i = 0; i < sourceCount; ++i)
+    {
+        const AudioBus * sourceBus = sourceBuses[i];
+        if (sourceBus && sourceBus != this && sourceBus->numberOfChannels() != numberOfChannels)
+            sumFrom(*sourceBus, channelInterpretation);
+    }
+}
+
 void AudioBus::speakersCopyFrom(const AudioBus& sourceBus)
 {
     // FIXME: Implement down mixing 5.1 to stereo.
@@ -356,9 +399,9 @@ void AudioBus::speakersSumFrom(const AudioBus& sourceBus)
         const float * sourceR = sourceBusSafe.channelByType(Channel::Right)->data();
         
         float * destination = channelByType(Channel::Left)->mutableData();
-        float scale = 0.5;
-        vsma(sourceL, 1, &scale, destination, 1, length());
-        vsma(sourceR, 1, &scale, destination, 1, length());
+        const float * sources[] = { sourceL, sourceR };
+        float scales[] = { 0.5f, 0.5f };
+        vrampsum(sources, scales, scales, 2, 1.f, destination, length(), true);
     } 
 	else if (numberOfDestinationChannels == Channels::Surround_5_1 && numberOfSourceChannels == Channels::Mono) 
 	{
@@ -399,23 +442,12 @@ void AudioBus::speakersSumFrom5_1_ToMono(const AudioBus& sourceBus)
     
     float * destination = channelByType(Channel::Left)->mutableData();
     
-    AudioFloatArray temp(length());
-    float * tempData = temp.data();
-    
-    // Sum in L and R.
-    vadd(sourceL, 1, sourceR, 1, tempData, 1, length());
-    float scale = 0.7071f;
-    vsmul(tempData, 1, &scale, tempData, 1, length());
-    vadd(tempData, 1, destination, 1, destination, 1, length());
-    
-    // Sum in SL and SR.
-    vadd(sourceSL, 1, sourceSR, 1, tempData, 1, length());
-    scale = 0.5;
-    vsmul(tempData, 1, &scale, tempData, 1, length());
-    vadd(tempData, 1, destination, 1, destination, 1, length());
-    
-    // Sum in center.
-    vadd(sourceC, 1, destination, 1, destination, 1, length());
+    // Scaled sums accumulate directly into the destination in a single pass, avoiding a temporary buffer on the audio thread.
+    // L and R are scaled by 0.7071, SL and SR by 0.5 and center is summed in at unity. The gains are constant, so
+    // they serve as their own ramp targets.
+    const float * sources[] = { sourceL, sourceR, sourceSL, sourceSR, sourceC };
+    float scales[] = { 0.7071f, 0.7071f, 0.5f, 0.5f, 1.f };
+    vrampsum(sources, scales, scales, 5, 1.f, destination, length(), true);
 }
 
 void AudioBus::speakersSumFrom7_1_ToMono(const AudioBus& sourceBus)
@@ -432,29 +464,10 @@ void AudioBus::speakersSumFrom7_1_ToMono(const AudioBus& sourceBus)
     
     float * destination = channelByType(Channel::Left)->mutableData();
     
-    AudioFloatArray temp(length());
-    float * tempData = temp.data();
-    
-    // Sum in L and R.
-    vadd(sourceL, 1, sourceR, 1, tempData, 1, length());
-    float scale = 0.7071f;
-    vsmul(tempData, 1, &scale, tempData, 1, length());
-    vadd(tempData, 1, destination, 1, destination, 1, length());
-    
-    // Sum in SL and SR.
-    vadd(sourceSL, 1, sourceSR, 1, tempData, 1, length());
-    scale = 0.5;
-    vsmul(tempData, 1, &scale, tempData, 1, length());
-    vadd(tempData, 1, destination, 1, destination, 1, length());
-    
-    // Sum in BL and BR.
-    vadd(sourceBL, 1, sourceBR, 1, tempData, 1, length());
-    scale = 0.5;
-    vsmul(tempData, 1, &scale, tempData, 1, length());
-    vadd(tempData, 1, destination, 1, destination, 1, length());
-    
-    // Sum in center.
-    vadd(sourceC, 1, destination, 1, destination, 1, length());
+    // As for 5.1, with BL and BR scaled by 0.5 as well.
+    const float * sources[] = { sourceL, sourceR, sourceSL, sourceSR, sourceBL, sourceBR, sourceC };
+    float scales[] = { 0.7071f, 0.7071f, 0.5f, 0.5f, 0.5f, 0.5f, 1.f };
+    vrampsum(sources, scales, scales, 7, 1.f, destination, length(), true);
 }
 
 void AudioBus::discreteCopyFrom(const AudioBus & sourceBus)
@@ -553,61 +566,119 @@ void AudioBus::copyWithGainFrom(const AudioBus & sourceBus, float * lastMixGain,
     float gain = static_cast<float>(m_isFirstTime ? totalDesiredGain : *lastMixGain);
     m_isFirstTime = false;
 
-    const float DezipperRate = 0.005f;
-    size_t framesToProcess = length();
+    const size_t framesToProcess = length();
 
     // If the gain is within epsilon of totalDesiredGain, we can skip dezippering. 
-    // FIXME: this value may need tweaking.
-    const float epsilon = 0.001f; 
-    float gainDiff = fabs(totalDesiredGain - gain);
-
-    // Number of frames to de-zipper before we are close enough to the target gain.
-    // FIXME: framesToDezipper could be smaller when target gain is close enough within this process loop.
-    size_t framesToDezipper = (gainDiff < epsilon) ? 0 : framesToProcess; 
-
-    if (framesToDezipper) 
+    const float epsilon = DezipperEpsilon;
+    const float gainDiff = fabs(totalDesiredGain - gain);
+
+    // Frame i of the dezipper gets the gain totalDesiredGain + (gain - totalDesiredGain) * (1 - DezipperRate)^i,
+    // which is what stepping gain += (totalDesiredGain - gain) * DezipperRate once per frame converges to. Being
+    // in closed form, it tells how many frames it takes to come within epsilon of the target, and the remaining
+    // frames get the target gain without ever decaying into denormals.
+    const float ratio = 1.f - DezipperRate;
+    size_t framesToDezipper = 0;
+    if (gainDiff >= epsilon)
     {
-        if (!m_dezipperGainValues.get() || m_dezipperGainValues->size() < framesToDezipper)
-        {
-            m_dezipperGainValues = std::unique_ptr<AudioFloatArray>(new AudioFloatArray(framesToDezipper));
-        }
-           
-        float * gainValues = m_dezipperGainValues->data();
-
-        for (uint32_t i = 0; i < framesToDezipper; ++i) 
-        {
-            gain += (totalDesiredGain - gain) * DezipperRate;
-        
-            // FIXME: If we are clever enough in calculating the framesToDezipper value, we can probably get
-            // rid of this DenormalDisabler::flushDenormalFloatToZero() call.
-            gain = DenormalDisabler::flushDenormalFloatToZero(gain);
-            *gainValues++ = gain;
-        }
+        const double frames = std::ceil(std::log(epsilon / gainDiff) / std::log(ratio));
+        framesToDezipper = std::min(framesToProcess, static_cast<size_t>(std::max(frames, 1.0)));
+    }
 
-        for (uint32_t channelIndex = 0; channelIndex < numberOfChannels; ++channelIndex) 
+    float nextGain = totalDesiredGain;
+    if (framesToDezipper)
+    {
+        for (uint32_t channelIndex = 0; channelIndex < numberOfChannels; ++channelIndex)
         {
-            vmul(sources[channelIndex], 1, m_dezipperGainValues->data(), 1, destinations[channelIndex], 1, framesToDezipper);
+            nextGain = gain;
+            vrampmul(sources[channelIndex], &nextGain, totalDesiredGain, ratio, destinations[channelIndex], framesToDezipper);
             sources[channelIndex] += framesToDezipper;
             destinations[channelIndex] += framesToDezipper;
         }
-    } 
-    else
-    {
-        gain = totalDesiredGain;
+
+        if (framesToDezipper < framesToProcess)
+            nextGain = totalDesiredGain;
     }
-        
 
     // Apply constant gain after de-zippering has converged on target gain.
     if (framesToDezipper < framesToProcess) 
     {
         for (size_t channelIndex = 0; channelIndex < numberOfChannels; ++channelIndex)
         {
-            vsmul(sources[channelIndex], 1, &gain, destinations[channelIndex], 1, framesToProcess - framesToDezipper);
+            vsmul(sources[channelIndex], 1, &totalDesiredGain, destinations[channelIndex], 1, framesToProcess - framesToDezipper);
         }        
     }
 
-    // Save the target gain as the starting point for next time around.
-    *lastMixGain = gain;
+    // Save the gain of the next frame as the starting point for next time around.
+    *lastMixGain = nextGain;
+}
+
+void AudioBus::sumWithGainFrom(const AudioBus * const * sourceBuses, float * lastMixGains, const float * targetGains, size_t sourceCount)
+{
+    const size_t numberOfChannels = m_channels.size();
+    ASSERT(numberOfChannels <= MaxBusChannels);
+    if (numberOfChannels > MaxBusChannels) return;
+
+    // Matching buses are gathered a block at a time on the stack, and each of our channels sums a whole block
+    // at once. Every channel starts from the same gains, so the ramps are advanced by a copy of them.
+    const size_t MaxBusesPerPass = 64;
+    const AudioChannel * sources[MaxBusesPerPass];
+    size_t indices[MaxBusesPerPass];
+    float gains[MaxBusesPerPass];
+    float targets[MaxBusesPerPass];
+    const float ratio = 1.f - DezipperRate;
+
+    for (size_t start = 0; start < sourceCount; start += MaxBusesPerPass)
+    {
+        const size_t end = std::min(sourceCount, start + MaxBusesPerPass);
+
+        size_t count = 0;
+        for (size_t i = start; i < end; ++i)
+        {
+            const AudioBus * sourceBus = sourceBuses[i];
+            ASSERT(sourceBus && topologyMatches(*sourceBus));
+            if (sourceBus && sourceBus != this && sourceBus->numberOfChannels() == numberOfChannels)
+            {
+                targets[count] = targetGains[i];
+                indices[count++] = i;
+            }
+        }
+
+        if (!count || !numberOfChannels)
+            continue;
+
+        for (size_t channelIndex = 0; channelIndex < numberOfChannels; ++channelIndex)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                sources[i] = sourceBuses[indices[i]]->channel(channelIndex);
+                gains[i] = lastMixGains[indices[i]];
+            }
+
+            channel(channelIndex)->sumFrom(sources, gains, targets, count, ratio);
+        }
+
+        // Save the gain of the next frame as the starting point for next time around.
+        for (size_t i = 0; i < count; ++i)
+            lastMixGains[indices[i]] = fabs(gains[i] - targets[i]) < DezipperEpsilon ? targets[i] : gains[i];
+    }
+}
+
+void AudioBus::sumWithSampleAccurateGainValuesFrom(const AudioBus & sourceBus, const float * gainValues, size_t numberOfGainValues)
+{
+    if (!topologyMatches(sourceBus) || &sourceBus == this)
+    {
+        ASSERT_NOT_REACHED();
+        return;
+    }
+
+    if (!gainValues || numberOfGainValues < length())
+    {
+        ASSERT_NOT_REACHED();
+        return;
+    }
+
+    for (size_t channelIndex = 0; channelIndex < numberOfChannels(); ++channelIndex)
+        channel(channelIndex)->sumFrom(sourceBus.channel(channelIndex), gainValues);
 }
 
 void AudioBus::copyWithSampleAccurateGainValuesFrom(const AudioBus &sourceBus, float* gainValues, size_t numberOfGainValues)
@@ -0,0 +1,114 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/AudioBusPool.h"
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+
+#include "internal/Assertions.h"
+
+namespace lab
+{
+
+AudioBusPool::AudioBusPool(size_t framesPerBus)
+    : m_framesPerBus(framesPerBus)
+    , m_maxChannels(AudioContext::maxNumberOfChannels)
+    , m_slots(new std::atomic<AudioBus*>[AudioContext::maxNumberOfChannels * SlotsPerChannelCount])
+{
+    for (size_t i = 0; i < m_maxChannels * SlotsPerChannelCount; ++i)
+        m_slots[i].store(nullptr, std::memory_order_relaxed);
+}
+
+AudioBusPool::~AudioBusPool()
+{
+    for (size_t i = 0; i < m_maxChannels * SlotsPerChannelCount; ++i)
+        delete m_slots[i].exchange(nullptr);
+}
+
+std::atomic<AudioBus*> * AudioBusPool::slotsFor(size_t numberOfChannels)
+{
+    if (numberOfChannels < 1 || numberOfChannels > m_maxChannels)
+        return nullptr;
+
+    return &m_slots[(numberOfChannels - 1) * SlotsPerChannelCount];
+}
+
+AudioBus * AudioBusPool::acquire(size_t numberOfChannels)
+{
+    if (std::atomic<AudioBus*> * slots = slotsFor(numberOfChannels))
+    {
+        for (size_t i = 0; i < SlotsPerChannelCount; ++i)
+        {
+            // Cheap relaxed peek first so that empty slots don't cost an exchange.
+            if (!slots[i].load(std::memory_order_relaxed))
+                continue;
+
+            if (AudioBus * bus = slots[i].exchange(nullptr, std::memory_order_acquire))
+            {
+                bus->zero();
+                bus->reset();
+                return bus;
+            }
+        }
+    }
+
+    m_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return new AudioBus(numberOfChannels, m_framesPerBus);
+}
+
+bool AudioBusPool::tryStore(AudioBus * bus)
+{
+    if (bus->length() != m_framesPerBus)
+        return false;
+
+    std::atomic<AudioBus*> * slots = slotsFor(bus->numberOfChannels());
+    if (!slots)
+        return false;
+
+    for (size_t i = 0; i < SlotsPerChannelCount; ++i)
+    {
+        AudioBus * expected = nullptr;
+        if (slots[i].compare_exchange_strong(expected, bus, std::memory_order_release, std::memory_order_relaxed))
+            return true;
+    }
+
+    return false;
+}
+
+void AudioBusPool::release(AudioBus * bus)
+{
+    if (!bus)
+        return;
+
+    if (!tryStore(bus))
+    {
+        m_deallocationCount.fetch_add(1, std::memory_order_relaxed);
+        delete bus;
+    }
+}
+
+void AudioBusPool::reserve(size_t numberOfChannels, size_t count)
+{
+    ASSERT(numberOfChannels >= 1 && numberOfChannels <= m_maxChannels);
+
+    std::atomic<AudioBus*> * slots = slotsFor(numberOfChannels);
+    if (!slots)
+        return;
+
+    size_t pooled = 0;
+    for (size_t i = 0; i < SlotsPerChannelCount; ++i)
+        if (slots[i].load(std::memory_order_relaxed))
+            ++pooled;
+
+    for (; pooled < count; ++pooled)
+    {
+        AudioBus * bus = new AudioBus(numberOfChannels, m_framesPerBus);
+        if (!tryStore(bus))
+        {
+            delete bus;
+            break;
+        }
+    }
+}
+
+} // namespace lab
@@ -14,6 +14,13 @@ namespace lab {
 
 using namespace VectorMath;
 
+namespace
+{
+    // Read-only silence shared by every zeroed channel; long enough for any render quantum.
+    const size_t SharedZeroesLength = 4096;
+    alignas(64) const float s_sharedZeroes[SharedZeroesLength] = {};
+}
+
 void AudioChannel::resizeSmaller(size_t newLength)
 {
     ASSERT(newLength <= m_length);
@@ -21,6 +28,72 @@ void AudioChannel::resizeSmaller(size_t newLength)
         m_length = newLength;
 }
 
+void AudioChannel::borrow(const AudioChannel * sourceChannel)
+{
+    bool isSafe = (sourceChannel && sourceChannel->length() >= length());
+    ASSERT(isSafe);
+    if (!isSafe)
+        return;
+
+    if (sourceChannel == this)
+        return;
+
+    // Without managed storage there is nothing to fall back to on write, so copy instead.
+    if (!m_memBuffer.get() || (m_rawPointer && !m_isBorrowed))
+    {
+        copyFrom(sourceChannel);
+        return;
+    }
+
+    // data() resolves to the underlying samples, so borrowing from a borrowed channel doesn't chain.
+    m_rawPointer = const_cast<float*>(sourceChannel->data());
+    m_isBorrowed = true;
+    m_silent = sourceChannel->isSilent();
+}
+
+void AudioChannel::releaseBorrow(bool copySamples)
+{
+    ASSERT(m_isBorrowed && m_memBuffer.get());
+
+    const float * borrowed = m_rawPointer;
+    m_rawPointer = nullptr;
+    m_isBorrowed = false;
+
+    if (!copySamples)
+        return;
+
+    if (borrowed == s_sharedZeroes)
+        m_memBuffer->zero();
+    else
+        memcpy(m_memBuffer->data(), borrowed, sizeof(float) * m_length);
+}
+
+void AudioChannel::zero()
+{
+    // Managed channels point at the shared zero buffer instead of clearing their storage. Silent
+    // subgraphs are then zeroed every quantum without touching memory.
+    if (m_memBuffer.get() && m_length <= SharedZeroesLength)
+    {
+        m_rawPointer = const_cast<float*>(s_sharedZeroes);
+        m_isBorrowed = true;
+        m_silent = true;
+        return;
+    }
+
+    if (m_isBorrowed)
+    {
+        releaseBorrow(false);
+        m_silent = false; // managed storage holds stale samples, so it must be cleared below
+    }
+
+    if (m_silent) return;
+
+    m_silent = true;
+
+    if (m_memBuffer.get()) m_memBuffer->zero();
+    else memset(m_rawPointer, 0, sizeof(float) * m_length);
+}
+
 void AudioChannel::scale(float scale)
 {
     if (isSilent())
@@ -40,6 +113,9 @@ void AudioChannel::copyFrom(const AudioChannel * sourceChannel)
         zero();
         return;
     }
+
+    // Every sample is about to be overwritten, so a borrowed view can be dropped without copying it back.
+    if (m_isBorrowed) releaseBorrow(false);
     memcpy(mutableData(), sourceChannel->data(), sizeof(float) * length());
 }
 
@@ -89,6 +165,102 @@ void AudioChannel::sumFrom(const AudioChannel* sourceChannel)
         vadd(data(), 1, sourceChannel->data(), 1, mutableData(), 1, length());
 }
 
+void AudioChannel::sumFrom(const AudioChannel * const * sourceChannels, size_t sourceCount)
+{
+    // Sources are gathered a block at a time on the stack so that the render thread never allocates.
+    const size_t MaxSourcesPerPass = 64;
+    const float * sources[MaxSourcesPerPass];
+
+    for (size_t start = 0; start < sourceCount; start += MaxSourcesPerPass)
+    {
+        const size_t end = std::min(sourceCount, start + MaxSourcesPerPass);
+
+        size_t count = 0;
+        for (size_t i = start; i < end; ++i)
+        {
+            const AudioChannel * sourceChannel = sourceChannels[i];
+            bool isSafe = sourceChannel && sourceChannel->length() >= length();
+            ASSERT(isSafe);
+            if (isSafe && !sourceChannel->isSilent())
+                sources[count++] = sourceChannel->data();
+        }
+
+        if (!count)
+            continue;
+
+        const bool accumulate = prepareToSum();
+        vsum(sources, count, mutableData(), length(), accumulate);
+    }
+}
+
+void AudioChannel::sumFrom(const AudioChannel * const * sourceChannels, float * gains, const float * targetGains, size_t sourceCount, float ratio)
+{
+    const size_t MaxSourcesPerPass = 64;
+    const float * sources[MaxSourcesPerPass];
+    float sourceGains[MaxSourcesPerPass];
+    float sourceTargets[MaxSourcesPerPass];
+    size_t sourceIndices[MaxSourcesPerPass];
+
+    // The ramp of a silent source advances without being summed.
+    const float silentRatio = powf(ratio, static_cast<float>(length()));
+
+    for (size_t start = 0; start < sourceCount; start += MaxSourcesPerPass)
+    {
+        const size_t end = std::min(sourceCount, start + MaxSourcesPerPass);
+
+        size_t count = 0;
+        for (size_t i = start; i < end; ++i)
+        {
+            const AudioChannel * sourceChannel = sourceChannels[i];
+            bool isSafe = sourceChannel && sourceChannel->length() >= length();
+            ASSERT(isSafe);
+            if (isSafe && !sourceChannel->isSilent())
+            {
+                sources[count] = sourceChannel->data();
+                sourceGains[count] = gains[i];
+                sourceTargets[count] = targetGains[i];
+                sourceIndices[count++] = i;
+            }
+            else
+                gains[i] = targetGains[i] + (gains[i] - targetGains[i]) * silentRatio;
+        }
+
+        if (!count)
+            continue;
+
+        const bool accumulate = prepareToSum();
+        vrampsum(sources, sourceGains, sourceTargets, count, ratio, mutableData(), length(), accumulate);
+
+        for (size_t i = 0; i < count; ++i)
+            gains[sourceIndices[i]] = sourceGains[i];
+    }
+}
+
+void AudioChannel::sumFrom(const AudioChannel * sourceChannel, const float * gainValues)
+{
+    bool isSafe = sourceChannel && gainValues && sourceChannel->length() >= length();
+    ASSERT(isSafe);
+    if (!isSafe)
+        return;
+
+    if (sourceChannel->isSilent())
+        return;
+
+    if (prepareToSum())
+        vma(sourceChannel->data(), gainValues, mutableData(), length());
+    else
+        vmul(sourceChannel->data(), 1, gainValues, 1, mutableData(), 1, length());
+}
+
+bool AudioChannel::prepareToSum()
+{
+    // A silent channel is overwritten rather than accumulated into, so a view of the shared zeroes
+    // can be dropped without copying it back.
+    const bool accumulate = !isSilent();
+    if (m_isBorrowed) releaseBorrow(accumulate);
+    return accumulate;
+}
+
 float AudioChannel::maxAbsValue() const
 {
     if (isSilent())
@@ -4,19 +4,22 @@
 #include "LabSound/core/AudioContext.h"
 #include "LabSound/core/AnalyserNode.h"
 #include "LabSound/core/AudioListener.h"
+#include "LabSound/core/AudioBusPool.h"
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioParam.h"
 #include "LabSound/core/DefaultAudioDestinationNode.h"
 #include "LabSound/core/OfflineAudioDestinationNode.h"
 #include "LabSound/core/OscillatorNode.h"
 #include "LabSound/core/AudioHardwareSourceNode.h"
+#include "LabSound/core/RenderProfiler.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 
 #include "internal/AudioDestination.h"
+#include "internal/AudioUtilities.h"
 #include "internal/Assertions.h"
-
-#include "readerwriterqueue/readerwriterqueue.h"
+#include "internal/TimerWheel.h"
 
 #include <stdio.h>
 #include <queue>
@@ -25,13 +28,89 @@
 namespace lab
 {
 
+enum class AudioContext::ConnectionType : int
+{
+    Disconnect = 0,
+    Connect,
+    FinishDisconnect
+};
+
+namespace
+{
+    // Length of the ramp out that precedes a disconnection.
+    const double DisconnectRampTime = 0.1;
+
+    // How long before a scheduled source starts its connection is due. Its own scheduling places its first frame,
+    // so this is only a margin for quanta in which the graph lock is busy and edits wait for the next.
+    const double ScheduledConnectLeadTime = 0.02;
+
+    // Buses kept ready for each channel count in use, so that the audio thread can change the channel count of
+    // inputs and outputs without allocating. Half the pool, so that the buses given back stay pooled too.
+    const size_t ReservedBusesPerChannelCount = AudioBusPool::SlotsPerChannelCount / 2;
+}
+
 struct AudioContext::Internals
 {
-    Internals(bool a) : autoDispatchEvents(a) {}
+    // A pending connect or disconnect. It is created by the thread calling connect() or disconnect(), which
+    // also makes room for a connection in the input and output, owned and applied by the audio thread once it
+    // falls due, and deleted by the update thread, so the node references it holds are never released on the
+    // audio thread.
+    struct GraphEdit
+    {
+        ConnectionType type;
+        std::shared_ptr<AudioNode> destination;
+        std::shared_ptr<AudioNode> source;
+        uint32_t destIndex = 0;
+        uint32_t srcIndex = 0;
+        std::shared_ptr<ConnectionGain> gain; // of the connection, if it isn't summed at unity gain
+        uint64_t sequence = 0; // submission order, preserved for edits that fall due in the same quantum
+        uint64_t dueTick = 0;  // index of the render quantum in which to apply the edit
+        GraphEdit * next = nullptr;
+    };
+
+    Internals(bool a) : autoDispatchEvents(a), busPool(AudioNode::ProcessingSizeInFrames) {}
     ~Internals() = default;
 
-    moodycamel::ReaderWriterQueue<std::function<void()>> enqueuedEvents;
     bool autoDispatchEvents;
+    uint64_t eventsWokenFor = 0; // postedCount() at the last wakeup for events; owned by the audio thread
+    AudioBusPool busPool;
+    RenderProfiler profiler;
+
+    std::atomic<uint64_t> nextEditSequence{ 0 };
+    std::atomic<int> outstandingEdits{ 0 };            // keeps the update thread ticking until all are released
+    std::atomic<GraphEdit*> submittedEdits{ nullptr }; // lock-free stack, collected by the audio thread
+    std::atomic<GraphEdit*> retiredEdits{ nullptr };   // lock-free stack, deleted by the update thread
+
+    // Owned by the audio thread.
+    TimerWheel<GraphEdit> scheduledEdits;
+    GraphEdit * dueEdits = nullptr;     // in sequence order, waiting for the graph lock
+    GraphEdit * appliedEdits = nullptr; // retired at the start of the next quantum, once the junctions have been rendered
+
+    static void push(std::atomic<GraphEdit*> & stack, GraphEdit * edit)
+    {
+        edit->next = stack.load(std::memory_order_relaxed);
+        while (!stack.compare_exchange_weak(edit->next, edit, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+
+    void deleteList(GraphEdit * edit)
+    {
+        while (edit)
+        {
+            GraphEdit * next = edit->next;
+            delete edit;
+            --outstandingEdits;
+            edit = next;
+        }
+    }
+
+    void addDue(GraphEdit * edit)
+    {
+        GraphEdit ** link = &dueEdits;
+        while (*link && (*link)->sequence < edit->sequence)
+            link = &(*link)->next;
+        edit->next = *link;
+        *link = edit;
+    }
 };
 
 const uint32_t lab::AudioContext::maxNumberOfChannels = 32;
@@ -61,6 +140,15 @@ AudioContext::~AudioContext()
 
     uninitialize();
 
+    // The audio thread is gone, so any graph edits it didn't get to are discarded here.
+    m_internal->deleteList(m_internal->submittedEdits.exchange(nullptr));
+    m_internal->deleteList(m_internal->dueEdits);
+    m_internal->dueEdits = nullptr;
+    m_internal->deleteList(m_internal->appliedEdits);
+    m_internal->appliedEdits = nullptr;
+    m_internal->scheduledEdits.clear([this](Internals::GraphEdit * edit) { edit->next = nullptr; m_internal->deleteList(edit); });
+    releaseRetiredGraphEdits();
+
     // Audio thread is dead. Nobody will schedule node deletion action. Let's do it ourselves.
     if (m_destinationNode.get()) m_destinationNode.reset();
 
@@ -87,6 +175,11 @@ void AudioContext::lazyInitialize()
             {
                 m_destinationNode->initialize();
 
+                // Mono and stereo, and the destination's channel count, are assumed to be in use from the start.
+                busPool().reserve(Channels::Mono, ReservedBusesPerChannelCount);
+                busPool().reserve(Channels::Stereo, ReservedBusesPerChannelCount);
+                busPool().reserve(m_destinationNode->channelCount(), ReservedBusesPerChannelCount);
+
                 graphKeepAlive = 0.25f; // pump the graph for the first 0.25 seconds
                 graphUpdateThread = std::thread(&AudioContext::update, this);
 
@@ -133,28 +226,39 @@ bool AudioContext::isInitialized() const
 
 void AudioContext::holdSourceNodeUntilFinished(std::shared_ptr<AudioScheduledSourceNode> node)
 {
-    std::lock_guard<std::mutex> lock(m_updateMutex);
-    automaticSources.push_back(node);
+    {
+        std::lock_guard<std::mutex> lock(m_updateMutex);
+        automaticSources.push_back(node);
+    }
+    cv.notify_all(); // the update thread retires it once it has finished
 }
 
+// Called by the update thread rather than the audio thread, so that neither the disconnection nor the release of a finished
+// node happens during rendering. Finished nodes are swapped to the back and removed in one go, in no particular order.
 void AudioContext::handleAutomaticSources()
 {
     std::lock_guard<std::mutex> lock(m_updateMutex);
-    for (auto i = automaticSources.begin(); i != automaticSources.end(); ++i)
+    size_t count = automaticSources.size();
+    for (size_t i = 0; i < count; )
     {
-        if ((*i)->hasFinished())
+        if (automaticSources[i]->hasFinished())
         {
-            pendingNodeConnections.emplace(*i, std::shared_ptr<AudioNode>(), ConnectionType::Disconnect, 0, 0);
-            i = automaticSources.erase(i);
-            if (i == automaticSources.end()) break;
+            scheduleGraphEdit(ConnectionType::Disconnect, automaticSources[i], std::shared_ptr<AudioNode>(), 0, 0);
+            std::swap(automaticSources[i], automaticSources[--count]);
         }
+        else
+            ++i;
     }
+    automaticSources.resize(count);
 }
 
 void AudioContext::handlePreRenderTasks(ContextRenderLock & r)
 {
     ASSERT(r.context());
 
+    // Apply the graph edits due in this quantum first, so that they are heard starting with it.
+    applyScheduledGraphEdits(r);
+
     // At the beginning of every render quantum, try to update the internal rendering graph state (from main thread changes).
     AudioSummingJunction::handleDirtyAudioSummingJunctions(r);
     updateAutomaticPullNodes();
@@ -167,29 +271,259 @@ void AudioContext::handlePostRenderTasks(ContextRenderLock & r)
     AudioSummingJunction::handleDirtyAudioSummingJunctions(r);
 
     updateAutomaticPullNodes();
-    handleAutomaticSources();
+    wakeForPostedEvents();
+
+    m_skippedNodesLastQuantum.store(m_skippedNodesThisQuantum, std::memory_order_relaxed);
+    m_skippedNodesThisQuantum = 0;
 }
 
 void AudioContext::connect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, uint32_t destIdx, uint32_t srcIdx)
 {
     if (!destination) throw std::runtime_error("Cannot connect to null destination");
-    if (!destination) throw std::runtime_error("Cannot connect from null source");
-    std::lock_guard<std::mutex> lock(m_updateMutex);
+    if (!source) throw std::runtime_error("Cannot connect from null source");
+    if (srcIdx > source->numberOfOutputs()) throw std::out_of_range("Output index greater than available outputs");
+    if (destIdx > destination->numberOfInputs()) throw std::out_of_range("Input index greater than available inputs");
+    scheduleGraphEdit(ConnectionType::Connect, destination, source, destIdx, srcIdx);
+    cv.notify_all();
+}
+
+std::shared_ptr<AudioParam> AudioContext::connectWithGain(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, float gain, uint32_t destIdx, uint32_t srcIdx)
+{
+    std::shared_ptr<AudioParam> param = std::make_shared<AudioParam>("gain", 1.0, 0.0, 10000.0);
+    param->setValue(gain);
+    connectWithGain(destination, source, param, destIdx, srcIdx);
+    return param;
+}
+
+void AudioContext::connectWithGain(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, std::shared_ptr<AudioParam> gain, uint32_t destIdx, uint32_t srcIdx)
+{
+    if (!destination) throw std::runtime_error("Cannot connect to null destination");
+    if (!source) throw std::runtime_error("Cannot connect from null source");
+    if (!gain) throw std::invalid_argument("No gain specified");
     if (srcIdx > source->numberOfOutputs()) throw std::out_of_range("Output index greater than available outputs");
     if (destIdx > destination->numberOfInputs()) throw std::out_of_range("Input index greater than available inputs");
-    pendingNodeConnections.emplace(destination, source, ConnectionType::Connect, destIdx, srcIdx);
+    scheduleGraphEdit(ConnectionType::Connect, destination, source, destIdx, srcIdx, gain);
     cv.notify_all();
 }
 
 void AudioContext::disconnect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, uint32_t destIdx, uint32_t srcIdx)
 {
-    std::lock_guard<std::mutex> lock(m_updateMutex);
     if (source && srcIdx > source->numberOfOutputs()) throw std::out_of_range("Output index greater than available outputs");
     if (destination && destIdx > destination->numberOfInputs()) throw std::out_of_range("Input index greater than available inputs");
-    pendingNodeConnections.emplace(destination, source, ConnectionType::Disconnect, destIdx, srcIdx);
+    scheduleGraphEdit(ConnectionType::Disconnect, destination, source, destIdx, srcIdx);
+
+    // keep the update thread ticking until the disconnection has finished, so that the edit is released promptly
+    std::lock_guard<std::mutex> lock(m_updateMutex);
+    if (updateThreadShouldRun)
+        graphKeepAlive = std::max(graphKeepAlive, static_cast<float>(DisconnectRampTime * 2));
     cv.notify_all();
 }
 
+void AudioContext::scheduleGraphEdit(ConnectionType type, std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, uint32_t destIdx, uint32_t srcIdx, std::shared_ptr<AudioParam> gain)
+{
+    Internals::GraphEdit * edit = new Internals::GraphEdit();
+    edit->type = type;
+    edit->destination = std::move(destination);
+    edit->source = std::move(source);
+    edit->destIndex = destIdx;
+    edit->srcIndex = srcIdx;
+    edit->sequence = m_internal->nextEditSequence++;
+    ++m_internal->outstandingEdits;
+
+    if (type == ConnectionType::Connect)
+    {
+        // Everything the connection needs is allocated here, rather than on the audio thread when it is made.
+        edit->gain = gain ? std::make_shared<ConnectionGain>(gain) : nullptr;
+
+        auto input = edit->destination->input(destIdx);
+        auto output = edit->source->output(srcIdx);
+        if (input && output)
+        {
+            ContextGraphLock gLock(this, "scheduleGraphEdit");
+            output->reserveInput(gLock);
+            input->reserveConnection();
+            if (output->isChannelCountKnown())
+                busPool().reserve(output->numberOfChannels(), ReservedBusesPerChannelCount);
+        }
+    }
+
+    // A source that is scheduled to start in the future is connected shortly before it starts, rather than
+    // being processed silently until then; its own scheduling places its first frame. Edits that are already
+    // due are applied in the next quantum.
+    if (type == ConnectionType::Connect && edit->source->isScheduledNode() && m_destinationNode)
+    {
+        AudioScheduledSourceNode * node = static_cast<AudioScheduledSourceNode*>(edit->source.get());
+        const double connectTime = node->startTime() - ScheduledConnectLeadTime;
+        if (connectTime > 0)
+            edit->dueTick = AudioUtilities::timeToSampleFrame(connectTime, sampleRate()) / AudioNode::ProcessingSizeInFrames;
+    }
+
+    Internals::push(m_internal->submittedEdits, edit);
+}
+
+void AudioContext::applyScheduledGraphEdits(ContextRenderLock & r)
+{
+    ASSERT(r.context());
+    Internals & internals = *m_internal;
+    const uint64_t tick = currentSampleFrame() / AudioNode::ProcessingSizeInFrames;
+
+    // The junctions changed by last quantum's edits have taken on their new connections, so the update thread may
+    // release the edits, and the gains they retired.
+    if (internals.appliedEdits)
+    {
+        Internals::GraphEdit * applied = internals.appliedEdits;
+        internals.appliedEdits = nullptr;
+        while (applied)
+        {
+            Internals::GraphEdit * next = applied->next;
+            Internals::push(internals.retiredEdits, applied);
+            applied = next;
+        }
+    }
+
+    Internals::GraphEdit * submitted = internals.submittedEdits.exchange(nullptr, std::memory_order_acquire);
+    while (submitted)
+    {
+        Internals::GraphEdit * next = submitted->next;
+        internals.scheduledEdits.insert(submitted);
+        submitted = next;
+    }
+
+    internals.scheduledEdits.advance(tick, [&internals](Internals::GraphEdit * edit) { internals.addDue(edit); });
+
+    if (!internals.dueEdits)
+        return;
+
+    // The graph lock is only held briefly by other threads. Rather than wait for it, try again next quantum.
+    // An offline context has no deadline, and waits, so that its edits land on the same quantum every render.
+    if (isOfflineContext())
+    {
+        ContextGraphLock gLock(this, "RenderQuantum");
+        applyDueGraphEdits(gLock);
+    }
+    else
+    {
+        ContextGraphLock gLock(this, "RenderQuantum", std::try_to_lock);
+        if (gLock.context())
+            applyDueGraphEdits(gLock);
+    }
+}
+
+void AudioContext::applyDueGraphEdits(ContextGraphLock & gLock)
+{
+    Internals & internals = *m_internal;
+    const uint64_t tick = currentSampleFrame() / AudioNode::ProcessingSizeInFrames;
+
+    while (Internals::GraphEdit * edit = internals.dueEdits)
+    {
+        internals.dueEdits = edit->next;
+
+        switch (edit->type)
+        {
+        case ConnectionType::Connect:
+        {
+            auto input = edit->destination->input(edit->destIndex);
+            auto output = edit->source->output(edit->srcIndex);
+
+            // Connecting again only changes the connection's gain. Ramping the source in afresh would dip it.
+            if (input && output && !input->isConnected(output))
+            {
+                // A source that hasn't started is silent until it plays from its first frame, which mustn't be
+                // faded in with the ramp that softens connecting a source mid-stream.
+                bool hasStarted = true;
+                if (edit->source->isScheduledNode())
+                {
+                    AudioScheduledSourceNode * node = static_cast<AudioScheduledSourceNode*>(edit->source.get());
+                    hasStarted = node->playbackState() != AudioScheduledSourceNode::UNSCHEDULED_STATE && node->playbackState() != AudioScheduledSourceNode::SCHEDULED_STATE;
+                }
+
+                if (hasStarted)
+                    edit->source->scheduleConnect();
+                else
+                    edit->source->scheduleConnectWithoutRamp();
+            }
+
+            AudioNodeInput::connect(gLock, input, output, edit->gain);
+        }
+        break;
+
+        case ConnectionType::Disconnect:
+        {
+            if (edit->source)
+            {
+                // if source and destination are specified, then we don't ramp out the destination
+                edit->source->scheduleDisconnect();
+            }
+            else if (edit->destination)
+            {
+                // source or dest by itself means disconnect all
+                edit->destination->scheduleDisconnect();
+            }
+
+            // finish the disconnection once the ramp out has completed
+            edit->type = ConnectionType::FinishDisconnect;
+            edit->dueTick = tick + static_cast<uint64_t>(std::ceil(DisconnectRampTime * sampleRate() / AudioNode::ProcessingSizeInFrames));
+            internals.scheduledEdits.insert(edit);
+            continue;
+        }
+
+        // @TODO disconnect should occur not at a fixed time, but when node->disconnectionReady() is true
+        case ConnectionType::FinishDisconnect:
+        {
+            if (edit->source && edit->destination)
+            {
+                AudioNodeInput::disconnect(gLock, edit->destination->input(edit->destIndex), edit->source->output(edit->srcIndex));
+            }
+            else if (edit->destination)
+            {
+                for (unsigned int out = 0; out < edit->destination->numberOfOutputs(); ++out)
+                {
+                    auto output = edit->destination->output(out);
+                    if (!output) continue;
+
+                    AudioNodeOutput::disconnectAll(gLock, output);
+                }
+            }
+            else if (edit->source)
+            {
+                for (unsigned int out = 0; out < edit->source->numberOfOutputs(); ++out)
+                {
+                    auto output = edit->source->output(out);
+                    if (!output) continue;
+
+                    AudioNodeOutput::disconnectAll(gLock, output);
+                }
+            }
+        }
+        break;
+        }
+
+        edit->next = internals.appliedEdits;
+        internals.appliedEdits = edit;
+    }
+}
+
+void AudioContext::releaseRetiredGraphEdits()
+{
+    Internals::GraphEdit * edit = m_internal->retiredEdits.exchange(nullptr, std::memory_order_acquire);
+    while (edit)
+    {
+        Internals::GraphEdit * next = edit->next;
+
+        // Release the gains that the edit's input has stopped rendering. Disconnecting everything from a node
+        // leaves the gains it retired to the next edit of each input, or to the input itself.
+        if (edit->destination && edit->source)
+        {
+            if (auto input = edit->destination->input(edit->destIndex))
+                input->releaseRetiredGains();
+        }
+
+        edit->next = nullptr;
+        m_internal->deleteList(edit);
+        edit = next;
+    }
+}
+
 void AudioContext::connectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, uint32_t index)
 {
     if (!param) throw std::invalid_argument("No parameter specified");
@@ -221,8 +555,15 @@ void AudioContext::update()
             // A condition variable is used to notify this thread that a graph update is pending
             // in one of the queues.
 
-            // graph needs to tick to complete
-            if ((currentTime() + graphKeepAlive) > currentTime())
+            // events posted while this thread was busy are dispatched without waiting
+            const bool eventsPending = m_internal->autoDispatchEvents && m_events.hasPendingEvents();
+
+            if (eventsPending)
+            {
+                // fall through to dispatch
+            }
+            // graph needs to tick to complete, applied graph edits need to be released, or held sources need to be retired
+            else if ((currentTime() + graphKeepAlive) > currentTime() || m_internal->outstandingEdits > 0 || !automaticSources.empty())
             {
                 cv.wait_until(lk, std::chrono::steady_clock::now() + std::chrono::microseconds(graphTickDurationUs));
             }
@@ -251,106 +592,14 @@ void AudioContext::update()
                 pendingParamConnections.pop();
                 AudioParam::connect(gLock, std::get<0>(connection), std::get<1>(connection)->output(std::get<2>(connection)));
             }
-
-            std::vector<PendingConnection> skippedConnections;
-
-            // Satisfy node connections
-            while (!pendingNodeConnections.empty())
-            {
-                auto connection = pendingNodeConnections.top();
-                pendingNodeConnections.pop();
-
-                switch (connection.type)
-                {
-                case ConnectionType::Connect:
-                {
-                    // requeue this node if the scheduled time is > 100ms away
-                    if (connection.destination && connection.destination->isScheduledNode())
-                    {
-                        AudioScheduledSourceNode * node = dynamic_cast<AudioScheduledSourceNode*>(connection.destination.get());
-                        if (node->startTime() > now + 0.1)
-                        {
-                            pendingNodeConnections.pop(); // pop from current queue
-                            skippedConnections.push_back(connection); // save for later
-                            continue;
-                        }
-                    }
-
-                    connection.source->scheduleConnect();
-
-                    AudioNodeInput::connect(gLock, connection.destination->input(connection.destIndex), connection.source->output(connection.srcIndex));
-                }
-                break;
-
-                case ConnectionType::Disconnect:
-                {
-                    connection.type = ConnectionType::FinishDisconnect;
-                    skippedConnections.push_back(connection); // save for later
-                    if (connection.source)
-                    {
-                        // if source and destination are specified, then we don't ramp out the destination
-                        connection.source->scheduleDisconnect();
-                    }
-                    else if (connection.destination)
-                    {
-                        // this case is a disconnect where source is nothing, and destination is something
-                        // probably this case should be disallowed because we have to study it to find out
-                        // if it is any different than a source with no destination. Answer: it's the same. source or dest by itself means disconnect all
-                        connection.destination->scheduleDisconnect();
-                    }
-                    graphKeepAlive = updateThreadShouldRun ? connection.duration : graphKeepAlive;
-                }
-                break;
-
-                // @TODO disconnect should occur not in the next quantum, but when node->disconnectionReady() is true
-                case ConnectionType::FinishDisconnect:
-                {
-                    if (connection.duration > 0)
-                    {
-                        connection.duration -= delta;
-                        skippedConnections.push_back(connection);
-                        continue;
-                    }
-
-                    if (connection.source && connection.destination)
-                    {
-                        AudioNodeInput::disconnect(gLock, connection.destination->input(connection.destIndex), connection.source->output(connection.srcIndex));
-                    }
-                    else if (connection.destination)
-                    {
-                        for (unsigned int out = 0; out < connection.destination->numberOfOutputs(); ++out)
-                        {
-                            auto output = connection.destination->output(out);
-                            if (!output) continue;
-
-                            AudioNodeOutput::disconnectAll(gLock, output);
-                        }
-                    }
-                    else if (connection.source)
-                    {
-                        for (unsigned int out = 0; out < connection.source->numberOfOutputs(); ++out)
-                        {
-                            auto output = connection.source->output(out);
-                            if (!output) continue;
-
-                            AudioNodeOutput::disconnectAll(gLock, output);
-                        }
-                    }
-
-                }
-                break;
-                }
-            }
-
-            // We have incompletely connected nodes, so next time the thread ticks we can re-check them
-            for (auto & sc : skippedConnections)
-            {
-                pendingNodeConnections.push(sc);
-            }
-
         }
 
+        releaseRetiredGraphEdits();
+
         if (lk.owns_lock()) lk.unlock();
+
+        handleAutomaticSources();
+        releaseRetiredAutomaticPullNodes();
     }
 
     LOG("End UpdateGraphThread");
@@ -362,6 +611,7 @@ void AudioContext::addAutomaticPullNode(std::shared_ptr<AudioNode> node)
     if (m_automaticPullNodes.find(node) == m_automaticPullNodes.end())
     {
         m_automaticPullNodes.insert(node);
+        m_pendingAutomaticPullNodes.assign(m_automaticPullNodes.begin(), m_automaticPullNodes.end());
         m_automaticPullNodesNeedUpdating = true;
     }
 }
@@ -373,34 +623,31 @@ void AudioContext::removeAutomaticPullNode(std::shared_ptr<AudioNode> node)
     if (it != m_automaticPullNodes.end())
     {
         m_automaticPullNodes.erase(it);
+        m_pendingAutomaticPullNodes.assign(m_automaticPullNodes.begin(), m_automaticPullNodes.end());
         m_automaticPullNodesNeedUpdating = true;
     }
 }
 
 void AudioContext::updateAutomaticPullNodes()
 {
-    /// @TODO this seems like work for the update thread.
-    /// m_automaticPullNodesNeedUpdating can go away in favor of
-    /// add and remove doing a cv.notify.
-    /// m_automaticPullNodes should be an add/remove vector
-    /// m_renderingAutomaticPullNodes should be the actual live vector
-    if (m_automaticPullNodesNeedUpdating)
+    // The list is built by addAutomaticPullNode() and removeAutomaticPullNode(), so the audio thread only swaps it in,
+    // without copying or allocating. If the update mutex is busy, the swap waits for the next quantum.
+    if (m_automaticPullNodesNeedUpdating.load(std::memory_order_acquire) && m_updateMutex.try_lock())
     {
-        std::lock_guard<std::mutex> lock(m_updateMutex);
-
-        // Copy from m_automaticPullNodes to m_renderingAutomaticPullNodes.
-        m_renderingAutomaticPullNodes.resize(m_automaticPullNodes.size());
-
-        unsigned j = 0;
-        for (auto i = m_automaticPullNodes.begin(); i != m_automaticPullNodes.end(); ++i, ++j)
-        {
-            m_renderingAutomaticPullNodes[j] = *i;
-        }
-
+        m_renderingAutomaticPullNodes.swap(m_pendingAutomaticPullNodes);
         m_automaticPullNodesNeedUpdating = false;
+        m_updateMutex.unlock();
     }
 }
 
+void AudioContext::releaseRetiredAutomaticPullNodes()
+{
+    // Once swapped out, the previous list holds the only references to removed nodes; release them off the audio thread.
+    std::lock_guard<std::mutex> lock(m_updateMutex);
+    if (!m_automaticPullNodesNeedUpdating)
+        m_pendingAutomaticPullNodes.clear();
+}
+
 void AudioContext::processAutomaticPullNodes(ContextRenderLock & r, size_t framesToProcess)
 {
     for (unsigned i = 0; i < m_renderingAutomaticPullNodes.size(); ++i)
@@ -409,18 +656,31 @@ void AudioContext::processAutomaticPullNodes(ContextRenderLock & r, size_t frame
 
 void AudioContext::enqueueEvent(std::function<void()>& fn)
 {
-    m_internal->enqueuedEvents.enqueue(fn);
-    cv.notify_all();    // processing thread must dispatch events
+    if (fn)
+        postEvent([fn]() { fn(); });
 }
 
 void AudioContext::dispatchEvents()
 {
-    std::function<void()> event_fn;
-    while (m_internal->enqueuedEvents.try_dequeue(event_fn))
-    {
-        if (event_fn)
-            event_fn();
-    }
+    m_events.dispatch();
+}
+
+void AudioContext::wakeForPostedEvents()
+{
+    // Wake the update thread once for everything posted since the last wakeup, rather than once per event.
+    // The audio thread mustn't block on m_updateMutex. If it is held, the update thread is awake and checks
+    // for pending events before it next waits - unless it was already about to wait, so the wakeup is
+    // retried next quantum rather than marked done.
+    const uint64_t posted = m_events.postedCount();
+    if (!m_internal->autoDispatchEvents || posted == m_internal->eventsWokenFor)
+        return;
+
+    if (!m_updateMutex.try_lock())
+        return;
+    m_updateMutex.unlock();
+
+    m_internal->eventsWokenFor = posted;
+    cv.notify_all();
 }
 
 void AudioContext::setDestinationNode(std::shared_ptr<AudioDestinationNode> node)
@@ -459,6 +719,16 @@ AudioListener & AudioContext::listener()
     return *m_listener.get();
 }
 
+AudioBusPool & AudioContext::busPool()
+{
+    return m_internal->busPool;
+}
+
+RenderProfiler & AudioContext::profiler()
+{
+    return m_internal->profiler;
+}
+
 unsigned long AudioContext::activeSourceCount() const
 {
     return static_cast<unsigned long>(m_activeSourceCount);
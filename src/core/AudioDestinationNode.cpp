@@ -8,6 +8,7 @@
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioSourceProvider.h"
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/RenderProfiler.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 
@@ -95,6 +96,10 @@ void AudioDestinationNode::render(AudioBus * sourceBus, AudioBus * destinationBu
     // Use an RAII object to protect all AudioNodes processed within this scope.
     DenormalDisabler denormalDisabler;
 
+    RenderProfiler & profiler = m_context->profiler();
+    const bool profiling = profiler.isEnabled();
+    const uint64_t quantumStart = profiling ? profiler.beginQuantum() : 0;
+
     // Let the context take care of any business at the start of each render quantum.
     m_context->handlePreRenderTasks(renderLock);
 
@@ -125,6 +130,15 @@ void AudioDestinationNode::render(AudioBus * sourceBus, AudioBus * destinationBu
     
     // Advance current sample-frame.
     m_currentSampleFrame += numberOfFrames;
+
+    if (profiling)
+        profiler.endQuantum(quantumStart, numberOfFrames / static_cast<double>(m_sampleRate));
+}
+
+void AudioDestinationNode::deviceXRun()
+{
+    if (m_context)
+        m_context->profiler().recordDeviceXRun();
 }
 
 double AudioDestinationNode::currentTime() const 
@@ -0,0 +1,95 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/AudioEventQueue.h"
+
+#include <stdint.h>
+
+namespace lab
+{
+
+// The slot protocol is Dmitry Vyukov's bounded MPMC queue: producers and consumers each claim a position
+// with a compare-and-swap, then hand the slot over by advancing its sequence.
+
+AudioEventQueue::AudioEventQueue(size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+
+    m_slots.reset(new Slot[size]);
+    m_mask = size - 1;
+
+    for (size_t i = 0; i < size; ++i)
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+AudioEventQueue::~AudioEventQueue()
+{
+    drain(false);
+}
+
+AudioEventQueue::Slot * AudioEventQueue::claim(size_t & position)
+{
+    position = m_enqueuePosition.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Slot & slot = m_slots[position & m_mask];
+        const intptr_t difference = static_cast<intptr_t>(slot.sequence.load(std::memory_order_acquire) - position);
+
+        if (difference == 0)
+        {
+            if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                return &slot;
+        }
+        else if (difference < 0)
+        {
+            return nullptr; // full: the slot still holds an event from the previous lap
+        }
+        else
+        {
+            position = m_enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t AudioEventQueue::dispatch()
+{
+    return drain(true);
+}
+
+size_t AudioEventQueue::drain(bool run)
+{
+    const size_t end = m_enqueuePosition.load(std::memory_order_acquire);
+    size_t position = m_dequeuePosition.load(std::memory_order_relaxed);
+    size_t count = 0;
+
+    while (static_cast<intptr_t>(end - position) > 0)
+    {
+        Slot & slot = m_slots[position & m_mask];
+        const intptr_t difference = static_cast<intptr_t>(slot.sequence.load(std::memory_order_acquire) - (position + 1));
+
+        if (difference == 0)
+        {
+            if (m_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                slot.invoke(slot.storage, run);
+                slot.sequence.store(position + m_mask + 1, std::memory_order_release);
+                ++position;
+                ++count;
+            }
+        }
+        else if (difference < 0)
+        {
+            break; // claimed but not yet published; it goes out with the next dispatch
+        }
+        else
+        {
+            position = m_dequeuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    return count;
+}
+
+} // namespace lab
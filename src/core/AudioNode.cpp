@@ -8,10 +8,12 @@
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioParam.h"
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/RenderProfiler.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 
 #include "internal/Assertions.h"
+#include "internal/VectorMath.h"
 
 using namespace std;
 
@@ -127,60 +129,73 @@ void AudioNode::processIfNecessary(ContextRenderLock & r, size_t framesToProcess
         if (!silentInputs)
         {
             m_lastNonSilentTime = (ac->currentSampleFrame() + framesToProcess) / static_cast<double>(ac->sampleRate());
+            m_tailExpired = false;
         }
 
-        // if this node is supposed to copy silence through, and is itself silent
+        // if this node is supposed to copy silence through, and is itself silent, skip processing entirely.
+        // Silenced outputs share a read-only zero buffer, so this costs no memory traffic.
         if (silentInputs && propagatesSilence(r))
         {
             silenceOutputs(r);
+            ++ac->m_skippedNodesThisQuantum;
         }
         else
         {
+            RenderProfiler & profiler = ac->profiler();
+            const bool profiling = profiler.isEnabled();
+            const uint64_t processStart = profiling ? profiler.now() : 0;
+
             process(r, framesToProcess);
 
-            float new_schedule = 0.f;
+            // The disconnect ramp fades each output by a factor of 0.98 per frame, and the connect ramp
+            // approaches unity at the same rate. Each is applied to every channel as one closed form ramp.
+            const float RampRatio = 0.98f;
 
-            if (m_disconnectSchedule >= 0)
+            const float disconnectSchedule = m_disconnectSchedule;
+            if (disconnectSchedule >= 0)
             {
-                for (auto out : m_outputs)
-                    for (unsigned i = 0; i < out->bus(r)->numberOfChannels(); ++i)
+                float new_schedule = 0.f;
+                for (auto & out : m_outputs)
+                {
+                    AudioBus * bus = out->bus(r);
+                    for (unsigned i = 0; i < bus->numberOfChannels(); ++i)
                     {
-                        float scale = m_disconnectSchedule;
-                        float * sample = out->bus(r)->channel(i)->mutableData();
-                        size_t numSamples = out->bus(r)->channel(i)->length();
-                        for (size_t s = 0; s < numSamples; ++s)
-                        {
-                            sample[s] *= scale;
-                            scale *= 0.98f;
-                        }
-                        new_schedule = scale;
+                        float * sample = bus->channel(i)->mutableData();
+                        new_schedule = disconnectSchedule;
+                        VectorMath::vrampmul(sample, &new_schedule, 0.f, RampRatio, sample, bus->channel(i)->length());
                     }
+                }
 
-                m_disconnectSchedule = new_schedule;
+                // Once inaudible, stop short of decaying into denormals.
+                m_disconnectSchedule = new_schedule < 1e-7f ? 0.f : new_schedule;
             }
 
-            new_schedule = 1.f;
-            if (m_connectSchedule < 1)
+            const float connectSchedule = m_connectSchedule;
+            if (connectSchedule < 1)
             {
-                for (auto out : m_outputs)
-                    for (unsigned i = 0; i < out->bus(r)->numberOfChannels(); ++i)
+                float new_schedule = 1.f;
+                for (auto & out : m_outputs)
+                {
+                    AudioBus * bus = out->bus(r);
+                    for (unsigned i = 0; i < bus->numberOfChannels(); ++i)
                     {
-                        float scale = m_connectSchedule;
-                        float * sample = out->bus(r)->channel(i)->mutableData();
-                        size_t numSamples = out->bus(r)->channel(i)->length();
-                        for (size_t s = 0; s < numSamples; ++s)
-                        {
-                            sample[s] *= scale;
-                            scale = 1.f - ((1.f - scale) * 0.98f);
-                        }
-                        new_schedule = scale;
+                        float * sample = bus->channel(i)->mutableData();
+                        new_schedule = connectSchedule;
+                        VectorMath::vrampmul(sample, &new_schedule, 1.f, RampRatio, sample, bus->channel(i)->length());
                     }
+                }
 
                 m_connectSchedule = new_schedule;
             }
 
             unsilenceOutputs(r);
+
+            if (profiling)
+                profiler.recordNode(this, m_profileIndex, m_profileEpoch, processStart, profiler.now());
         }
+
+        for (auto & out : m_outputs)
+            out->notifyTaps(r, framesToProcess);
     }
 }
 
@@ -201,7 +216,14 @@ bool AudioNode::propagatesSilence(ContextRenderLock & r) const
 {
     ASSERT(r.context());
 
-    return m_lastNonSilentTime + latencyTime(r) + tailTime(r) < r.context()->currentTime(); // dimitri use of latencyTime() / tailTime()
+    // Once the tail has rung out it stays expired until non-silent input arrives (see processIfNecessary),
+    // so latencyTime() and tailTime() aren't evaluated for every quantum of silence.
+    if (!m_tailExpired)
+    {
+        m_tailExpired = m_lastNonSilentTime + latencyTime(r) + tailTime(r) < r.context()->currentTime();
+    }
+
+    return m_tailExpired;
 }
 
 void AudioNode::pullInputs(ContextRenderLock& r, size_t framesToProcess)
@@ -7,6 +7,8 @@
 #include "LabSound/core/AudioNode.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioBusPool.h"
+#include "LabSound/core/AudioParam.h"
 #include "LabSound/core/Mixing.h"
 
 #include "LabSound/extended/AudioContextLock.h"
@@ -31,17 +33,28 @@ AudioNodeInput::~AudioNodeInput()
 {
 }
 
-void AudioNodeInput::connect(ContextGraphLock& g, std::shared_ptr<AudioNodeInput> junction, std::shared_ptr<AudioNodeOutput> toOutput)
+void AudioNodeInput::connect(ContextGraphLock& g, std::shared_ptr<AudioNodeInput> junction, std::shared_ptr<AudioNodeOutput> toOutput, std::shared_ptr<AudioParam> gain)
+{
+    connect(g, junction, toOutput, gain ? std::make_shared<ConnectionGain>(gain) : nullptr);
+}
+
+void AudioNodeInput::connect(ContextGraphLock& g, std::shared_ptr<AudioNodeInput> junction, std::shared_ptr<AudioNodeOutput> toOutput, std::shared_ptr<ConnectionGain> gain)
 {
     if (!junction || !toOutput || !junction->node())
         return;
 
-    // return if input is already connected to this output.
+    // return if input is already connected to this output, once the connection has taken on the new gain, and any
+    // room reserved for it has been given back.
     if (junction->isConnected(toOutput))
+    {
+        if (toOutput->m_reservedInputs)
+            --toOutput->m_reservedInputs;
+        junction->junctionConnectOutput(toOutput, gain);
         return;
+    }
 
     toOutput->addInput(g, junction);
-    junction->junctionConnectOutput(toOutput);
+    junction->junctionConnectOutput(toOutput, gain);
 }
 
 void AudioNodeInput::disconnect(ContextGraphLock& g, std::shared_ptr<AudioNodeInput> junction, std::shared_ptr<AudioNodeOutput> toOutput)
@@ -68,7 +81,10 @@ void AudioNodeInput::updateInternalBus(ContextRenderLock& r)
     if (numberOfInputChannels == m_internalSummingBus->numberOfChannels())
         return;
 
-    m_internalSummingBus = std::unique_ptr<AudioBus>(new AudioBus(numberOfInputChannels, AudioNode::ProcessingSizeInFrames));
+    // Called on the audio thread, so recycle buses through the context's pool rather than the heap.
+    AudioBusPool & pool = r.context()->busPool();
+    pool.release(m_internalSummingBus.release());
+    m_internalSummingBus.reset(pool.acquire(numberOfInputChannels));
 }
 
 size_t AudioNodeInput::numberOfChannels(ContextRenderLock& r) const
@@ -107,7 +123,7 @@ AudioBus* AudioNodeInput::bus(ContextRenderLock& r)
     // note: The webkit sources check for max, but I can't see how that's correct
 
     // @tofix - did I miss part of the merge?
-    if (numberOfRenderingConnections(r) == 1) // && node()->channelCountMode() == ChannelCountMode::Max)
+    if (numberOfRenderingConnections(r) == 1 && !renderingGain(r, 0)) // && node()->channelCountMode() == ChannelCountMode::Max)
     {
         std::shared_ptr<AudioNodeOutput> output = renderingOutput(r, 0);
         if (output) {
@@ -133,18 +149,99 @@ void AudioNodeInput::sumAllConnections(ContextRenderLock& r, AudioBus* summingBu
 
     summingBus->zero();
 
-    for (int i = 0; i < c; ++i)
+    // Every connection is rendered before any of them is summed, so that the summing bus is written in a single
+    // pass per block of connections rather than once per connection. Connections at unity gain and connections
+    // with de-zippered gains are summed as two such blocks. A gain that has sample-accurate values, because it
+    // is automated or driven by an audio-rate signal, is applied as its connection is rendered. Connections
+    // mixed to our channel count hold a pooled bus until they are summed, so no more are pending than the pool
+    // keeps, lest it fall back to the heap.
+    const size_t MaxConnectionsPerPass = 64;
+    const size_t MaxMixedPerPass = AudioBusPool::SlotsPerChannelCount;
+    const AudioBus * unityBuses[MaxConnectionsPerPass];
+    const AudioBus * gainBuses[MaxConnectionsPerPass];
+    ConnectionGain * gains[MaxConnectionsPerPass];
+    float lastGains[MaxConnectionsPerPass];
+    float targetGains[MaxConnectionsPerPass];
+    AudioBus * mixedBuses[MaxConnectionsPerPass];
+    size_t unityCount = 0;
+    size_t gainCount = 0;
+    size_t mixedCount = 0;
+
+    AudioBusPool & pool = r.context()->busPool();
+    const size_t numberOfChannels = summingBus->numberOfChannels();
+
+    auto sumPending = [&]()
+    {
+        // Sum, with unity-gain.
+        summingBus->sumFrom(unityBuses, unityCount);
+
+        summingBus->sumWithGainFrom(gainBuses, lastGains, targetGains, gainCount);
+        for (size_t i = 0; i < gainCount; ++i)
+            gains[i]->lastGain = lastGains[i];
+
+        for (size_t i = 0; i < mixedCount; ++i)
+            pool.release(mixedBuses[i]);
+
+        unityCount = gainCount = mixedCount = 0;
+    };
+
+    for (size_t i = 0; i < c; ++i)
     {
         auto output = renderingOutput(r, i);
-        if (output)
-        {
-            // Render audio from this output.
-            AudioBus* connectionBus = output->pull(r, 0, framesToProcess);
+        if (!output)
+            continue;
 
-            // Sum, with unity-gain.
-            summingBus->sumFrom(*connectionBus);
+        // Render audio from this output.
+        const AudioBus * connectionBus = output->pull(r, 0, framesToProcess);
+
+        ConnectionGain * gain = renderingGain(r, i);
+        if (!gain)
+        {
+            unityBuses[unityCount++] = connectionBus;
         }
+        else
+        {
+            if (connectionBus->numberOfChannels() != numberOfChannels)
+            {
+                // Up or down mixing is linear, so a connection is mixed to our channel count before its gain is applied.
+                AudioBus * mixedBus = pool.acquire(numberOfChannels);
+                mixedBus->copyFrom(*connectionBus);
+                mixedBuses[mixedCount++] = mixedBus;
+                connectionBus = mixedBus;
+            }
+
+            AudioParam & param = *gain->param;
+            if (param.hasSampleAccurateValues())
+            {
+                param.calculateSampleAccurateValues(r, gain->values.data(), framesToProcess);
+                summingBus->sumWithSampleAccurateGainValuesFrom(*connectionBus, gain->values.data(), framesToProcess);
+
+                // Continue from the last value if the gain becomes constant.
+                gain->lastGain = gain->values[framesToProcess - 1];
+                gain->isFirstTime = false;
+            }
+            else
+            {
+                // First time, snap directly to the gain.
+                const float targetGain = param.value(r);
+                if (gain->isFirstTime)
+                {
+                    gain->lastGain = targetGain;
+                    gain->isFirstTime = false;
+                }
+
+                gainBuses[gainCount] = connectionBus;
+                gains[gainCount] = gain;
+                lastGains[gainCount] = gain->lastGain;
+                targetGains[gainCount++] = targetGain;
+            }
+        }
+
+        if (unityCount == MaxConnectionsPerPass || gainCount == MaxConnectionsPerPass || mixedCount == MaxMixedPerPass)
+            sumPending();
     }
+
+    sumPending();
 }
 
 AudioBus* AudioNodeInput::pull(ContextRenderLock& r, AudioBus* inPlaceBus, size_t framesToProcess)
@@ -153,8 +250,8 @@ AudioBus* AudioNodeInput::pull(ContextRenderLock& r, AudioBus* inPlaceBus, size_
 
     size_t c = numberOfRenderingConnections(r);
 
-    // Handle single connection case.
-    if (c == 1)
+    // Handle single connection case. A connection with a gain is summed like multiple connections are.
+    if (c == 1 && !renderingGain(r, 0))
     {
         // If this input is simply passing data through, then immediately delegate the pull request to it.
         auto output = renderingOutput(r, 0);
@@ -169,8 +266,8 @@ AudioBus* AudioNodeInput::pull(ContextRenderLock& r, AudioBus* inPlaceBus, size_
     AudioBus* internalSummingBusPtr = internalSummingBus(r);
     if (c == 0)
     {
-        // Generate silence if we're not connected to anything.
-        /// @TODO a possible optimization is to flag silence and propagate it to consumers of this input.
+        // Generate silence if we're not connected to anything. zero() flags the bus as silent and points it
+        // at the shared zero buffer, so consumers that propagate silence skip processing altogether.
         internalSummingBusPtr->zero();
         return internalSummingBusPtr;
     }
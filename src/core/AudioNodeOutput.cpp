@@ -7,6 +7,7 @@
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioParam.h"
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioBusPool.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 
@@ -51,15 +52,23 @@ void AudioNodeOutput::setNumberOfChannels(ContextRenderLock& r, size_t numberOfC
         return;
     
     m_desiredNumberOfChannels = numberOfChannels;
-    m_internalBus.reset(new AudioBus(numberOfChannels, AudioNode::ProcessingSizeInFrames));
+    replaceInternalBus(r, numberOfChannels);
 }
 
-void AudioNodeOutput::updateInternalBus()
+void AudioNodeOutput::updateInternalBus(ContextRenderLock& r)
 {
     if (numberOfChannels() == m_internalBus->numberOfChannels())
         return;
 
-    m_internalBus.reset(new AudioBus(numberOfChannels(), AudioNode::ProcessingSizeInFrames));
+    replaceInternalBus(r, numberOfChannels());
+}
+
+void AudioNodeOutput::replaceInternalBus(ContextRenderLock& r, size_t numberOfChannels)
+{
+    // Called on the audio thread, so recycle buses through the context's pool rather than the heap.
+    AudioBusPool & pool = r.context()->busPool();
+    pool.release(m_internalBus.release());
+    m_internalBus.reset(pool.acquire(numberOfChannels));
 }
 
 void AudioNodeOutput::updateRenderingState(ContextRenderLock& r)
@@ -68,7 +77,7 @@ void AudioNodeOutput::updateRenderingState(ContextRenderLock& r)
     {
         ASSERT(r.context());
         m_numberOfChannels = m_desiredNumberOfChannels;
-        updateInternalBus();
+        updateInternalBus(r);
         propagateChannelCount(r);
     }
     m_renderingFanOutCount = fanOutCount();
@@ -116,6 +125,29 @@ AudioBus * AudioNodeOutput::pull(ContextRenderLock& r, AudioBus* inPlaceBus, siz
     return bus(r);
 }
 
+void AudioNodeOutput::addTap(ContextRenderLock & r, std::shared_ptr<AudioTap> tap)
+{
+    ASSERT(r.context());
+    if (tap && std::find(m_taps.begin(), m_taps.end(), tap) == m_taps.end())
+        m_taps.push_back(tap);
+}
+
+void AudioNodeOutput::removeTap(ContextRenderLock & r, std::shared_ptr<AudioTap> tap)
+{
+    ASSERT(r.context());
+    m_taps.erase(std::remove(m_taps.begin(), m_taps.end(), tap), m_taps.end());
+}
+
+void AudioNodeOutput::notifyTaps(ContextRenderLock & r, size_t framesToProcess)
+{
+    if (m_taps.empty())
+        return;
+
+    const AudioBus * rendered = bus(r);
+    for (auto & tap : m_taps)
+        tap->rendered(r, *this, *rendered, framesToProcess);
+}
+
 AudioBus* AudioNodeOutput::bus(ContextRenderLock& r) const
 {
     ASSERT(r.context()); // only legal during rendering because an in place bus might have been supplied to pull
@@ -142,11 +174,20 @@ size_t AudioNodeOutput::renderingParamFanOutCount() const
     return m_renderingParamFanOutCount;
 }
 
+void AudioNodeOutput::reserveInput(ContextGraphLock& g)
+{
+    ASSERT(g.context());
+    ++m_reservedInputs;
+    m_inputs.reserve(m_inputs.size() + m_reservedInputs);
+}
+
 void AudioNodeOutput::addInput(ContextGraphLock& g, std::shared_ptr<AudioNodeInput> input)
 {
     if (!input)
         return;
     
+    if (m_reservedInputs)
+        --m_reservedInputs;
     m_inputs.emplace_back(input);
     input->setDirty();
 }
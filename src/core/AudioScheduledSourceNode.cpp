@@ -151,7 +151,12 @@ void AudioScheduledSourceNode::finish(ContextRenderLock& r)
 {
     m_playbackState = FINISHED_STATE;
     r.context()->decrementActiveSourceCount();
-    r.context()->enqueueEvent(m_onEnded);
+    if (m_onEnded)
+    {
+        // Copying the shared callback only bumps a reference count, so the render thread doesn't allocate.
+        std::shared_ptr<std::function<void()>> onEnded = m_onEnded;
+        r.context()->postEvent([onEnded]() { (*onEnded)(); });
+    }
 }
 
 } // namespace lab
@@ -5,6 +5,8 @@
 #include "LabSound/core/AudioSummingJunction.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/AudioParam.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 
@@ -31,6 +33,14 @@ void AudioSummingJunction::handleDirtyAudioSummingJunctions(ContextRenderLock& r
         asj->updateRenderingState(r);
 }
 
+ConnectionGain::ConnectionGain(std::shared_ptr<AudioParam> p) : param(std::move(p)), values(AudioNode::ProcessingSizeInFrames)
+{
+}
+
+ConnectionGain::~ConnectionGain()
+{
+}
+
 AudioSummingJunction::AudioSummingJunction() : m_renderingStateNeedUpdating(false)
 {
     
@@ -52,6 +62,19 @@ bool AudioSummingJunction::isConnected(std::shared_ptr<AudioNodeOutput> o) const
     return false;
 }
 
+void AudioSummingJunction::retireGain(std::shared_ptr<ConnectionGain> gain)
+{
+    if (gain)
+        m_retiredGains.push_back(std::move(gain));
+}
+
+void AudioSummingJunction::releaseRetiredGains()
+{
+    std::lock_guard<std::mutex> lock(junctionMutex);
+    m_retiredGains.erase(m_retiredGains.begin(), m_retiredGains.begin() + m_releasableGainCount);
+    m_releasableGainCount = 0;
+}
+
 size_t AudioSummingJunction::numberOfRenderingConnections(ContextRenderLock&) const {
     size_t count = 0;
     for (auto i : m_renderingOutputs) {
@@ -61,24 +84,52 @@ size_t AudioSummingJunction::numberOfRenderingConnections(ContextRenderLock&) co
     return count;
 }
     
-void AudioSummingJunction::junctionConnectOutput(std::shared_ptr<AudioNodeOutput> o)
+void AudioSummingJunction::reserveConnection()
+{
+    std::lock_guard<std::mutex> lock(junctionMutex);
+    ++m_reservedConnections;
+
+    const size_t connections = m_connectedOutputs.size() + m_reservedConnections;
+    m_connectedOutputs.reserve(connections);
+    m_connectedGains.reserve(connections);
+
+    // Every gain may be retired before the next change to the connections releases any.
+    m_retiredGains.reserve(m_retiredGains.size() + connections);
+}
+
+void AudioSummingJunction::junctionConnectOutput(std::shared_ptr<AudioNodeOutput> o, std::shared_ptr<ConnectionGain> gain)
 {
     if (!o)
         return;
     
     std::lock_guard<std::mutex> lock(junctionMutex);
-
-    for (std::vector<std::weak_ptr<AudioNodeOutput>>::iterator i = m_connectedOutputs.begin(); i != m_connectedOutputs.end();)
-        if (i->expired())
-            i = m_connectedOutputs.erase(i);
+    if (m_reservedConnections)
+        --m_reservedConnections;
+
+    for (size_t i = 0; i < m_connectedOutputs.size();)
+        if (m_connectedOutputs[i].expired())
+        {
+            retireGain(m_connectedGains[i]);
+            m_connectedOutputs.erase(m_connectedOutputs.begin() + i);
+            m_connectedGains.erase(m_connectedGains.begin() + i);
+        }
         else
             i++;
     
-    for (auto i : m_connectedOutputs)
-        if (i.lock() == o)
+    for (size_t i = 0; i < m_connectedOutputs.size(); ++i)
+        if (m_connectedOutputs[i].lock() == o)
+        {
+            if (gain && (!m_connectedGains[i] || m_connectedGains[i]->param != gain->param))
+            {
+                retireGain(m_connectedGains[i]);
+                m_connectedGains[i] = std::move(gain);
+                m_renderingStateNeedUpdating = true;
+            }
             return;
+        }
 
     m_connectedOutputs.push_back(o);
+    m_connectedGains.push_back(std::move(gain));
     m_renderingStateNeedUpdating = true;
 }
 
@@ -89,9 +140,11 @@ void AudioSummingJunction::junctionDisconnectOutput(std::shared_ptr<AudioNodeOut
     
     std::lock_guard<std::mutex> lock(junctionMutex);
 
-    for (std::vector<std::weak_ptr<AudioNodeOutput>>::iterator i = m_connectedOutputs.begin(); i != m_connectedOutputs.end(); ++i)
-        if (!i->expired() && i->lock() == o) {
-            m_connectedOutputs.erase(i);
+    for (size_t i = 0; i < m_connectedOutputs.size(); ++i)
+        if (!m_connectedOutputs[i].expired() && m_connectedOutputs[i].lock() == o) {
+            retireGain(m_connectedGains[i]);
+            m_connectedOutputs.erase(m_connectedOutputs.begin() + i);
+            m_connectedGains.erase(m_connectedGains.begin() + i);
             m_renderingStateNeedUpdating = true;
             break;
         }
@@ -100,7 +153,10 @@ void AudioSummingJunction::junctionDisconnectOutput(std::shared_ptr<AudioNodeOut
 void AudioSummingJunction::junctionDisconnectAllOutputs()
 {
 	std::lock_guard<std::mutex> lock(junctionMutex);
+	for (auto & gain : m_connectedGains)
+		retireGain(gain);
 	m_connectedOutputs.clear();
+	m_connectedGains.clear();
 	m_renderingStateNeedUpdating = true;
 }
 
@@ -118,15 +174,21 @@ void AudioSummingJunction::updateRenderingState(ContextRenderLock& r)
     {
         std::lock_guard<std::mutex> lock(junctionMutex);
         
-        // Copy from m_outputs to m_renderingOutputs.
+        // Copy from m_outputs to m_renderingOutputs. Every gain being let go of is still held by m_connectedGains
+        // or m_retiredGains, so none is destroyed here.
         m_renderingOutputs.clear();
-        for (std::vector<std::weak_ptr<AudioNodeOutput>>::iterator i = m_connectedOutputs.begin(); i != m_connectedOutputs.end(); ++i)
-            if (!i->expired())
+        m_renderingGains.clear();
+        for (size_t i = 0; i < m_connectedOutputs.size(); ++i)
+            if (auto output = m_connectedOutputs[i].lock())
             {
-                m_renderingOutputs.push_back(*i);
-                i->lock()->updateRenderingState(r);
+                m_renderingOutputs.push_back(m_connectedOutputs[i]);
+                m_renderingGains.push_back(m_connectedGains[i]);
+                output->updateRenderingState(r);
             }
 
+        // The gains retired so far are no longer rendered, and may be released.
+        m_releasableGainCount = m_retiredGains.size();
+
         didUpdate(r);
         m_renderingStateNeedUpdating = false;
     }
@@ -58,7 +58,8 @@ void ChannelMergerNode::process(ContextRenderLock& r, size_t framesToProcess)
                 AudioChannel* inputChannel = input->bus(r)->channel(j);
                 AudioChannel* outputChannel = output->bus(r)->channel(outputChannelIndex);
                 
-                outputChannel->copyFrom(inputChannel);
+                // Forward the input samples without a copy; valid for this quantum only.
+                outputChannel->borrow(inputChannel);
                 ++outputChannelIndex;
             }
         }
@@ -47,9 +47,9 @@ void ChannelSplitterNode::process(ContextRenderLock& r, size_t framesToProcess)
         
         if (i < numberOfSourceChannels)
         {
-            // Split the channel out if it exists in the source.
-            // It would be nice to avoid the copy and simply pass along pointers, but this becomes extremely difficult with fanout and fanin.
-            destination->channel(0)->copyFrom(source->channel(i));
+            // Split the channel out if it exists in the source. Rather than copying, the destination borrows
+            // the source channel for this quantum; downstream in-place processing copies on first write.
+            destination->channel(0)->borrow(source->channel(i));
         }
         else if (output(i)->renderingFanOutCount() > 0)
         {
@@ -0,0 +1,269 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/CompressedAudioBus.h"
+#include "LabSound/core/AudioBus.h"
+
+#include "internal/Assertions.h"
+#include "internal/VectorMath.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace lab {
+
+using namespace VectorMath;
+
+namespace {
+
+    const float Int16Scale = 1.0f / 32768.0f;
+    const float Int24Scale = 1.0f / 8388608.0f;
+
+    // An IMA ADPCM block is a header holding its first sample and the step index to decode the rest with, followed by
+    // the other ImaAdpcmBlockLength - 1 samples at four bits each, low nibble first. Every block is stored whole, so
+    // that block b is found at b * ImaAdpcmBlockBytes; the last is padded with silence.
+    const size_t ImaAdpcmHeaderBytes = 4;
+    const size_t ImaAdpcmBlockBytes = ImaAdpcmHeaderBytes + CompressedAudioBus::ImaAdpcmBlockLength / 2;
+
+    const int ImaIndexTable[16] = {
+        -1, -1, -1, -1, 2, 4, 6, 8,
+        -1, -1, -1, -1, 2, 4, 6, 8,
+    };
+
+    const int ImaStepTable[89] = {
+        7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97,
+        107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+        876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871,
+        5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623,
+        27086, 29794, 32767,
+    };
+
+    // Clips to [-1, 1], sending NaN to -1, and scales to an integer of full scale `scale`.
+    inline int32_t quantize(float x, float scale)
+    {
+        x = x > 1.0f ? 1.0f : (x >= -1.0f ? x : -1.0f);
+        int32_t s = static_cast<int32_t>(floorf(x * scale + 0.5f));
+        return std::min(s, static_cast<int32_t>(scale) - 1);
+    }
+
+    // Advances the decoder state by one nibble, as both the encoder and decoder must.
+    inline void imaStep(int nibble, int & predictor, int & index)
+    {
+        const int step = ImaStepTable[index];
+        int diff = step >> 3;
+        if (nibble & 4) diff += step;
+        if (nibble & 2) diff += step >> 1;
+        if (nibble & 1) diff += step >> 2;
+        predictor += (nibble & 8) ? -diff : diff;
+        predictor = std::max(-32768, std::min(32767, predictor));
+        index = std::max(0, std::min(88, index + ImaIndexTable[nibble]));
+    }
+
+    // Encodes a block starting from the given step index, and returns its squared error, leaving index as the
+    // block ends.
+    int64_t imaEncodeBlock(const int16_t * samples, int & index, uint8_t * block)
+    {
+        int64_t error = 0;
+
+        int predictor = samples[0];
+        block[0] = static_cast<uint8_t>(predictor & 0xff);
+        block[1] = static_cast<uint8_t>((predictor >> 8) & 0xff);
+        block[2] = static_cast<uint8_t>(index);
+        block[3] = 0;
+
+        uint8_t * nibbles = block + ImaAdpcmHeaderBytes;
+        memset(nibbles, 0, ImaAdpcmBlockBytes - ImaAdpcmHeaderBytes);
+
+        for (size_t i = 1; i < CompressedAudioBus::ImaAdpcmBlockLength; ++i)
+        {
+            int diff = samples[i] - predictor;
+            int nibble = 0;
+            if (diff < 0)
+            {
+                nibble = 8;
+                diff = -diff;
+            }
+
+            // Weighing the step and its halves in turn picks the nibble whose reconstruction is nearest, since
+            // imaStep() adds an eighth of the step to what they sum to.
+            int step = ImaStepTable[index];
+            for (int bit = 4; bit; bit >>= 1, step >>= 1)
+            {
+                if (diff >= step)
+                {
+                    nibble |= bit;
+                    diff -= step;
+                }
+            }
+
+            imaStep(nibble, predictor, index);
+            error += int64_t(samples[i] - predictor) * (samples[i] - predictor);
+            nibbles[(i - 1) >> 1] |= static_cast<uint8_t>(((i - 1) & 1) ? nibble << 4 : nibble);
+        }
+        return error;
+    }
+
+    // Decodes the first count samples of a block.
+    void imaDecodeBlock(const uint8_t * block, size_t count, int16_t * samples)
+    {
+        int predictor = static_cast<int16_t>(block[0] | (block[1] << 8));
+        int index = std::min<int>(block[2], 88);
+        samples[0] = static_cast<int16_t>(predictor);
+
+        const uint8_t * nibbles = block + ImaAdpcmHeaderBytes;
+        for (size_t i = 1; i < count; ++i)
+        {
+            const uint8_t byte = nibbles[(i - 1) >> 1];
+            imaStep(((i - 1) & 1) ? byte >> 4 : byte & 0xf, predictor, index);
+            samples[i] = static_cast<int16_t>(predictor);
+        }
+    }
+
+    size_t bytesPerChannel(CompressedAudioBus::Format format, size_t length)
+    {
+        switch (format)
+        {
+            case CompressedAudioBus::Format::Int16: return length * 2;
+            case CompressedAudioBus::Format::Int24: return length * 3;
+            case CompressedAudioBus::Format::ImaAdpcm:
+                return (length + CompressedAudioBus::ImaAdpcmBlockLength - 1) / CompressedAudioBus::ImaAdpcmBlockLength * ImaAdpcmBlockBytes;
+        }
+        return 0;
+    }
+
+} // anonymous namespace
+
+CompressedAudioBus::CompressedAudioBus(Format format, size_t numberOfChannels, size_t length, float sampleRate)
+    : m_format(format)
+    , m_length(length)
+    , m_sampleRate(sampleRate)
+    , m_channels(numberOfChannels, std::vector<uint8_t>(bytesPerChannel(format, length)))
+{
+}
+
+std::shared_ptr<CompressedAudioBus> CompressedAudioBus::create(const AudioBus & sourceBus, Format format)
+{
+    std::shared_ptr<CompressedAudioBus> bus(new CompressedAudioBus(format, sourceBus.numberOfChannels(), sourceBus.length(), sourceBus.sampleRate()));
+    for (size_t c = 0; c < sourceBus.numberOfChannels(); ++c)
+        bus->encodeChannel(c, sourceBus.channel(c)->data());
+    return bus;
+}
+
+size_t CompressedAudioBus::sizeInBytes() const
+{
+    return m_channels.size() * bytesPerChannel(m_format, m_length);
+}
+
+void CompressedAudioBus::encodeChannel(size_t channel, const float * source, size_t stride)
+{
+    ASSERT(channel < m_channels.size());
+    if (channel >= m_channels.size() || !source) return;
+
+    uint8_t * dest = m_channels[channel].data();
+
+    switch (m_format)
+    {
+        case Format::Int16:
+            for (size_t i = 0; i < m_length; ++i)
+            {
+                int16_t s = static_cast<int16_t>(quantize(source[i * stride], 32768.0f));
+                memcpy(dest + i * 2, &s, 2);
+            }
+            break;
+
+        case Format::Int24:
+            for (size_t i = 0; i < m_length; ++i)
+            {
+                int32_t s = quantize(source[i * stride], 8388608.0f);
+                dest[i * 3] = static_cast<uint8_t>(s & 0xff);
+                dest[i * 3 + 1] = static_cast<uint8_t>((s >> 8) & 0xff);
+                dest[i * 3 + 2] = static_cast<uint8_t>((s >> 16) & 0xff);
+            }
+            break;
+
+        case Format::ImaAdpcm:
+        {
+            // Each block's header holds the step index it starts from, so the encoder may choose it. Running on from
+            // the block before suits a steady signal, but adapts slowly to the first transient, or one after a quiet
+            // passage, so a spread of larger steps is tried too.
+            int index = 0;
+            int16_t samples[ImaAdpcmBlockLength];
+            uint8_t trial[ImaAdpcmBlockBytes];
+            for (size_t start = 0; start < m_length; start += ImaAdpcmBlockLength)
+            {
+                size_t count = std::min<size_t>(ImaAdpcmBlockLength, m_length - start);
+                for (size_t i = 0; i < count; ++i)
+                    samples[i] = static_cast<int16_t>(quantize(source[(start + i) * stride], 32768.0f));
+                std::fill(samples + count, samples + ImaAdpcmBlockLength, int16_t(0));
+
+                uint8_t * block = dest + start / ImaAdpcmBlockLength * ImaAdpcmBlockBytes;
+                int endIndex = index;
+                int64_t leastError = imaEncodeBlock(samples, endIndex, block);
+                for (int startIndex = 8; startIndex <= 88 && leastError; startIndex += 8)
+                {
+                    int trialEndIndex = startIndex;
+                    int64_t error = imaEncodeBlock(samples, trialEndIndex, trial);
+                    if (error < leastError)
+                    {
+                        leastError = error;
+                        endIndex = trialEndIndex;
+                        memcpy(block, trial, ImaAdpcmBlockBytes);
+                    }
+                }
+                index = endIndex;
+            }
+            break;
+        }
+    }
+}
+
+void CompressedAudioBus::decode(size_t channel, size_t startFrame, size_t frameCount, float * destination) const
+{
+    ASSERT(channel < m_channels.size() && startFrame + frameCount <= m_length);
+    if (channel >= m_channels.size() || startFrame > m_length || !destination) return;
+    frameCount = std::min(frameCount, m_length - startFrame);
+
+    const uint8_t * source = m_channels[channel].data();
+
+    switch (m_format)
+    {
+        case Format::Int16:
+            vs16tof(reinterpret_cast<const int16_t *>(source) + startFrame, Int16Scale, destination, frameCount);
+            break;
+
+        case Format::Int24:
+            vs24tof(source + startFrame * 3, Int24Scale, destination, frameCount);
+            break;
+
+        case Format::ImaAdpcm:
+        {
+            int16_t samples[ImaAdpcmBlockLength];
+            while (frameCount)
+            {
+                const size_t block = startFrame / ImaAdpcmBlockLength;
+                const size_t offset = startFrame % ImaAdpcmBlockLength;
+                const size_t count = std::min(frameCount, ImaAdpcmBlockLength - offset);
+
+                imaDecodeBlock(source + block * ImaAdpcmBlockBytes, offset + count, samples);
+                vs16tof(samples + offset, Int16Scale, destination, count);
+
+                startFrame += count;
+                destination += count;
+                frameCount -= count;
+            }
+            break;
+        }
+    }
+}
+
+std::unique_ptr<AudioBus> CompressedAudioBus::createDecodedBus() const
+{
+    std::unique_ptr<AudioBus> bus(new AudioBus(numberOfChannels(), m_length));
+    bus->setSampleRate(m_sampleRate);
+    for (size_t c = 0; c < numberOfChannels(); ++c)
+        decode(c, 0, m_length, bus->channel(c)->mutableData());
+    return bus;
+}
+
+} // namespace lab
@@ -7,6 +7,7 @@
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/Mixing.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 
@@ -25,6 +26,13 @@ const size_t MaxFFTSize = 32768;
 
 namespace lab {
 
+static size_t outputChannelsForImpulse(const AudioBus* bus)
+{
+    if (!bus || bus->numberOfChannels() <= Channels::Quad)
+        return Channels::Stereo;
+    return bus->numberOfChannels();
+}
+
 ConvolverNode::ConvolverNode() : m_swapOnRender(false), m_normalize(true)
 {
     addInput(unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
@@ -51,6 +59,12 @@ void ConvolverNode::process(ContextRenderLock & r, size_t framesToProcess)
         m_bus = m_newBus;
         m_newBus.reset();
         m_swapOnRender = false;
+
+        // A surround response renders one output channel per response channel, and convolves as many input
+        // channels as it has, in the same order. Anything else renders stereo.
+        const size_t outputChannels = outputChannelsForImpulse(m_bus.get());
+        m_channelCount = outputChannels;
+        output(0)->setNumberOfChannels(r, outputChannels);
     }
     
     AudioBus * outputBus = output(0)->bus(r);
@@ -99,14 +113,16 @@ void ConvolverNode::setImpulse(std::shared_ptr<AudioBus> bus)
     unsigned numberOfChannels = bus->numberOfChannels();
     size_t bufferLength = bus->length();
 
-    // The current implementation supports up to four channel impulse responses, which are interpreted as true-stereo (see Reverb class).
-    bool isBufferGood = numberOfChannels > 0 && numberOfChannels <= 4 && bufferLength;
+    // Four channel impulse responses are interpreted as true-stereo, and responses of five or more channels as one
+    // channel per output speaker (see Reverb class).
+    bool isBufferGood = numberOfChannels > 0 && numberOfChannels <= Channels::Surround_7_1 && bufferLength;
     ASSERT(isBufferGood);
     if (!isBufferGood) return;
 
     // Create the reverb with the given impulse response.
-    const bool threaded = false;
-    m_newReverb = std::unique_ptr<Reverb>(new Reverb(bus.get(), AudioNode::ProcessingSizeInFrames, MaxFFTSize, 2, threaded, m_normalize));
+    // Long responses share their convolutions between the render thread and helper threads.
+    const bool threaded = true;
+    m_newReverb = std::unique_ptr<Reverb>(new Reverb(bus.get(), AudioNode::ProcessingSizeInFrames, MaxFFTSize, outputChannelsForImpulse(bus.get()), threaded, m_normalize));
     m_newBus = bus;
     m_swapOnRender = true;
 }
@@ -3,6 +3,7 @@
 // Copyright (C) 2015+, The LabSound Authors. All rights reserved.
 
 #include "LabSound/core/DefaultAudioDestinationNode.h"
+#include "LabSound/core/AudioContext.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/extended/Logging.h"
@@ -10,10 +11,15 @@
 #include "internal/Assertions.h"
 #include "internal/AudioDestination.h"
 
+#include "backends/null/AudioDestinationNull.h"
+
 namespace lab {
     
-DefaultAudioDestinationNode::DefaultAudioDestinationNode(AudioContext* context, unsigned channelCount, const float sampleRate) 
+DefaultAudioDestinationNode::DefaultAudioDestinationNode(AudioContext* context, unsigned channelCount, const float sampleRate,
+    AudioDestinationBackend backend, HeadlessRenderCallback headlessCallback)
 : AudioDestinationNode(context, channelCount, sampleRate)
+, m_backend(backend)
+, m_headlessCallback(std::move(headlessCallback))
 {
     // Node-specific default mixing rules.
     m_channelCount = channelCount;
@@ -21,6 +27,12 @@ DefaultAudioDestinationNode::DefaultAudioDestinationNode(AudioContext* context,
     m_channelInterpretation = ChannelInterpretation::Speakers;
 }
 
+DefaultAudioDestinationNode::DefaultAudioDestinationNode(AudioContext* context, unsigned channelCount, const float sampleRate, const AudioDeviceConfiguration & deviceConfiguration)
+: DefaultAudioDestinationNode(context, channelCount, sampleRate)
+{
+    m_deviceConfiguration = deviceConfiguration;
+}
+
 DefaultAudioDestinationNode::~DefaultAudioDestinationNode()
 {
     uninitialize();
@@ -48,7 +60,22 @@ void DefaultAudioDestinationNode::uninitialize()
 void DefaultAudioDestinationNode::createDestination()
 {
     LOG("Designated Samplerate: %f", m_sampleRate);
-    m_destination = std::unique_ptr<AudioDestination>(AudioDestination::MakePlatformAudioDestination(*this, channelCount(), m_sampleRate));
+
+    // Close any device already open before opening the new one, which may be the same device opened exclusively.
+    m_destination.reset();
+
+    switch (m_backend)
+    {
+    case AudioDestinationBackend::Null:
+        m_destination.reset(new AudioDestinationNull(*this, channelCount(), m_sampleRate, true, m_headlessCallback));
+        break;
+    case AudioDestinationBackend::FreeRunning:
+        m_destination.reset(new AudioDestinationNull(*this, channelCount(), m_sampleRate, false, m_headlessCallback));
+        break;
+    default:
+        m_destination = std::unique_ptr<AudioDestination>(AudioDestination::MakePlatformAudioDestination(*this, channelCount(), m_sampleRate, m_deviceConfiguration));
+        break;
+    }
 }
 
 void DefaultAudioDestinationNode::startRendering()
@@ -60,6 +87,10 @@ void DefaultAudioDestinationNode::startRendering()
     
 unsigned DefaultAudioDestinationNode::maxChannelCount() const
 {
+    // Without a device, the only limit is the context's.
+    if (m_backend != AudioDestinationBackend::Platform)
+        return AudioContext::maxNumberOfChannels;
+
     return AudioDestination::maxChannelCount();
 }
 
@@ -88,4 +119,19 @@ void DefaultAudioDestinationNode::setChannelCount(ContextGraphLock& g, size_t ch
     }
 }
     
+void DefaultAudioDestinationNode::setDeviceConfiguration(ContextGraphLock & g, const AudioDeviceConfiguration & configuration)
+{
+    ASSERT(g.context());
+
+    m_deviceConfiguration = configuration;
+
+    if (isInitialized() && m_backend == AudioDestinationBackend::Platform)
+    {
+        // Re-create destination.
+        m_destination->stop();
+        createDestination();
+        m_destination->start();
+    }
+}
+
 } // namespace lab
@@ -34,9 +34,8 @@ GainNode::~GainNode()
 
 void GainNode::process(ContextRenderLock& r, size_t framesToProcess)
 {
-    // FIXME: for some cases there is a nice optimization to avoid processing here, and let the gain change
-    // happen in the summing junction input of the AudioNode we're connected to.
-    // Then we can avoid all of the following:
+    // A gain in front of a summing input is cheaper as a connection gain (see AudioContext::connectWithGain),
+    // which the input applies as it sums, without the copy into our output bus made here.
 
     AudioBus* outputBus = output(0)->bus(r);
     ASSERT(outputBus);
@@ -68,8 +67,6 @@ void GainNode::reset(ContextRenderLock& r)
     m_lastGain = gain()->value(r);
 }
 
-// FIXME: this can go away when we do mixing with gain directly in summing junction of AudioNodeInput
-//
 // As soon as we know the channel count of our input, we can lazily initialize.
 // Sometimes this may be called more than once with different channel counts, in which case we must safely
 // uninitialize and then re-initialize with the new channel count.
@@ -403,14 +403,22 @@ float PannerNode::distanceConeGain(ContextRenderLock& r)
 
     m_distanceGain->setValue(static_cast<float>(distanceGain));
 
-    // FIXME: could optimize by caching coneGain
-
     FloatPoint3D orientation = {
                                                     orientationX()->value(r),
                                                     orientationY()->value(r),
                                                     orientationZ()->value(r) };
 
-    double coneGain = m_coneEffect->gain(position, orientation, listenerPosition);
+    // Sources and listeners are usually still from one quantum to the next, and the cone's acos is only needed when they move.
+    // The flag is set before the gain is computed, so a cone setter that clears it meanwhile is seen next quantum.
+    if (!m_coneGainIsValid.exchange(true, std::memory_order_acq_rel) || position != m_conePosition || orientation != m_coneOrientation || listenerPosition != m_coneListenerPosition)
+    {
+        m_cachedConeGain = m_coneEffect->gain(position, orientation, listenerPosition);
+        m_conePosition = position;
+        m_coneOrientation = orientation;
+        m_coneListenerPosition = listenerPosition;
+    }
+
+    double coneGain = m_cachedConeGain;
 
     m_coneGain->setValue(static_cast<float>(coneGain));
 
@@ -458,13 +466,13 @@ float PannerNode::rolloffFactor() { return static_cast<float>(m_distanceEffect->
 void PannerNode::setRolloffFactor(float rolloffFactor) { m_distanceEffect->setRolloffFactor(rolloffFactor); }
 
 float PannerNode::coneInnerAngle() const { return static_cast<float>(m_coneEffect->innerAngle()); }
-void PannerNode::setConeInnerAngle(float angle) { m_coneEffect->setInnerAngle(angle); }
+void PannerNode::setConeInnerAngle(float angle) { m_coneEffect->setInnerAngle(angle); m_coneGainIsValid.store(false, std::memory_order_release); }
 
 float PannerNode::coneOuterAngle() const { return static_cast<float>(m_coneEffect->outerAngle()); }
-void PannerNode::setConeOuterAngle(float angle) { m_coneEffect->setOuterAngle(angle); }
+void PannerNode::setConeOuterAngle(float angle) { m_coneEffect->setOuterAngle(angle); m_coneGainIsValid.store(false, std::memory_order_release); }
 
 float PannerNode::coneOuterGain() const { return static_cast<float>(m_coneEffect->outerGain()); }
-void PannerNode::setConeOuterGain(float angle) { m_coneEffect->setOuterGain(angle); }
+void PannerNode::setConeOuterGain(float angle) { m_coneEffect->setOuterGain(angle); m_coneGainIsValid.store(false, std::memory_order_release); }
 
 double PannerNode::tailTime(ContextRenderLock & r) const { return m_panner ? m_panner->tailTime(r) : 0; }
 double PannerNode::latencyTime(ContextRenderLock & r) const { return m_panner ? m_panner->latencyTime(r) : 0; }
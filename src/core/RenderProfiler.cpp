@@ -0,0 +1,346 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/RenderProfiler.h"
+#include "LabSound/core/AudioNode.h"
+
+#include "internal/RingBuffer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <typeinfo>
+
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#include <stdlib.h>
+#endif
+
+namespace lab
+{
+
+struct RenderProfiler::NodeStats
+{
+    std::atomic<const AudioNode*> node{ nullptr };
+    std::atomic<const char*> typeName{ nullptr };
+    std::atomic<uint64_t> processCount{ 0 };
+    std::atomic<uint64_t> totalTime{ 0 };
+    std::atomic<uint64_t> maxTime{ 0 };
+    std::atomic<uint64_t> lastTime{ 0 };
+};
+
+struct RenderProfiler::Trace
+{
+    // A span of a node's process(), or of a whole quantum if node is null.
+    struct Span
+    {
+        const AudioNode * node;
+        const char * typeName;
+        uint64_t start;
+        uint64_t duration;
+    };
+
+    Trace() : spans(TraceCapacity) {}
+
+    SPSCRingBuffer<Span> spans;
+    std::atomic<uint64_t> dropped{ 0 };
+    std::mutex readMutex;
+};
+
+namespace
+{
+    // Times are kept as nanoseconds since the first profiler was created, so that they fit relaxed 64 bit atomics.
+    const std::chrono::steady_clock::time_point & epochStart()
+    {
+        static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        return start;
+    }
+
+    double seconds(uint64_t nanoseconds) { return nanoseconds * 1e-9; }
+
+    std::string readableTypeName(const char * name)
+    {
+        if (!name)
+            return std::string();
+
+#if defined(__GNUG__)
+        int status = 0;
+        char * demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+        if (demangled)
+        {
+            std::string result(demangled);
+            free(demangled);
+            return result;
+        }
+#endif
+
+        std::string result(name);
+        const char * prefixes[] = { "class ", "struct " }; // MSVC
+        for (const char * prefix : prefixes)
+        {
+            const size_t length = strlen(prefix);
+            if (result.compare(0, length, prefix) == 0)
+                result.erase(0, length);
+        }
+        return result;
+    }
+
+    void storeMax(std::atomic<uint64_t> & value, uint64_t candidate)
+    {
+        // Only the audio thread writes, so there is no need for a compare-and-swap loop.
+        if (candidate > value.load(std::memory_order_relaxed))
+            value.store(candidate, std::memory_order_relaxed);
+    }
+
+    void writeJsonString(std::ostream & out, const std::string & s)
+    {
+        out << '"';
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                out << '\\' << c;
+            else if (static_cast<unsigned char>(c) < 0x20)
+                out << ' ';
+            else
+                out << c;
+        }
+        out << '"';
+    }
+}
+
+RenderProfiler::RenderProfiler()
+{
+    epochStart();
+}
+
+RenderProfiler::~RenderProfiler()
+{
+    delete[] m_nodes.load(std::memory_order_relaxed);
+    delete m_trace.load(std::memory_order_relaxed);
+}
+
+void RenderProfiler::setEnabled(bool enabled)
+{
+    // The table is published before the flag, so the audio thread finds it once it sees profiling enabled.
+    if (enabled && !m_nodes.load(std::memory_order_acquire))
+    {
+        NodeStats * nodes = new NodeStats[MaxNodes];
+        NodeStats * expected = nullptr;
+        if (!m_nodes.compare_exchange_strong(expected, nodes, std::memory_order_acq_rel))
+            delete[] nodes;
+    }
+
+    m_enabled.store(enabled, std::memory_order_release);
+}
+
+void RenderProfiler::setTracing(bool tracing)
+{
+    if (tracing && !m_trace.load(std::memory_order_acquire))
+    {
+        Trace * trace = new Trace();
+        Trace * expected = nullptr;
+        if (!m_trace.compare_exchange_strong(expected, trace, std::memory_order_acq_rel))
+            delete trace;
+    }
+
+    m_tracing.store(tracing, std::memory_order_release);
+}
+
+uint64_t RenderProfiler::now() const
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epochStart()).count());
+}
+
+void RenderProfiler::applyReset()
+{
+    NodeStats * nodes = m_nodes.load(std::memory_order_acquire);
+    const uint32_t count = m_nodeCount.exchange(0, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        NodeStats & stats = nodes[i];
+        stats.node.store(nullptr, std::memory_order_relaxed);
+        stats.typeName.store(nullptr, std::memory_order_relaxed);
+        stats.processCount.store(0, std::memory_order_relaxed);
+        stats.totalTime.store(0, std::memory_order_relaxed);
+        stats.maxTime.store(0, std::memory_order_relaxed);
+        stats.lastTime.store(0, std::memory_order_relaxed);
+    }
+
+    ++m_epoch;
+    m_untrackedNodes.store(0, std::memory_order_relaxed);
+
+    m_quantumCount.store(0, std::memory_order_relaxed);
+    m_quantumLastTime.store(0, std::memory_order_relaxed);
+    m_quantumMaxTime.store(0, std::memory_order_relaxed);
+    m_quantumTotalTime.store(0, std::memory_order_relaxed);
+    m_deadlineMisses.store(0, std::memory_order_relaxed);
+    m_deviceXRuns.store(0, std::memory_order_relaxed);
+    m_lastMissWorstNode.store(nullptr, std::memory_order_relaxed);
+    m_lastMissWorstTypeName.store(nullptr, std::memory_order_relaxed);
+    m_lastMissWorstTime.store(0, std::memory_order_relaxed);
+}
+
+uint64_t RenderProfiler::beginQuantum()
+{
+    if (m_resetRequested.load(std::memory_order_relaxed) && m_resetRequested.exchange(false, std::memory_order_acquire))
+        applyReset();
+
+    m_worstNode = nullptr;
+    m_worstNodeTime = 0;
+    return now();
+}
+
+void RenderProfiler::endQuantum(uint64_t start, double budget)
+{
+    const uint64_t end = now();
+    const uint64_t elapsed = end - start;
+
+    m_quantumBudget.store(budget, std::memory_order_relaxed);
+    m_quantumLastTime.store(elapsed, std::memory_order_relaxed);
+    m_quantumTotalTime.store(m_quantumTotalTime.load(std::memory_order_relaxed) + elapsed, std::memory_order_relaxed);
+    storeMax(m_quantumMaxTime, elapsed);
+
+    if (seconds(elapsed) > budget)
+    {
+        m_lastMissWorstNode.store(m_worstNode, std::memory_order_relaxed);
+        m_lastMissWorstTypeName.store(m_worstNode ? typeid(*m_worstNode).name() : nullptr, std::memory_order_relaxed);
+        m_lastMissWorstTime.store(m_worstNodeTime, std::memory_order_relaxed);
+        m_deadlineMisses.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    m_quantumCount.fetch_add(1, std::memory_order_release);
+
+    if (isTracing())
+        trace(nullptr, start, end);
+}
+
+void RenderProfiler::recordNode(const AudioNode * node, uint32_t & index, uint32_t & epoch, uint64_t start, uint64_t end)
+{
+    const uint64_t elapsed = end - start;
+
+    if (elapsed > m_worstNodeTime)
+    {
+        m_worstNode = node;
+        m_worstNodeTime = elapsed;
+    }
+
+    if (isTracing())
+        trace(node, start, end);
+
+    // Nodes are only recorded while profiling is enabled, which allocated the table.
+    NodeStats * nodes = m_nodes.load(std::memory_order_acquire);
+
+    if (epoch != m_epoch)
+    {
+        const uint32_t count = m_nodeCount.load(std::memory_order_relaxed);
+        if (count == MaxNodes)
+        {
+            m_untrackedNodes.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        NodeStats & stats = nodes[count];
+        stats.node.store(node, std::memory_order_relaxed);
+        stats.typeName.store(typeid(*node).name(), std::memory_order_relaxed);
+        m_nodeCount.store(count + 1, std::memory_order_release);
+
+        index = count;
+        epoch = m_epoch;
+    }
+
+    NodeStats & stats = nodes[index];
+    stats.lastTime.store(elapsed, std::memory_order_relaxed);
+    stats.totalTime.store(stats.totalTime.load(std::memory_order_relaxed) + elapsed, std::memory_order_relaxed);
+    storeMax(stats.maxTime, elapsed);
+    stats.processCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RenderProfiler::trace(const AudioNode * node, uint64_t start, uint64_t end)
+{
+    Trace * t = m_trace.load(std::memory_order_acquire);
+    if (!t)
+        return;
+
+    const Trace::Span span = { node, node ? typeid(*node).name() : nullptr, start, end - start };
+    if (!t->spans.write(&span, 1))
+        t->dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+RenderProfile RenderProfiler::snapshot() const
+{
+    RenderProfile profile;
+
+    QuantumProfile & q = profile.quanta;
+    q.count = m_quantumCount.load(std::memory_order_acquire);
+    q.budget = m_quantumBudget.load(std::memory_order_relaxed);
+    q.lastTime = seconds(m_quantumLastTime.load(std::memory_order_relaxed));
+    q.maxTime = seconds(m_quantumMaxTime.load(std::memory_order_relaxed));
+    q.totalTime = seconds(m_quantumTotalTime.load(std::memory_order_relaxed));
+    q.deadlineMisses = m_deadlineMisses.load(std::memory_order_relaxed);
+    q.deviceXRuns = m_deviceXRuns.load(std::memory_order_relaxed);
+    q.lastMissWorstNode = m_lastMissWorstNode.load(std::memory_order_relaxed);
+    q.lastMissWorstTypeName = readableTypeName(m_lastMissWorstTypeName.load(std::memory_order_relaxed));
+    q.lastMissWorstTime = seconds(m_lastMissWorstTime.load(std::memory_order_relaxed));
+
+    const NodeStats * nodes = m_nodes.load(std::memory_order_acquire);
+    const uint32_t count = nodes ? m_nodeCount.load(std::memory_order_acquire) : 0;
+    profile.nodes.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const NodeStats & stats = nodes[i];
+        NodeProfile & p = profile.nodes[i];
+        p.node = stats.node.load(std::memory_order_relaxed);
+        p.typeName = readableTypeName(stats.typeName.load(std::memory_order_relaxed));
+        p.processCount = stats.processCount.load(std::memory_order_relaxed);
+        p.totalTime = seconds(stats.totalTime.load(std::memory_order_relaxed));
+        p.maxTime = seconds(stats.maxTime.load(std::memory_order_relaxed));
+        p.lastTime = seconds(stats.lastTime.load(std::memory_order_relaxed));
+    }
+
+    profile.untrackedNodes = m_untrackedNodes.load(std::memory_order_relaxed);
+    if (const Trace * t = m_trace.load(std::memory_order_acquire))
+        profile.droppedTraceEvents = t->dropped.load(std::memory_order_relaxed);
+    return profile;
+}
+
+size_t RenderProfiler::writeChromeTrace(std::ostream & out)
+{
+    // Everything is reported on one thread of one process; timestamps and durations are in microseconds.
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    size_t written = 0;
+    if (Trace * t = m_trace.load(std::memory_order_acquire))
+    {
+        std::lock_guard<std::mutex> lock(t->readMutex);
+
+        Trace::Span span;
+        char text[64];
+        while (t->spans.read(&span, 1))
+        {
+            if (written++)
+                out << ',';
+
+            out << "\n{\"name\":";
+            if (span.node)
+                writeJsonString(out, readableTypeName(span.typeName));
+            else
+                out << "\"render quantum\"";
+
+            snprintf(text, sizeof(text), ",\"ts\":%.3f,\"dur\":%.3f", span.start * 1e-3, span.duration * 1e-3);
+            out << ",\"cat\":\"" << (span.node ? "node" : "quantum") << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1" << text;
+
+            if (span.node)
+            {
+                snprintf(text, sizeof(text), "%p", static_cast<const void*>(span.node));
+                out << ",\"args\":{\"node\":\"" << text << "\"}";
+            }
+            out << '}';
+        }
+    }
+
+    out << "\n]}\n";
+    return written;
+}
+
+} // namespace lab
@@ -9,6 +9,7 @@
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/CompressedAudioBus.h"
 #include "LabSound/core/Macros.h"
 
 #include "LabSound/extended/AudioContextLock.h"
@@ -29,6 +30,9 @@ const double DefaultGrainDuration = 0.020; // 20ms
 // to minimize linear interpolation aliasing.
 const double MaxRate = 1024;
 
+// Frames of a compressed bus decoded at a time for interpolated playback; a multiple of every format's block length.
+const size_t DecodeWindowLength = 1024;
+
 SampledAudioNode::SampledAudioNode() : AudioScheduledSourceNode(), m_grainDuration(DefaultGrainDuration)
 {
     m_gain = make_shared<AudioParam>("gain", 1.0, 0.0, 1.0);
@@ -52,7 +56,7 @@ void SampledAudioNode::process(ContextRenderLock & r, size_t framesToProcess)
 {
     AudioBus* outputBus = output(0)->bus(r);
 
-    if (!getBus() || !isInitialized() || ! r.context())
+    if (!hasSource() || !isInitialized() || ! r.context())
     {
         outputBus->zero();
         return;
@@ -61,7 +65,7 @@ void SampledAudioNode::process(ContextRenderLock & r, size_t framesToProcess)
     // After calling setBuffer() with a buffer having a different number of channels, there can in rare cases be a slight delay
     // before the output bus is updated to the new number of channels because of use of tryLocks() in the context's updating system.
     // In this case, if the the buffer has just been changed and we're not quite ready yet, then just output silence. 
-    if (numberOfChannels(r) != getBus()->numberOfChannels())
+    if (numberOfChannels(r) != sourceChannelCount())
     {
         outputBus->zero();
         return;
@@ -93,7 +97,7 @@ void SampledAudioNode::process(ContextRenderLock & r, size_t framesToProcess)
         // at a sub-sample position since it will degrade the quality.
         // When aligned to the sample-frame the playback will be identical to the PCM data stored in the buffer.
         // Since playbackRate == 1 is very common, it's worth considering quality.
-        m_virtualReadIndex = AudioUtilities::timeToSampleFrame(m_grainOffset, getBus()->sampleRate());
+        m_virtualReadIndex = AudioUtilities::timeToSampleFrame(m_grainOffset, sourceSampleRate());
         m_startRequested = false;
     }
 
@@ -150,8 +154,9 @@ bool SampledAudioNode::renderFromBuffer(ContextRenderLock& r, AudioBus* bus, uns
         return false;
 
     auto srcBus = getBus();
+    auto compressedBus = getCompressedBus();
 
-    if (!bus || !srcBus)
+    if (!bus || (!srcBus && !compressedBus))
         return false;
 
     unsigned numChannels = numberOfChannels(r);
@@ -178,8 +183,8 @@ bool SampledAudioNode::renderFromBuffer(ContextRenderLock& r, AudioBus* bus, uns
     // Offset the pointers to the correct offset frame.
     unsigned writeIndex = destinationFrameOffset;
 
-    size_t bufferLength = srcBus->length();
-    double bufferSampleRate = srcBus->sampleRate();
+    size_t bufferLength = sourceLength();
+    double bufferSampleRate = sourceSampleRate();
 
     // Avoid converting from time to sample-frames twice by computing
     // the grain end time first before computing the sample frame.
@@ -206,8 +211,8 @@ bool SampledAudioNode::renderFromBuffer(ContextRenderLock& r, AudioBus* bus, uns
     if (loop() && (m_loopStart || m_loopEnd) && m_loopStart >= 0 && m_loopEnd > 0 && m_loopStart < m_loopEnd) 
     {
         // Convert from seconds to sample-frames.
-        double loopStartFrame = m_loopStart * srcBus->sampleRate();
-        double loopEndFrame = m_loopEnd * srcBus->sampleRate();
+        double loopStartFrame = m_loopStart * bufferSampleRate;
+        double loopEndFrame = m_loopEnd * bufferSampleRate;
 
         virtualEndFrame = std::min(loopEndFrame, virtualEndFrame);
         virtualDeltaFrames = virtualEndFrame - loopStartFrame;
@@ -242,7 +247,10 @@ bool SampledAudioNode::renderFromBuffer(ContextRenderLock& r, AudioBus* bus, uns
 
             for (unsigned i = 0; i < numChannels; ++i)
             {
-                memcpy(bus->channel(i)->mutableData() + writeIndex, srcBus->channel(i)->data() + readIndex, sizeof(float) * framesThisTime);
+                if (compressedBus)
+                    compressedBus->decode(i, readIndex, framesThisTime, bus->channel(i)->mutableData() + writeIndex);
+                else
+                    memcpy(bus->channel(i)->mutableData() + writeIndex, srcBus->channel(i)->data() + readIndex, sizeof(float) * framesThisTime);
             }
 
             writeIndex += framesThisTime;
@@ -283,14 +291,39 @@ bool SampledAudioNode::renderFromBuffer(ContextRenderLock& r, AudioBus* bus, uns
             if (readIndex >= bufferLength || readIndex2 >= bufferLength)
                 break;
 
+            // A compressed bus is read from the decode window, except for a frame wrapped around to the loop start.
+            bool isReadIndex2Decoded = false;
+            if (compressedBus)
+            {
+                fillDecodeWindow(readIndex);
+                isReadIndex2Decoded = readIndex2 >= m_decodeWindowStart && readIndex2 < m_decodeWindowStart + m_decodeWindowLength;
+            }
+
             // Linear interpolation.
             for (unsigned i = 0; i < numChannels; ++i) 
             {
                 float * destination = bus->channel(i)->mutableData();
-                const float * source = srcBus->channel(i)->data();
 
-                double sample1 = source[readIndex];
-                double sample2 = source[readIndex2];
+                double sample1;
+                double sample2;
+                if (compressedBus)
+                {
+                    const float * source = m_decodeWindow->channel(i)->data();
+                    sample1 = source[readIndex - m_decodeWindowStart];
+
+                    float wrappedSample;
+                    if (isReadIndex2Decoded)
+                        wrappedSample = source[readIndex2 - m_decodeWindowStart];
+                    else
+                        compressedBus->decode(i, readIndex2, 1, &wrappedSample);
+                    sample2 = wrappedSample;
+                }
+                else
+                {
+                    const float * source = srcBus->channel(i)->data();
+                    sample1 = source[readIndex];
+                    sample2 = source[readIndex2];
+                }
                 double sample = (1.0 - interpolationFactor) * sample1 + interpolationFactor * sample2;
 
                 destination[writeIndex] = static_cast<float>(sample);
@@ -341,9 +374,75 @@ bool SampledAudioNode::setBus(ContextRenderLock & r, std::shared_ptr<AudioBus> b
 
     m_virtualReadIndex = 0;
     m_sourceBus = buffer;
+    m_compressedBus.reset();
+    m_decodeWindow.reset();
     return true;
 }
 
+bool SampledAudioNode::setCompressedBus(ContextRenderLock & r, std::shared_ptr<CompressedAudioBus> sourceBus)
+{
+    ASSERT(r.context());
+
+    std::unique_ptr<AudioBus> decodeWindow;
+    if (sourceBus)
+    {
+        unsigned numberOfChannels = static_cast<unsigned>(sourceBus->numberOfChannels());
+
+        if (numberOfChannels > AudioContext::maxNumberOfChannels)
+            return false;
+
+        ASSERT(DecodeWindowLength % sourceBus->blockLength() == 0);
+        decodeWindow.reset(new AudioBus(numberOfChannels, DecodeWindowLength));
+
+        output(0)->setNumberOfChannels(r, numberOfChannels);
+    }
+
+    m_virtualReadIndex = 0;
+    m_sourceBus.reset();
+    m_compressedBus = sourceBus;
+    m_decodeWindow = std::move(decodeWindow);
+    m_decodeWindowStart = 0;
+    m_decodeWindowLength = 0;
+    return true;
+}
+
+size_t SampledAudioNode::sourceChannelCount() const
+{
+    if (m_compressedBus)
+        return m_compressedBus->numberOfChannels();
+    return m_sourceBus ? m_sourceBus->numberOfChannels() : 0;
+}
+
+size_t SampledAudioNode::sourceLength() const
+{
+    if (m_compressedBus)
+        return m_compressedBus->length();
+    return m_sourceBus ? m_sourceBus->length() : 0;
+}
+
+float SampledAudioNode::sourceSampleRate() const
+{
+    if (m_compressedBus)
+        return m_compressedBus->sampleRate();
+    return m_sourceBus ? m_sourceBus->sampleRate() : 0;
+}
+
+void SampledAudioNode::fillDecodeWindow(size_t frame)
+{
+    const size_t length = m_compressedBus->length();
+    const size_t windowEnd = m_decodeWindowStart + m_decodeWindowLength;
+    if (frame >= m_decodeWindowStart && (frame + 1 < windowEnd || (frame < windowEnd && windowEnd == length)))
+        return;
+
+    // Starting on a block boundary avoids decoding frames only to skip them. The window is a whole number of blocks
+    // long, so it reaches past the frame after.
+    m_decodeWindowStart = frame - frame % m_compressedBus->blockLength();
+    m_decodeWindowLength = std::min(DecodeWindowLength, length - m_decodeWindowStart);
+
+    for (size_t i = 0; i < m_compressedBus->numberOfChannels(); ++i)
+        m_compressedBus->decode(i, m_decodeWindowStart, m_decodeWindowLength, m_decodeWindow->channel(i)->mutableData());
+}
+
 unsigned SampledAudioNode::numberOfChannels(ContextRenderLock& r)
 {
     return output(0)->numberOfChannels();
@@ -357,7 +456,7 @@ void SampledAudioNode::startGrain(double when, double grainOffset)
 
 void SampledAudioNode::startGrain(double when, double grainOffset, double grainDuration)
 {
-    if (!getBus())
+    if (!hasSource())
         return;
 
     m_requestWhen = when;
@@ -370,11 +469,10 @@ void SampledAudioNode::startGrain(double when, double grainOffset, double grainD
 
 float SampledAudioNode::duration() const 
 {
-    auto bus = getBus();
-    if (!bus)
+    if (!hasSource())
         return 0;
 
-    return bus->length() / bus->sampleRate(); 
+    return sourceLength() / sourceSampleRate(); 
 }
 
 double SampledAudioNode::totalPitchRate(ContextRenderLock & r)
@@ -386,8 +484,8 @@ double SampledAudioNode::totalPitchRate(ContextRenderLock & r)
     // Incorporate buffer's sample-rate versus AudioContext's sample-rate.
     // Normally it's not an issue because buffers are loaded at the AudioContext's sample-rate, but we can handle it in any case.
     double sampleRateFactor = 1.0;
-    if (getBus())
-        sampleRateFactor = getBus()->sampleRate() / r.context()->sampleRate();
+    if (hasSource())
+        sampleRateFactor = sourceSampleRate() / r.context()->sampleRate();
 
     double basePitchRate = playbackRate()->value(r);
 
@@ -409,7 +507,7 @@ double SampledAudioNode::totalPitchRate(ContextRenderLock & r)
 
 bool SampledAudioNode::propagatesSilence(ContextRenderLock & r) const
 {
-    return !isPlayingOrScheduled() || hasFinished() || !m_sourceBus;
+    return !isPlayingOrScheduled() || hasFinished() || !hasSource();
 }
 
 void SampledAudioNode::setPannerNode(PannerNode* pannerNode)
@@ -2,15 +2,19 @@
 // Copyright (C) 2015+, The LabSound Authors. All rights reserved.
 
 #include "LabSound/extended/ADSRNode.h"
+#include "LabSound/extended/EnvelopeGenerator.h"
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioProcessor.h"
 #include "LabSound/core/AudioBus.h"
 
+#include "internal/Assertions.h"
+#include "internal/RingBuffer.h"
 #include "internal/VectorMath.h"
 
-#include <limits>
+#include <algorithm>
+#include <atomic>
 
 using namespace lab;
 
@@ -25,13 +29,25 @@ namespace lab
 
     public:
 
-        ADSRNodeInternal() : AudioProcessor(2), m_noteOffTime(0), m_currentGain(0), m_noteOnTime(-1.)
+        // A noteOn() or noteOff(), handed from the main thread to the audio thread.
+        struct GateRequest
+        {
+            double when;
+            bool on;
+        };
+
+        enum { MaxPendingGates = 64 };
+
+        ADSRNodeInternal() : AudioProcessor(2), m_envelope(1, 44100.f, MaxPendingGates), m_gainValues(AudioNode::ProcessingSizeInFrames), m_requests(MaxPendingGates)
         {
             m_attackTime = std::make_shared<AudioParam>("attackTime",  0.05, 0, 120);
             m_attackLevel = std::make_shared<AudioParam>("attackLevel",  1.0, 0, 10);
             m_decayTime = std::make_shared<AudioParam>("decayTime",   0.05,  0, 120);
             m_sustainLevel = std::make_shared<AudioParam>("sustain", 0.75, 0, 10);
             m_releaseTime = std::make_shared<AudioParam>("release", 0.0625, 0, 120);
+            m_attackCurve = std::make_shared<AudioParam>("attackCurve", 0, -32, 32);
+            m_decayCurve = std::make_shared<AudioParam>("decayCurve", 0, -32, 32);
+            m_releaseCurve = std::make_shared<AudioParam>("releaseCurve", 0, -32, 32);
         }
 
         virtual ~ADSRNodeInternal() { }
@@ -48,78 +64,61 @@ namespace lab
             if (!numberOfChannels())
                 return;
 
-            if (m_noteOnTime >= 0)
-            {
-                if (m_currentGain > 0)
-                {
-                    m_zeroSteps = 16;
-                    m_zeroStepSize = -m_currentGain / 16.0f;
-                }
-                else
-                    m_zeroSteps = 0;
-
-                m_attackTimeTarget = m_noteOnTime + m_attackTime->value(r);
-
-                m_attackSteps = m_attackTime->value(r) * r.context()->sampleRate();
-                m_attackStepSize = m_attackLevel->value(r) / m_attackSteps;
-
-                m_decayTimeTarget = m_attackTimeTarget + m_decayTime->value(r);
+            ASSERT(framesToProcess <= m_gainValues.size());
+            framesToProcess = std::min(framesToProcess, m_gainValues.size());
 
-                m_decaySteps = m_decayTime->value(r) * r.context()->sampleRate();
-                m_decayStepSize = (m_sustainLevel->value(r) - m_attackLevel->value(r)) / m_decaySteps;
+            const float sampleRate = r.context()->sampleRate();
+            m_envelope.setSampleRate(sampleRate);
 
-                m_releaseSteps = 0;
+            // Gates that fall within this quantum are handed to the envelope at their frame; later ones wait.
+            m_pendingCount += m_requests.read(m_pending + m_pendingCount, MaxPendingGates - m_pendingCount);
 
-                m_noteOffTime = std::numeric_limits<double>::max();
-                m_noteOnTime = -1.;
-            }
-
-            // We handle both the 1 -> N and N -> N case here.
-            const float* source = sourceBus->channelByType(Channel::First)->data();
-
-            // this will only ever happen once, so if heap contention is an issue it should only ever cause one glitch
-            // what would be better, alloca? What does webaudio do elsewhere for this sort of thing?
-            if (gainValues.size() < framesToProcess)
-                gainValues.resize(framesToProcess);
-
-            float s = m_sustainLevel->value(r);
-
-            for (size_t i = 0; i < framesToProcess; ++i)
+            const double startTime = r.context()->currentTime();
+            const double endTime = startTime + framesToProcess / static_cast<double>(sampleRate);
+            size_t waiting = 0;
+            bool gated = false;
+            for (size_t i = 0; i < m_pendingCount; ++i)
             {
-                if (m_zeroSteps > 0)
+                const GateRequest & request = m_pending[i];
+                if (request.when >= endTime)
                 {
-                    --m_zeroSteps;
-                    m_currentGain += m_zeroStepSize;
-                    gainValues[i] = m_currentGain;
+                    m_pending[waiting++] = request;
+                    continue;
                 }
 
-                else if (m_attackSteps > 0)
+                // The parameters are read as the gate opens or closes, rather than every quantum.
+                if (!gated)
                 {
-                    --m_attackSteps;
-                    m_currentGain += m_attackStepSize;
-                    gainValues[i] = m_currentGain;
+                    updateSettings(r);
+                    gated = true;
                 }
 
-                else if (m_decaySteps > 0)
-                {
-                    --m_decaySteps;
-                    m_currentGain += m_decayStepSize;
-                    gainValues[i] = m_currentGain;
-                }
+                // The envelope has room for every request that can be pending, but one it can't take waits a quantum.
+                const size_t offset = std::min(request.when > startTime ? static_cast<size_t>((request.when - startTime) * sampleRate) : 0, framesToProcess - 1);
+                if (!(request.on ? m_envelope.gateOn(0, offset) : m_envelope.gateOff(0, offset)))
+                    m_pending[waiting++] = request;
+            }
+            m_pendingCount = waiting;
 
-                else if (m_releaseSteps > 0)
-                {
-                    --m_releaseSteps;
-                    m_currentGain += m_releaseStepSize;
-                    gainValues[i] = m_currentGain;
-                }
-                else
-                {
-                    m_currentGain = (m_noteOffTime == std::numeric_limits<double>::max()) ? s : 0;
-                    gainValues[i] = m_currentGain;
-                }
+            // A sustaining envelope follows the sustain level.
+            if (!gated && m_envelope.stage(0) == EnvelopeGenerator::Stage::Sustain)
+            {
+                EnvelopeSettings settings = m_envelope.settings(0);
+                settings.sustainLevel = m_sustainLevel->value(r);
+                m_envelope.setSettings(0, settings);
             }
 
+            float * gainValues = m_gainValues.data();
+            m_envelope.process(&gainValues, framesToProcess);
+
+            bool finished = m_envelope.isIdle(0);
+            for (size_t i = 0; i < m_pendingCount && finished; ++i)
+                finished = !m_pending[i].on;
+            m_finished.store(finished, std::memory_order_relaxed);
+
+            // We handle both the 1 -> N and N -> N case here.
+            const float* source = sourceBus->channelByType(Channel::First)->data();
+
             unsigned numChannels = numberOfChannels();
             for (unsigned int channelIndex = 0; channelIndex < numChannels; ++channelIndex)
             {
@@ -128,7 +127,7 @@ namespace lab
 
                 float * destination = destinationBus->channel(channelIndex)->mutableData();
 
-                VectorMath::vmul(source, 1, &gainValues[0], 1, destination, 1, framesToProcess);
+                VectorMath::vmul(source, 1, gainValues, 1, destination, 1, framesToProcess);
             }
         }
 
@@ -137,49 +136,49 @@ namespace lab
         virtual double tailTime(ContextRenderLock & r) const override { return 0; }
         virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
 
-        void noteOn(double now)
+        void updateSettings(ContextRenderLock & r)
         {
-            m_noteOnTime = now;
+            EnvelopeSettings settings;
+            settings.attackTime = m_attackTime->value(r);
+            settings.attackLevel = m_attackLevel->value(r);
+            settings.decayTime = m_decayTime->value(r);
+            settings.sustainLevel = m_sustainLevel->value(r);
+            settings.releaseTime = m_releaseTime->value(r);
+            settings.attackCurve = m_attackCurve->value(r);
+            settings.decayCurve = m_decayCurve->value(r);
+            settings.releaseCurve = m_releaseCurve->value(r);
+            m_envelope.setSettings(0, settings);
         }
 
-        void noteOff(ContextRenderLock& r, double now)
+        bool gate(double when, bool on)
         {
-            // note off at any time except while a note is on, has no effect
-            m_noteOnTime = -1.;
+            const GateRequest request = { when, on };
+            if (!m_requests.write(&request, 1))
+                return false;
 
-            if (m_noteOffTime == std::numeric_limits<double>::max())
-            {
-                m_noteOffTime = now + m_releaseTime->value(r);
-                m_releaseSteps = m_releaseTime->value(r) * r.context()->sampleRate();
-                m_releaseStepSize = -m_sustainLevel->value(r) / m_releaseSteps;
-            }
+            if (on)
+                m_finished.store(false, std::memory_order_relaxed);
+            return true;
         }
 
-        int m_zeroSteps;
-        float m_zeroStepSize;
-
-        int m_attackSteps;
-        float m_attackStepSize;
-
-        int m_decaySteps;
-        float m_decayStepSize;
-
-        int m_releaseSteps;
-        float m_releaseStepSize;
+        EnvelopeGenerator m_envelope;
+        AudioFloatArray m_gainValues;
 
-        double m_noteOnTime;
+        // Written by noteOn() and noteOff(), and read on the audio thread into m_pending until they are due.
+        SPSCRingBuffer<GateRequest> m_requests;
+        GateRequest m_pending[MaxPendingGates];
+        size_t m_pendingCount = 0;
 
-        double m_attackTimeTarget, m_decayTimeTarget, m_noteOffTime;
-
-        float m_currentGain;
-
-        std::vector<float> gainValues;
+        std::atomic<bool> m_finished{ true };
 
         std::shared_ptr<AudioParam> m_attackTime;
         std::shared_ptr<AudioParam> m_attackLevel;
         std::shared_ptr<AudioParam> m_decayTime;
         std::shared_ptr<AudioParam> m_sustainLevel;
         std::shared_ptr<AudioParam> m_releaseTime;
+        std::shared_ptr<AudioParam> m_attackCurve;
+        std::shared_ptr<AudioParam> m_decayCurve;
+        std::shared_ptr<AudioParam> m_releaseCurve;
     };
 
     /////////////////////
@@ -200,6 +199,9 @@ namespace lab
         m_params.push_back(internalNode->m_decayTime);
         m_params.push_back(internalNode->m_sustainLevel);
         m_params.push_back(internalNode->m_releaseTime);
+        m_params.push_back(internalNode->m_attackCurve);
+        m_params.push_back(internalNode->m_decayCurve);
+        m_params.push_back(internalNode->m_releaseCurve);
 
         initialize();
     }
@@ -210,14 +212,14 @@ namespace lab
     }
 
 
-    void ADSRNode::noteOn(double when)
+    bool ADSRNode::noteOn(double when)
     {
-        internalNode->noteOn(when);
+        return internalNode->gate(when, true);
     }
 
-    void ADSRNode::noteOff(ContextRenderLock& r, double when)
+    bool ADSRNode::noteOff(ContextRenderLock&, double when)
     {
-        internalNode->noteOff(r, when);
+        return internalNode->gate(when, false);
     }
 
     std::shared_ptr<AudioParam> ADSRNode::attackTime() const
@@ -254,19 +256,24 @@ namespace lab
         return internalNode->m_releaseTime;
     }
 
-    bool ADSRNode::finished(ContextRenderLock& r)
+    std::shared_ptr<AudioParam> ADSRNode::attackCurve() const
     {
-        if (!r.context())
-            return true;
+        return internalNode->m_attackCurve;
+    }
 
-        double now = r.context()->currentTime();
+    std::shared_ptr<AudioParam> ADSRNode::decayCurve() const
+    {
+        return internalNode->m_decayCurve;
+    }
 
-        if (now > internalNode->m_noteOffTime)
-        {
-            internalNode->m_noteOffTime = 0;
-        }
+    std::shared_ptr<AudioParam> ADSRNode::releaseCurve() const
+    {
+        return internalNode->m_releaseCurve;
+    }
 
-        return now > internalNode->m_noteOffTime;
+    bool ADSRNode::finished(ContextRenderLock&)
+    {
+        return internalNode->m_finished.load(std::memory_order_relaxed);
     }
 
 } // End namespace lab
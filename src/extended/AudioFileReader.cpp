@@ -58,6 +58,41 @@ namespace detail
 
         return audioBus;
     }
+
+    std::shared_ptr<lab::CompressedAudioBus> LoadCompressedInternal(nqr::AudioData * audioData, bool mixToMono, lab::CompressedAudioBus::Format format)
+    {
+        std::unique_ptr<nqr::AudioData> data(audioData);
+
+        const size_t channelCount = data->channelCount;
+        const size_t numSamples = data->samples.size();
+        if (!numSamples || !channelCount) return nullptr;
+
+        const size_t length = numSamples / channelCount;
+        const size_t busChannelCount = mixToMono ? 1 : channelCount;
+
+        std::shared_ptr<lab::CompressedAudioBus> audioBus(new lab::CompressedAudioBus(format, busChannelCount, length, (float) data->sampleRate));
+
+        // Channels are encoded straight from the interleaved samples; only a mix to mono needs a copy
+        if (channelCount == lab::Channels::Stereo && mixToMono)
+        {
+            std::vector<float> mono(length);
+            const float * interleaved = data->samples.data();
+            for (size_t i = 0; i < length; i++)
+            {
+                mono[i] = 0.5f * (interleaved[i * 2] + interleaved[i * 2 + 1]);
+            }
+            audioBus->encodeChannel(0, mono.data());
+        }
+        else
+        {
+            for (size_t i = 0; i < busChannelCount; ++i)
+            {
+                audioBus->encodeChannel(i, data->samples.data() + i, channelCount);
+            }
+        }
+
+        return audioBus;
+    }
 }
 
 namespace lab
@@ -82,4 +117,12 @@ std::shared_ptr<AudioBus> MakeBusFromMemory(const std::vector<uint8_t> & buffer,
     return detail::LoadInternal(audioData, mixToMono);
 }
 
+std::shared_ptr<CompressedAudioBus> MakeCompressedBusFromFile(const char * filePath, bool mixToMono, CompressedAudioBus::Format format)
+{
+    std::lock_guard<std::mutex> lock(g_fileIOMutex);
+    nqr::AudioData * audioData = new nqr::AudioData();
+    nyquistFileIO.Load(audioData, std::string(filePath));
+    return detail::LoadCompressedInternal(audioData, mixToMono, format);
+}
+
 } // end namespace lab
@@ -0,0 +1,268 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/EnvelopeGenerator.h"
+
+#include "internal/Assertions.h"
+#include "internal/VectorMath.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace lab
+{
+
+namespace
+{
+    // Curves flatter than this are rendered as straight lines, where the exponential form loses precision.
+    const float MinimumCurve = 1e-3f;
+}
+
+EnvelopeGenerator::EnvelopeGenerator(size_t voiceCount, float sampleRate, size_t maxPendingGates)
+    : m_sampleRate(sampleRate)
+    , m_attackTime(voiceCount)
+    , m_attackLevel(voiceCount)
+    , m_decayTime(voiceCount)
+    , m_sustainLevel(voiceCount)
+    , m_releaseTime(voiceCount)
+    , m_attackCurve(voiceCount)
+    , m_decayCurve(voiceCount)
+    , m_releaseCurve(voiceCount)
+    , m_stage(voiceCount, Stage::Idle)
+    , m_level(voiceCount, 0.f)
+    , m_segmentStart(voiceCount, 0.f)
+    , m_segmentEnd(voiceCount, 0.f)
+    , m_segmentCurve(voiceCount, 0.f)
+    , m_segmentPosition(voiceCount, 0)
+    , m_segmentLength(voiceCount, 0)
+    , m_events(maxPendingGates ? maxPendingGates : voiceCount * 4)
+{
+    const EnvelopeSettings defaults;
+    for (size_t i = 0; i < voiceCount; ++i)
+        setSettings(i, defaults);
+}
+
+EnvelopeGenerator::~EnvelopeGenerator()
+{
+}
+
+void EnvelopeGenerator::setSettings(size_t voice, const EnvelopeSettings & settings)
+{
+    ASSERT(voice < voiceCount());
+    m_attackTime[voice] = std::max(0.f, settings.attackTime);
+    m_attackLevel[voice] = settings.attackLevel;
+    m_decayTime[voice] = std::max(0.f, settings.decayTime);
+    m_sustainLevel[voice] = settings.sustainLevel;
+    m_releaseTime[voice] = std::max(0.f, settings.releaseTime);
+    m_attackCurve[voice] = settings.attackCurve;
+    m_decayCurve[voice] = settings.decayCurve;
+    m_releaseCurve[voice] = settings.releaseCurve;
+}
+
+EnvelopeSettings EnvelopeGenerator::settings(size_t voice) const
+{
+    ASSERT(voice < voiceCount());
+    EnvelopeSettings settings;
+    settings.attackTime = m_attackTime[voice];
+    settings.attackLevel = m_attackLevel[voice];
+    settings.decayTime = m_decayTime[voice];
+    settings.sustainLevel = m_sustainLevel[voice];
+    settings.releaseTime = m_releaseTime[voice];
+    settings.attackCurve = m_attackCurve[voice];
+    settings.decayCurve = m_decayCurve[voice];
+    settings.releaseCurve = m_releaseCurve[voice];
+    return settings;
+}
+
+bool EnvelopeGenerator::gateOn(size_t voice, size_t frameOffset)
+{
+    return addGate(voice, frameOffset, true);
+}
+
+bool EnvelopeGenerator::gateOff(size_t voice, size_t frameOffset)
+{
+    return addGate(voice, frameOffset, false);
+}
+
+bool EnvelopeGenerator::addGate(size_t voice, size_t frameOffset, bool on)
+{
+    ASSERT(voice < voiceCount());
+    if (voice >= voiceCount() || m_eventCount == m_events.size())
+        return false;
+
+    GateEvent & event = m_events[m_eventCount++];
+    event.voice = static_cast<uint32_t>(voice);
+    event.sequence = m_eventSequence++;
+    event.offset = frameOffset;
+    event.on = on;
+    return true;
+}
+
+bool EnvelopeGenerator::isIdle(size_t voice) const
+{
+    if (m_stage[voice] != Stage::Idle)
+        return false;
+
+    for (size_t i = 0; i < m_eventCount; ++i)
+        if (m_events[i].voice == voice && m_events[i].on)
+            return false;
+
+    return true;
+}
+
+void EnvelopeGenerator::reset()
+{
+    std::fill(m_stage.begin(), m_stage.end(), Stage::Idle);
+    std::fill(m_level.begin(), m_level.end(), 0.f);
+    m_eventCount = 0;
+}
+
+void EnvelopeGenerator::applyGate(size_t voice, bool on)
+{
+    if (on)
+        beginSegment(voice, Stage::Attack, m_attackLevel[voice], m_attackTime[voice], m_attackCurve[voice]);
+    else if (m_stage[voice] != Stage::Idle && m_stage[voice] != Stage::Release)
+        beginSegment(voice, Stage::Release, 0.f, m_releaseTime[voice], m_releaseCurve[voice]);
+}
+
+void EnvelopeGenerator::beginSegment(size_t voice, Stage stage, float endLevel, float time, float curve)
+{
+    m_stage[voice] = stage;
+    m_segmentStart[voice] = m_level[voice];
+    m_segmentEnd[voice] = endLevel;
+    m_segmentCurve[voice] = curve;
+    m_segmentPosition[voice] = 0;
+    m_segmentLength[voice] = static_cast<uint32_t>(std::min(std::round(static_cast<double>(time) * m_sampleRate), double(UINT32_MAX)));
+}
+
+void EnvelopeGenerator::finishSegment(size_t voice)
+{
+    m_level[voice] = m_segmentEnd[voice];
+
+    switch (m_stage[voice])
+    {
+    case Stage::Attack:
+        beginSegment(voice, Stage::Decay, m_sustainLevel[voice], m_decayTime[voice], m_decayCurve[voice]);
+        break;
+    case Stage::Decay:
+        m_stage[voice] = Stage::Sustain;
+        break;
+    case Stage::Release:
+        m_stage[voice] = Stage::Idle;
+        m_level[voice] = 0.f;
+        break;
+    default:
+        break;
+    }
+}
+
+// A segment of length L from s to e with curve c is level(k) = s + (e - s) * (1 - exp(c * k / L)) / (1 - exp(c)),
+// which is a + b * r^k with a = s + (e - s) / (1 - exp(c)), b = s - a and r = exp(c / L). With c = 0 it is linear.
+float EnvelopeGenerator::segmentLevel(size_t voice, uint32_t position) const
+{
+    const uint32_t length = m_segmentLength[voice];
+    const float start = m_segmentStart[voice];
+    const float end = m_segmentEnd[voice];
+    if (position >= length)
+        return end;
+
+    const double x = static_cast<double>(position) / length;
+    const double curve = m_segmentCurve[voice];
+    if (std::fabs(curve) < MinimumCurve)
+        return static_cast<float>(start + (end - start) * x);
+
+    return static_cast<float>(start + (end - start) * (1.0 - std::exp(curve * x)) / (1.0 - std::exp(curve)));
+}
+
+void EnvelopeGenerator::renderVoice(size_t voice, float * output, size_t framesToProcess)
+{
+    size_t frame = 0;
+    while (frame < framesToProcess)
+    {
+        const Stage stage = m_stage[voice];
+        if (stage == Stage::Idle || stage == Stage::Sustain)
+        {
+            const float level = stage == Stage::Sustain ? m_sustainLevel[voice] : 0.f;
+            m_level[voice] = level;
+            if (output)
+                std::fill(output + frame, output + framesToProcess, level);
+            return;
+        }
+
+        const uint32_t position = m_segmentPosition[voice];
+        const uint32_t length = m_segmentLength[voice];
+        if (position >= length)
+        {
+            finishSegment(voice);
+            continue;
+        }
+
+        const size_t count = std::min(framesToProcess - frame, static_cast<size_t>(length - position));
+        if (output)
+        {
+            // Each block restarts from the closed form at its position, so that long segments don't accumulate rounding.
+            const double start = m_segmentStart[voice];
+            const double end = m_segmentEnd[voice];
+            const double curve = m_segmentCurve[voice];
+            if (std::fabs(curve) < MinimumCurve)
+            {
+                const double step = (end - start) / length;
+                VectorMath::vramp(static_cast<float>(start + step * position), static_cast<float>(step), output + frame, count);
+            }
+            else
+            {
+                const double offset = start + (end - start) / (1.0 - std::exp(curve));
+                const double scale = (start - offset) * std::exp(curve * position / length);
+                VectorMath::vgeom(static_cast<float>(offset), static_cast<float>(scale), static_cast<float>(std::exp(curve / length)), output + frame, count);
+            }
+        }
+
+        m_segmentPosition[voice] = position + static_cast<uint32_t>(count);
+        m_level[voice] = segmentLevel(voice, m_segmentPosition[voice]);
+        frame += count;
+    }
+}
+
+void EnvelopeGenerator::process(float * const * outputs, size_t framesToProcess)
+{
+    // Gate events are ordered by voice, then offset, then submission, so each voice renders the spans between its events.
+    // std::sort works in place, so ordering them doesn't allocate.
+    std::sort(m_events.begin(), m_events.begin() + m_eventCount, [](const GateEvent & a, const GateEvent & b)
+    {
+        if (a.voice != b.voice) return a.voice < b.voice;
+        if (a.offset != b.offset) return a.offset < b.offset;
+        return a.sequence < b.sequence;
+    });
+
+    size_t event = 0;
+    size_t carried = 0;
+    for (size_t voice = 0; voice < voiceCount(); ++voice)
+    {
+        float * output = outputs ? outputs[voice] : nullptr;
+        size_t frame = 0;
+
+        for (; event < m_eventCount && m_events[event].voice == voice; ++event)
+        {
+            GateEvent & gate = m_events[event];
+            if (gate.offset >= framesToProcess)
+            {
+                // Falls in a later call; keep it, relative to the start of the next one.
+                gate.offset -= framesToProcess;
+                m_events[carried++] = gate;
+                continue;
+            }
+
+            renderVoice(voice, output ? output + frame : nullptr, gate.offset - frame);
+            frame = gate.offset;
+            applyGate(voice, gate.on);
+        }
+
+        renderVoice(voice, output ? output + frame : nullptr, framesToProcess - frame);
+    }
+
+    m_eventCount = carried;
+    if (!m_eventCount)
+        m_eventSequence = 0;
+}
+
+} // namespace lab
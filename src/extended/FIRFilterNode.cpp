@@ -0,0 +1,142 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/AudioProcessor.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioBus.h"
+
+#include "LabSound/extended/FIRFilterNode.h"
+#include "LabSound/extended/AudioContextLock.h"
+
+#include "internal/DirectConvolver.h"
+
+#include <mutex>
+
+namespace lab
+{
+
+    //////////////////////////////////////////
+    // Private FIRFilterNode Implementation //
+    //////////////////////////////////////////
+
+    class FIRFilterNode::FIRFilterNodeInternal : public AudioProcessor
+    {
+
+    public:
+
+        FIRFilterNodeInternal() : AudioProcessor(1) { }
+
+        virtual ~FIRFilterNodeInternal() { }
+
+        virtual void initialize() override
+        {
+            if (isInitialized())
+                return;
+
+            for (size_t i = 0; i < numberOfChannels(); ++i)
+                m_convolvers.push_back(std::unique_ptr<DirectConvolver>(new DirectConvolver(AudioNode::ProcessingSizeInFrames, MaxKernelSize)));
+
+            m_initialized = true;
+        }
+
+        virtual void uninitialize() override
+        {
+            m_convolvers.clear();
+            m_initialized = false;
+        }
+
+        virtual void process(ContextRenderLock & r, const AudioBus * source, AudioBus * destination, size_t framesToProcess) override
+        {
+            if (!isInitialized() || !r.context())
+            {
+                destination->zero();
+                return;
+            }
+
+            // Take up a new kernel if the main thread isn't in the middle of setting one. The previous kernel is
+            // left behind in m_newKernel so that it is freed by the main thread rather than here.
+            {
+                std::unique_lock<std::mutex> lock(m_kernelMutex, std::try_to_lock);
+                if (lock.owns_lock() && m_kernelChanged)
+                {
+                    m_kernel.swap(m_newKernel);
+                    m_kernelChanged = false;
+                }
+            }
+
+            const bool channelCountMatches = source->numberOfChannels() == destination->numberOfChannels() && source->numberOfChannels() == m_convolvers.size();
+            if (!channelCountMatches)
+                return;
+
+            for (size_t i = 0; i < m_convolvers.size(); ++i)
+            {
+                const float * sourceP = source->channel(i)->data();
+                float * destinationP = destination->channel(i)->mutableData();
+
+                // With no kernel, pass through with a unit impulse so that the history stays current for the next kernel.
+                if (m_kernel.empty())
+                {
+                    const float unit = 1.f;
+                    m_convolvers[i]->process(&unit, 1, sourceP, destinationP, framesToProcess);
+                    continue;
+                }
+
+                m_convolvers[i]->process(m_kernel.data(), m_kernel.size(), sourceP, destinationP, framesToProcess);
+            }
+        }
+
+        virtual void reset() override
+        {
+            for (auto & convolver : m_convolvers)
+                convolver->reset();
+        }
+
+        virtual double tailTime(ContextRenderLock & r) const override
+        {
+            return r.context() ? double(m_kernel.size()) / r.context()->sampleRate() : 0;
+        }
+
+        virtual double latencyTime(ContextRenderLock &) const override { return 0; }
+
+        void setKernel(const std::vector<float> & kernel)
+        {
+            const size_t taps = kernel.size() < MaxKernelSize ? kernel.size() : size_t(MaxKernelSize);
+            std::vector<float> newKernel(kernel.begin(), kernel.begin() + taps);
+
+            std::lock_guard<std::mutex> lock(m_kernelMutex);
+            m_newKernel.swap(newKernel);
+            m_kernelChanged = true;
+        }
+
+    private:
+
+        std::vector<std::unique_ptr<DirectConvolver>> m_convolvers;
+
+        std::vector<float> m_kernel;    // owned by the audio thread
+        std::vector<float> m_newKernel; // guarded by m_kernelMutex
+        bool m_kernelChanged = false;
+        std::mutex m_kernelMutex;
+    };
+
+    //////////////////////////
+    // Public FIRFilterNode //
+    //////////////////////////
+
+    FIRFilterNode::FIRFilterNode() : AudioBasicProcessorNode()
+    {
+        m_processor.reset(new FIRFilterNodeInternal());
+        internalNode = static_cast<FIRFilterNodeInternal*>(m_processor.get());
+        initialize();
+    }
+
+    FIRFilterNode::~FIRFilterNode()
+    {
+        uninitialize();
+    }
+
+    void FIRFilterNode::setKernel(const std::vector<float> & kernel)
+    {
+        internalNode->setKernel(kernel);
+    }
+
+} // namespace lab
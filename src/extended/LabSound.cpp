@@ -35,6 +35,24 @@ namespace lab
         return ctx;
     }
 
+    std::unique_ptr<lab::AudioContext> MakeRealtimeAudioContext(const AudioDeviceConfiguration & device, uint32_t numChannels, float sample_rate)
+    {
+        LOG("Initialize Realtime Context");
+        std::unique_ptr<AudioContext> ctx(new lab::AudioContext(false));
+        ctx->setDestinationNode(std::make_shared<lab::DefaultAudioDestinationNode>(ctx.get(), numChannels, sample_rate, device));
+        ctx->lazyInitialize();
+        return ctx;
+    }
+
+    std::unique_ptr<lab::AudioContext> MakeHeadlessAudioContext(uint32_t numChannels, AudioDestinationBackend backend, HeadlessRenderCallback output, float sample_rate)
+    {
+        LOG("Initialize Headless Context");
+        std::unique_ptr<AudioContext> ctx(new lab::AudioContext(false));
+        ctx->setDestinationNode(std::make_shared<lab::DefaultAudioDestinationNode>(ctx.get(), numChannels, sample_rate, backend, std::move(output)));
+        ctx->lazyInitialize();
+        return ctx;
+    }
+
     std::unique_ptr<lab::AudioContext> MakeOfflineAudioContext(uint32_t numChannels, float recordTimeMilliseconds)
     {
         LOG("Initialize Offline Context");
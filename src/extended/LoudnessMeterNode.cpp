@@ -0,0 +1,478 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/LoudnessMeterNode.h"
+#include "LabSound/extended/AudioContextLock.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/Macros.h"
+
+#include "internal/TripleBuffer.h"
+#include "internal/VectorMath.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <string.h>
+
+namespace lab {
+
+namespace
+{
+    const size_t MaxChannels = LoudnessMeasurement::MaxChannels;
+    const size_t ChunkSize = AudioNode::ProcessingSizeInFrames;
+
+    // Gating blocks are 400 ms long and start every 100 ms, so they are summed from 100 ms sub-blocks. The short-term
+    // window is the last 30 sub-blocks.
+    const size_t MomentarySubBlocks = 4;
+    const size_t ShortTermSubBlocks = 30;
+
+    // Gating blocks are binned by loudness, 0.1 LU to the bin, from the absolute gate up to +30 LUFS. Each bin sums
+    // its blocks' energy, so the integrated loudness is exact but for the relative gate, which is placed to the bin.
+    const double AbsoluteGate = -70.0;
+    const double RelativeGate = -10.0;
+    const double BinsPerLU = 10.0;
+    const size_t BinCount = 1000;
+
+    // The polyphase interpolation filter of BS.1770-4 Annex 2; four phases of 12 taps.
+    const size_t TruePeakTaps = 12;
+    const float TruePeakPhases[4][TruePeakTaps] =
+    {
+        {  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f, -0.0594482421875f,  0.1373291015625f,
+           0.9721679687500f, -0.1022949218750f,  0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+        { -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f, -0.1665039062500f,  0.4650878906250f,
+           0.7797851562500f, -0.2003173828125f,  0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+        { -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f, -0.2003173828125f,  0.7797851562500f,
+           0.4650878906250f, -0.1665039062500f,  0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+        { -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f, -0.1022949218750f,  0.9721679687500f,
+           0.1373291015625f, -0.0594482421875f,  0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f },
+    };
+
+    const float NegativeInfinity = -std::numeric_limits<float>::infinity();
+
+    inline float loudness(double energy) { return energy > 0 ? static_cast<float>(-0.691 + 10.0 * std::log10(energy)) : NegativeInfinity; }
+    inline float decibels(double amplitude) { return amplitude > 0 ? static_cast<float>(20.0 * std::log10(amplitude)) : NegativeInfinity; }
+
+    struct BiquadCoefficients { double b0, b1, b2, a1, a2; };
+
+    // A biquad in transposed direct form II. The state is kept in double precision, since the high-pass stage's poles
+    // lie very close to the unit circle.
+    struct BiquadState
+    {
+        double z1 = 0, z2 = 0;
+
+        double process(const BiquadCoefficients & k, double x)
+        {
+            const double y = k.b0 * x + z1;
+            z1 = k.b1 * x - k.a1 * y + z2;
+            z2 = k.b2 * x - k.a2 * y;
+            return y;
+        }
+    };
+
+    struct ChannelMeter
+    {
+        BiquadState shelf;
+        BiquadState highPass;
+        double weight = 1;
+
+        // The last TruePeakTaps - 1 input samples, followed by the chunk being measured.
+        alignas(16) float history[TruePeakTaps - 1 + ChunkSize];
+
+        alignas(16) float weighted[ChunkSize];
+
+        float truePeak = 0;
+        float peak = 0;
+        double meanSquare = 0;
+    };
+}
+
+struct LoudnessMeter::Internals
+{
+    Internals() : published(unmeasured())
+    {
+        clearMeasurement();
+    }
+
+    static LoudnessMeasurement unmeasured()
+    {
+        LoudnessMeasurement m;
+        m.momentary = m.shortTerm = m.integrated = m.maxMomentary = m.maxShortTerm = m.truePeak = NegativeInfinity;
+        m.channelCount = 0;
+        for (size_t c = 0; c < MaxChannels; ++c)
+            m.channelTruePeak[c] = m.channelPeak[c] = m.channelRms[c] = NegativeInfinity;
+        m.duration = 0;
+        return m;
+    }
+
+    // The K-weighting pre-filter (a high shelf modelling the head) and RLB high-pass, designed for the sample rate as
+    // in BS.1770, rather than using the 48 kHz coefficients tabulated there.
+    void configure(float rate, size_t channels)
+    {
+        sampleRate = rate;
+        channelCount = channels;
+
+        {
+            const double f0 = 1681.974450955533, gain = 3.999843853973347, q = 0.7071752369554196;
+            const double k = std::tan(piDouble * f0 / rate);
+            const double vh = std::pow(10.0, gain / 20.0);
+            const double vb = std::pow(vh, 0.4996667741545416);
+            const double a0 = 1.0 + k / q + k * k;
+            shelf = { (vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+                      2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+        }
+        {
+            const double f0 = 38.13547087602444, q = 0.5003270373238773;
+            const double k = std::tan(piDouble * f0 / rate);
+            const double a0 = 1.0 + k / q + k * k;
+            highPass = { 1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+        }
+
+        subBlockLength = std::max(size_t(1), static_cast<size_t>(std::lround(0.1 * rate)));
+
+        for (size_t c = 0; c < MaxChannels; ++c)
+        {
+            ChannelMeter & channel = channelState[c];
+            channel.shelf = BiquadState();
+            channel.highPass = BiquadState();
+            memset(channel.history, 0, sizeof(channel.history));
+            channel.peak = 0;
+            channel.meanSquare = 0;
+
+            // L R C LFE Ls Rs, and any further surrounds.
+            if (channels >= 6 && c == 3)
+                channel.weight = 0;
+            else if (channels >= 6 && c > 3)
+                channel.weight = 1.41;
+            else
+                channel.weight = 1;
+        }
+
+        clearMeasurement();
+    }
+
+    void clearMeasurement()
+    {
+        memset(subBlocks, 0, sizeof(subBlocks));
+        subBlockCount = 0;
+        subBlockEnergy = 0;
+        subBlockPosition = 0;
+
+        memset(binEnergy, 0, sizeof(binEnergy));
+        memset(binCount, 0, sizeof(binCount));
+        gatedEnergy = 0;
+        gatedCount = 0;
+
+        momentary = shortTerm = integrated = 0;
+        maxMomentary = maxShortTerm = 0;
+        frames = 0;
+
+        for (size_t c = 0; c < MaxChannels; ++c)
+            channelState[c].truePeak = 0;
+    }
+
+    void completeSubBlock()
+    {
+        subBlocks[subBlockCount % ShortTermSubBlocks] = subBlockEnergy / subBlockLength;
+        ++subBlockCount;
+        subBlockEnergy = 0;
+        subBlockPosition = 0;
+
+        // Windows that haven't filled yet are padded with silence.
+        const size_t available = static_cast<size_t>(std::min(subBlockCount, static_cast<uint64_t>(ShortTermSubBlocks)));
+        double sum = 0;
+        for (size_t i = 0; i < std::min(available, MomentarySubBlocks); ++i)
+            sum += subBlocks[(subBlockCount - 1 - i) % ShortTermSubBlocks];
+        momentary = sum / MomentarySubBlocks;
+
+        for (size_t i = MomentarySubBlocks; i < available; ++i)
+            sum += subBlocks[(subBlockCount - 1 - i) % ShortTermSubBlocks];
+        shortTerm = sum / ShortTermSubBlocks;
+
+        maxMomentary = std::max(maxMomentary, momentary);
+        if (subBlockCount >= ShortTermSubBlocks)
+            maxShortTerm = std::max(maxShortTerm, shortTerm);
+
+        if (subBlockCount < MomentarySubBlocks)
+            return;
+
+        // Each complete momentary window is a gating block.
+        const double blockLoudness = loudness(momentary);
+        if (blockLoudness > AbsoluteGate)
+        {
+            const size_t bin = std::min(BinCount - 1, static_cast<size_t>((blockLoudness - AbsoluteGate) * BinsPerLU));
+            binEnergy[bin] += momentary;
+            ++binCount[bin];
+            gatedEnergy += momentary;
+            ++gatedCount;
+        }
+
+        if (!gatedCount)
+            return;
+
+        const double threshold = loudness(gatedEnergy / gatedCount) + RelativeGate;
+        const size_t firstBin = threshold > AbsoluteGate ? static_cast<size_t>((threshold - AbsoluteGate) * BinsPerLU) : 0;
+
+        double energy = 0;
+        uint64_t count = 0;
+        for (size_t bin = std::min(firstBin, BinCount - 1); bin < BinCount; ++bin)
+        {
+            energy += binEnergy[bin];
+            count += binCount[bin];
+        }
+        integrated = count ? energy / count : 0;
+    }
+
+    // Measures frames [0, count) of each channel; count is at most ChunkSize.
+    void measure(const float * const * sources, size_t count)
+    {
+        const size_t HistoryLength = TruePeakTaps - 1;
+
+        for (size_t c = 0; c < channelCount; ++c)
+        {
+            ChannelMeter & channel = channelState[c];
+            const float * source = sources[c];
+
+            float peak = 0;
+            VectorMath::vmaxmgv(source, 1, &peak, count);
+
+            float sumOfSquares = 0;
+            VectorMath::vsvesq(source, 1, &sumOfSquares, count);
+
+            // Ballistics: the peak rises at once and falls at the fall rate, and the mean square follows an
+            // exponential average.
+            channel.peak = std::max(peak, channel.peak * peakFall);
+            channel.meanSquare = rmsCoefficient * channel.meanSquare + (1.0 - rmsCoefficient) * (sumOfSquares / count);
+
+            // True peak. Each phase of the interpolator is accumulated over the chunk, a tap at a time.
+            memcpy(channel.history + HistoryLength, source, count * sizeof(float));
+            float truePeak = peak;
+            for (size_t phase = 0; phase < 4; ++phase)
+            {
+                memset(interpolated, 0, count * sizeof(float));
+                for (size_t tap = 0; tap < TruePeakTaps; ++tap)
+                    VectorMath::vsma(channel.history + HistoryLength - tap, 1, &TruePeakPhases[phase][tap], interpolated, 1, count);
+
+                float phasePeak = 0;
+                VectorMath::vmaxmgv(interpolated, 1, &phasePeak, count);
+                truePeak = std::max(truePeak, phasePeak);
+            }
+            memmove(channel.history, channel.history + count, HistoryLength * sizeof(float));
+            channel.truePeak = std::max(channel.truePeak, truePeak);
+
+            // K-weighting.
+            if (channel.weight > 0)
+            {
+                for (size_t i = 0; i < count; ++i)
+                    channel.weighted[i] = static_cast<float>(channel.highPass.process(highPass, channel.shelf.process(shelf, source[i])));
+            }
+        }
+
+        // The weighted energy, split where sub-blocks end.
+        for (size_t offset = 0; offset < count; )
+        {
+            const size_t length = std::min(count - offset, subBlockLength - subBlockPosition);
+
+            for (size_t c = 0; c < channelCount; ++c)
+            {
+                const ChannelMeter & channel = channelState[c];
+                if (channel.weight > 0)
+                {
+                    float sum = 0;
+                    VectorMath::vsvesq(channel.weighted + offset, 1, &sum, length);
+                    subBlockEnergy += channel.weight * sum;
+                }
+            }
+
+            offset += length;
+            subBlockPosition += length;
+            if (subBlockPosition == subBlockLength)
+                completeSubBlock();
+        }
+
+        frames += count;
+    }
+
+    void publish()
+    {
+        LoudnessMeasurement & m = published.back();
+        m.momentary = loudness(momentary);
+        m.shortTerm = loudness(shortTerm);
+        m.integrated = loudness(integrated);
+        m.maxMomentary = loudness(maxMomentary);
+        m.maxShortTerm = loudness(maxShortTerm);
+        m.channelCount = channelCount;
+
+        float truePeak = 0;
+        for (size_t c = 0; c < MaxChannels; ++c)
+        {
+            const ChannelMeter & channel = channelState[c];
+            if (c < channelCount)
+            {
+                truePeak = std::max(truePeak, channel.truePeak);
+                m.channelTruePeak[c] = decibels(channel.truePeak);
+                m.channelPeak[c] = decibels(channel.peak);
+                m.channelRms[c] = decibels(std::sqrt(channel.meanSquare));
+            }
+            else
+                m.channelTruePeak[c] = m.channelPeak[c] = m.channelRms[c] = NegativeInfinity;
+        }
+        m.truePeak = decibels(truePeak);
+        m.duration = sampleRate > 0 ? frames / static_cast<double>(sampleRate) : 0;
+
+        published.publish();
+    }
+
+    // Audio thread.
+    float sampleRate = 0;
+    size_t channelCount = 0;
+    BiquadCoefficients shelf = {};
+    BiquadCoefficients highPass = {};
+    ChannelMeter channelState[MaxChannels];
+    alignas(16) float interpolated[ChunkSize];
+
+    size_t subBlockLength = 1;
+    size_t subBlockPosition = 0;
+    double subBlockEnergy = 0;
+    double subBlocks[ShortTermSubBlocks];
+    uint64_t subBlockCount = 0;
+
+    double binEnergy[BinCount];
+    uint64_t binCount[BinCount];
+    double gatedEnergy = 0;
+    uint64_t gatedCount = 0;
+
+    // Mean weighted energies.
+    double momentary = 0, shortTerm = 0, integrated = 0, maxMomentary = 0, maxShortTerm = 0;
+    uint64_t frames = 0;
+
+    float peakFall = 1;
+    double rmsCoefficient = 0;
+    float ballisticsRate = 0;
+    size_t ballisticsCount = 0;
+
+    // Set from any thread.
+    std::atomic<float> peakFallRate{ 20.f };
+    std::atomic<float> rmsTime{ 0.3f };
+    std::atomic<bool> resetRequested{ false };
+    std::atomic<bool> ballisticsChanged{ true };
+
+    TripleBuffer<LoudnessMeasurement> published;
+    mutable std::mutex readerMutex; // serializes readers; never taken by the audio thread
+};
+
+LoudnessMeter::LoudnessMeter() : m_internal(new Internals())
+{
+}
+
+LoudnessMeter::~LoudnessMeter()
+{
+}
+
+void LoudnessMeter::process(const AudioBus & bus, size_t framesToProcess, float sampleRate)
+{
+    Internals & internal = *m_internal;
+
+    const size_t channels = std::min(bus.numberOfChannels(), MaxChannels);
+    if (!channels || !(sampleRate > 0))
+        return;
+
+    if (channels != internal.channelCount || sampleRate != internal.sampleRate)
+        internal.configure(sampleRate, channels);
+
+    if (internal.resetRequested.exchange(false, std::memory_order_acquire))
+        internal.clearMeasurement();
+
+    const size_t frames = std::min(framesToProcess, bus.length());
+    const size_t chunk = std::min(frames, ChunkSize);
+
+    // The ballistic coefficients depend only on the chunk length, which only changes with the settings.
+    if (internal.ballisticsChanged.exchange(false, std::memory_order_acquire) || internal.ballisticsCount != chunk || internal.ballisticsRate != sampleRate)
+    {
+        const float fallRate = internal.peakFallRate.load(std::memory_order_relaxed);
+        const float rmsTime = internal.rmsTime.load(std::memory_order_relaxed);
+        internal.peakFall = static_cast<float>(std::pow(10.0, -fallRate * chunk / (20.0 * sampleRate)));
+        internal.rmsCoefficient = rmsTime > 0 ? std::exp(-static_cast<double>(chunk) / (rmsTime * sampleRate)) : 0;
+        internal.ballisticsCount = chunk;
+        internal.ballisticsRate = sampleRate;
+    }
+
+    const float * sources[MaxChannels];
+    for (size_t offset = 0; offset < frames; offset += ChunkSize)
+    {
+        for (size_t c = 0; c < channels; ++c)
+            sources[c] = bus.channel(c)->data() + offset;
+        internal.measure(sources, std::min(ChunkSize, frames - offset));
+    }
+
+    internal.publish();
+}
+
+void LoudnessMeter::rendered(ContextRenderLock & r, const AudioNodeOutput &, const AudioBus & bus, size_t framesToProcess)
+{
+    process(bus, framesToProcess, r.context()->sampleRate());
+}
+
+void LoudnessMeter::read(LoudnessMeasurement & measurement) const
+{
+    std::lock_guard<std::mutex> lock(m_internal->readerMutex);
+    m_internal->published.update();
+    measurement = m_internal->published.front();
+}
+
+void LoudnessMeter::reset()
+{
+    m_internal->resetRequested.store(true, std::memory_order_release);
+}
+
+void LoudnessMeter::setPeakFallRate(float decibelsPerSecond)
+{
+    m_internal->peakFallRate.store(std::max(0.f, decibelsPerSecond), std::memory_order_relaxed);
+    m_internal->ballisticsChanged.store(true, std::memory_order_release);
+}
+
+void LoudnessMeter::setRmsTime(float seconds)
+{
+    m_internal->rmsTime.store(std::max(0.f, seconds), std::memory_order_relaxed);
+    m_internal->ballisticsChanged.store(true, std::memory_order_release);
+}
+
+LoudnessMeterNode::LoudnessMeterNode() : AudioBasicInspectorNode(2), m_meter(std::make_shared<LoudnessMeter>())
+{
+}
+
+LoudnessMeterNode::~LoudnessMeterNode()
+{
+    uninitialize();
+}
+
+void LoudnessMeterNode::process(ContextRenderLock & r, size_t framesToProcess)
+{
+    AudioBus * outputBus = output(0)->bus(r);
+
+    if (!isInitialized() || !input(0)->isConnected())
+    {
+        if (outputBus)
+            outputBus->zero();
+        return;
+    }
+
+    AudioBus * bus = input(0)->bus(r);
+    m_meter->process(*bus, framesToProcess, r.context()->sampleRate());
+
+    // Usually in place: pullInputs() renders the input straight into the output when their channel counts match.
+    if (bus != outputBus)
+        outputBus->copyFrom(*bus);
+}
+
+void LoudnessMeterNode::reset(ContextRenderLock &)
+{
+    m_meter->reset();
+}
+
+} // namespace lab
@@ -0,0 +1,323 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/OneShotNode.h"
+#include "LabSound/extended/AudioContextLock.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeOutput.h"
+
+#include "internal/Assertions.h"
+#include "internal/RingBuffer.h"
+#include "internal/VectorMath.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <vector>
+
+namespace lab {
+
+namespace
+{
+    enum class RequestType : uint8_t { Play, StopAll };
+
+    struct Request
+    {
+        RequestType type;
+        uint32_t voice;
+        const AudioBus * bus;
+        double when;
+        float gain;
+        float playbackRate;
+    };
+
+    // A voice as the audio thread sees it. The bus is kept alive by Internals::buses until the voice is released.
+    struct Voice
+    {
+        const AudioBus * bus = nullptr;
+        int64_t startFrame = 0;
+        double readIndex = 0;
+        float gain = 1.f;
+        float playbackRate = 1.f;
+        bool active = false;
+    };
+}
+
+struct OneShotNode::Internals
+{
+    Internals(size_t voiceCount)
+    : voices(voiceCount)
+    , buses(voiceCount)
+    , requests(2 * voiceCount + 1)
+    , finished(voiceCount)
+    {
+        freeVoices.reserve(voiceCount);
+        for (size_t i = voiceCount; i > 0; --i)
+            freeVoices.push_back(static_cast<uint32_t>(i - 1));
+    }
+
+    // Audio thread.
+    std::vector<Voice> voices;
+    size_t activeCount = 0;
+
+    // Callers of play(), serialized by callerMutex, which the audio thread never takes.
+    std::mutex callerMutex;
+    std::vector<std::shared_ptr<AudioBus>> buses;
+    std::vector<uint32_t> freeVoices;
+
+    // A voice is only free once the audio thread has read its last request, so at most one Play per voice is queued.
+    // stopAll() doesn't queue a StopAll straight after another that is still queued, so there is at most one more
+    // StopAll than there are Plays, and the queue has room for both.
+    SPSCRingBuffer<Request> requests;   // to the audio thread
+    SPSCRingBuffer<uint32_t> finished;  // from the audio thread; never fuller than the voice count
+    bool lastRequestWasStop = false;
+    std::atomic<size_t> queuedStops{ 0 };
+
+    std::atomic<size_t> publishedActiveCount{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+
+    // Must be called with callerMutex held.
+    void releaseFinished()
+    {
+        uint32_t voice;
+        while (finished.read(&voice, 1))
+        {
+            buses[voice].reset();
+            freeVoices.push_back(voice);
+        }
+    }
+
+    void finish(uint32_t voice)
+    {
+        voices[voice].active = false;
+        voices[voice].bus = nullptr;
+        --activeCount;
+        finished.write(&voice, 1);
+    }
+
+    // Mixes frames [offset, offset + count) of the voice into the destination, reading from the voice's position at rate.
+    // Returns true when the voice reaches the end of its bus.
+    bool render(Voice & voice, AudioBus * destination, size_t offset, size_t count, double rate)
+    {
+        const AudioBus * bus = voice.bus;
+        const size_t length = bus->length();
+        const size_t sourceChannels = bus->numberOfChannels();
+        const size_t destinationChannels = destination->numberOfChannels();
+
+        // Mono is copied to every channel, and everything else is mixed down to mono, or played channel for channel.
+        const bool spread = sourceChannels == 1;
+        const bool mixDown = destinationChannels == 1 && sourceChannels > 1;
+        const float gain = mixDown ? voice.gain / sourceChannels : voice.gain;
+
+        auto mix = [&](const float * source, float * dest)
+        {
+            if (rate == 1.0)
+            {
+                const size_t start = static_cast<size_t>(voice.readIndex);
+                VectorMath::vsma(source + start, 1, &gain, dest + offset, 1, count);
+                return;
+            }
+
+            // Linear interpolation, for buses at another sample rate or played at another pitch.
+            double readIndex = voice.readIndex;
+            for (size_t i = 0; i < count; ++i, readIndex += rate)
+            {
+                const size_t index = static_cast<size_t>(readIndex);
+                const double fraction = readIndex - index;
+                const float sample1 = source[index];
+                const float sample2 = index + 1 < length ? source[index + 1] : 0.f;
+                dest[offset + i] += gain * static_cast<float>(sample1 + (sample2 - sample1) * fraction);
+            }
+        };
+
+        if (spread || mixDown)
+        {
+            for (size_t c = 0; c < (spread ? destinationChannels : sourceChannels); ++c)
+            {
+                const float * source = bus->channel(spread ? 0 : c)->data();
+                float * dest = destination->channel(spread ? c : 0)->mutableData();
+                mix(source, dest);
+            }
+        }
+        else
+        {
+            for (size_t c = 0; c < std::min(sourceChannels, destinationChannels); ++c)
+                mix(bus->channel(c)->data(), destination->channel(c)->mutableData());
+        }
+
+        voice.readIndex += count * rate;
+        return voice.readIndex >= length;
+    }
+};
+
+OneShotNode::OneShotNode(size_t voiceCount, size_t channelCount)
+: m_internal(new Internals(std::max(size_t(1), voiceCount)))
+{
+    addOutput(std::unique_ptr<AudioNodeOutput>(new AudioNodeOutput(this, std::max(size_t(1), channelCount))));
+    initialize();
+}
+
+OneShotNode::~OneShotNode()
+{
+    uninitialize();
+}
+
+bool OneShotNode::play(std::shared_ptr<AudioBus> bus, double when, float gain, float playbackRate)
+{
+    if (!bus || !bus->length() || !bus->numberOfChannels() || !(playbackRate > 0.f))
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_internal->callerMutex);
+    m_internal->releaseFinished();
+
+    if (m_internal->freeVoices.empty())
+    {
+        m_internal->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    const uint32_t voice = m_internal->freeVoices.back();
+    m_internal->freeVoices.pop_back();
+
+    Request request;
+    request.type = RequestType::Play;
+    request.voice = voice;
+    request.bus = bus.get();
+    request.when = when;
+    request.gain = gain;
+    request.playbackRate = playbackRate;
+
+    m_internal->buses[voice] = std::move(bus);
+    if (!m_internal->requests.write(&request, 1))
+    {
+        m_internal->buses[voice].reset();
+        m_internal->freeVoices.push_back(voice);
+        m_internal->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    m_internal->lastRequestWasStop = false;
+    return true;
+}
+
+void OneShotNode::stopAll()
+{
+    std::lock_guard<std::mutex> lock(m_internal->callerMutex);
+    m_internal->releaseFinished();
+
+    // A StopAll that the audio thread hasn't read yet, with no Play after it, already stops everything this would.
+    if (m_internal->lastRequestWasStop && m_internal->queuedStops.load(std::memory_order_acquire))
+        return;
+
+    Request request = {};
+    request.type = RequestType::StopAll;
+    m_internal->queuedStops.fetch_add(1, std::memory_order_relaxed);
+    if (!m_internal->requests.write(&request, 1))
+    {
+        m_internal->queuedStops.fetch_sub(1, std::memory_order_relaxed);
+        return;
+    }
+
+    m_internal->lastRequestWasStop = true;
+}
+
+void OneShotNode::releaseFinishedVoices()
+{
+    std::lock_guard<std::mutex> lock(m_internal->callerMutex);
+    m_internal->releaseFinished();
+}
+
+size_t OneShotNode::voiceCount() const
+{
+    return m_internal->voices.size();
+}
+
+size_t OneShotNode::activeVoiceCount() const
+{
+    return m_internal->publishedActiveCount.load(std::memory_order_relaxed);
+}
+
+uint64_t OneShotNode::droppedCount() const
+{
+    return m_internal->dropped.load(std::memory_order_relaxed);
+}
+
+bool OneShotNode::propagatesSilence(ContextRenderLock &) const
+{
+    return !m_internal->activeCount && !m_internal->requests.availableToRead();
+}
+
+void OneShotNode::process(ContextRenderLock & r, size_t framesToProcess)
+{
+    AudioBus * destination = output(0)->bus(r);
+    ASSERT(destination);
+
+    Internals & internal = *m_internal;
+    const float sampleRate = r.context()->sampleRate();
+    const int64_t quantumStart = static_cast<int64_t>(r.context()->currentSampleFrame());
+    const int64_t quantumEnd = quantumStart + static_cast<int64_t>(framesToProcess);
+
+    Request request;
+    while (internal.requests.read(&request, 1))
+    {
+        if (request.type == RequestType::StopAll)
+        {
+            for (uint32_t i = 0; i < internal.voices.size(); ++i)
+                if (internal.voices[i].active)
+                    internal.finish(i);
+            internal.queuedStops.fetch_sub(1, std::memory_order_release);
+            continue;
+        }
+
+        Voice & voice = internal.voices[request.voice];
+        voice.bus = request.bus;
+        voice.startFrame = std::max(quantumStart, static_cast<int64_t>(std::llround(request.when * sampleRate)));
+        voice.readIndex = 0;
+        voice.gain = request.gain;
+        voice.playbackRate = request.playbackRate;
+        voice.active = true;
+        ++internal.activeCount;
+    }
+
+    destination->zero();
+
+    if (internal.activeCount)
+    {
+        for (uint32_t i = 0; i < internal.voices.size(); ++i)
+        {
+            Voice & voice = internal.voices[i];
+            if (!voice.active || voice.startFrame >= quantumEnd)
+                continue;
+
+            const size_t offset = static_cast<size_t>(std::max(int64_t(0), voice.startFrame - quantumStart));
+            const float busRate = voice.bus->sampleRate() > 0.f ? voice.bus->sampleRate() : sampleRate;
+            const double rate = voice.playbackRate * static_cast<double>(busRate) / sampleRate;
+
+            // Frames left in the bus at this rate, so that the last one read is inside it.
+            const double remaining = std::ceil((voice.bus->length() - voice.readIndex) / rate);
+            const size_t count = static_cast<size_t>(std::min(static_cast<double>(framesToProcess - offset), remaining));
+
+            if (!count || internal.render(voice, destination, offset, count, rate))
+                internal.finish(i);
+        }
+
+        destination->clearSilentFlag();
+    }
+
+    internal.publishedActiveCount.store(internal.activeCount, std::memory_order_relaxed);
+}
+
+void OneShotNode::reset(ContextRenderLock &)
+{
+    Internals & internal = *m_internal;
+    for (uint32_t i = 0; i < internal.voices.size(); ++i)
+        if (internal.voices[i].active)
+            internal.finish(i);
+
+    internal.publishedActiveCount.store(0, std::memory_order_relaxed);
+}
+
+} // namespace lab
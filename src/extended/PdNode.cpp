@@ -1,152 +1,364 @@
-
 // Copyright (c) 2003-2013 Nick Porcino, All rights reserved.
 // License is MIT: http://opensource.org/licenses/MIT
 
 #ifdef PD
 
-#include "LabSound.h"
-#include "PdNode.h"
+#include "LabSound/extended/PdNode.h"
+#include "LabSound/extended/AudioContextLock.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
 
-#include "AudioBus.h"
-#include "AudioNodeInput.h"
-#include "AudioNodeOutput.h"
-#include "AudioProcessor.h"
+#include "internal/Assertions.h"
 
-#include "PdBase.hpp"
 #include "z_libpd.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace lab {
 
-class PdNode::PdNodeInternal : public lab::AudioProcessor {
+namespace
+{
+    std::once_flag libpdInitialized;
+
+    void printHook(const char * message)
+    {
+        std::cout << message;
+    }
+}
+
+class PdNode::PdNodeInternal
+{
+
 public:
 
-    PdNodeInternal(float sampleRate)
-    : AudioProcessor(sampleRate)
-    , numChannels(2)
-    , pdBuffSize(128)
+    // The worker's hand-off. The audio thread fills the input and submits it, the worker
+    // renders it into the output and marks it rendered, and the audio thread plays it.
+    enum class Block : int { Empty, Submitted, Rendered };
+
+    PdNodeInternal(float sampleRate, unsigned inputChannels, unsigned outputChannels, bool runOnWorkerThread)
+    : inputChannels(inputChannels)
+    , outputChannels(outputChannels)
+    , sampleRate(sampleRate)
+    , inputBuffer(AudioNode::ProcessingSizeInFrames * std::max(1u, inputChannels))
+    , outputBuffer(AudioNode::ProcessingSizeInFrames * std::max(1u, outputChannels))
     {
+        std::call_once(libpdInitialized, []()
+        {
+            libpd_set_printhook(printHook);
+            libpd_init();
+        });
+
+        instance = libpd_new_instance();
+        if (instance)
+        {
+            libpd_set_instance(instance);
+            if (libpd_init_audio(inputChannels, outputChannels, static_cast<int>(sampleRate)) == 0)
+            {
+                // audio processing on
+                libpd_start_message(1);
+                libpd_add_float(1.0f);
+                libpd_finish_message("pd", "dsp");
+                blockSize = libpd_blocksize();
+            }
+        }
+
+        if (runOnWorkerThread && isInited())
+            worker = std::thread(&PdNodeInternal::workerEntry, this);
     }
-    
-    virtual ~PdNodeInternal() {
+
+    ~PdNodeInternal()
+    {
+        if (worker.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(workerMutex);
+                workerShouldExit = true;
+            }
+            workerCondition.notify_one();
+            worker.join();
+        }
+
+        if (instance)
+        {
+            std::lock_guard<std::mutex> lock(instanceMutex);
+            libpd_set_instance(instance);
+            if (patch)
+                libpd_closefile(patch);
+            libpd_free_instance(instance);
+        }
     }
 
-    // AudioProcessor interface
-    virtual void initialize() {
+    bool isInited() const { return instance && blockSize > 0; }
+
+    // Renders the interleaved input buffer into the interleaved output buffer. Must be called
+    // with instanceMutex held.
+    void renderLocked(size_t framesToProcess)
+    {
+        libpd_set_instance(instance);
+        libpd_process_float(static_cast<int>(framesToProcess / blockSize), inputBuffer.data(), outputBuffer.data());
     }
-    
-    virtual void uninitialize() { }
-    
-    // Processes the source to destination bus.  The number of channels must match in source and destination.
-    virtual void process(const lab::AudioBus* source, lab::AudioBus* destination, size_t framesToProcess) {
-        if (!numChannels)
+
+    void interleave(const AudioBus * source, size_t framesToProcess)
+    {
+        if (!inputChannels)
             return;
-        
-        int ticks = framesToProcess >> blockSizeAsLog; // this is a faster way of computing (inNumberFrames / blockSize)
-        const float* inData = source->channel(0)->data();
-        float* outData = destination->channel(0)->mutableData();
-        pd.processFloat(ticks, inData, outData);
+
+        const size_t channels = std::min(static_cast<size_t>(inputChannels), source ? source->numberOfChannels() : 0);
+        for (size_t c = 0; c < channels; ++c)
+        {
+            const float * in = source->channel(c)->data();
+            for (size_t i = 0; i < framesToProcess; ++i)
+                inputBuffer[i * inputChannels + c] = in[i];
+        }
+
+        for (size_t c = channels; c < inputChannels; ++c)
+            for (size_t i = 0; i < framesToProcess; ++i)
+                inputBuffer[i * inputChannels + c] = 0.f;
     }
-    
-    // Resets filter state
-    virtual void reset() { }
-    
-    virtual void setNumberOfChannels(unsigned i) {
-        numChannels = i;
+
+    void deinterleave(AudioBus * destination, size_t framesToProcess)
+    {
+        const size_t channels = std::min(static_cast<size_t>(outputChannels), destination->numberOfChannels());
+        for (size_t c = 0; c < channels; ++c)
+        {
+            float * out = destination->channel(c)->mutableData();
+            for (size_t i = 0; i < framesToProcess; ++i)
+                out[i] = outputBuffer[i * outputChannels + c];
+        }
+
+        for (size_t c = channels; c < destination->numberOfChannels(); ++c)
+            destination->channel(c)->zero();
     }
-    
-    virtual double tailTime() const { return 0; }
-    virtual double latencyTime() const { return 0; }
-    
-    // return true on successful initialization
-    bool initPure(const int numInChannels, const int numOutChannels,
-                  const int sampleRate, const int ticksPerBuffer);
-    
-    /// print
-    virtual void print(const std::string& message);
-    
-    pd::PdBase pd;
-    
-    int numChannels;
-    int pdBuffSize;
-    int blockSizeAsLog;
-};
 
-namespace {
-    //http://graphics.stanford.edu/~seander/bithacks.html#IntegerLogObvious
-    int log2int(int x) {
-        if (x < 1) {
-            return -1;
+    void workerEntry()
+    {
+        std::unique_lock<std::mutex> lock(workerMutex);
+        while (!workerShouldExit)
+        {
+            // The audio thread only try_locks to notify, so a missed notification is picked up by the timeout.
+            workerCondition.wait_for(lock, std::chrono::milliseconds(1), [this]()
+            {
+                return workerShouldExit || block.load(std::memory_order_acquire) == Block::Submitted;
+            });
+
+            if (workerShouldExit)
+                break;
+
+            if (block.load(std::memory_order_acquire) != Block::Submitted)
+                continue;
+
+            {
+                std::lock_guard<std::mutex> instanceLock(instanceMutex);
+                renderLocked(submittedFrames);
+            }
+            block.store(Block::Rendered, std::memory_order_release);
         }
-        int y = 1;
-        while (x >>= 1) {
-            ++y;
+    }
+
+    void process(const AudioBus * source, AudioBus * destination, size_t framesToProcess)
+    {
+        ASSERT(framesToProcess <= AudioNode::ProcessingSizeInFrames);
+        framesToProcess -= framesToProcess % blockSize;
+
+        if (!worker.joinable())
+        {
+            // Rendering on the audio thread; if a message is being sent, the patch skips a quantum rather than waiting.
+            std::unique_lock<std::mutex> instanceLock(instanceMutex, std::try_to_lock);
+            if (!instanceLock.owns_lock())
+            {
+                destination->zero();
+                return;
+            }
+
+            interleave(source, framesToProcess);
+            renderLocked(framesToProcess);
+            deinterleave(destination, framesToProcess);
+            return;
+        }
+
+        const Block state = block.load(std::memory_order_acquire);
+        if (state == Block::Submitted)
+        {
+            // Still rendering the previous quantum. Play silence, and drop this quantum's input.
+            lateQuanta.fetch_add(1, std::memory_order_relaxed);
+            destination->zero();
+            return;
+        }
+
+        if (state == Block::Rendered && submittedFrames == framesToProcess)
+            deinterleave(destination, framesToProcess);
+        else
+            destination->zero();
+
+        interleave(source, framesToProcess);
+        submittedFrames = framesToProcess;
+        block.store(Block::Submitted, std::memory_order_release);
+
+        if (workerMutex.try_lock())
+        {
+            workerCondition.notify_one();
+            workerMutex.unlock();
         }
-        return y;
     }
-} // anon
 
+    void reset()
+    {
+        // The patch keeps its state; only a rendered block that would now be stale is dropped.
+        Block rendered = Block::Rendered;
+        block.compare_exchange_strong(rendered, Block::Empty, std::memory_order_acq_rel);
+    }
 
-// return true on successful initialization
-bool PdNode::PdNodeInternal::initPure(const int numInChannels, const int numOutChannels,
-                                      const int sampleRate, const int ticksPerBuffer) {
-    
-    if (!pd.init(numInChannels, numOutChannels, sampleRate)) {
-        return false;
+    // Selects the instance for a message, and keeps it from rendering meanwhile.
+    std::unique_lock<std::mutex> select()
+    {
+        std::unique_lock<std::mutex> lock(instanceMutex);
+        libpd_set_instance(instance);
+        return lock;
     }
-    blockSizeAsLog = log2int(libpd_blocksize());
-    
-    // subscribe to receive source names
-    pd.subscribe("toOF");
-    pd.subscribe("env");
-    
-    // add the data/pd folder to the search path
-    pd.addToSearchPath("pd");
-    
-    // audio processing on
-    pd.computeAudio(true);
-    
-    return true;
+
+    const unsigned inputChannels;
+    const unsigned outputChannels;
+    const float sampleRate;
+
+    t_pdinstance * instance = nullptr;
+    void * patch = nullptr;
+    int blockSize = 0;
+
+    // Interleaved, as libpd expects them.
+    std::vector<float> inputBuffer;
+    std::vector<float> outputBuffer;
+
+    // Held while the instance renders or receives a message.
+    std::mutex instanceMutex;
+
+    std::thread worker;
+    std::mutex workerMutex;
+    std::condition_variable workerCondition;
+    bool workerShouldExit = false;
+    std::atomic<Block> block{ Block::Empty };
+    size_t submittedFrames = 0;
+    std::atomic<uint64_t> lateQuanta{ 0 };
+};
+
+PdNode::PdNode(float sampleRate, unsigned inputChannels, unsigned outputChannels, bool runOnWorkerThread)
+: data(new PdNodeInternal(sampleRate, inputChannels, outputChannels, runOnWorkerThread))
+{
+    addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+    addOutput(std::unique_ptr<AudioNodeOutput>(new AudioNodeOutput(this, std::max(1u, outputChannels))));
+
+    // The input is mixed to the number of channels the patch reads.
+    m_channelCount = std::max(1u, inputChannels);
+    m_channelCountMode = ChannelCountMode::Explicit;
+
+    initialize();
 }
 
-//--------------------------------------------------------------
-void PdNode::PdNodeInternal::print(const std::string& message) {
-    std::cout << message << std::endl;
+PdNode::~PdNode()
+{
+    uninitialize();
 }
 
-pd::PdBase& PdNode::pd() const {
-    return data->pd;
+void PdNode::process(ContextRenderLock & r, size_t framesToProcess)
+{
+    AudioBus * destination = output(0)->bus(r);
+    if (!isInitialized() || !data->isInited())
+    {
+        destination->zero();
+        return;
+    }
+
+    const AudioBus * source = input(0)->isConnected() ? input(0)->bus(r) : nullptr;
+    data->process(source, destination, framesToProcess);
 }
 
-PdNode::PdNode(lab::AudioContext* context, float sampleRate)
-: lab::AudioBasicProcessorNode(context, sampleRate)
-, data(new PdNodeInternal(sampleRate))
+void PdNode::reset(ContextRenderLock &)
 {
-    // Initially setup as lowpass filter.
-    m_processor = std::move(std::unique_ptr<lab::AudioProcessor>(data));
-    
-    setNodeType((AudioNode::NodeType) lab::NodeTypePd);
-    
-    addInput(adoptPtr(new lab::AudioNodeInput(this)));
-    addOutput(adoptPtr(new lab::AudioNodeOutput(this, 2))); // 2 stereo
-
-    data->initPure(2, 2, sampleRate, 128);
-    
-    initialize();
+    data->reset();
 }
 
-PdNode::~PdNode() {
-    data->numChannels = 0;  // ensure there if there is a latent callback pending, pd is not invoked
-    data = 0;
-    uninitialize();
+double PdNode::latencyTime(ContextRenderLock & r) const
+{
+    return data->worker.joinable() ? AudioNode::ProcessingSizeInFrames / static_cast<double>(data->sampleRate) : 0;
 }
 
-bool PdNode::propagatesSilence() const {
-    return !data->pd.isInited();
+bool PdNode::openPatch(const std::string & file, const std::string & directory)
+{
+    if (!data->instance)
+        return false;
+
+    auto lock = data->select();
+    if (data->patch)
+        libpd_closefile(data->patch);
+    data->patch = libpd_openfile(file.c_str(), directory.c_str());
+    return data->patch != nullptr;
 }
-    
-    
-} // LabSound
 
-#endif
+void PdNode::closePatch()
+{
+    if (!data->instance)
+        return;
+
+    auto lock = data->select();
+    if (data->patch)
+        libpd_closefile(data->patch);
+    data->patch = nullptr;
+}
+
+void PdNode::addToSearchPath(const std::string & path)
+{
+    if (!data->instance)
+        return;
+
+    auto lock = data->select();
+    libpd_add_to_search_path(path.c_str());
+}
+
+void PdNode::sendBang(const std::string & receiver)
+{
+    if (!data->instance)
+        return;
+
+    auto lock = data->select();
+    libpd_bang(receiver.c_str());
+}
+
+void PdNode::sendFloat(const std::string & receiver, float value)
+{
+    if (!data->instance)
+        return;
+
+    auto lock = data->select();
+    libpd_float(receiver.c_str(), value);
+}
+
+void PdNode::sendSymbol(const std::string & receiver, const std::string & symbol)
+{
+    if (!data->instance)
+        return;
+
+    auto lock = data->select();
+    libpd_symbol(receiver.c_str(), symbol.c_str());
+}
+
+bool PdNode::runsOnWorkerThread() const
+{
+    return data->worker.joinable();
+}
+
+uint64_t PdNode::lateQuantumCount() const
+{
+    return data->lateQuanta.load(std::memory_order_relaxed);
+}
+
+} // namespace lab
+
+#endif // PD
@@ -8,6 +8,11 @@
 
 #include "LabSound/extended/PowerMonitorNode.h"
 
+#include "internal/VectorMath.h"
+
+#include <algorithm>
+#include <cmath>
+
 namespace lab {
     
     using namespace lab;
@@ -45,35 +50,28 @@ namespace lab {
 
         // specific to this node
         {
-            std::vector<const float*> channels;
-            unsigned numberOfChannels = bus->numberOfChannels();
-            for (unsigned i = 0; i < numberOfChannels; ++i) {
-                channels.push_back(bus->channel(i)->data());
-            }
-
-            int start = framesToProcess - _windowSize;
-            int end = framesToProcess;
-            if (start < 0)
-                start = 0;
+            // The window is the last _windowSize frames of the quantum, or the whole quantum if it is shorter.
+            const size_t window = std::max(size_t(1), std::min(_windowSize.load(std::memory_order_relaxed), framesToProcess));
+            const size_t start = framesToProcess - window;
+            const size_t numberOfChannels = bus->numberOfChannels();
 
             float power = 0;
-            for (unsigned c = 0; c < numberOfChannels; ++c)
-                for (int i = start; i < end; ++i) {
-                    float p = channels[c][i];
-                    power += p * p;
-                }
-            float rms = sqrtf(power / (numberOfChannels * framesToProcess));
-            
-            // Protect against accidental overload due to bad values in input stream
-            const float kMinPower = 0.000125f;
-            if (isinf(power) || isnan(power) || power < kMinPower)
-                power = kMinPower;
-            
-            // db is 20 * log10(rms/Vref) where Vref is 1.0
-            _db = 20.0f * logf(rms) / logf(10.0f);
+            for (size_t c = 0; c < numberOfChannels; ++c)
+            {
+                float sum = 0;
+                VectorMath::vsvesq(bus->channel(c)->data() + start, 1, &sum, window);
+                power += sum;
+            }
+            const float meanSquare = power / (numberOfChannels * window);
+
+            // Protect against accidental overload due to bad values in input stream: the last good level is kept
+            // db is 20 * log10(rms/Vref) where Vref is 1.0, or 10 * log10 of the mean square
+            // Silence reads as -120 dB rather than -inf.
+            const float kMinMeanSquare = 1e-12f;
+            if (std::isfinite(meanSquare))
+                _db.store(10.0f * std::log10(std::max(meanSquare, kMinMeanSquare)), std::memory_order_relaxed);
         }
-        // to here
-        
+
         // For in-place processing, our override of pullInputs() will just pass the audio data
         // through unchanged if the channel count matches from input to output
         // (resulting in inputBus == outputBus). Otherwise, do an up-mix to stereo.
@@ -84,7 +82,7 @@ namespace lab {
     
     void PowerMonitorNode::reset(ContextRenderLock&)
     {
-        _db = 0;
+        _db.store(0, std::memory_order_relaxed);
     }
     
 } // namespace lab
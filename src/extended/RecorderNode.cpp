@@ -6,39 +6,269 @@
 #include "LabSound/core/AudioBus.h"
 
 #include "LabSound/extended/RecorderNode.h"
+#include "LabSound/extended/AudioContextLock.h"
+
+#include "internal/RingBuffer.h"
 
 #include "libnyquist/WavEncoder.h"
 
-namespace lab 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+namespace lab
 {
-    
+
     using namespace lab;
-    
-    RecorderNode::RecorderNode() : AudioBasicInspectorNode(2)
+
+    namespace
+    {
+        // Samples held between the audio thread and the writer thread. At 48kHz stereo this is
+        // roughly ten seconds of slack, far more than the writer's polling interval while recording.
+        const size_t RecorderRingCapacity = 1 << 20;
+
+        // Frames interleaved on the stack per ring write in process().
+        const size_t InterleaveBlockFrames = 32;
+        const size_t MaxRecordedChannels = 32;
+
+        const size_t DrainBlockSamples = 1 << 16;
+        const auto WriterPollInterval = std::chrono::milliseconds(10);
+
+        // Streams interleaved 32-bit float samples to a WAV file. The header is written as a placeholder and
+        // patched when the file is finalized. A JUNK chunk reserves room for the ds64 chunk so that recordings
+        // larger than 4GB can be promoted to RF64 in place. Samples are written in host order, which is
+        // little-endian on every platform LabSound supports.
+        class WavStreamWriter
+        {
+            FILE * m_file = nullptr;
+            uint64_t m_dataBytes = 0;
+
+            static const size_t HeaderSize = 94;
+
+            static uint8_t * put16(uint8_t * p, uint32_t v) { p[0] = v & 0xff; p[1] = (v >> 8) & 0xff; return p + 2; }
+            static uint8_t * put32(uint8_t * p, uint32_t v) { p = put16(p, v & 0xffff); return put16(p, v >> 16); }
+            static uint8_t * put64(uint8_t * p, uint64_t v) { p = put32(p, uint32_t(v & 0xffffffff)); return put32(p, uint32_t(v >> 32)); }
+            static uint8_t * putId(uint8_t * p, const char * id) { memcpy(p, id, 4); return p + 4; }
+
+            void writeHeader(uint32_t channels, uint32_t sampleRate)
+            {
+                const uint32_t bytesPerFrame = channels * sizeof(float);
+                const uint64_t frames = m_dataBytes / bytesPerFrame;
+                const uint64_t riffSize = HeaderSize - 8 + m_dataBytes;
+                const bool isRF64 = riffSize > 0xffffffffull;
+
+                uint8_t header[HeaderSize] = {};
+                uint8_t * p = header;
+
+                p = putId(p, isRF64 ? "RF64" : "RIFF");
+                p = put32(p, isRF64 ? 0xffffffff : uint32_t(riffSize));
+                p = putId(p, "WAVE");
+
+                p = putId(p, isRF64 ? "ds64" : "JUNK");
+                p = put32(p, 28);
+                p = put64(p, isRF64 ? riffSize : 0);
+                p = put64(p, isRF64 ? m_dataBytes : 0);
+                p = put64(p, isRF64 ? frames : 0);
+                p = put32(p, 0); // table length
+
+                p = putId(p, "fmt ");
+                p = put32(p, 18);
+                p = put16(p, 3); // WAVE_FORMAT_IEEE_FLOAT
+                p = put16(p, channels);
+                p = put32(p, sampleRate);
+                p = put32(p, sampleRate * bytesPerFrame);
+                p = put16(p, bytesPerFrame);
+                p = put16(p, 32);
+                p = put16(p, 0);
+
+                p = putId(p, "fact");
+                p = put32(p, 4);
+                p = put32(p, isRF64 ? 0xffffffff : uint32_t(frames));
+
+                p = putId(p, "data");
+                p = put32(p, isRF64 ? 0xffffffff : uint32_t(m_dataBytes));
+
+                rewind(m_file);
+                fwrite(header, 1, HeaderSize, m_file);
+            }
+
+        public:
+
+            ~WavStreamWriter() { if (m_file) fclose(m_file); }
+
+            bool isOpen() const { return m_file != nullptr; }
+
+            bool open(const std::string & path)
+            {
+                m_file = fopen(path.c_str(), "wb");
+                if (!m_file) return false;
+                m_dataBytes = 0;
+                writeHeader(1, 44100); // placeholder, rewritten by close()
+                return true;
+            }
+
+            void write(const float * samples, size_t count)
+            {
+                m_dataBytes += fwrite(samples, sizeof(float), count, m_file) * sizeof(float);
+            }
+
+            void close(uint32_t channels, uint32_t sampleRate)
+            {
+                if (!m_file) return;
+                writeHeader(channels ? channels : 1, sampleRate);
+                fclose(m_file);
+                m_file = nullptr;
+            }
+        };
+    }
+
+    class RecorderNode::RecorderNodeInternal
+    {
+    public:
+
+        RecorderNodeInternal() : ring(RecorderRingCapacity), scratch(DrainBlockSamples) { }
+
+        // Filled by the audio thread, drained by the writer thread or by whichever thread is
+        // collecting the recording. Drains are serialized by consumerMutex.
+        SPSCRingBuffer<float> ring;
+
+        std::mutex consumerMutex;
+        std::vector<float> scratch;
+        std::vector<float> data; // interleaved, in-memory recordings only
+        WavStreamWriter file;
+        std::atomic<bool> clearRequested{ false };
+
+        std::thread writerThread;
+        std::mutex wakeMutex;
+        std::condition_variable wake;
+        bool writerShouldRun = true;
+        bool writerActive = false; // while recording; otherwise the writer sleeps until woken
+
+        // Moves everything currently in the ring to its destination.
+        // Must be called with consumerMutex held.
+        void drain()
+        {
+            if (clearRequested.exchange(false))
+            {
+                ring.skip(ring.availableToRead());
+                data.clear();
+            }
+
+            while (size_t count = ring.read(scratch.data(), scratch.size()))
+            {
+                if (file.isOpen())
+                    file.write(scratch.data(), count);
+                else
+                    data.insert(data.end(), scratch.data(), scratch.data() + count);
+            }
+        }
+
+        void setWriterActive(bool active)
+        {
+            {
+                std::lock_guard<std::mutex> lock(wakeMutex);
+                writerActive = active;
+            }
+            wake.notify_all();
+        }
+
+        void writerLoop()
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            while (writerShouldRun)
+            {
+                // The audio thread doesn't lock to wake the writer, so the writer polls while recording.
+                if (writerActive)
+                    wake.wait_for(lock, WriterPollInterval);
+                else
+                    wake.wait(lock);
+
+                std::lock_guard<std::mutex> consumerLock(consumerMutex);
+                drain();
+            }
+        }
+    };
+
+    RecorderNode::RecorderNode() : AudioBasicInspectorNode(2), m_internal(new RecorderNodeInternal())
     {
         addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
         addOutput(std::unique_ptr<AudioNodeOutput>(new AudioNodeOutput(this, 2)));
 
+        m_internal->writerThread = std::thread(&RecorderNodeInternal::writerLoop, m_internal.get());
+
         initialize();
     }
-    
+
     RecorderNode::~RecorderNode()
     {
+        stopRecording();
+
+        {
+            std::lock_guard<std::mutex> lock(m_internal->wakeMutex);
+            m_internal->writerShouldRun = false;
+        }
+        m_internal->wake.notify_all();
+        m_internal->writerThread.join();
+
         uninitialize();
     }
-    
+
+    void RecorderNode::startRecording()
+    {
+        stopRecording();
+        m_recordingChannels = 0;
+        m_recording = true;
+        m_internal->setWriterActive(true);
+    }
+
+    bool RecorderNode::startRecordingToFile(const std::string & filenameWithWavExtension)
+    {
+        stopRecording();
+
+        {
+            std::lock_guard<std::mutex> lock(m_internal->consumerMutex);
+            m_internal->drain(); // anything still pending belongs to the previous, in-memory recording
+            if (!m_internal->file.open(filenameWithWavExtension))
+                return false;
+        }
+
+        m_recordingChannels = 0;
+        m_recording = true;
+        m_internal->setWriterActive(true);
+        return true;
+    }
+
+    void RecorderNode::stopRecording()
+    {
+        m_recording = false;
+
+        // A quantum the audio thread is already capturing is let finish, so that it is drained with the rest
+        // of the recording rather than left in the ring for the next.
+        while (m_capturing)
+            std::this_thread::yield();
+
+        m_internal->setWriterActive(false);
+
+        std::lock_guard<std::mutex> lock(m_internal->consumerMutex);
+        m_internal->drain();
+        m_internal->file.close(m_recordingChannels, static_cast<uint32_t>(m_sampleRate));
+    }
+
     void RecorderNode::getData(std::vector<float> & result)
     {
-        // swap is quick enough that process should not be adversely affected
         result.clear();
-        std::lock_guard<std::recursive_mutex> lock(m_mutex);
-        result.swap(m_data);
+        std::lock_guard<std::mutex> lock(m_internal->consumerMutex);
+        m_internal->drain();
+        result.swap(m_internal->data);
     }
 
     void RecorderNode::process(ContextRenderLock& r, size_t framesToProcess)
     {
         AudioBus* outputBus = output(0)->bus(r);
-        
+
         if (!isInitialized() || !input(0)->isConnected())
         {
             if (outputBus)
@@ -46,71 +276,81 @@ namespace lab
             return;
         }
 
-        // =====> should this follow the WebAudio pattern have a writer object to call here?
-        AudioBus* bus = input(0)->bus(r);        
+        AudioBus* bus = input(0)->bus(r);
         bool isBusGood = bus && (bus->numberOfChannels() > 0) && (bus->channel(0)->length() >= framesToProcess);
-        
+
         if (!isBusGood)
         {
             outputBus->zero();
             return;
         }
-        
+
+        // Announced before m_recording is checked, so that stopRecording() either sees this quantum in
+        // flight or this quantum sees the stop.
+        m_capturing = true;
+
         if (m_recording)
         {
-            std::vector<const float*> channels;
-            size_t numberOfChannels = bus->numberOfChannels();
-            
-            for (size_t i = 0; i < numberOfChannels; ++i)
+            const size_t numberOfChannels = std::min(bus->numberOfChannels(), MaxRecordedChannels);
+
+            // The stream's channel count is fixed by the first quantum so that every frame in the
+            // recording has the same width, even if the input's channel count changes later.
+            uint32_t recordedChannels = m_recordingChannels;
+            if (!recordedChannels)
             {
-                channels.push_back(bus->channel(i)->data());
+                recordedChannels = m_mixToMono ? 1 : static_cast<uint32_t>(numberOfChannels);
+                m_recordingChannels = recordedChannels;
             }
 
-            // mix down the output, or interleave the output
-            // use the tightest loop possible since this is part of the processing step
-            std::lock_guard<std::recursive_mutex> lock(m_mutex);
-            
-            m_data.reserve(framesToProcess * (m_mixToMono ? 1 : 2));
-            
-            if (m_mixToMono)
+            m_sampleRate = r.context()->sampleRate();
+
+            SPSCRingBuffer<float> & ring = m_internal->ring;
+
+            // Only whole quanta are written, so a full ring never leaves a partial frame behind.
+            if (ring.availableToWrite() < framesToProcess * recordedChannels)
             {
-                if (numberOfChannels == Channels::Mono)
-                {
-                    for (size_t i = 0; i < framesToProcess; ++i)
-                    {
-                        m_data.push_back(channels[0][i]);
-                    }
-                }
-                
-                else
+                m_droppedFrames += framesToProcess;
+            }
+            else
+            {
+                const float * channels[MaxRecordedChannels];
+                for (size_t c = 0; c < numberOfChannels; ++c)
+                    channels[c] = bus->channel(c)->data();
+
+                float interleaved[InterleaveBlockFrames * MaxRecordedChannels];
+                const float monoScale = 1.0f / float(numberOfChannels);
+
+                for (size_t offset = 0; offset < framesToProcess; offset += InterleaveBlockFrames)
                 {
-                    for (size_t i = 0; i < framesToProcess; ++i)
+                    const size_t frames = std::min(InterleaveBlockFrames, framesToProcess - offset);
+                    float * out = interleaved;
+
+                    if (recordedChannels == 1)
                     {
-                        float val = 0;
-                        for (unsigned int c = 0; c < numberOfChannels; ++ c)
+                        // mix down the output
+                        for (size_t i = offset; i < offset + frames; ++i)
                         {
-                            val += channels[c][i];
+                            float val = 0;
+                            for (size_t c = 0; c < numberOfChannels; ++c)
+                                val += channels[c][i];
+                            *out++ = val * monoScale;
                         }
-                        val *= 1.0f / float(numberOfChannels);
-                        m_data.push_back(val);
                     }
-                }
-
-            }
-            else
-            {
-                for (size_t i = 0; i < framesToProcess; ++i)
-                {
-                    for (unsigned int c = 0; c < numberOfChannels; ++ c)
+                    else
                     {
-                        m_data.push_back(channels[c][i]);
+                        // interleave the output, padding or dropping channels to match the stream
+                        for (size_t i = offset; i < offset + frames; ++i)
+                            for (size_t c = 0; c < recordedChannels; ++c)
+                                *out++ = c < numberOfChannels ? channels[c][i] : 0.f;
                     }
+
+                    ring.write(interleaved, frames * recordedChannels);
                 }
             }
-
         }
-        // <====== to here
-        
+
+        m_capturing = false;
+
         // For in-place processing, our override of pullInputs() will just pass the audio data
         // through unchanged if the channel count matches from input to output
         // (resulting in inputBus == outputBus). Otherwise, do an up-mix to stereo.
@@ -119,39 +359,32 @@ namespace lab
            outputBus->copyFrom(*bus);
         }
     }
-    
+
     void RecorderNode::writeRecordingToWav(int channels, const std::string & filenameWithWavExtension)
     {
         // Represents structure of underlying data
         std::unique_ptr<nqr::AudioData> fileData(new nqr::AudioData());
-        
-        {
-            std::lock_guard<std::recursive_mutex> lock(m_mutex);
-            fileData->samples.swap(m_data);
-        }
-        
+
+        getData(fileData->samples);
+
         fileData->channelCount = channels;
         fileData->sourceFormat = nqr::PCM_FLT;
-        fileData->sampleRate = 44100; // @tofix - hardcoded sample rate
-        
+        fileData->sampleRate = static_cast<int>(m_sampleRate);
+
         // fileData->... other file data not needed
-        
+
         // Represents target encoding (wav only)
         // Libnyquist bug with things other than PCM_FLT?
         nqr::EncoderParams params = {channels, nqr::PCM_FLT, nqr::DITHER_NONE};
 
         /*int encoderStatus =*/ nqr::WavEncoder::WriteFile(params, fileData.get(), filenameWithWavExtension);
     }
-    
+
     void RecorderNode::reset(ContextRenderLock& r)
     {
-        std::vector<float> clear;
-        {
-            std::lock_guard<std::recursive_mutex> lock(m_mutex);
-            m_data.swap(clear);
-        }
-        
-        // release the data in clear's destructor after the mutex has been released
+        // Called on the audio thread, which only produces into the ring; the next drain discards the
+        // pending samples and the in-memory recording.
+        m_internal->clearRequested = true;
     }
-                                           
+
 } // end namespace lab
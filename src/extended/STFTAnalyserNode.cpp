@@ -0,0 +1,388 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/STFTAnalyserNode.h"
+#include "LabSound/extended/AudioContextLock.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/Macros.h"
+
+#include "internal/FFTBackend.h"
+#include "internal/RingBuffer.h"
+#include "internal/VectorMath.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <string.h>
+#include <thread>
+
+namespace lab {
+
+namespace
+{
+    // A frame of the history. Its sequence is odd while the worker writes frame (sequence - 1) / 2 into it, and
+    // even once frame sequence / 2 - 1 is complete, so a reader can tell whether its copy is whole. The values are
+    // relaxed atomics, so that reading while the worker writes is well defined, if useless.
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence{ 0 };
+        std::atomic<uint64_t> position{ 0 };
+        std::atomic<float> sampleRate{ 0 };
+        std::unique_ptr<std::atomic<float>[]> magnitude;
+        std::unique_ptr<std::atomic<float>[]> phase;
+    };
+}
+
+struct STFTAnalyserNode::Internals
+{
+    Internals(size_t fftSize, size_t windowSize, size_t hopSize, WindowType windowType, size_t historyLength, size_t channelCount)
+    : fftSize(fftSize)
+    , windowSize(windowSize)
+    , hopSize(hopSize)
+    , historyLength(historyLength)
+    , channelCount(channelCount)
+    , binCount(fftSize / 2 + 1)
+    , plan(FFTPlan::forSize(fftSize))
+    , window(windowSize, 1.f)
+    , slots(historyLength + 2)
+    {
+        applyWindow(windowType, window);
+
+        // Scaled by the window's gain, so that magnitudes read as amplitudes.
+        double sum = 0;
+        for (float w : window)
+            sum += w;
+        scale = sum > 0 ? static_cast<float>(1.0 / sum) : 1.f;
+
+        for (size_t c = 0; c < channelCount; ++c)
+        {
+            rings.emplace_back(new SPSCRingBuffer<float>(windowSize * 4 + 16384));
+            buffers.emplace_back(windowSize, 0.f);
+        }
+
+        fftInput.assign(fftSize, 0.f);
+        real.resize(fftSize / 2);
+        imag.resize(fftSize / 2);
+        zeros.assign(AudioNode::ProcessingSizeInFrames, 0.f);
+
+        for (Slot & slot : slots)
+        {
+            slot.magnitude.reset(new std::atomic<float>[channelCount * binCount]);
+            slot.phase.reset(new std::atomic<float>[channelCount * binCount]);
+        }
+
+        // Without a plan, for an FFT size that isn't a power of two, the node only passes its input through.
+        if (plan)
+            worker = std::thread(&Internals::workerEntry, this);
+    }
+
+    ~Internals()
+    {
+        if (!worker.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(workerMutex);
+            workerShouldExit = true;
+        }
+        workerCondition.notify_one();
+        worker.join();
+    }
+
+    // Input frames needed before the next frame can be analysed.
+    size_t needed() const { return filled < windowSize ? windowSize - filled : hopSize; }
+
+    void workerEntry()
+    {
+        std::unique_lock<std::mutex> lock(workerMutex);
+        while (!workerShouldExit)
+        {
+            // The audio thread only try_locks to notify, so a missed notification is picked up by the timeout, which
+            // is about a hop, the least time between frames.
+            const float rate = sampleRate.load(std::memory_order_relaxed);
+            const auto hop = std::chrono::microseconds(rate > 0 ? static_cast<int64_t>(hopSize * 1e6 / rate) : 10000);
+            workerCondition.wait_for(lock, std::max(hop, std::chrono::microseconds(1000)), [this]()
+            {
+                return workerShouldExit || rings.back()->availableToRead() >= needed();
+            });
+
+            if (workerShouldExit)
+                break;
+
+            // The mutex only guards the wait, and is released while analysing so the audio thread can notify.
+            lock.unlock();
+
+            for (;;)
+            {
+                // A reset discards the window before anything is read into it, so that what is needed is counted afresh.
+                if (resetRequested.exchange(false, std::memory_order_acquire))
+                    filled = 0;
+
+                if (filled == windowSize)
+                {
+                    for (auto & buffer : buffers)
+                        memmove(buffer.data(), buffer.data() + hopSize, (windowSize - hopSize) * sizeof(float));
+                    filled -= hopSize;
+                }
+
+                // The last channel is written last, so every ring holds at least as much as it does.
+                const size_t count = needed();
+                if (rings.back()->availableToRead() < count)
+                    break;
+
+                bool complete = true;
+                for (size_t c = 0; c < channelCount; ++c)
+                    complete = rings[c]->read(buffers[c].data() + filled, count) == count && complete;
+
+                // A short read would leave the channels out of step in the window; start a new one rather than
+                // analyse it.
+                if (!complete)
+                {
+                    filled = 0;
+                    break;
+                }
+
+                filled += count;
+                consumed += count;
+
+                analyse();
+            }
+
+            lock.lock();
+        }
+    }
+
+    void analyse()
+    {
+        const uint64_t index = framesWritten.load(std::memory_order_relaxed);
+        Slot & slot = slots[index % slots.size()];
+
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.position.store(consumed - windowSize, std::memory_order_relaxed);
+        slot.sampleRate.store(sampleRate.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+        const size_t half = fftSize / 2;
+        for (size_t c = 0; c < channelCount; ++c)
+        {
+            // The tail of the FFT input past the window stays zero.
+            VectorMath::vmul(buffers[c].data(), 1, window.data(), 1, fftInput.data(), 1, windowSize);
+            plan->forward(fftInput.data(), real.data(), imag.data());
+
+            std::atomic<float> * magnitude = slot.magnitude.get() + c * binCount;
+            std::atomic<float> * phase = slot.phase.get() + c * binCount;
+
+            // DC and Nyquist are real, and packed into real[0] and imag[0].
+            magnitude[0].store(std::abs(real[0]) * scale, std::memory_order_relaxed);
+            phase[0].store(real[0] < 0 ? piFloat : 0.f, std::memory_order_relaxed);
+            magnitude[half].store(std::abs(imag[0]) * scale, std::memory_order_relaxed);
+            phase[half].store(imag[0] < 0 ? piFloat : 0.f, std::memory_order_relaxed);
+
+            const float binScale = 2.f * scale;
+            for (size_t i = 1; i < half; ++i)
+            {
+                magnitude[i].store(std::sqrt(real[i] * real[i] + imag[i] * imag[i]) * binScale, std::memory_order_relaxed);
+                phase[i].store(std::atan2(imag[i], real[i]), std::memory_order_relaxed);
+            }
+        }
+
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+        framesWritten.store(index + 1, std::memory_order_release);
+    }
+
+    // Returns false if the frame is no longer, or not yet, in the history.
+    bool copy(uint64_t index, STFTFrame & frame) const
+    {
+        const Slot & slot = slots[index % slots.size()];
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2)
+            return false;
+
+        const size_t count = channelCount * binCount;
+        frame.magnitude.resize(count);
+        frame.phase.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            frame.magnitude[i] = slot.magnitude[i].load(std::memory_order_relaxed);
+            frame.phase[i] = slot.phase[i].load(std::memory_order_relaxed);
+        }
+
+        frame.index = index;
+        frame.position = slot.position.load(std::memory_order_relaxed);
+        frame.sampleRate = slot.sampleRate.load(std::memory_order_relaxed);
+        frame.channelCount = channelCount;
+        frame.binCount = binCount;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == sequence;
+    }
+
+    const size_t fftSize;
+    const size_t windowSize;
+    const size_t hopSize;
+    const size_t historyLength;
+    const size_t channelCount;
+    const size_t binCount;
+
+    const FFTPlan * plan;
+    std::vector<float> window;
+    float scale = 1.f;
+
+    // Audio thread to worker.
+    std::vector<std::unique_ptr<SPSCRingBuffer<float>>> rings;
+    std::vector<float> zeros;
+    std::atomic<float> sampleRate{ 0 };
+    std::atomic<bool> resetRequested{ false };
+    std::atomic<uint64_t> dropped{ 0 };
+
+    // Worker.
+    std::vector<std::vector<float>> buffers;
+    size_t filled = 0;
+    uint64_t consumed = 0;
+    std::vector<float> fftInput;
+    std::vector<float> real;
+    std::vector<float> imag;
+
+    std::thread worker;
+    std::mutex workerMutex;
+    std::condition_variable workerCondition;
+    bool workerShouldExit = false;
+
+    // Worker to readers. The history has two slots to spare, so that the frames a reader asks for are rarely the
+    // ones being overwritten.
+    std::vector<Slot> slots;
+    std::atomic<uint64_t> framesWritten{ 0 };
+};
+
+STFTAnalyserNode::STFTAnalyserNode(size_t fftSize, size_t windowSize, size_t hopSize, WindowType window, size_t historyLength, size_t channelCount)
+: AudioBasicInspectorNode(2)
+{
+    windowSize = windowSize ? std::min(windowSize, fftSize) : fftSize;
+    hopSize = hopSize ? std::min(hopSize, windowSize) : std::max(size_t(1), windowSize / 4);
+
+    m_internal.reset(new Internals(fftSize, windowSize, hopSize, window, std::max(size_t(1), historyLength), std::max(size_t(1), channelCount)));
+}
+
+STFTAnalyserNode::~STFTAnalyserNode()
+{
+    uninitialize();
+}
+
+void STFTAnalyserNode::process(ContextRenderLock & r, size_t framesToProcess)
+{
+    AudioBus * outputBus = output(0)->bus(r);
+
+    if (!isInitialized() || !input(0)->isConnected())
+    {
+        if (outputBus)
+            outputBus->zero();
+        return;
+    }
+
+    // Usually in place: pullInputs() renders the input straight into the output when their channel counts match.
+    AudioBus * bus = input(0)->bus(r);
+    if (bus != outputBus)
+        outputBus->copyFrom(*bus);
+
+    Internals & internal = *m_internal;
+    if (!internal.plan)
+        return;
+
+    internal.sampleRate.store(r.context()->sampleRate(), std::memory_order_relaxed);
+
+    // All channels or none, so that the rings stay in step. Only this thread writes, so the space can only grow.
+    bool fits = true;
+    for (auto & ring : internal.rings)
+        fits = fits && ring->availableToWrite() >= framesToProcess;
+
+    if (fits)
+    {
+        const size_t channels = std::min(bus->numberOfChannels(), internal.channelCount);
+        for (size_t c = 0; c < internal.channelCount; ++c)
+        {
+            if (c < channels)
+            {
+                internal.rings[c]->write(bus->channel(c)->data(), framesToProcess);
+                continue;
+            }
+
+            for (size_t offset = 0; offset < framesToProcess; offset += internal.zeros.size())
+                internal.rings[c]->write(internal.zeros.data(), std::min(internal.zeros.size(), framesToProcess - offset));
+        }
+
+        if (internal.rings.back()->availableToRead() >= internal.hopSize && internal.workerMutex.try_lock())
+        {
+            internal.workerCondition.notify_one();
+            internal.workerMutex.unlock();
+        }
+    }
+    else
+        internal.dropped.fetch_add(framesToProcess, std::memory_order_relaxed);
+}
+
+void STFTAnalyserNode::reset(ContextRenderLock &)
+{
+    m_internal->resetRequested.store(true, std::memory_order_release);
+}
+
+size_t STFTAnalyserNode::fftSize() const { return m_internal->fftSize; }
+size_t STFTAnalyserNode::windowSize() const { return m_internal->windowSize; }
+size_t STFTAnalyserNode::hopSize() const { return m_internal->hopSize; }
+size_t STFTAnalyserNode::historyLength() const { return m_internal->historyLength; }
+size_t STFTAnalyserNode::channelCount() const { return m_internal->channelCount; }
+
+uint64_t STFTAnalyserNode::frameCount() const
+{
+    return m_internal->framesWritten.load(std::memory_order_acquire);
+}
+
+size_t STFTAnalyserNode::readFrames(std::vector<STFTFrame> & frames, uint64_t firstIndex) const
+{
+    const uint64_t count = m_internal->framesWritten.load(std::memory_order_acquire);
+    const uint64_t history = m_internal->historyLength;
+    const uint64_t first = std::max(firstIndex, count > history ? count - history : 0);
+
+    if (first >= count)
+    {
+        frames.clear();
+        return 0;
+    }
+
+    frames.resize(static_cast<size_t>(count - first));
+
+    size_t copied = 0;
+    for (uint64_t index = first; index < count; ++index)
+        if (m_internal->copy(index, frames[copied]))
+            ++copied;
+
+    frames.resize(copied);
+    return copied;
+}
+
+bool STFTAnalyserNode::readLatestFrame(STFTFrame & frame) const
+{
+    // Retried while the worker laps the reader, which only happens if it is preempted for a whole history.
+    for (;;)
+    {
+        const uint64_t count = m_internal->framesWritten.load(std::memory_order_acquire);
+        if (!count)
+            return false;
+        if (m_internal->copy(count - 1, frame))
+            return true;
+    }
+}
+
+uint64_t STFTAnalyserNode::droppedInputCount() const
+{
+    return m_internal->dropped.load(std::memory_order_relaxed);
+}
+
+} // namespace lab
@@ -0,0 +1,536 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/SampleCache.h"
+#include "LabSound/extended/AudioFileReader.h"
+
+#include "LabSound/core/AudioBus.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace lab {
+
+namespace
+{
+    // The disk cache's file format: this header, then each channel's samples in turn. The samples start 64 bytes
+    // in, so that they are aligned for SIMD.
+    struct PCMHeader
+    {
+        char magic[8];
+        uint64_t contentHash;
+        uint64_t contentSize;
+        uint32_t channelCount;
+        uint32_t mixToMono;
+        uint64_t length;
+        float sampleRate;           // of the samples
+        float requestedSampleRate;  // as passed to load()
+        uint8_t reserved[16];
+    };
+    static_assert(sizeof(PCMHeader) == 64, "the samples must start 64 bytes into the file");
+
+    const char PCMMagic[8] = { 'L', 'S', 'P', 'C', 'M', '0', '0', '1' };
+
+    // A 64 bit hash of a file's contents, a word at a time. It only needs to tell files apart, not resist attack;
+    // the content size is part of the key besides.
+    uint64_t hashContents(const uint8_t * data, size_t size)
+    {
+        const uint64_t Multiplier = 0x9E3779B97F4A7C15ull;
+        uint64_t hash = 0xCBF29CE484222325ull ^ size;
+
+        auto mix = [&](uint64_t word)
+        {
+            word *= Multiplier;
+            word ^= word >> 29;
+            hash = (hash ^ word) * 0xBF58476D1CE4E5B9ull;
+            hash ^= hash >> 32;
+        };
+
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            mix(word);
+        }
+
+        uint64_t tail = 0;
+        memcpy(&tail, data + i, size - i);
+        mix(tail);
+
+        hash ^= hash >> 31;
+        return hash * Multiplier;
+    }
+
+    std::string extensionOf(const std::string & path)
+    {
+        const size_t dot = path.find_last_of('.');
+        const size_t slash = path.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            return std::string();
+
+        std::string extension = path.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return extension;
+    }
+
+    bool fileSignature(const std::string & path, uint64_t & size, int64_t & modified)
+    {
+#if defined(_WIN32)
+        struct _stat64 info;
+        if (_stat64(path.c_str(), &info) != 0)
+            return false;
+#else
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+            return false;
+#endif
+        size = static_cast<uint64_t>(info.st_size);
+        modified = static_cast<int64_t>(info.st_mtime);
+        return true;
+    }
+
+    bool readFile(const std::string & path, std::vector<uint8_t> & contents)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+            return false;
+
+        const std::streamoff size = file.tellg();
+        if (size <= 0)
+            return false;
+
+        contents.resize(static_cast<size_t>(size));
+        file.seekg(0);
+        return !!file.read(reinterpret_cast<char *>(contents.data()), size);
+    }
+
+    // A read-only file mapped copy-on-write, so that a careless write to a bus can't reach the file.
+    class MappedFile
+    {
+    public:
+
+        static std::shared_ptr<MappedFile> open(const std::string & path)
+        {
+            std::shared_ptr<MappedFile> mapped(new MappedFile());
+#if defined(_WIN32)
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                return nullptr;
+
+            LARGE_INTEGER size;
+            HANDLE mapping = nullptr;
+            if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+                mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+            CloseHandle(file);
+            if (!mapping)
+                return nullptr;
+
+            mapped->m_data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+            CloseHandle(mapping);
+            mapped->m_size = static_cast<size_t>(size.QuadPart);
+#else
+            const int file = ::open(path.c_str(), O_RDONLY);
+            if (file < 0)
+                return nullptr;
+
+            struct stat info;
+            void * data = MAP_FAILED;
+            if (fstat(file, &info) == 0 && info.st_size > 0)
+                data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+            ::close(file);
+            if (data == MAP_FAILED)
+                return nullptr;
+
+            mapped->m_data = data;
+            mapped->m_size = static_cast<size_t>(info.st_size);
+#endif
+            return mapped->m_data ? mapped : nullptr;
+        }
+
+        ~MappedFile()
+        {
+            if (!m_data)
+                return;
+#if defined(_WIN32)
+            UnmapViewOfFile(m_data);
+#else
+            munmap(m_data, m_size);
+#endif
+        }
+
+        uint8_t * data() const { return static_cast<uint8_t *>(m_data); }
+        size_t size() const { return m_size; }
+
+    private:
+
+        MappedFile() = default;
+
+        void * m_data = nullptr;
+        size_t m_size = 0;
+    };
+
+    size_t busBytes(const AudioBus & bus)
+    {
+        return bus.numberOfChannels() * bus.length() * sizeof(float);
+    }
+}
+
+struct SampleCache::Internals
+{
+    // What a load decodes to: the contents of a file, in a given form.
+    struct Key
+    {
+        uint64_t contentHash;
+        uint64_t contentSize;
+        bool mixToMono;
+        float sampleRate;
+
+        std::string name() const
+        {
+            char name[64];
+            snprintf(name, sizeof(name), "%016llx-%llx-%s-%u", static_cast<unsigned long long>(contentHash),
+                     static_cast<unsigned long long>(contentSize), mixToMono ? "mono" : "all", static_cast<unsigned>(sampleRate));
+            return name;
+        }
+    };
+
+    struct Entry
+    {
+        std::shared_ptr<AudioBus> bus;  // while within the budget
+        std::weak_ptr<AudioBus> alive;  // for as long as anyone holds the bus
+        size_t bytes = 0;
+        std::list<std::string>::iterator recent;
+    };
+
+    // A path seen before, so that an unchanged file isn't read again just to hash it.
+    struct PathRecord
+    {
+        uint64_t size;
+        int64_t modified;
+        std::string key;
+    };
+
+    Internals(size_t budget, const std::string & directory) : budget(budget), directory(directory)
+    {
+        if (this->directory.empty())
+            return;
+
+        const char last = this->directory.back();
+        if (last != '/' && last != '\\')
+            this->directory += '/';
+
+#if defined(_WIN32)
+        _mkdir(this->directory.c_str());
+#else
+        mkdir(this->directory.c_str(), 0755);
+#endif
+    }
+
+    // Must be called with mutex held.
+    std::shared_ptr<AudioBus> find(const std::string & key)
+    {
+        auto it = entries.find(key);
+        if (it == entries.end())
+            return nullptr;
+
+        Entry & entry = it->second;
+        std::shared_ptr<AudioBus> bus = entry.bus ? entry.bus : entry.alive.lock();
+        if (!bus)
+        {
+            recent.erase(entry.recent);
+            entries.erase(it);
+            return nullptr;
+        }
+
+        if (!entry.bus)
+        {
+            entry.bus = bus;
+            resident += entry.bytes;
+        }
+
+        recent.splice(recent.begin(), recent, entry.recent);
+        trim();
+        return bus;
+    }
+
+    // Must be called with mutex held. Returns the bus already cached under key, if another thread got there first.
+    std::shared_ptr<AudioBus> insert(const std::string & key, std::shared_ptr<AudioBus> bus)
+    {
+        if (std::shared_ptr<AudioBus> existing = find(key))
+            return existing;
+
+        Entry & entry = entries[key];
+        entry.bus = bus;
+        entry.alive = bus;
+        entry.bytes = busBytes(*bus);
+        entry.recent = recent.insert(recent.begin(), key);
+        resident += entry.bytes;
+
+        trim();
+        forgetFreed();
+        return bus;
+    }
+
+    // Must be called with mutex held. Evicts least recently used entries until the cache fits its budget, although
+    // the most recent is always kept. Evicted entries are remembered for as long as their buses are alive.
+    void trim()
+    {
+        for (auto it = recent.rbegin(); resident > budget && std::next(it) != recent.rend(); ++it)
+        {
+            Entry & entry = entries[*it];
+            if (!entry.bus)
+                continue;
+
+            entry.bus.reset();
+            resident -= entry.bytes;
+            ++stats.evictions;
+        }
+    }
+
+    // Must be called with mutex held. Forgets evicted entries whose buses have since been freed.
+    void forgetFreed()
+    {
+        for (auto it = recent.begin(); it != recent.end(); )
+        {
+            auto entry = entries.find(*it);
+            if (!entry->second.bus && entry->second.alive.expired())
+            {
+                entries.erase(entry);
+                it = recent.erase(it);
+            }
+            else
+                ++it;
+        }
+    }
+
+    std::string cachePath(const std::string & key) const { return directory + key + ".pcm"; }
+
+    std::shared_ptr<AudioBus> mapFromDisk(const Key & key, const std::string & path) const
+    {
+        std::shared_ptr<MappedFile> mapped = MappedFile::open(path);
+        if (!mapped || mapped->size() < sizeof(PCMHeader))
+            return nullptr;
+
+        PCMHeader header;
+        memcpy(&header, mapped->data(), sizeof(header));
+
+        const bool valid = !memcmp(header.magic, PCMMagic, sizeof(PCMMagic))
+            && header.contentHash == key.contentHash && header.contentSize == key.contentSize
+            && header.channelCount > 0 && header.length > 0
+            && mapped->size() == sizeof(PCMHeader) + header.channelCount * header.length * sizeof(float);
+        if (!valid)
+            return nullptr;
+
+        // The bus refers to the mapping, which it keeps alive.
+        const size_t length = static_cast<size_t>(header.length);
+        AudioBus * bus = new AudioBus(header.channelCount, length, false);
+        float * samples = reinterpret_cast<float *>(mapped->data() + sizeof(PCMHeader));
+        for (size_t c = 0; c < header.channelCount; ++c)
+            bus->setChannelMemory(c, samples + c * length, length);
+        bus->setSampleRate(header.sampleRate);
+
+        return std::shared_ptr<AudioBus>(bus, [mapped](AudioBus * mappedBus) { delete mappedBus; });
+    }
+
+    // Written to a temporary file first, so that a reader never maps a partial file.
+    void writeToDisk(const Key & key, const AudioBus & bus) const
+    {
+        PCMHeader header = {};
+        memcpy(header.magic, PCMMagic, sizeof(PCMMagic));
+        header.contentHash = key.contentHash;
+        header.contentSize = key.contentSize;
+        header.channelCount = static_cast<uint32_t>(bus.numberOfChannels());
+        header.mixToMono = key.mixToMono ? 1 : 0;
+        header.length = bus.length();
+        header.sampleRate = bus.sampleRate();
+        header.requestedSampleRate = key.sampleRate;
+
+        const std::string path = cachePath(key.name());
+        const std::string temporary = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+        bool written = false;
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return;
+
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            for (size_t c = 0; c < bus.numberOfChannels(); ++c)
+                file.write(reinterpret_cast<const char *>(bus.channel(c)->data()), bus.length() * sizeof(float));
+            written = !!file;
+        }
+
+#if defined(_WIN32)
+        written = written && MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+        written = written && rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+        if (!written)
+            remove(temporary.c_str());
+    }
+
+    std::shared_ptr<AudioBus> decode(const std::vector<uint8_t> & contents, const std::string & path, bool mixToMono, float sampleRate) const
+    {
+        std::shared_ptr<AudioBus> bus = MakeBusFromMemory(contents, extensionOf(path), mixToMono);
+        if (!bus || !bus->length())
+            return nullptr;
+
+        if (sampleRate > 0 && bus->sampleRate() > 0 && bus->sampleRate() != sampleRate)
+        {
+            std::unique_ptr<AudioBus> converted = AudioBus::createBySampleRateConverting(bus.get(), false, sampleRate);
+            if (!converted)
+                return nullptr;
+            bus = std::move(converted);
+        }
+
+        return bus;
+    }
+
+    mutable std::mutex mutex;
+    size_t budget;
+    size_t resident = 0;
+    std::string directory;
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> recent; // most recently used first
+    std::unordered_map<std::string, PathRecord> paths;
+    Stats stats;
+};
+
+SampleCache::SampleCache(size_t memoryBudget, const std::string & diskCacheDirectory)
+: m_internal(new Internals(memoryBudget, diskCacheDirectory))
+{
+}
+
+SampleCache::~SampleCache()
+{
+}
+
+std::shared_ptr<AudioBus> SampleCache::load(const std::string & path, bool mixToMono, float sampleRate)
+{
+    Internals & internal = *m_internal;
+    const std::string pathKey = path + (mixToMono ? "|mono|" : "|all|") + std::to_string(static_cast<unsigned>(sampleRate));
+
+    uint64_t size = 0;
+    int64_t modified = 0;
+    if (!fileSignature(path, size, modified))
+        return nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(internal.mutex);
+        auto known = internal.paths.find(pathKey);
+        if (known != internal.paths.end() && known->second.size == size && known->second.modified == modified)
+        {
+            if (std::shared_ptr<AudioBus> bus = internal.find(known->second.key))
+            {
+                ++internal.stats.hits;
+                return bus;
+            }
+        }
+    }
+
+    // Hashing needs the contents, which a miss decodes anyway.
+    std::vector<uint8_t> contents;
+    if (!readFile(path, contents))
+        return nullptr;
+
+    Internals::Key key;
+    key.contentHash = hashContents(contents.data(), contents.size());
+    key.contentSize = contents.size();
+    key.mixToMono = mixToMono;
+    key.sampleRate = sampleRate;
+    const std::string name = key.name();
+
+    {
+        std::lock_guard<std::mutex> lock(internal.mutex);
+        internal.paths[pathKey] = { size, modified, name };
+        if (std::shared_ptr<AudioBus> bus = internal.find(name))
+        {
+            ++internal.stats.hits;
+            return bus;
+        }
+    }
+
+    // Decoding and file IO happen outside the lock; two threads loading the same sound may both decode it, but
+    // only the first result is kept.
+    std::shared_ptr<AudioBus> bus;
+    bool fromDisk = false;
+    if (!internal.directory.empty())
+    {
+        bus = internal.mapFromDisk(key, internal.cachePath(name));
+        fromDisk = !!bus;
+    }
+
+    if (!bus)
+    {
+        bus = internal.decode(contents, path, mixToMono, sampleRate);
+        if (!bus)
+            return nullptr;
+
+        if (!internal.directory.empty())
+            internal.writeToDisk(key, *bus);
+    }
+
+    std::lock_guard<std::mutex> lock(internal.mutex);
+    ++(fromDisk ? internal.stats.diskHits : internal.stats.misses);
+    return internal.insert(name, std::move(bus));
+}
+
+void SampleCache::setMemoryBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_internal->mutex);
+    m_internal->budget = bytes;
+    m_internal->trim();
+}
+
+size_t SampleCache::memoryBudget() const
+{
+    std::lock_guard<std::mutex> lock(m_internal->mutex);
+    return m_internal->budget;
+}
+
+void SampleCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_internal->mutex);
+    m_internal->entries.clear();
+    m_internal->recent.clear();
+    m_internal->paths.clear();
+    m_internal->resident = 0;
+}
+
+SampleCache::Stats SampleCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_internal->mutex);
+    Stats stats = m_internal->stats;
+    stats.residentBytes = m_internal->resident;
+    stats.entryCount = m_internal->entries.size();
+    return stats;
+}
+
+} // namespace lab
@@ -3,102 +3,457 @@
 
 #include "LabSound/core/PannerNode.h"
 #include "LabSound/core/FloatPoint3D.h"
+#include "LabSound/core/Macros.h"
 
 #include "LabSound/extended/SpatializationNode.h"
 #include "LabSound/extended/AudioContextLock.h"
 
+#include "internal/Cone.h"
+#include "internal/Distance.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
 namespace lab
 {
-    
-    namespace 
+
+    namespace
+    {
+        // The occluders in one leaf of the index are tested together.
+        const uint32_t MaxOccludersPerLeaf = 4;
+
+        // Deep enough for a hierarchy built by median splits over any number of occluders.
+        const size_t MaxTraversalDepth = 64;
+    }
+
+    // A bounding volume hierarchy over the occluders' outer spheres. The nodes are stored depth first, so a node's first
+    // child follows it; leaves refer to a run of occluders, which are stored as arrays in leaf order.
+    struct Occluders::Index
+    {
+        struct Node
+        {
+            float lower[3];
+            float upper[3];
+            uint32_t first;         // first occluder of a leaf
+            uint32_t count;         // occluders in a leaf, zero for an interior node
+            uint32_t secondChild;
+        };
+
+        std::vector<Node> nodes;
+        std::vector<float> x, y, z;
+        std::vector<float> innerRadius, outerRadius, maxAttenuation;
+
+        // Scratch space for building.
+        std::vector<Occluder> items;
+        std::vector<uint32_t> order;
+
+        bool dirty = true;
+
+        void reserve(size_t count)
+        {
+            nodes.reserve(count * 2);
+            for (auto v : { &x, &y, &z, &innerRadius, &outerRadius, &maxAttenuation })
+                v->reserve(count);
+            items.reserve(count);
+            order.reserve(count);
+        }
+
+        // Doesn't allocate if reserve() was called with at least as many occluders.
+        void build(const std::map<int, Occluder> & occluders)
+        {
+            nodes.clear();
+            for (auto v : { &x, &y, &z, &innerRadius, &outerRadius, &maxAttenuation })
+                v->clear();
+            items.clear();
+            order.clear();
+
+            for (const auto & i : occluders)
+            {
+                order.push_back(static_cast<uint32_t>(items.size()));
+                items.push_back(i.second);
+            }
+
+            if (!items.empty())
+                buildNode(0, static_cast<uint32_t>(items.size()));
+
+            dirty = false;
+        }
+
+        uint32_t buildNode(uint32_t begin, uint32_t end)
+        {
+            const uint32_t index = static_cast<uint32_t>(nodes.size());
+            nodes.push_back(Node());
+
+            float lower[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+            float upper[3] = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+            float centerLower[3] = { lower[0], lower[1], lower[2] };
+            float centerUpper[3] = { upper[0], upper[1], upper[2] };
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const Occluder & o = items[order[i]];
+                const float center[3] = { o.x, o.y, o.z };
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    lower[axis] = std::min(lower[axis], center[axis] - o.outerRadius);
+                    upper[axis] = std::max(upper[axis], center[axis] + o.outerRadius);
+                    centerLower[axis] = std::min(centerLower[axis], center[axis]);
+                    centerUpper[axis] = std::max(centerUpper[axis], center[axis]);
+                }
+            }
+
+            int axis = 0;
+            for (int i = 1; i < 3; ++i)
+                if (centerUpper[i] - centerLower[i] > centerUpper[axis] - centerLower[axis])
+                    axis = i;
+
+            uint32_t first = 0;
+            uint32_t count = 0;
+            uint32_t secondChild = 0;
+            if (end - begin <= MaxOccludersPerLeaf || centerUpper[axis] == centerLower[axis])
+            {
+                first = static_cast<uint32_t>(x.size());
+                count = end - begin;
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    const Occluder & o = items[order[i]];
+                    x.push_back(o.x);
+                    y.push_back(o.y);
+                    z.push_back(o.z);
+                    innerRadius.push_back(o.innerRadius);
+                    outerRadius.push_back(o.outerRadius);
+                    maxAttenuation.push_back(o.maxAttenuation);
+                }
+            }
+            else
+            {
+                const uint32_t middle = begin + (end - begin) / 2;
+                std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [this, axis](uint32_t a, uint32_t b)
+                {
+                    const Occluder & oa = items[a];
+                    const Occluder & ob = items[b];
+                    return (&oa.x)[axis] < (&ob.x)[axis];
+                });
+
+                buildNode(begin, middle);
+                secondChild = buildNode(middle, end);
+            }
+
+            Node & node = nodes[index];
+            std::copy(lower, lower + 3, node.lower);
+            std::copy(upper, upper + 3, node.upper);
+            node.first = first;
+            node.count = count;
+            node.secondChild = secondChild;
+            return index;
+        }
+
+        // Clips the segment from origin to origin + direction against the node's box.
+        static bool segmentIntersects(const Node & node, const float origin[3], const float direction[3])
+        {
+            float enter = 0.f;
+            float exit = 1.f;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                if (direction[axis] == 0.f)
+                {
+                    if (origin[axis] < node.lower[axis] || origin[axis] > node.upper[axis])
+                        return false;
+                    continue;
+                }
+
+                const float inverse = 1.f / direction[axis];
+                float t0 = (node.lower[axis] - origin[axis]) * inverse;
+                float t1 = (node.upper[axis] - origin[axis]) * inverse;
+                if (t0 > t1)
+                    std::swap(t0, t1);
+
+                enter = std::max(enter, t0);
+                exit = std::min(exit, t1);
+                if (enter > exit)
+                    return false;
+            }
+            return true;
+        }
+
+        float occlusion(const FloatPoint3D & sourcePos, const FloatPoint3D & listenerPos) const
+        {
+            const FloatPoint3D path = sourcePos - listenerPos;
+            const float pathLength2 = dot(path, path);
+            if (nodes.empty() || pathLength2 == 0.f)
+                return 1.f;
+
+            const float pathLength = std::sqrt(pathLength2);
+            const float origin[3] = { listenerPos.x, listenerPos.y, listenerPos.z };
+            const float direction[3] = { path.x, path.y, path.z };
+
+            float occlusionAttenuation = 1.0f;
+
+            uint32_t stack[MaxTraversalDepth];
+            size_t depth = 0;
+            stack[depth++] = 0;
+            while (depth)
+            {
+                const uint32_t index = stack[--depth];
+                const Node & node = nodes[index];
+                if (!segmentIntersects(node, origin, direction))
+                    continue;
+
+                if (!node.count)
+                {
+                    stack[depth++] = node.secondChild;
+                    stack[depth++] = index + 1;
+                    continue;
+                }
+
+                // http://mathworld.wolfram.com/Point-LineDistance3-Dimensional.html
+                for (uint32_t i = node.first; i < node.first + node.count; ++i)
+                {
+                    const FloatPoint3D occPos(x[i], y[i], z[i]);
+                    const FloatPoint3D x0x1 = occPos - listenerPos;
+                    const FloatPoint3D x0x2 = occPos - sourcePos;
+
+                    // Only occluders alongside the path, rather than behind the listener or beyond the source, occlude it.
+                    const float t = dot(x0x1, path) / pathLength2;
+                    if (t <= 0 || t >= 1)
+                        continue;
+
+                    const float d = magnitude(cross(x0x1, x0x2)) / pathLength;
+                    const float maxAtten = maxAttenuation[i];
+                    const float inner = innerRadius[i];
+
+                    if (d <= inner)
+                    {
+                        occlusionAttenuation *= maxAtten;
+                    }
+                    else if (d <= outerRadius[i])
+                    {
+                        const float s = (d - inner) / (outerRadius[i] - inner);
+                        occlusionAttenuation *= maxAtten + (1.0f - maxAtten) * s;
+                    }
+                }
+            }
+
+            return occlusionAttenuation;
+        }
+    };
+
+    // The SpatializationNodes sharing the occluders, with their positions, orientations and gains as arrays in the same order.
+    // The arrays are sized as nodes are added, so that evaluating them doesn't allocate.
+    struct Occluders::EmitterBatch
     {
-        // http://mathworld.wolfram.com/Point-LineDistance3-Dimensional.html
-        float distanceFromPointToLine(const FloatPoint3D& x0, const FloatPoint3D& x1, const FloatPoint3D& x2, float& t)
+        std::vector<SpatializationNode *> nodes;
+        std::vector<float> x, y, z;
+        std::vector<float> orientationX, orientationY, orientationZ;
+        std::vector<float> distance, cosine, occlusion;
+
+        size_t evaluatedFrame = static_cast<size_t>(-1);
+
+        void resize()
         {
-            FloatPoint3D x2x1 = x2 - x1;
-            FloatPoint3D x1x0 = x1 - x0;
-            float l = magnitude(x2x1);
-            t = dot(-x1x0, x2x1) / (l * l);
-            
-            FloatPoint3D x0x1 = x0 - x1;
-            FloatPoint3D x0x2 = x0 - x2;
-            float d = magnitude(cross(x0x1, x0x2)) / magnitude(x2x1);
-            return d;
+            for (auto v : { &x, &y, &z, &orientationX, &orientationY, &orientationZ, &distance, &cosine, &occlusion })
+                v->resize(nodes.size());
         }
+    };
+
+    Occluders::Occluders() : m_index(new Index()), m_emitters(new EmitterBatch())
+    {
+    }
+
+    Occluders::~Occluders()
+    {
     }
-    
+
     void Occluders::setOccluder(int id, float x, float y, float z, float radius)
     {
         Occluder o(x, y, z, radius);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
         occluders[id] = o;
+        m_index->reserve(occluders.size());
+        m_index->dirty = true;
     }
-    
+
     void Occluders::removeOccluder(int id)
     {
+        std::lock_guard<std::mutex> lock(m_mutex);
         auto i = occluders.find(id);
         if (i != occluders.end())
+        {
             occluders.erase(i);
+            m_index->dirty = true;
+        }
+    }
+
+    void Occluders::updateIndex() const
+    {
+        if (m_index->dirty)
+            m_index->build(occluders);
     }
-    
+
     float Occluders::occlusion(const FloatPoint3D & sourcePos, const FloatPoint3D & listenerPos) const
     {
-        float occlusionAttenuation = 1.0f;
-        for (auto i : occluders)
-        {
-            FloatPoint3D occPos(i.second.x, i.second.y, i.second.z);
-            
-            float t;
-            float d = distanceFromPointToLine(occPos, listenerPos, sourcePos, t);
-            
-            if (t <= 0 || t >= 1)
-                continue;
-
-            //printf("param(%f), dist: %f\n", t, d);
-            float maxAtten = i.second.maxAttenuation;
-            
-            if (d <= i.second.innerRadius)
-            {
-                occlusionAttenuation *= maxAtten;
-            }
-            else if (d <= i.second.outerRadius)
-            {
-                float inner = i.second.innerRadius;
-                float t = (d - inner) / (i.second.outerRadius - inner);
-                occlusionAttenuation *= maxAtten + (1.0f - maxAtten) * t;
-            }
-        }
-        return occlusionAttenuation;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        updateIndex();
+        return m_index->occlusion(sourcePos, listenerPos);
+    }
+
+    void Occluders::occlusion(const float * sourceX, const float * sourceY, const float * sourceZ, size_t count,
+                              const FloatPoint3D & listenerPos, float * result) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        occlusionLocked(sourceX, sourceY, sourceZ, count, listenerPos, result);
+    }
+
+    void Occluders::occlusionLocked(const float * sourceX, const float * sourceY, const float * sourceZ, size_t count,
+                                    const FloatPoint3D & listenerPos, float * result) const
+    {
+        updateIndex();
+        for (size_t i = 0; i < count; ++i)
+            result[i] = m_index->occlusion(FloatPoint3D(sourceX[i], sourceY[i], sourceZ[i]), listenerPos);
+    }
+
+    void Occluders::addEmitter(SpatializationNode * node)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_emitters->nodes.push_back(node);
+        m_emitters->resize();
+        node->m_evaluatedFrame = static_cast<size_t>(-1);
+        node->m_hasEvaluatedGains = false;
+    }
+
+    void Occluders::removeEmitter(SpatializationNode * node)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto & nodes = m_emitters->nodes;
+        nodes.erase(std::remove(nodes.begin(), nodes.end(), node), nodes.end());
+        m_emitters->resize();
     }
-    
+
     // @tofix - pass in HRTF loader path
     SpatializationNode::SpatializationNode(const float sampleRate) : lab::PannerNode(sampleRate)
     {
         initialize();
     }
-    
+
+    SpatializationNode::~SpatializationNode()
+    {
+        if (occluders)
+            occluders->removeEmitter(this);
+    }
+
     void SpatializationNode::setOccluders(std::shared_ptr<Occluders> o)
     {
+        if (o == occluders)
+            return;
+
+        if (occluders)
+            occluders->removeEmitter(this);
+
         occluders = o;
+
+        if (occluders)
+            occluders->addEmitter(this);
+    }
+
+    void SpatializationNode::evaluateEmitters(ContextRenderLock & r, Occluders & occluders, size_t frame)
+    {
+        Occluders::EmitterBatch & batch = *occluders.m_emitters;
+        batch.evaluatedFrame = frame;
+
+        const size_t count = batch.nodes.size();
+        if (!count)
+            return;
+
+        AudioListener & listener = r.context()->listener();
+
+        const FloatPoint3D listenerPosition = {
+            listener.positionX()->value(r),
+            listener.positionY()->value(r),
+            listener.positionZ()->value(r) };
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            SpatializationNode * node = batch.nodes[i];
+            batch.x[i] = node->positionX()->value(r);
+            batch.y[i] = node->positionY()->value(r);
+            batch.z[i] = node->positionZ()->value(r);
+            batch.orientationX[i] = node->orientationX()->value(r);
+            batch.orientationY[i] = node->orientationY()->value(r);
+            batch.orientationZ[i] = node->orientationZ()->value(r);
+        }
+
+        // The distance to the listener, and the cosine of the angle between each source's orientation and its direction
+        // to the listener, for every source at once. Written over the arrays so that the compiler can vectorize it.
+        {
+            const float * x = batch.x.data();
+            const float * y = batch.y.data();
+            const float * z = batch.z.data();
+            const float * ox = batch.orientationX.data();
+            const float * oy = batch.orientationY.data();
+            const float * oz = batch.orientationZ.data();
+            float * distance = batch.distance.data();
+            float * cosine = batch.cosine.data();
+            const float lx = listenerPosition.x;
+            const float ly = listenerPosition.y;
+            const float lz = listenerPosition.z;
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                const float dx = lx - x[i];
+                const float dy = ly - y[i];
+                const float dz = lz - z[i];
+                const float d = std::sqrt(dx * dx + dy * dy + dz * dz);
+                const float o = std::sqrt(ox[i] * ox[i] + oy[i] * oy[i] + oz[i] * oz[i]);
+                const float scale = d * o > 0.f ? 1.f / (d * o) : 0.f;
+                distance[i] = d;
+                cosine[i] = std::min(1.f, std::max(-1.f, (dx * ox[i] + dy * oy[i] + dz * oz[i]) * scale));
+            }
+        }
+
+        occluders.occlusionLocked(batch.x.data(), batch.y.data(), batch.z.data(), count, listenerPosition, batch.occlusion.data());
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            SpatializationNode * node = batch.nodes[i];
+
+            const FloatPoint3D orientation(batch.orientationX[i], batch.orientationY[i], batch.orientationZ[i]);
+            double coneGain = 1.0;
+            if (!is_zero(orientation) && !node->m_coneEffect->isOmnidirectional())
+                coneGain = node->m_coneEffect->gain(180.0 * std::acos(static_cast<double>(batch.cosine[i])) / piDouble);
+
+            node->m_evaluatedFrame = frame;
+            node->m_hasEvaluatedGains = true;
+            node->m_evaluatedDistanceGain = static_cast<float>(node->m_distanceEffect->gain(batch.distance[i]));
+            node->m_evaluatedConeGain = static_cast<float>(coneGain);
+            node->m_evaluatedOcclusion = batch.occlusion[i];
+        }
     }
-    
+
     float SpatializationNode::distanceConeGain(ContextRenderLock & r)
     {
         if (!r.context())
             return 1.f;
-        
-        AudioListener & listener = r.context()->listener();
 
-        FloatPoint3D fwd = {
-            listener.forwardX()->value(r),
-            listener.forwardY()->value(r),
-            listener.forwardZ()->value(r) };
+        if (!occluders)
+            return PannerNode::distanceConeGain(r);
+
+        const size_t frame = r.context()->currentSampleFrame();
+        if (m_evaluatedFrame != frame)
+        {
+            // If the occluders are being edited, the gains of the previous quantum are used rather than waiting.
+            std::unique_lock<std::mutex> lock(occluders->m_mutex, std::try_to_lock);
+            if (lock.owns_lock() && occluders->m_emitters->evaluatedFrame != frame)
+                evaluateEmitters(r, *occluders, frame);
+        }
 
-        FloatPoint3D pos = {
-            positionX()->value(r),
-            positionY()->value(r),
-            positionZ()->value(r) };
+        // Not yet evaluated, because the occluders were being edited when this node first played.
+        if (!m_hasEvaluatedGains)
+            return PannerNode::distanceConeGain(r);
 
-        float occlusionAttenuation = occluders ? occluders->occlusion(pos, fwd) : 1.0f;
-        return occlusionAttenuation * PannerNode::distanceConeGain(r);
+        m_distanceGain->setValue(m_evaluatedDistanceGain);
+        m_coneGain->setValue(m_evaluatedConeGain);
+        return m_evaluatedOcclusion * m_evaluatedDistanceGain * m_evaluatedConeGain;
     }
 }
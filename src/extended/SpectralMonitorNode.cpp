@@ -9,7 +9,8 @@
 
 #include "LabSound/extended/SpectralMonitorNode.h"
 
-#include <ooura/fftsg.h>
+#include "internal/FFTBackend.h"
+
 #include <cmath>
 
 namespace lab 
@@ -17,52 +18,19 @@ namespace lab
 
     using namespace lab;
 
-    //////////////////////////////////////////////////////
-    // Prviate FFT + SpectralMonitorNode Implementation //
-    //////////////////////////////////////////////////////
-
-    // FFT class directly inspired by that in Cinder Audio 2.
-    struct FFT 
-    {
-    public:
-        FFT(size_t size) : size(size)
-        {
-            oouraIp = (int *)calloc( 2 + (int)sqrt( size/2 ), sizeof( int ) );
-            oouraW = (float *)calloc( size/2, sizeof( float ) );
-        }
-
-        ~FFT()
-        {
-            free(oouraIp);
-            free(oouraW);
-        }
-
-        // does an in place transform of waveform to real and imag.
-        // real values are on even, imag on odd
-        void forward( std::vector<float>& waveform)
-        {
-            ooura::rdft( size, 1, &waveform[0], oouraIp, oouraW );
-        }
-
-        size_t size;
-        int * oouraIp;
-        float * oouraW;
-    };
+    ////////////////////////////////////////////////
+    // Private SpectralMonitorNode Implementation //
+    ////////////////////////////////////////////////
 
     class SpectralMonitorNode::SpectralMonitorNodeInternal 
     {
     public:
 
-        SpectralMonitorNodeInternal() : fft(0) 
+        SpectralMonitorNodeInternal()
         {
             setWindowSize(512);
         }
 
-        ~SpectralMonitorNodeInternal() 
-        {
-            delete fft;
-        }
-
         void setWindowSize(int s) 
         {
             cursor = 0;
@@ -75,8 +43,7 @@ namespace lab
                 buffer[i] = 0;
             }
 
-            delete fft;
-            fft = new FFT(s);
+            fft = FFTPlan::forSize(s);
         }
         
         float _db;
@@ -87,7 +54,7 @@ namespace lab
         std::vector<float> buffer;
         std::recursive_mutex magMutex;
 
-        FFT * fft;
+        const FFTPlan * fft = nullptr;
     };
 
     ////////////////////////////////
@@ -145,10 +112,9 @@ namespace lab
                 framesToProcess = internalNode->windowSize - internalNode->cursor;
 
             {
+                // The buffer is sized by setWindowSize, never here, so that rendering doesn't allocate.
                 std::lock_guard<std::recursive_mutex> lock(internalNode->magMutex);
 
-                internalNode->buffer.resize(internalNode->windowSize);
-
                 for (size_t i = 0; i < framesToProcess; ++i) 
                 {
                     internalNode->buffer[i + internalNode->cursor] = 0;
@@ -195,25 +161,34 @@ namespace lab
             internalNode->setWindowSize(internalNode->windowSize);
         }
 
+        // the window size must be a power of two
+        if (!internalNode->fft)
+        {
+            result.clear();
+            return;
+        }
+
         // http://www.ni.com/white-paper/4844/en/
         applyWindow(lab::window_blackman, window);
-        internalNode->fft->forward(window);
+
+        const size_t bins = window.size() / 2;
+        std::vector<float> imag(bins);
+        result.resize(bins);
+        internalNode->fft->forward(window.data(), result.data(), imag.data());
 
         // similar to cinder audio2 Scope object, although Scope smooths spectral samples frame by frame
-        // remove nyquist component - the first imaginary component
-        window[1] = 0.0f;
+        // remove nyquist component - packed into the first imaginary component
+        imag[0] = 0.0f;
 
         // compute normalized magnitude spectrum
-        // @tofix - break this into vector cartisian -> polar and then vector lowpass. skip lowpass if smoothing factor is very small
+        // @tofix - vector lowpass. skip lowpass if smoothing factor is very small
         const float kMagScale = 1.0f ;/// detail->windowSize;
-        for(size_t i = 0; i < window.size(); i += 2)
+        for (size_t i = 0; i < bins; ++i)
         {
-            float re = window[i];
-            float im = window[i+1];
-            window[i/2] = sqrt(re * re + im * im) * kMagScale;
+            float re = result[i];
+            float im = imag[i];
+            result[i] = sqrt(re * re + im * im) * kMagScale;
         }
-
-        result.swap(window);
     }
 
     void SpectralMonitorNode::windowSize(size_t ws) 
@@ -8,6 +8,7 @@
 namespace lab {
 
 struct AudioIOCallback;
+struct AudioDeviceConfiguration;
 
 // AudioDestination is an abstraction for audio hardware I/O.
 // The audio hardware periodically calls the AudioIOCallback render() method asking it to render/output the next render quantum of audio.
@@ -15,7 +16,7 @@ struct AudioIOCallback;
 struct AudioDestination
 {
     //@tofix - web audio puts the input initialization on the destination as well. I'm not sure that makes sense.
-    static AudioDestination * MakePlatformAudioDestination(AudioIOCallback &, unsigned numberOfOutputChannels, float sampleRate);
+    static AudioDestination * MakePlatformAudioDestination(AudioIOCallback &, unsigned numberOfOutputChannels, float sampleRate, const AudioDeviceConfiguration &);
 
     virtual ~AudioDestination() { }
 
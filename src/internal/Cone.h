@@ -18,6 +18,12 @@ public:
     // Returns scalar gain for the given source/listener positions/orientations
     double gain(FloatPoint3D sourcePosition, FloatPoint3D sourceOrientation, FloatPoint3D listenerPosition);
 
+    // Returns scalar gain for the angle in degrees between the source orientation and the source-listener vector
+    double gain(double angle) const;
+
+    // True if no cone is specified, in which case the gain is always one
+    bool isOmnidirectional() const { return (m_innerAngle == 360.0) && (m_outerAngle == 360.0); }
+
     // Angles in degrees
     void setInnerAngle(double innerAngle) { m_innerAngle = innerAngle; }
     double innerAngle() const { return m_innerAngle; }
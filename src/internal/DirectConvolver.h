@@ -15,15 +15,18 @@ class DirectConvolver
 
 public:
 
-    DirectConvolver(size_t inputBlockSize);
+    // Kernels may have up to maxKernelSize taps; zero means inputBlockSize. At most inputBlockSize frames are processed at a time.
+    DirectConvolver(size_t inputBlockSize, size_t maxKernelSize = 0);
 
     void process(AudioFloatArray* convolutionKernel, const float* sourceP, float* destP, size_t framesToProcess);
+    void process(const float* kernelP, size_t kernelSize, const float* sourceP, float* destP, size_t framesToProcess);
 
     void reset();
 
 private:
 
     size_t m_inputBlockSize;
+    size_t m_maxKernelSize;
     AudioFloatArray m_buffer;
 };
 
@@ -0,0 +1,57 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef FFTBackend_h
+#define FFTBackend_h
+
+#include <stddef.h>
+
+namespace lab
+{
+
+enum class FFTBackend
+{
+    KissFFT,    // scalar kissfft, kept as a reference
+    Vectorized, // in-tree split-format radix-2 transform using SSE, AVX or NEON where available
+};
+
+// A real FFT of one power-of-two size. Plans hold only twiddle and permutation tables, are immutable once
+// built, and are shared by every FFTFrame and thread using that size.
+//
+// Spectra are size() / 2 bins in split form, unscaled, with the Nyquist term packed into imag[0]:
+// real[0] is the DC term and imag[0] is the Nyquist term.
+class FFTPlan
+{
+public:
+
+    virtual ~FFTPlan() {}
+
+    size_t size() const { return m_size; }
+    FFTBackend backend() const { return m_backend; }
+
+    virtual void forward(const float* input, float* real, float* imag) const = 0;
+
+    // Scaled so that inverse(forward(x)) == x. The spectrum is used as scratch space and does not survive.
+    virtual void inverse(float* real, float* imag, float* output) const = 0;
+
+    // Returns the shared plan for fftSize, building it on first use. Lookups after that are lock-free.
+    // The plans live until the process exits.
+    static const FFTPlan* forSize(size_t fftSize);
+    static const FFTPlan* forSize(size_t fftSize, FFTBackend backend);
+
+protected:
+
+    FFTPlan(size_t size, FFTBackend backend) : m_size(size), m_backend(backend) {}
+
+    size_t m_size;
+    FFTBackend m_backend;
+};
+
+// Selects the backend used by plans requested from now on, so that the two implementations can be compared
+// in the same process. Frames that already exist keep the plan they were built with.
+void setFFTBackend(FFTBackend backend);
+FFTBackend fftBackend();
+
+} // namespace lab
+
+#endif // FFTBackend_h
@@ -22,10 +22,9 @@
 #include <Accelerate/Accelerate.h>
 #endif // !USE_ACCELERATE_FFT
 
-#if defined(WEBAUDIO_KISSFFT)
-#include <kissfft/kiss_fft.hpp>
-#include <kissfft/kiss_fftr.hpp>
-#endif // USE(WEBAUDIO_KISSFFT)
+#if !USE_ACCELERATE_FFT
+#include "internal/FFTBackend.h"
+#endif // !USE_ACCELERATE_FFT
 
 namespace lab 
 {
@@ -45,7 +44,7 @@ public:
     ~FFTFrame();
     
     void doFFT(const float* data);
-    void doInverseFFT(float* data);
+    void doInverseFFT(float* data); // the frequency-domain data does not survive the inverse transform
     void multiply(const FFTFrame& frame); // multiplies ourself with frame : effectively operator*=()
 
     float* realData() const;
@@ -90,19 +89,12 @@ private:
     AudioFloatArray m_realData;
     AudioFloatArray m_imagData;
 #else // !USE_ACCELERATE_FFT
-    
-#if defined(WEBAUDIO_KISSFFT)
-    kiss_fftr_cfg mFFT;
-    kiss_fftr_cfg mIFFT;
 
-    kiss_fft_cpx* m_cpxInputData;
-    kiss_fft_cpx* m_cpxOutputData;
-
-    std::vector<kiss_fft_cpx> mOutputBuffer; 
+    // Shared with every other frame of the same size; the frame itself holds only its spectrum.
+    const FFTPlan* m_plan;
 
     AudioFloatArray m_realData;
     AudioFloatArray m_imagData;
-#endif
 
 #endif // !USE_ACCELERATE_FFT
 };
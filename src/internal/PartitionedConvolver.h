@@ -0,0 +1,72 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef PartitionedConvolver_h
+#define PartitionedConvolver_h
+
+#include "LabSound/core/AudioArray.h"
+
+#include "internal/DirectConvolver.h"
+#include "internal/FFTFrame.h"
+
+#include <memory>
+#include <vector>
+
+namespace lab {
+
+class AudioChannel;
+class ContextRenderLock;
+
+// Zero-latency convolution with a non-uniformly partitioned impulse response.
+//
+// The first renderSliceSize taps are convolved directly. The rest of the response is split into levels
+// of equally sized partitions, the block size doubling from one level to the next until it reaches
+// maxFFTSize / 2. Each level keeps a frequency-domain delay line: an input block is transformed once and
+// its spectrum is reused by every partition of that level, so the per-block work is one forward FFT,
+// one inverse FFT, and a complex multiply-accumulate per partition. The multiply-accumulates for older
+// partitions are spread over the render quanta between a level's block boundaries to even out the load.
+//
+// Compared to ReverbConvolver this needs no per-stage delay lines or accumulation buffer the length of
+// the response, and does all of its work on the calling thread.
+class PartitionedConvolver
+{
+public:
+
+    // framesToProcess must always equal renderSliceSize. maxFFTSize is capped at 2048.
+    PartitionedConvolver(AudioChannel* impulseResponse, size_t renderSliceSize, size_t maxFFTSize);
+    ~PartitionedConvolver();
+
+    void process(ContextRenderLock& r, const AudioChannel* sourceChannel, AudioChannel* destinationChannel, size_t framesToProcess);
+    void process(const float* source, float* destination, size_t framesToProcess);
+    void reset();
+
+    size_t impulseResponseLength() const { return m_impulseResponseLength; }
+    size_t latencyFrames() const { return 0; }
+
+    // Bytes of sample and spectral data owned by the convolver.
+    size_t memoryFootprint() const;
+
+private:
+
+    struct Level;
+
+    void processLevel(Level& level, const float* source);
+
+    size_t m_impulseResponseLength;
+    size_t m_renderSliceSize;
+    uint64_t m_frameCount = 0;
+
+    // Leading taps, convolved directly.
+    AudioFloatArray m_headKernel;
+    DirectConvolver m_headConvolver;
+
+    std::vector<std::unique_ptr<Level>> m_levels;
+
+    // Level outputs are added in here at their offset into the response, and read back one quantum at a time.
+    AudioFloatArray m_output;
+    size_t m_outputMask;
+};
+
+} // namespace lab
+
+#endif // PartitionedConvolver_h
@@ -5,22 +5,31 @@
 #ifndef Reverb_h
 #define Reverb_h
 
-#include "internal/ReverbConvolver.h"
+#include "internal/PartitionedConvolver.h"
 
+#include <memory>
 #include <vector>
 
 namespace lab {
 
 class AudioBus;
     
-// Multi-channel convolution reverb with channel matrixing - one or more ReverbConvolver objects are used internally.
+// Multi-channel convolution reverb with channel matrixing - one or more PartitionedConvolver objects are used internally.
+//
+// Mono and stereo responses are applied per channel, and four-channel responses as "true" stereo
+// (L->L, L->R, R->L, R->R). A response with as many channels as the output, and more than two, is a
+// surround response: each output channel is its input channel convolved with the matching response
+// channel, or a mono downmix of the input if the channel counts differ.
 
 class Reverb {
 public:
     enum { MaxFrameSize = 256 };
 
-    // renderSliceSize is a rendering hint, so the FFTs can be optimized to not all occur at the same time (very bad when rendering on a real-time thread).
+    // renderSliceSize is the size of every process() call; the convolvers' finest partitions match it.
+    // With useBackgroundThreads, the independent convolutions of a long response are shared between the calling
+    // thread and helper threads, and are all complete when process() returns.
     Reverb(AudioBus* impulseResponseBuffer, size_t renderSliceSize, size_t maxFFTSize, size_t numberOfChannels, bool useBackgroundThreads, bool normalize);
+    ~Reverb();
 
     void process(ContextRenderLock& r, const AudioBus* sourceBus, AudioBus* destinationBus, size_t framesToProcess);
     void reset();
@@ -32,11 +41,31 @@ private:
 
     void initialize(AudioBus* impulseResponseBuffer, size_t renderSliceSize, size_t maxFFTSize, size_t numberOfChannels, bool useBackgroundThreads);
 
+    // One convolution for the current quantum. Paths write to distinct channels, so they can run concurrently.
+    struct Path
+    {
+        PartitionedConvolver* convolver;
+        const float* source;
+        float* destination;
+    };
+
+    void addPath(PartitionedConvolver* convolver, const AudioChannel* source, AudioChannel* destination);
+    void processPaths(size_t framesToProcess);
+
     size_t m_impulseResponseLength;
 
-    std::vector<std::unique_ptr<ReverbConvolver> > m_convolvers;
+    std::vector<std::unique_ptr<PartitionedConvolver> > m_convolvers;
+
+    // Rebuilt every quantum; reserved up front so that process() doesn't allocate.
+    std::vector<Path> m_paths;
+
+    struct Workers;
+    std::unique_ptr<Workers> m_workers;
+
+    // A mono response applied to stereo input needs a second convolver, since each one tracks a single stream.
+    std::unique_ptr<PartitionedConvolver> m_monoResponseRightConvolver;
 
-    // For "True" stereo processing
+    // For "True" stereo processing, or the mono downmix feeding a surround response
     std::unique_ptr<AudioBus> m_tempBuffer;
 };
 
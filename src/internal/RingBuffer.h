@@ -0,0 +1,101 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef RingBuffer_h
+#define RingBuffer_h
+
+#include "LabSound/core/AudioArray.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace lab {
+
+// SPSCRingBuffer is a fixed-capacity, lock-free queue for exactly one producer thread and one consumer thread.
+// It is intended for handing audio from the realtime thread to a background thread: write() and read() never
+// allocate, lock, or block, they simply transfer as many elements as currently fit.
+// Storage is allocated once in the constructor; the capacity is rounded up to a power of two.
+template<typename T>
+class SPSCRingBuffer
+{
+    SPSCRingBuffer(const SPSCRingBuffer&); // noncopyable
+
+public:
+
+    explicit SPSCRingBuffer(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+
+        m_buffer.allocate(size);
+        m_mask = size - 1;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+    // Producer side.
+    size_t availableToWrite() const
+    {
+        return capacity() - (m_writeIndex.load(std::memory_order_relaxed) - m_readIndex.load(std::memory_order_acquire));
+    }
+
+    // Copies up to count elements into the ring, returning the number that fit.
+    size_t write(const T* source, size_t count)
+    {
+        const size_t writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+        count = std::min(count, availableToWrite());
+
+        const size_t start = writeIndex & m_mask;
+        const size_t firstPart = std::min(count, capacity() - start);
+        memcpy(m_buffer.data() + start, source, sizeof(T) * firstPart);
+        memcpy(m_buffer.data(), source + firstPart, sizeof(T) * (count - firstPart));
+
+        m_writeIndex.store(writeIndex + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side.
+    size_t availableToRead() const
+    {
+        return m_writeIndex.load(std::memory_order_acquire) - m_readIndex.load(std::memory_order_relaxed);
+    }
+
+    // Copies up to count elements out of the ring, returning the number read.
+    size_t read(T* destination, size_t count)
+    {
+        const size_t readIndex = m_readIndex.load(std::memory_order_relaxed);
+        count = std::min(count, availableToRead());
+
+        const size_t start = readIndex & m_mask;
+        const size_t firstPart = std::min(count, capacity() - start);
+        memcpy(destination, m_buffer.data() + start, sizeof(T) * firstPart);
+        memcpy(destination + firstPart, m_buffer.data(), sizeof(T) * (count - firstPart));
+
+        m_readIndex.store(readIndex + count, std::memory_order_release);
+        return count;
+    }
+
+    // Discards up to count elements without copying them out.
+    size_t skip(size_t count)
+    {
+        const size_t readIndex = m_readIndex.load(std::memory_order_relaxed);
+        count = std::min(count, availableToRead());
+        m_readIndex.store(readIndex + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+
+    AudioArray<T> m_buffer;
+    size_t m_mask;
+
+    // Monotonic indices, wrapped with m_mask on access. Kept on separate cache lines so the producer and
+    // consumer don't invalidate each other's line on every update.
+    alignas(64) std::atomic<size_t> m_writeIndex{ 0 };
+    alignas(64) std::atomic<size_t> m_readIndex{ 0 };
+};
+
+} // namespace lab
+
+#endif // RingBuffer_h
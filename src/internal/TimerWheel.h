@@ -0,0 +1,161 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef TimerWheel_h
+#define TimerWheel_h
+
+#include <algorithm>
+#include <stdint.h>
+
+namespace lab {
+
+// TimerWheel is a hierarchical timing wheel of intrusive items, keyed by an integer tick.
+// Insertion is O(1) regardless of how far in the future an item is due; advancing costs O(1) per tick
+// plus an occasional cascade of a coarser slot into the finer levels.
+//
+// T must provide `T * next` and `uint64_t dueTick` members. The wheel doesn't own its items and
+// never allocates, so it is safe to drive from the audio thread. It is not thread-safe.
+template<typename T>
+class TimerWheel
+{
+    TimerWheel(const TimerWheel&); // noncopyable
+
+public:
+
+    enum { SlotBits = 8, SlotCount = 1 << SlotBits, SlotMask = SlotCount - 1, Levels = 4 };
+
+    TimerWheel()
+    {
+        for (int level = 0; level < Levels; ++level)
+            for (int slot = 0; slot < SlotCount; ++slot)
+                m_slots[level][slot] = List();
+    }
+
+    // The next tick that advance() will expire.
+    uint64_t now() const { return m_now; }
+
+    size_t size() const { return m_size; }
+
+    // Schedules item to expire at item->dueTick. Items that are already due expire on the next advance().
+    void insert(T * item)
+    {
+        item->dueTick = std::max(item->dueTick, m_now);
+        place(item);
+        ++m_size;
+    }
+
+    // Expires, in tick order, every item due up to and including tick, by calling expired(T*).
+    // An item may be re-inserted from within the callback.
+    template<typename F>
+    void advance(uint64_t tick, F && expired)
+    {
+        while (m_now <= tick)
+        {
+            if (!m_size)
+            {
+                m_now = tick + 1;
+                return;
+            }
+
+            // When a finer level wraps around, the matching slot of the next level is redistributed.
+            if (!(m_now & SlotMask))
+            {
+                for (int level = 1; level < Levels; ++level)
+                {
+                    const uint32_t index = (m_now >> (SlotBits * level)) & SlotMask;
+                    cascade(m_slots[level][index]);
+                    if (index)
+                        break;
+                }
+            }
+
+            List due = m_slots[0][m_now & SlotMask];
+            m_slots[0][m_now & SlotMask] = List();
+
+            const uint64_t current = m_now++;
+            for (T * item = due.head; item; )
+            {
+                T * next = item->next;
+                --m_size;
+
+                if (item->dueTick > current)
+                    insert(item); // placed by a clamped far-future key; not due yet
+                else
+                    expired(item);
+
+                item = next;
+            }
+        }
+    }
+
+    // Removes every item, calling release(T*) on each.
+    template<typename F>
+    void clear(F && release)
+    {
+        for (int level = 0; level < Levels; ++level)
+        {
+            for (int slot = 0; slot < SlotCount; ++slot)
+            {
+                for (T * item = m_slots[level][slot].head; item; )
+                {
+                    T * next = item->next;
+                    release(item);
+                    item = next;
+                }
+                m_slots[level][slot] = List();
+            }
+        }
+        m_size = 0;
+    }
+
+private:
+
+    struct List
+    {
+        T * head = nullptr;
+        T * tail = nullptr;
+
+        void append(T * item)
+        {
+            item->next = nullptr;
+            if (tail) tail->next = item;
+            else head = item;
+            tail = item;
+        }
+    };
+
+    void place(T * item)
+    {
+        const uint64_t range = uint64_t(1) << (SlotBits * Levels);
+
+        // Items beyond the span of the wheel are parked in the coarsest level and re-placed when they cascade.
+        const uint64_t key = std::min(item->dueTick, m_now + range - 1);
+        const uint64_t delta = key - m_now;
+
+        int level = 0;
+        while (level < Levels - 1 && delta >= (uint64_t(1) << (SlotBits * (level + 1))))
+            ++level;
+
+        m_slots[level][(key >> (SlotBits * level)) & SlotMask].append(item);
+    }
+
+    void cascade(List & list)
+    {
+        T * item = list.head;
+        list = List();
+        while (item)
+        {
+            T * next = item->next;
+            place(item);
+            item = next;
+        }
+    }
+
+    List m_slots[Levels][SlotCount];
+    uint64_t m_now = 0;
+    size_t m_size = 0;
+};
+
+} // namespace lab
+
+#endif // TimerWheel_h
@@ -0,0 +1,57 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#ifndef TripleBuffer_h
+#define TripleBuffer_h
+
+#include <atomic>
+#include <stdint.h>
+
+namespace lab {
+
+// Hands the latest value of T from one writer thread to one reader thread, without locks and without either
+// waiting on the other. The writer fills back(), then publish()es it; the reader calls update() and reads front(),
+// which stays put until the next update(). Values the reader never saw are simply replaced.
+template<typename T>
+class TripleBuffer
+{
+public:
+
+    TripleBuffer() = default;
+    explicit TripleBuffer(const T & initial) : m_slots{ initial, initial, initial } {}
+
+    // Writer side.
+    T & back() { return m_slots[m_back]; }
+
+    void publish()
+    {
+        const uint32_t previous = m_middle.exchange(m_back | Fresh, std::memory_order_acq_rel);
+        m_back = previous & IndexMask;
+    }
+
+    // Reader side. Returns true if front() changed.
+    bool update()
+    {
+        if (!(m_middle.load(std::memory_order_relaxed) & Fresh))
+            return false;
+
+        const uint32_t previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+        m_front = previous & IndexMask;
+        return true;
+    }
+
+    const T & front() const { return m_slots[m_front]; }
+
+private:
+
+    enum : uint32_t { IndexMask = 3, Fresh = 4 };
+
+    T m_slots[3];
+    uint32_t m_back = 0;                      // writer only
+    uint32_t m_front = 1;                     // reader only
+    std::atomic<uint32_t> m_middle{ 2 };      // shared: index of the middle slot, and whether it is fresh
+};
+
+} // namespace lab
+
+#endif // TripleBuffer_h
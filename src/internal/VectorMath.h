@@ -7,6 +7,7 @@
 
 
 #include <cstddef>
+#include <stdint.h>
 
 // Defines the interface for several vector math functions whose implementation will ideally be optimized.
 
@@ -34,9 +35,43 @@ void vmul(const float* source1P, int sourceStride1, const float* source2P, int s
 // Multiplies two complex vectors.
 void zvmul(const float* real1P, const float* imag1P, const float* real2P, const float* imag2P, float* realDestP, float* imagDestP, size_t framesToProcess);
 
+// Multiplies two complex vectors and adds the product to a third.
+void zvmac(const float* real1P, const float* imag1P, const float* real2P, const float* imag2P, float* realAccumP, float* imagAccumP, size_t framesToProcess);
+
+// Direct-form convolution: destP[i] = sum over j < kernelSize of kernelP[j] * sourceP[i - j].
+// The kernelSize - 1 samples before sourceP must be readable.
+void conv(const float* sourceP, const float* kernelP, float* destP, size_t framesToProcess, size_t kernelSize);
+
 // Copies elements while clipping values to the threshold inputs.
 void vclip(const float* sourceP, int sourceStride, const float* lowThresholdP, const float* highThresholdP, float* destP, int destStride, size_t framesToProcess);
 
+// Multiplies two vectors and adds the product to a third: destP[i] += source1P[i] * source2P[i].
+void vma(const float* source1P, const float* source2P, float* destP, size_t framesToProcess);
+
+// Sums sourceCount vectors into destP in a single pass over it, adding to its contents if accumulate is true.
+void vsum(const float* const* sourcePs, size_t sourceCount, float* destP, size_t framesToProcess, bool accumulate);
+
+// Sums sourceCount vectors into destP in a single pass, each scaled by its own exponential gain ramp. Frame i of
+// source k is scaled by targetGains[k] + (gains[k] - targetGains[k]) * ratio^i, which is how a one pole smoother
+// with coefficient 1 - ratio approaches its target, evaluated in closed form. On return gains holds each ramp's
+// value for the frame following the last one, so that the next call continues it.
+void vrampsum(const float* const* sourcePs, float* gains, const float* targetGains, size_t sourceCount, float ratio, float* destP, size_t framesToProcess, bool accumulate);
+
+// Multiplies a vector by one exponential gain ramp, as vrampsum does for a single source. sourceP may equal destP.
+void vrampmul(const float* sourceP, float* gain, float targetGain, float ratio, float* destP, size_t framesToProcess);
+
+// Generates a linear ramp: destP[i] = start + step * i.
+void vramp(float start, float step, float* destP, size_t framesToProcess);
+
+// Generates an exponential segment: destP[i] = offset + scale * ratio^i.
+void vgeom(float offset, float scale, float ratio, float* destP, size_t framesToProcess);
+
+// Converts 16 bit integers to floats: destP[i] = sourceP[i] * scale.
+void vs16tof(const int16_t* sourceP, float scale, float* destP, size_t framesToProcess);
+
+// Converts packed little-endian 24 bit integers, three bytes apiece, to floats: destP[i] = sample i * scale.
+void vs24tof(const uint8_t* sourceP, float scale, float* destP, size_t framesToProcess);
+
 } // namespace VectorMath
 
 } // namespace lab
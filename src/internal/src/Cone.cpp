@@ -16,7 +16,7 @@ ConeEffect::ConeEffect()
 
 double ConeEffect::gain(FloatPoint3D sourcePosition, FloatPoint3D sourceOrientation, FloatPoint3D listenerPosition)
 {
-    if (is_zero(sourceOrientation) || ((m_innerAngle == 360.0) && (m_outerAngle == 360.0)))
+    if (is_zero(sourceOrientation) || isOmnidirectional())
         return 1.0; // no cone specified - unity gain
 
     // Normalized source-listener vector
@@ -29,6 +29,11 @@ double ConeEffect::gain(FloatPoint3D sourcePosition, FloatPoint3D sourceOrientat
     // Angle between the source orientation vector and the source-listener vector
     double dotProduct = dot(sourceToListener, normalizedSourceOrientation);
     double angle = 180.0 * acos(dotProduct) / piDouble;
+    return gain(angle);
+}
+
+double ConeEffect::gain(double angle) const
+{
     double absAngle = fabs(angle);
 
     // Divide by 2.0 here since API is entire angle (not half-angle)
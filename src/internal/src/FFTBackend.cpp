@@ -0,0 +1,597 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/AudioArray.h"
+#include "LabSound/core/Macros.h"
+
+#include "internal/Assertions.h"
+#include "internal/FFTBackend.h"
+#include "internal/VectorMath.h"
+
+#include <kissfft/kiss_fft.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(ARM_NEON_INTRINSICS)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lab
+{
+
+namespace
+{
+
+const int MaxFFTPow2Size = 24;
+const int BackendCount = 2;
+
+// Just enough of a vector type for the transforms below. Without SIMD it degenerates to one float and the same
+// loops run as scalar code.
+#if defined(__AVX__)
+
+    typedef __m256 vfloat;
+    const size_t VectorWidth = 8;
+    inline vfloat vload(const float* p) { return _mm256_loadu_ps(p); }
+    inline void vstore(float* p, vfloat v) { _mm256_storeu_ps(p, v); }
+    inline vfloat vsplat(float x) { return _mm256_set1_ps(x); }
+    inline vfloat vadd(vfloat a, vfloat b) { return _mm256_add_ps(a, b); }
+    inline vfloat vsub(vfloat a, vfloat b) { return _mm256_sub_ps(a, b); }
+    inline vfloat vmul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+    inline vfloat vreverse(vfloat v)
+    {
+        v = _mm256_permute2f128_ps(v, v, 1);
+        return _mm256_permute_ps(v, _MM_SHUFFLE(0, 1, 2, 3));
+    }
+
+#elif defined(__SSE2__)
+
+    typedef __m128 vfloat;
+    const size_t VectorWidth = 4;
+    inline vfloat vload(const float* p) { return _mm_loadu_ps(p); }
+    inline void vstore(float* p, vfloat v) { _mm_storeu_ps(p, v); }
+    inline vfloat vsplat(float x) { return _mm_set1_ps(x); }
+    inline vfloat vadd(vfloat a, vfloat b) { return _mm_add_ps(a, b); }
+    inline vfloat vsub(vfloat a, vfloat b) { return _mm_sub_ps(a, b); }
+    inline vfloat vmul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+    inline vfloat vreverse(vfloat v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3)); }
+
+#elif defined(ARM_NEON_INTRINSICS)
+
+    typedef float32x4_t vfloat;
+    const size_t VectorWidth = 4;
+    inline vfloat vload(const float* p) { return vld1q_f32(p); }
+    inline void vstore(float* p, vfloat v) { vst1q_f32(p, v); }
+    inline vfloat vsplat(float x) { return vdupq_n_f32(x); }
+    inline vfloat vadd(vfloat a, vfloat b) { return vaddq_f32(a, b); }
+    inline vfloat vsub(vfloat a, vfloat b) { return vsubq_f32(a, b); }
+    inline vfloat vmul(vfloat a, vfloat b) { return vmulq_f32(a, b); }
+    inline vfloat vreverse(vfloat v)
+    {
+        v = vrev64q_f32(v);
+        return vcombine_f32(vget_high_f32(v), vget_low_f32(v));
+    }
+
+#else
+
+    typedef float vfloat;
+    const size_t VectorWidth = 1;
+    inline vfloat vload(const float* p) { return *p; }
+    inline void vstore(float* p, vfloat v) { *p = v; }
+    inline vfloat vsplat(float x) { return x; }
+    inline vfloat vadd(vfloat a, vfloat b) { return a + b; }
+    inline vfloat vsub(vfloat a, vfloat b) { return a - b; }
+    inline vfloat vmul(vfloat a, vfloat b) { return a * b; }
+    inline vfloat vreverse(vfloat v) { return v; }
+
+#endif
+
+// A real FFT of size N is computed as a complex FFT of size M = N / 2 over z[n] = x[2n] + i x[2n + 1].
+// The backends differ only in the complex transform; splitting its result into the real spectrum, and
+// merging a real spectrum back into a complex one for the inverse, is shared.
+class RealFFTPlan : public FFTPlan
+{
+public:
+
+    RealFFTPlan(size_t size, FFTBackend backend)
+        : FFTPlan(size, backend)
+        , m_cos(size / 4 + 1)
+        , m_sin(size / 4 + 1)
+    {
+        // W^k = exp(-2 pi i k / N) for the bins that are paired up below
+        for (size_t k = 0; k < m_cos.size(); ++k)
+        {
+            const double phase = twoPiDouble * double(k) / double(size);
+            m_cos[k] = static_cast<float>(cos(phase));
+            m_sin[k] = static_cast<float>(-sin(phase));
+        }
+    }
+
+protected:
+
+    // Turns Z = FFT(z), in place, into the first half of X = FFT(x), pairing bin k with bin M - k:
+    //   X[k] = E + W^k O  and  X[M - k] = conj(E - W^k O)
+    // where E = (Z[k] + conj(Z[M - k])) / 2 and O = (Z[k] - conj(Z[M - k])) / 2i.
+    void splitSpectrum(float* re, float* im) const
+    {
+        const size_t m = m_size / 2;
+        const size_t half = m / 2;
+        const float* wr = m_cos.data();
+        const float* wi = m_sin.data();
+
+        const float z0r = re[0];
+        const float z0i = im[0];
+
+        size_t k = 1;
+        const vfloat h = vsplat(0.5f);
+        for (; k + VectorWidth <= half; k += VectorWidth)
+        {
+            const size_t j = m - k - (VectorWidth - 1);
+            const vfloat ar = vload(re + k);
+            const vfloat ai = vload(im + k);
+            const vfloat br = vreverse(vload(re + j));
+            const vfloat bi = vreverse(vload(im + j)); // conj(Z[M - k]) has imaginary part -bi
+
+            const vfloat er = vmul(vadd(ar, br), h);
+            const vfloat ei = vmul(vsub(ai, bi), h);
+            const vfloat odr = vmul(vadd(ai, bi), h);
+            const vfloat odi = vmul(vsub(br, ar), h);
+
+            const vfloat c = vload(wr + k);
+            const vfloat s = vload(wi + k);
+            const vfloat tr = vsub(vmul(odr, c), vmul(odi, s));
+            const vfloat ti = vadd(vmul(odr, s), vmul(odi, c));
+
+            vstore(re + k, vadd(er, tr));
+            vstore(im + k, vadd(ei, ti));
+            vstore(re + j, vreverse(vsub(er, tr)));
+            vstore(im + j, vreverse(vsub(ti, ei)));
+        }
+
+        for (; k <= half; ++k)
+        {
+            const size_t j = m - k;
+            const float ar = re[k];
+            const float ai = im[k];
+            const float br = re[j];
+            const float bi = im[j];
+
+            const float er = (ar + br) * 0.5f;
+            const float ei = (ai - bi) * 0.5f;
+            const float odr = (ai + bi) * 0.5f;
+            const float odi = (br - ar) * 0.5f;
+
+            const float tr = odr * wr[k] - odi * wi[k];
+            const float ti = odr * wi[k] + odi * wr[k];
+
+            re[k] = er + tr;
+            im[k] = ei + ti;
+            re[j] = er - tr;
+            im[j] = ti - ei;
+        }
+
+        re[0] = z0r + z0i; // DC
+        im[0] = z0r - z0i; // Nyquist
+    }
+
+    // The inverse of splitSpectrum, without the factors of 1/2; the inverse transform scales by 1/N instead of 1/M.
+    //   Z[k] = E + i O  and  Z[M - k] = conj(E) + i conj(O)
+    // where E = X[k] + conj(X[M - k]) and O = (X[k] - conj(X[M - k])) conj(W^k).
+    void mergeSpectrum(float* re, float* im) const
+    {
+        const size_t m = m_size / 2;
+        const size_t half = m / 2;
+        const float* wr = m_cos.data();
+        const float* wi = m_sin.data();
+
+        const float dc = re[0];
+        const float nyquist = im[0];
+
+        size_t k = 1;
+        for (; k + VectorWidth <= half; k += VectorWidth)
+        {
+            const size_t j = m - k - (VectorWidth - 1);
+            const vfloat ar = vload(re + k);
+            const vfloat ai = vload(im + k);
+            const vfloat br = vreverse(vload(re + j));
+            const vfloat bi = vreverse(vload(im + j));
+
+            const vfloat er = vadd(ar, br);
+            const vfloat ei = vsub(ai, bi);
+            const vfloat dr = vsub(ar, br);
+            const vfloat di = vadd(ai, bi);
+
+            const vfloat c = vload(wr + k);
+            const vfloat s = vload(wi + k);
+            const vfloat odr = vadd(vmul(dr, c), vmul(di, s));
+            const vfloat odi = vsub(vmul(di, c), vmul(dr, s));
+
+            vstore(re + k, vsub(er, odi));
+            vstore(im + k, vadd(ei, odr));
+            vstore(re + j, vreverse(vadd(er, odi)));
+            vstore(im + j, vreverse(vsub(odr, ei)));
+        }
+
+        for (; k <= half; ++k)
+        {
+            const size_t j = m - k;
+            const float ar = re[k];
+            const float ai = im[k];
+            const float br = re[j];
+            const float bi = im[j];
+
+            const float er = ar + br;
+            const float ei = ai - bi;
+            const float dr = ar - br;
+            const float di = ai + bi;
+
+            const float odr = dr * wr[k] + di * wi[k];
+            const float odi = di * wr[k] - dr * wi[k];
+
+            re[k] = er - odi;
+            im[k] = ei + odr;
+            re[j] = er + odi;
+            im[j] = odr - ei;
+        }
+
+        re[0] = dc + nyquist;
+        im[0] = dc - nyquist;
+    }
+
+    AudioFloatArray m_cos;
+    AudioFloatArray m_sin;
+};
+
+// Radix-2 transform on split real and imaginary arrays. The forward transform is decimation in time: the input
+// is scattered into bit-reversed order while it is deinterleaved, and the stages leave the result in natural
+// order. The inverse runs the stages as decimation in frequency and gathers the bit-reversed result while
+// interleaving the output, so neither direction needs a separate permutation pass. Butterflies vectorize
+// across the contiguous half of each group once the groups are at least one vector wide.
+class VectorizedFFTPlan : public RealFFTPlan
+{
+public:
+
+    VectorizedFFTPlan(size_t size)
+        : RealFFTPlan(size, FFTBackend::Vectorized)
+        , m_twiddleReal(std::max<size_t>(size / 2, 1))
+        , m_twiddleImag(std::max<size_t>(size / 2, 1))
+        , m_bitReverse(size / 2)
+    {
+        const size_t m = size / 2;
+
+        // Twiddles for the stage with half-span h are exp(-i pi j / h) for j < h, stored contiguously from h - 1.
+        for (size_t h = 1; h < m; h <<= 1)
+        {
+            for (size_t j = 0; j < h; ++j)
+            {
+                const double phase = piDouble * double(j) / double(h);
+                m_twiddleReal[h - 1 + j] = static_cast<float>(cos(phase));
+                m_twiddleImag[h - 1 + j] = static_cast<float>(-sin(phase));
+            }
+        }
+
+        unsigned bits = 0;
+        while ((size_t(1) << bits) < m)
+            ++bits;
+
+        for (size_t n = 0; n < m; ++n)
+        {
+            uint32_t r = 0;
+            for (unsigned b = 0; b < bits; ++b)
+                r |= ((n >> b) & 1) << (bits - 1 - b);
+            m_bitReverse[n] = r;
+        }
+    }
+
+    virtual void forward(const float* input, float* re, float* im) const override
+    {
+        const size_t m = m_size / 2;
+        const uint32_t* rev = m_bitReverse.data();
+
+        for (size_t n = 0; n < m; ++n)
+        {
+            re[rev[n]] = input[2 * n];
+            im[rev[n]] = input[2 * n + 1];
+        }
+
+        for (size_t h = 1; h < m; h <<= 1)
+        {
+            const float* wr = m_twiddleReal.data() + h - 1;
+            const float* wi = m_twiddleImag.data() + h - 1;
+
+            for (size_t g = 0; g < m; g += 2 * h)
+            {
+                float* ar = re + g;
+                float* ai = im + g;
+                float* br = ar + h;
+                float* bi = ai + h;
+
+                size_t j = 0;
+                if (h >= VectorWidth)
+                {
+                    for (; j < h; j += VectorWidth)
+                    {
+                        const vfloat xr = vload(br + j);
+                        const vfloat xi = vload(bi + j);
+                        const vfloat cr = vload(wr + j);
+                        const vfloat ci = vload(wi + j);
+                        const vfloat tr = vsub(vmul(xr, cr), vmul(xi, ci));
+                        const vfloat ti = vadd(vmul(xr, ci), vmul(xi, cr));
+                        const vfloat yr = vload(ar + j);
+                        const vfloat yi = vload(ai + j);
+                        vstore(br + j, vsub(yr, tr));
+                        vstore(bi + j, vsub(yi, ti));
+                        vstore(ar + j, vadd(yr, tr));
+                        vstore(ai + j, vadd(yi, ti));
+                    }
+                }
+
+                for (; j < h; ++j)
+                {
+                    const float tr = br[j] * wr[j] - bi[j] * wi[j];
+                    const float ti = br[j] * wi[j] + bi[j] * wr[j];
+                    br[j] = ar[j] - tr;
+                    bi[j] = ai[j] - ti;
+                    ar[j] += tr;
+                    ai[j] += ti;
+                }
+            }
+        }
+
+        splitSpectrum(re, im);
+    }
+
+    virtual void inverse(float* re, float* im, float* output) const override
+    {
+        const size_t m = m_size / 2;
+
+        mergeSpectrum(re, im);
+
+        // The inverse transform is the forward transform with the real and imaginary parts exchanged on the way
+        // in and out, so the stages run with the arrays' roles swapped and the result lands back in re and im.
+        float* sr = im;
+        float* si = re;
+
+        for (size_t h = m / 2; h >= 1; h >>= 1)
+        {
+            const float* wr = m_twiddleReal.data() + h - 1;
+            const float* wi = m_twiddleImag.data() + h - 1;
+
+            for (size_t g = 0; g < m; g += 2 * h)
+            {
+                float* ar = sr + g;
+                float* ai = si + g;
+                float* br = ar + h;
+                float* bi = ai + h;
+
+                size_t j = 0;
+                if (h >= VectorWidth)
+                {
+                    for (; j < h; j += VectorWidth)
+                    {
+                        const vfloat yr = vload(ar + j);
+                        const vfloat yi = vload(ai + j);
+                        const vfloat xr = vload(br + j);
+                        const vfloat xi = vload(bi + j);
+                        const vfloat dr = vsub(yr, xr);
+                        const vfloat di = vsub(yi, xi);
+                        const vfloat cr = vload(wr + j);
+                        const vfloat ci = vload(wi + j);
+                        vstore(ar + j, vadd(yr, xr));
+                        vstore(ai + j, vadd(yi, xi));
+                        vstore(br + j, vsub(vmul(dr, cr), vmul(di, ci)));
+                        vstore(bi + j, vadd(vmul(dr, ci), vmul(di, cr)));
+                    }
+                }
+
+                for (; j < h; ++j)
+                {
+                    const float dr = ar[j] - br[j];
+                    const float di = ai[j] - bi[j];
+                    ar[j] += br[j];
+                    ai[j] += bi[j];
+                    br[j] = dr * wr[j] - di * wi[j];
+                    bi[j] = dr * wi[j] + di * wr[j];
+                }
+            }
+        }
+
+        const float scale = 1.0f / float(m_size);
+        const uint32_t* rev = m_bitReverse.data();
+        for (size_t n = 0; n < m; ++n)
+        {
+            output[2 * n] = re[rev[n]] * scale;
+            output[2 * n + 1] = im[rev[n]] * scale;
+        }
+    }
+
+private:
+
+    AudioFloatArray m_twiddleReal;
+    AudioFloatArray m_twiddleImag;
+    std::vector<uint32_t> m_bitReverse;
+};
+
+// kissfft's complex transform is stateless when run out of place, so its configurations can be shared. The
+// interleaved scratch it needs is allocated with the plan, as a few buffers that the threads transforming with
+// the plan at the same time claim in turn, so that no thread allocates on its first transform.
+class KissFFTPlan : public RealFFTPlan
+{
+public:
+
+    KissFFTPlan(size_t size)
+        : RealFFTPlan(size, FFTBackend::KissFFT)
+        , m_forward(kiss_fft_alloc(static_cast<int>(size / 2), 0, nullptr, nullptr))
+        , m_inverse(kiss_fft_alloc(static_cast<int>(size / 2), 1, nullptr, nullptr))
+    {
+        for (Scratch& scratch : m_scratch)
+            scratch.buffer.resize(size / 2);
+    }
+
+    virtual ~KissFFTPlan()
+    {
+        KISS_FFT_FREE(m_forward);
+        KISS_FFT_FREE(m_inverse);
+    }
+
+    virtual void forward(const float* input, float* re, float* im) const override
+    {
+        const size_t m = m_size / 2;
+        ScratchClaim claim(*this);
+        kiss_fft_cpx* scratch = claim.data();
+
+        kiss_fft(m_forward, reinterpret_cast<const kiss_fft_cpx*>(input), scratch);
+        VectorMath::vdeintlve(reinterpret_cast<const float*>(scratch), re, im, m_size);
+
+        splitSpectrum(re, im);
+    }
+
+    virtual void inverse(float* re, float* im, float* output) const override
+    {
+        const size_t m = m_size / 2;
+        ScratchClaim claim(*this);
+        kiss_fft_cpx* scratch = claim.data();
+
+        mergeSpectrum(re, im);
+        for (size_t k = 0; k < m; ++k)
+        {
+            scratch[k].r = re[k];
+            scratch[k].i = im[k];
+        }
+
+        kiss_fft(m_inverse, scratch, reinterpret_cast<kiss_fft_cpx*>(output));
+
+        const float scale = 1.0f / float(m_size);
+        VectorMath::vsmul(output, 1, &scale, output, 1, m_size);
+    }
+
+private:
+
+    // More threads than this transforming with one plan at once wait for a buffer to be released.
+    static const size_t ScratchCount = 4;
+
+    struct Scratch
+    {
+        std::vector<kiss_fft_cpx> buffer;
+        std::atomic<bool> claimed{ false };
+    };
+
+    class ScratchClaim
+    {
+    public:
+
+        explicit ScratchClaim(const KissFFTPlan& plan)
+        {
+            for (;;)
+            {
+                for (Scratch& scratch : plan.m_scratch)
+                {
+                    if (!scratch.claimed.load(std::memory_order_relaxed) && !scratch.claimed.exchange(true, std::memory_order_acquire))
+                    {
+                        m_scratch = &scratch;
+                        return;
+                    }
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        ~ScratchClaim() { m_scratch->claimed.store(false, std::memory_order_release); }
+
+        kiss_fft_cpx* data() const { return m_scratch->buffer.data(); }
+
+    private:
+
+        Scratch* m_scratch = nullptr;
+    };
+
+    kiss_fft_cfg m_forward;
+    kiss_fft_cfg m_inverse;
+    mutable Scratch m_scratch[ScratchCount];
+};
+
+struct PlanCache
+{
+    std::mutex buildMutex;
+    std::atomic<const FFTPlan*> plans[BackendCount][MaxFFTPow2Size + 1];
+    std::atomic<int> selectedBackend{ static_cast<int>(FFTBackend::Vectorized) };
+
+    PlanCache()
+    {
+        for (auto& backend : plans)
+            for (auto& plan : backend)
+                plan.store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~PlanCache()
+    {
+        for (auto& backend : plans)
+            for (auto& plan : backend)
+                delete plan.load(std::memory_order_relaxed);
+    }
+};
+
+PlanCache& planCache()
+{
+    static PlanCache cache;
+    return cache;
+}
+
+} // anonymous namespace
+
+const FFTPlan* FFTPlan::forSize(size_t fftSize)
+{
+    return forSize(fftSize, fftBackend());
+}
+
+const FFTPlan* FFTPlan::forSize(size_t fftSize, FFTBackend backend)
+{
+    int log2Size = 0;
+    while ((size_t(1) << log2Size) < fftSize)
+        ++log2Size;
+
+    // We only allow powers of two, and the real/complex split needs at least two complex points.
+    ASSERT((size_t(1) << log2Size) == fftSize && log2Size >= 2 && log2Size <= MaxFFTPow2Size);
+    if ((size_t(1) << log2Size) != fftSize || log2Size < 2 || log2Size > MaxFFTPow2Size)
+        return nullptr;
+
+    PlanCache& cache = planCache();
+    std::atomic<const FFTPlan*>& slot = cache.plans[static_cast<int>(backend)][log2Size];
+
+    const FFTPlan* plan = slot.load(std::memory_order_acquire);
+    if (plan)
+        return plan;
+
+    std::lock_guard<std::mutex> lock(cache.buildMutex);
+    plan = slot.load(std::memory_order_relaxed);
+    if (!plan)
+    {
+        if (backend == FFTBackend::KissFFT)
+            plan = new KissFFTPlan(fftSize);
+        else
+            plan = new VectorizedFFTPlan(fftSize);
+        slot.store(plan, std::memory_order_release);
+    }
+    return plan;
+}
+
+void setFFTBackend(FFTBackend backend)
+{
+    planCache().selectedBackend.store(static_cast<int>(backend), std::memory_order_relaxed);
+}
+
+FFTBackend fftBackend()
+{
+    return static_cast<FFTBackend>(planCache().selectedBackend.load(std::memory_order_relaxed));
+}
+
+} // namespace lab
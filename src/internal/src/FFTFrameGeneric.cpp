@@ -0,0 +1,100 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/Macros.h"
+#include "internal/Assertions.h"
+#include "internal/FFTFrame.h"
+
+#if !USE_ACCELERATE_FFT
+
+#include "internal/VectorMath.h"
+
+// Used wherever Accelerate is not; define WEBAUDIO_KISSFFT=1 to use it on OSX as well.
+// The transform itself is done by a shared FFTPlan from the backend selected with setFFTBackend().
+namespace lab
+{
+
+    // Normal constructor: allocates for a given fftSize. The transforms use fftSize / 2 bins; the extra
+    // element is scratch that callers such as WaveTable clear along with the bins.
+    FFTFrame::FFTFrame(unsigned fftSize)
+        : m_FFTSize(fftSize)
+        , m_log2FFTSize(static_cast<unsigned>(log2((double)fftSize)))
+        , m_plan(FFTPlan::forSize(fftSize))
+        , m_realData(fftSize / 2 + 1)
+        , m_imagData(fftSize / 2 + 1)
+    {
+        // We only allow power of two.
+        ASSERT(1UL << m_log2FFTSize == m_FFTSize);
+    }
+
+    // Creates a blank/empty frame (interpolate() must later be called).
+    FFTFrame::FFTFrame() : m_FFTSize(0), m_log2FFTSize(0), m_plan(nullptr)
+    {
+
+    }
+
+    // Copy constructor.
+    FFTFrame::FFTFrame(const FFTFrame& frame)
+        : m_FFTSize(frame.m_FFTSize)
+        , m_log2FFTSize(frame.m_log2FFTSize)
+        , m_plan(frame.m_plan)
+        , m_realData(frame.m_FFTSize / 2 + 1)
+        , m_imagData(frame.m_FFTSize / 2 + 1)
+    {
+        // Copy/setup frame data.
+        size_t nbytes = sizeof(float) * m_realData.size();
+        memcpy(realData(), frame.realData(), nbytes);
+        memcpy(imagData(), frame.imagData(), nbytes);
+    }
+
+    FFTFrame::~FFTFrame()
+    {
+    }
+
+    void FFTFrame::multiply(const FFTFrame& frame)
+    {
+        FFTFrame& frame1 = *this;
+        FFTFrame& frame2 = const_cast<FFTFrame&>(frame);
+
+        float* realP1 = frame1.realData();
+        float* imagP1 = frame1.imagData();
+        const float* realP2 = frame2.realData();
+        const float* imagP2 = frame2.imagData();
+
+        unsigned halfSize = fftSize() / 2;
+        float real0 = realP1[0];
+        float imag0 = imagP1[0];
+        VectorMath::zvmul(realP1, imagP1, realP2, imagP2, realP1, imagP1, halfSize);
+
+        // Multiply the packed DC/nyquist component
+        realP1[0] = real0 * realP2[0];
+        imagP1[0] = imag0 * imagP2[0];
+    }
+
+    void FFTFrame::doFFT(const float* data)
+    {
+        ASSERT(m_plan);
+        m_plan->forward(data, m_realData.data(), m_imagData.data());
+    }
+
+    void FFTFrame::doInverseFFT(float* data)
+    {
+        // Scaled so that a forward then inverse FFT yields exactly the original data:
+        //  x == IFFT(FFT(x))
+        ASSERT(m_plan);
+        m_plan->inverse(m_realData.data(), m_imagData.data(), data);
+    }
+
+    float* FFTFrame::realData() const
+    {
+        return const_cast<float*>(m_realData.data());
+    }
+
+    float* FFTFrame::imagData() const
+    {
+        return const_cast<float*>(m_imagData.data());
+    }
+
+} // namespace lab
+
+#endif // !USE_ACCELERATE_FFT
@@ -0,0 +1,248 @@
+// License: BSD 2 Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+#include "internal/PartitionedConvolver.h"
+#include "internal/VectorMath.h"
+#include "internal/Assertions.h"
+
+#include "LabSound/core/AudioBus.h"
+
+#include <algorithm>
+
+namespace lab {
+
+using namespace VectorMath;
+
+// Number of partitions in every level but the last. Each level must start at least one of its own blocks into
+// the response so that its output is ready in time; with this many partitions the next level's (doubled)
+// block size is always covered.
+const size_t PartitionsPerLevel = 4;
+
+// Every partition is processed on the calling thread, so the largest block is capped to keep a block boundary
+// (one forward and one inverse FFT) well within a render quantum.
+const size_t MaxRealtimeFFTSize = 2048;
+
+struct PartitionedConvolver::Level
+{
+    Level(size_t blockSize, size_t offset, size_t partitions)
+        : blockSize(blockSize)
+        , offset(offset)
+        , partitions(partitions)
+        , kernelReal(blockSize * partitions)
+        , kernelImag(blockSize * partitions)
+        , delayLineReal(blockSize * partitions)
+        , delayLineImag(blockSize * partitions)
+        , accumulatorReal(blockSize)
+        , accumulatorImag(blockSize)
+        , input(blockSize * 2)
+        , output(blockSize * 2)
+        , frame(static_cast<uint32_t>(blockSize * 2))
+    {
+    }
+
+    size_t blockSize;  // partition length; the FFT size is twice this
+    size_t offset;     // position of the first partition in the impulse response
+    size_t partitions;
+
+    // Spectra are blockSize bins long, with the DC and Nyquist terms packed in the first bin as FFTFrame does.
+    AudioFloatArray kernelReal;
+    AudioFloatArray kernelImag;
+
+    // Spectra of the most recent input blocks, newest at delayLineHead.
+    AudioFloatArray delayLineReal;
+    AudioFloatArray delayLineImag;
+    size_t delayLineHead = 0;
+
+    // Sum of products for the next block, built up between block boundaries.
+    AudioFloatArray accumulatorReal;
+    AudioFloatArray accumulatorImag;
+    size_t nextPartition = 1;
+
+    AudioFloatArray input; // the previous block followed by the current one
+    AudioFloatArray output;
+    FFTFrame frame;
+
+    float* kernelRealAt(size_t p) { return kernelReal.data() + p * blockSize; }
+    float* kernelImagAt(size_t p) { return kernelImag.data() + p * blockSize; }
+    float* delayLineRealAt(size_t slot) { return delayLineReal.data() + slot * blockSize; }
+    float* delayLineImagAt(size_t slot) { return delayLineImag.data() + slot * blockSize; }
+
+    // acc += x * h, treating the first bin as packed DC/Nyquist rather than complex.
+    void multiplyAccumulate(const float* xReal, const float* xImag, const float* hReal, const float* hImag)
+    {
+        float* accReal = accumulatorReal.data();
+        float* accImag = accumulatorImag.data();
+        const float dc = accReal[0] + xReal[0] * hReal[0];
+        const float nyquist = accImag[0] + xImag[0] * hImag[0];
+        zvmac(xReal, xImag, hReal, hImag, accReal, accImag, blockSize);
+        accReal[0] = dc;
+        accImag[0] = nyquist;
+    }
+
+    // Accumulates partition p for the coming block. The delay line still ends with the current block,
+    // which is one block newer than partition 1 needs.
+    void accumulatePartition(size_t p)
+    {
+        const size_t slot = (delayLineHead + partitions + 1 - p) % partitions;
+        multiplyAccumulate(delayLineRealAt(slot), delayLineImagAt(slot), kernelRealAt(p), kernelImagAt(p));
+    }
+
+    void reset()
+    {
+        delayLineReal.zero();
+        delayLineImag.zero();
+        accumulatorReal.zero();
+        accumulatorImag.zero();
+        input.zero();
+        delayLineHead = 0;
+        nextPartition = 1;
+    }
+};
+
+PartitionedConvolver::PartitionedConvolver(AudioChannel* impulseResponse, size_t renderSliceSize, size_t maxFFTSize)
+    : m_impulseResponseLength(impulseResponse->length())
+    , m_renderSliceSize(renderSliceSize)
+    , m_headKernel(std::min(renderSliceSize, impulseResponse->length()))
+    , m_headConvolver(renderSliceSize)
+{
+    const float* response = impulseResponse->data();
+    const size_t responseLength = impulseResponse->length();
+    const size_t maxBlockSize = std::max(renderSliceSize, std::min(maxFFTSize, MaxRealtimeFFTSize) / 2);
+
+    memcpy(m_headKernel.data(), response, sizeof(float) * m_headKernel.size());
+
+    size_t offset = renderSliceSize;
+    size_t blockSize = renderSliceSize;
+    while (offset < responseLength)
+    {
+        const size_t remainingPartitions = (responseLength - offset + blockSize - 1) / blockSize;
+        const size_t partitions = blockSize < maxBlockSize ? std::min(PartitionsPerLevel, remainingPartitions) : remainingPartitions;
+
+        std::unique_ptr<Level> level(new Level(blockSize, offset, partitions));
+        for (size_t p = 0; p < partitions; ++p)
+        {
+            const size_t start = offset + p * blockSize;
+            level->frame.doPaddedFFT(response + start, std::min(blockSize, responseLength - start));
+            memcpy(level->kernelRealAt(p), level->frame.realData(), sizeof(float) * blockSize);
+            memcpy(level->kernelImagAt(p), level->frame.imagData(), sizeof(float) * blockSize);
+        }
+        m_levels.push_back(std::move(level));
+
+        offset += partitions * blockSize;
+        blockSize = std::min(blockSize * 2, maxBlockSize);
+    }
+
+    // A level's output for a block lands at most its offset plus one quantum beyond the current position.
+    size_t outputSize = 1;
+    const size_t furthestWrite = (m_levels.size() ? m_levels.back()->offset : 0) + 2 * renderSliceSize;
+    while (outputSize < furthestWrite)
+        outputSize <<= 1;
+
+    m_output.allocate(outputSize);
+    m_outputMask = outputSize - 1;
+}
+
+PartitionedConvolver::~PartitionedConvolver()
+{
+}
+
+void PartitionedConvolver::processLevel(Level& level, const float* source)
+{
+    const size_t blockSize = level.blockSize;
+    const size_t position = static_cast<size_t>(m_frameCount % blockSize);
+    const size_t steps = blockSize / m_renderSliceSize;
+    const size_t step = position / m_renderSliceSize;
+
+    memcpy(level.input.data() + blockSize + position, source, sizeof(float) * m_renderSliceSize);
+
+    // Spread the older partitions evenly over the quanta leading up to the block boundary.
+    const size_t partitionsPerStep = (level.partitions - 1 + steps - 1) / steps;
+    const size_t lastPartition = std::min(level.partitions, 1 + (step + 1) * partitionsPerStep);
+    for (; level.nextPartition < lastPartition; ++level.nextPartition)
+        level.accumulatePartition(level.nextPartition);
+
+    if (position + m_renderSliceSize < blockSize)
+        return;
+
+    // The block is complete: transform it into the delay line and add the first partition.
+    level.frame.doFFT(level.input.data());
+    level.delayLineHead = (level.delayLineHead + 1) % level.partitions;
+    float* newestReal = level.delayLineRealAt(level.delayLineHead);
+    float* newestImag = level.delayLineImagAt(level.delayLineHead);
+    memcpy(newestReal, level.frame.realData(), sizeof(float) * blockSize);
+    memcpy(newestImag, level.frame.imagData(), sizeof(float) * blockSize);
+    level.multiplyAccumulate(newestReal, newestImag, level.kernelRealAt(0), level.kernelImagAt(0));
+
+    memcpy(level.frame.realData(), level.accumulatorReal.data(), sizeof(float) * blockSize);
+    memcpy(level.frame.imagData(), level.accumulatorImag.data(), sizeof(float) * blockSize);
+    level.frame.doInverseFFT(level.output.data());
+
+    level.accumulatorReal.zero();
+    level.accumulatorImag.zero();
+    level.nextPartition = 1;
+
+    // Overlap-save: the second half is the convolution of the block just completed.
+    memcpy(level.input.data(), level.input.data() + blockSize, sizeof(float) * blockSize);
+
+    const uint64_t blockStart = m_frameCount + m_renderSliceSize - blockSize;
+    const size_t writeIndex = static_cast<size_t>((blockStart + level.offset) & m_outputMask);
+    const size_t firstPart = std::min(blockSize, m_output.size() - writeIndex);
+    const float* result = level.output.data() + blockSize;
+    vadd(m_output.data() + writeIndex, 1, result, 1, m_output.data() + writeIndex, 1, firstPart);
+    vadd(m_output.data(), 1, result + firstPart, 1, m_output.data(), 1, blockSize - firstPart);
+}
+
+void PartitionedConvolver::process(const float* source, float* destination, size_t framesToProcess)
+{
+    ASSERT(framesToProcess == m_renderSliceSize);
+    if (framesToProcess != m_renderSliceSize)
+        return;
+
+    // The levels read the source before the direct stage writes the destination, so processing in-place is allowed.
+    for (auto& level : m_levels)
+        processLevel(*level, source);
+
+    if (m_headKernel.size())
+        m_headConvolver.process(&m_headKernel, source, destination, framesToProcess);
+    else
+        memset(destination, 0, sizeof(float) * framesToProcess);
+
+    const size_t readIndex = static_cast<size_t>(m_frameCount & m_outputMask);
+    vadd(destination, 1, m_output.data() + readIndex, 1, destination, 1, framesToProcess);
+    memset(m_output.data() + readIndex, 0, sizeof(float) * framesToProcess);
+
+    m_frameCount += framesToProcess;
+}
+
+void PartitionedConvolver::process(ContextRenderLock&, const AudioChannel* sourceChannel, AudioChannel* destinationChannel, size_t framesToProcess)
+{
+    bool isSafe = sourceChannel && destinationChannel && sourceChannel->length() >= framesToProcess && destinationChannel->length() >= framesToProcess;
+    ASSERT(isSafe);
+    if (!isSafe)
+        return;
+
+    process(sourceChannel->data(), destinationChannel->mutableData(), framesToProcess);
+}
+
+void PartitionedConvolver::reset()
+{
+    for (auto& level : m_levels)
+        level->reset();
+
+    m_headConvolver.reset();
+    m_output.zero();
+    m_frameCount = 0;
+}
+
+size_t PartitionedConvolver::memoryFootprint() const
+{
+    size_t floats = m_headKernel.size() + m_renderSliceSize * 2 + m_output.size();
+    for (auto& level : m_levels)
+    {
+        // kernel and delay line spectra, accumulator, input and output blocks, and the FFT frame
+        floats += level->blockSize * (level->partitions * 4 + 2 + 4 + 2);
+    }
+    return floats * sizeof(float);
+}
+
+} // namespace lab
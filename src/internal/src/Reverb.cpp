@@ -3,15 +3,22 @@
 // Copyright (C) 2015+, The LabSound Authors. All rights reserved.
 
 #include "internal/Reverb.h"
-#include "internal/ReverbConvolver.h"
+#include "internal/PartitionedConvolver.h"
 #include "internal/VectorMath.h"
 #include "internal/Assertions.h"
+#include "internal/DenormalDisabler.h"
 
 #include "LabSound/core/AudioBus.h"
 #include "LabSound/core/Macros.h"
 #include "LabSound/extended/AudioFileReader.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <math.h>
+#include <mutex>
+#include <thread>
 
 #if defined(LABSOUND_PLATFORM_OSX)
 using namespace std;
@@ -64,6 +71,118 @@ static float calculateNormalizationScale(AudioBus* response)
     return scale;
 }
 
+// Below this length a convolution path costs less than waking a helper thread for it.
+const size_t MinParallelResponseLength = 16384;
+
+// Helper threads for the convolution paths of one quantum. The calling thread publishes the paths and then claims
+// them alongside the helpers, one at a time, until none are left; it returns once every claimed path is finished.
+// Since the caller does any work no helper has claimed, a helper that wakes late only makes the quantum slower.
+//
+// The path count and the next index to claim share one atomic word, so that a helper that lost the race for the
+// last path of one quantum can never claim a path of the next with a stale count.
+struct Reverb::Workers
+{
+    static const uint64_t IndexMask = 0xffffffff;
+
+    // Roughly a few microseconds of polling before a helper goes to sleep.
+    static const int SpinCount = 4000;
+
+    explicit Workers(size_t threadCount)
+    {
+        for (size_t i = 0; i < threadCount; ++i)
+            threads.emplace_back(&Workers::threadMain, this);
+    }
+
+    ~Workers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            running = false;
+        }
+        wake.notify_all();
+        for (auto& t : threads)
+            t.join();
+    }
+
+    void run(Path* p, size_t count, size_t frames)
+    {
+        paths = p;
+        framesToProcess = frames;
+        finished.store(0, std::memory_order_relaxed);
+        claims.store(uint64_t(count) << 32, std::memory_order_release);
+        generation.fetch_add(1, std::memory_order_release);
+
+        // A helper that is falling asleep just now may miss this; it is woken again by its timeout, and its
+        // share of the paths is done here in the meantime.
+        if (sleepers.load(std::memory_order_acquire) > 0)
+            wake.notify_all();
+
+        processClaimedPaths();
+
+        while (finished.load(std::memory_order_acquire) < count)
+            std::this_thread::yield();
+
+        // Close the quantum: late claims now see a count of zero.
+        claims.store(0, std::memory_order_release);
+    }
+
+    void processClaimedPaths()
+    {
+        for (;;)
+        {
+            const uint64_t claim = claims.fetch_add(1, std::memory_order_acq_rel);
+            if ((claim & IndexMask) >= (claim >> 32))
+                return;
+
+            Path& path = paths[claim & IndexMask];
+            path.convolver->process(path.source, path.destination, framesToProcess);
+            finished.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    void threadMain()
+    {
+        DenormalDisabler denormalDisabler;
+
+        uint32_t seen = generation.load(std::memory_order_acquire);
+        while (running.load(std::memory_order_acquire))
+        {
+            int spins = 0;
+            while (generation.load(std::memory_order_acquire) == seen && spins < SpinCount)
+                ++spins;
+
+            if (generation.load(std::memory_order_acquire) == seen)
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                sleepers.fetch_add(1, std::memory_order_acq_rel);
+                wake.wait_for(lock, std::chrono::milliseconds(10), [&] {
+                    return generation.load(std::memory_order_acquire) != seen || !running.load(std::memory_order_acquire);
+                });
+                sleepers.fetch_sub(1, std::memory_order_acq_rel);
+                if (generation.load(std::memory_order_acquire) == seen)
+                    continue;
+            }
+
+            seen = generation.load(std::memory_order_acquire);
+            processClaimedPaths();
+        }
+    }
+
+    std::vector<std::thread> threads;
+
+    Path* paths = nullptr;
+    size_t framesToProcess = 0;
+
+    std::atomic<uint64_t> claims{ 0 }; // path count in the high word, next index in the low word
+    std::atomic<size_t> finished{ 0 };
+    std::atomic<uint32_t> generation{ 0 };
+
+    std::atomic<bool> running{ true };
+    std::atomic<int> sleepers{ 0 };
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+};
+
 Reverb::Reverb(AudioBus* impulseResponse, size_t renderSliceSize, size_t maxFFTSize, size_t numberOfChannels, bool useBackgroundThreads, bool normalize)
 {
     float scale = 1;
@@ -92,25 +211,56 @@ void Reverb::initialize(AudioBus* impulseResponseBuffer, size_t renderSliceSize,
     size_t numResponseChannels = impulseResponseBuffer->numberOfChannels();
     m_convolvers.reserve(numberOfChannels);
 
-    int convolverRenderPhase = 0;
     for (size_t i = 0; i < numResponseChannels; ++i) {
         AudioChannel* channel = impulseResponseBuffer->channel(i);
 
         m_convolvers.push_back(
-           std::unique_ptr<ReverbConvolver>(
-               new ReverbConvolver(channel, renderSliceSize, maxFFTSize,
-                                  convolverRenderPhase, useBackgroundThreads)));
-
-        convolverRenderPhase += renderSliceSize;
+           std::unique_ptr<PartitionedConvolver>(
+               new PartitionedConvolver(channel, renderSliceSize, maxFFTSize)));
     }
 
+    if (numResponseChannels == Channels::Mono && numberOfChannels >= Channels::Stereo)
+        m_monoResponseRightConvolver.reset(new PartitionedConvolver(impulseResponseBuffer->channel(0), renderSliceSize, maxFFTSize));
+
     // For "True" stereo processing we allocate a temporary buffer to avoid repeatedly allocating it in the process() method.
     // It can be bad to allocate memory in a real-time thread.
     if (numResponseChannels == Channels::Quad)
         m_tempBuffer = std::unique_ptr<AudioBus>(new AudioBus(2, MaxFrameSize));
+    else if (numResponseChannels > Channels::Stereo)
+        m_tempBuffer = std::unique_ptr<AudioBus>(new AudioBus(1, MaxFrameSize));
+
+    m_paths.reserve(numResponseChannels + 1);
+
+    // Handing paths to other threads costs a wakeup per quantum, which only pays off for longer responses.
+    const size_t maxPaths = m_convolvers.size() + (m_monoResponseRightConvolver ? 1 : 0);
+    const size_t helperThreads = std::min<size_t>(maxPaths, std::thread::hardware_concurrency()) - 1;
+    if (useBackgroundThreads && m_impulseResponseLength >= MinParallelResponseLength && helperThreads > 0 && helperThreads < maxPaths)
+        m_workers.reset(new Workers(helperThreads));
 }
 
-void Reverb::process(ContextRenderLock& r, const AudioBus* sourceBus, AudioBus* destinationBus, size_t framesToProcess)
+Reverb::~Reverb()
+{
+}
+
+void Reverb::addPath(PartitionedConvolver* convolver, const AudioChannel* source, AudioChannel* destination)
+{
+    // Resolve the channels here on the calling thread: writing to a channel can copy it out of a shared buffer.
+    m_paths.push_back({ convolver, source->data(), destination->mutableData() });
+}
+
+void Reverb::processPaths(size_t framesToProcess)
+{
+    if (m_workers && m_paths.size() > 1)
+        m_workers->run(m_paths.data(), m_paths.size(), framesToProcess);
+    else {
+        for (auto& path : m_paths)
+            path.convolver->process(path.source, path.destination, framesToProcess);
+    }
+
+    m_paths.clear();
+}
+
+void Reverb::process(ContextRenderLock&, const AudioBus* sourceBus, AudioBus* destinationBus, size_t framesToProcess)
 {
     // Do a fairly comprehensive sanity check.
     // If these conditions are satisfied, all of the source and destination pointers will be valid for the various matrixing cases.
@@ -121,8 +271,36 @@ void Reverb::process(ContextRenderLock& r, const AudioBus* sourceBus, AudioBus*
     if (!isSafeToProcess)
         return;
 
-    // For now only handle mono or stereo output
-    if (destinationBus->numberOfChannels() > Channels::Stereo) 
+    // Handle input -> output matrixing...
+    size_t numInputChannels = sourceBus->numberOfChannels();
+    size_t numOutputChannels = destinationBus->numberOfChannels();
+    size_t numReverbChannels = m_convolvers.size();
+
+    if (numReverbChannels > Channels::Stereo && numReverbChannels == numOutputChannels) {
+        // N -> N -> N, or anything else -> 1 -> N -> N
+        // Surround responses are indexed by output channel, so the input channels are taken in bus order as well.
+        if (numInputChannels == numOutputChannels) {
+            for (size_t i = 0; i < numReverbChannels; ++i)
+                addPath(m_convolvers[i].get(), sourceBus->channel(i), destinationBus->channel(i));
+        } else {
+            AudioChannel* downmix = m_tempBuffer->channel(0);
+            float* downmixP = downmix->mutableData();
+            memcpy(downmixP, sourceBus->channel(0)->data(), sizeof(float) * framesToProcess);
+            for (size_t i = 1; i < numInputChannels; ++i)
+                vadd(downmixP, 1, sourceBus->channel(i)->data(), 1, downmixP, 1, framesToProcess);
+
+            const float scale = 1.0f / numInputChannels;
+            vsmul(downmixP, 1, &scale, downmixP, 1, framesToProcess);
+
+            for (size_t i = 0; i < numReverbChannels; ++i)
+                addPath(m_convolvers[i].get(), downmix, destinationBus->channel(i));
+        }
+        processPaths(framesToProcess);
+        return;
+    }
+
+    // Otherwise only handle mono or stereo output
+    if (numOutputChannels > Channels::Stereo) 
     {
         destinationBus->zero();
         return;
@@ -131,34 +309,34 @@ void Reverb::process(ContextRenderLock& r, const AudioBus* sourceBus, AudioBus*
     AudioChannel* destinationChannelL = destinationBus->channelByType(Channel::Left);
     const AudioChannel* sourceChannelL = sourceBus->channelByType(Channel::Left);
 
-    // Handle input -> output matrixing...
-    size_t numInputChannels = sourceBus->numberOfChannels();
-    size_t numOutputChannels = destinationBus->numberOfChannels();
-    size_t numReverbChannels = m_convolvers.size();
-
     if (numInputChannels == Channels::Stereo && numReverbChannels == Channels::Stereo && numOutputChannels == Channels::Stereo) {
         // 2 -> 2 -> 2
         const AudioChannel* sourceChannelR = sourceBus->channelByType(Channel::Right);
         AudioChannel* destinationChannelR = destinationBus->channelByType(Channel::Right);
-        m_convolvers[0]->process(r, sourceChannelL, destinationChannelL, framesToProcess);
-        m_convolvers[1]->process(r, sourceChannelR, destinationChannelR, framesToProcess);
+        addPath(m_convolvers[0].get(), sourceChannelL, destinationChannelL);
+        addPath(m_convolvers[1].get(), sourceChannelR, destinationChannelR);
+        processPaths(framesToProcess);
     } else if (numInputChannels == Channels::Stereo && numReverbChannels == Channels::Mono && numOutputChannels == Channels::Stereo) {
         // LabSound added this case, should submit it back to WebKit after it's known to work correctly
         // because the initialize method says that a mono-IR is expected to work with a stero in/out setup
         // 2 -> 1 -> 2
         const AudioChannel* sourceChannelR = sourceBus->channelByType(Channel::Right);
         AudioChannel* destinationChannelR = destinationBus->channelByType(Channel::Right);
-        m_convolvers[0]->process(r, sourceChannelL, destinationChannelL, framesToProcess);
-        m_convolvers[0]->process(r, sourceChannelR, destinationChannelR, framesToProcess);
+        addPath(m_convolvers[0].get(), sourceChannelL, destinationChannelL);
+        if (m_monoResponseRightConvolver)
+            addPath(m_monoResponseRightConvolver.get(), sourceChannelR, destinationChannelR);
+        processPaths(framesToProcess);
+        if (!m_monoResponseRightConvolver)
+            destinationChannelR->copyFrom(destinationChannelL);
     } else  if (numInputChannels == Channels::Mono && numOutputChannels == Channels::Stereo && numReverbChannels == Channels::Stereo) {
         // 1 -> 2 -> 2
-        for (int i = 0; i < 2; ++i) {
-            AudioChannel* destinationChannel = destinationBus->channel(i);
-            m_convolvers[i]->process(r, sourceChannelL, destinationChannel, framesToProcess);
-        }
+        for (int i = 0; i < 2; ++i)
+            addPath(m_convolvers[i].get(), sourceChannelL, destinationBus->channel(i));
+        processPaths(framesToProcess);
     } else if (numInputChannels == Channels::Mono && numReverbChannels == Channels::Mono && numOutputChannels == Channels::Stereo) {
         // 1 -> 1 -> 2
-        m_convolvers[0]->process(r, sourceChannelL, destinationChannelL, framesToProcess);
+        addPath(m_convolvers[0].get(), sourceChannelL, destinationChannelL);
+        processPaths(framesToProcess);
 
         // simply copy L -> R
         AudioChannel* destinationChannelR = destinationBus->channelByType(Channel::Right);
@@ -169,45 +347,31 @@ void Reverb::process(ContextRenderLock& r, const AudioBus* sourceBus, AudioBus*
         memcpy(destinationChannelR->mutableData(), destinationChannelL->data(), sizeof(float) * framesToProcess);
     } else if (numInputChannels == Channels::Mono && numReverbChannels == Channels::Mono && numOutputChannels == Channels::Mono) {
         // 1 -> 1 -> 1
-        m_convolvers[0]->process(r, sourceChannelL, destinationChannelL, framesToProcess);
-    } else if (numInputChannels == Channels::Stereo && numReverbChannels == Channels::Quad && numOutputChannels == Channels::Stereo) {
+        addPath(m_convolvers[0].get(), sourceChannelL, destinationChannelL);
+        processPaths(framesToProcess);
+    } else if (numReverbChannels == Channels::Quad && numOutputChannels == Channels::Stereo && numInputChannels <= Channels::Stereo) {
         // 2 -> 4 -> 2 ("True" stereo)
-        const AudioChannel* sourceChannelR = sourceBus->channelByType(Channel::Right);
-        AudioChannel* destinationChannelR = destinationBus->channelByType(Channel::Right);
-
-        AudioChannel* tempChannelL = m_tempBuffer->channelByType(Channel::Left);
-        AudioChannel* tempChannelR = m_tempBuffer->channelByType(Channel::Right);
-
-        // Process left virtual source
-        m_convolvers[0]->process(r, sourceChannelL, destinationChannelL, framesToProcess);
-        m_convolvers[1]->process(r, sourceChannelL, destinationChannelR, framesToProcess);
-
-        // Process right virtual source
-        m_convolvers[2]->process(r, sourceChannelR, tempChannelL, framesToProcess);
-        m_convolvers[3]->process(r, sourceChannelR, tempChannelR, framesToProcess);
-
-        destinationBus->sumFrom(*m_tempBuffer);
-    } else if (numInputChannels == Channels::Mono && numReverbChannels == Channels::Quad && numOutputChannels == Channels::Stereo) {
         // 1 -> 4 -> 2 (Processing mono with "True" stereo impulse response)
         // This is an inefficient use of a four-channel impulse response, but we should handle the case.
+        const AudioChannel* sourceChannelR = numInputChannels == Channels::Stereo ? sourceBus->channelByType(Channel::Right) : sourceChannelL;
         AudioChannel* destinationChannelR = destinationBus->channelByType(Channel::Right);
 
         AudioChannel* tempChannelL = m_tempBuffer->channelByType(Channel::Left);
         AudioChannel* tempChannelR = m_tempBuffer->channelByType(Channel::Right);
 
-        // Process left virtual source
-        m_convolvers[0]->process(r, sourceChannelL, destinationChannelL, framesToProcess);
-        m_convolvers[1]->process(r, sourceChannelL, destinationChannelR, framesToProcess);
+        // Left virtual source
+        addPath(m_convolvers[0].get(), sourceChannelL, destinationChannelL);
+        addPath(m_convolvers[1].get(), sourceChannelL, destinationChannelR);
 
-        // Process right virtual source
-        m_convolvers[2]->process(r, sourceChannelL, tempChannelL, framesToProcess);
-        m_convolvers[3]->process(r, sourceChannelL, tempChannelR, framesToProcess);
+        // Right virtual source
+        addPath(m_convolvers[2].get(), sourceChannelR, tempChannelL);
+        addPath(m_convolvers[3].get(), sourceChannelR, tempChannelR);
+
+        processPaths(framesToProcess);
 
         destinationBus->sumFrom(*m_tempBuffer);
     } else {
         // Handle gracefully any unexpected / unsupported matrixing
-        // FIXME: add code for 5.1 support...
-        // FIXME: add code for 7.1 support...
         destinationBus->zero();
     }
 }
@@ -216,6 +380,9 @@ void Reverb::reset()
 {
     for (size_t i = 0; i < m_convolvers.size(); ++i)
         m_convolvers[i]->reset();
+
+    if (m_monoResponseRightConvolver)
+        m_monoResponseRightConvolver->reset();
 }
 
 size_t Reverb::latencyFrames() const
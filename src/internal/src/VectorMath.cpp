@@ -15,6 +15,14 @@
 #include <emmintrin.h>
 #endif
 
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
 #if defined(ARM_NEON_INTRINSICS)
 #include <arm_neon.h>
 #endif
@@ -76,6 +84,20 @@ void zvmul(const float* real1P, const float* imag1P, const float* real2P, const
 #endif
 }
 
+void zvmac(const float* real1P, const float* imag1P, const float* real2P, const float* imag2P, float* realAccumP, float* imagAccumP, size_t framesToProcess)
+{
+    DSPSplitComplex sc1;
+    DSPSplitComplex sc2;
+    DSPSplitComplex accum;
+    sc1.realp = const_cast<float*>(real1P);
+    sc1.imagp = const_cast<float*>(imag1P);
+    sc2.realp = const_cast<float*>(real2P);
+    sc2.imagp = const_cast<float*>(imag2P);
+    accum.realp = realAccumP;
+    accum.imagp = imagAccumP;
+    vDSP_zvma(&sc1, 1, &sc2, 1, &accum, 1, &accum, 1, framesToProcess);
+}
+
 void vsma(const float* sourceP, int sourceStride, const float* scale, float* destP, int destStride, size_t framesToProcess)
 {
     vDSP_vsma(sourceP, sourceStride, scale, destP, destStride, destP, destStride, framesToProcess);
@@ -95,6 +117,15 @@ void vclip(const float* sourceP, int sourceStride, const float* lowThresholdP, c
 {
     vDSP_vclip(const_cast<float*>(sourceP), sourceStride, const_cast<float*>(lowThresholdP), const_cast<float*>(highThresholdP), destP, destStride, framesToProcess);
 }
+
+void conv(const float* sourceP, const float* kernelP, float* destP, size_t framesToProcess, size_t kernelSize)
+{
+#if defined(__ppc__) || defined(__i386__)
+    ::conv(sourceP - kernelSize + 1, 1, kernelP + kernelSize - 1, -1, destP, 1, framesToProcess, kernelSize);
+#else
+    vDSP_conv(sourceP - kernelSize + 1, 1, kernelP + kernelSize - 1, -1, destP, 1, framesToProcess, kernelSize);
+#endif
+}
 #else
 
 void vsma(const float* sourceP, int sourceStride, const float* scale, float* destP, int destStride, size_t framesToProcess)
@@ -493,6 +524,54 @@ void zvmul(const float* real1P, const float* imag1P, const float* real2P, const
     }
 }
 
+void zvmac(const float* real1P, const float* imag1P, const float* real2P, const float* imag2P, float* realAccumP, float* imagAccumP, size_t framesToProcess)
+{
+    unsigned i = 0;
+#ifdef __SSE2__
+    // As with zvmul, only use the SSE optimization when all addresses are 16-byte aligned.
+    if (!(reinterpret_cast<uintptr_t>(real1P) & 0x0F)
+        && !(reinterpret_cast<uintptr_t>(imag1P) & 0x0F)
+        && !(reinterpret_cast<uintptr_t>(real2P) & 0x0F)
+        && !(reinterpret_cast<uintptr_t>(imag2P) & 0x0F)
+        && !(reinterpret_cast<uintptr_t>(realAccumP) & 0x0F)
+        && !(reinterpret_cast<uintptr_t>(imagAccumP) & 0x0F)) {
+
+        unsigned endSize = framesToProcess - framesToProcess % 4;
+        while (i < endSize) {
+            __m128 real1 = _mm_load_ps(real1P + i);
+            __m128 real2 = _mm_load_ps(real2P + i);
+            __m128 imag1 = _mm_load_ps(imag1P + i);
+            __m128 imag2 = _mm_load_ps(imag2P + i);
+            __m128 real = _mm_sub_ps(_mm_mul_ps(real1, real2), _mm_mul_ps(imag1, imag2));
+            __m128 imag = _mm_add_ps(_mm_mul_ps(real1, imag2), _mm_mul_ps(imag1, real2));
+            _mm_store_ps(realAccumP + i, _mm_add_ps(_mm_load_ps(realAccumP + i), real));
+            _mm_store_ps(imagAccumP + i, _mm_add_ps(_mm_load_ps(imagAccumP + i), imag));
+            i += 4;
+        }
+    }
+#elif defined(ARM_NEON_INTRINSICS)
+    unsigned endSize = framesToProcess - framesToProcess % 4;
+    while (i < endSize) {
+        float32x4_t real1 = vld1q_f32(real1P + i);
+        float32x4_t real2 = vld1q_f32(real2P + i);
+        float32x4_t imag1 = vld1q_f32(imag1P + i);
+        float32x4_t imag2 = vld1q_f32(imag2P + i);
+
+        float32x4_t realAccum = vmlsq_f32(vmlaq_f32(vld1q_f32(realAccumP + i), real1, real2), imag1, imag2);
+        float32x4_t imagAccum = vmlaq_f32(vmlaq_f32(vld1q_f32(imagAccumP + i), real1, imag2), imag1, real2);
+
+        vst1q_f32(realAccumP + i, realAccum);
+        vst1q_f32(imagAccumP + i, imagAccum);
+
+        i += 4;
+    }
+#endif
+    for (; i < framesToProcess; ++i) {
+        realAccumP[i] += real1P[i] * real2P[i] - imag1P[i] * imag2P[i];
+        imagAccumP[i] += real1P[i] * imag2P[i] + imag1P[i] * real2P[i];
+    }
+}
+
 void vsvesq(const float* sourceP, int sourceStride, float* sumP, size_t framesToProcess)
 {
     int n = framesToProcess;
@@ -657,6 +736,94 @@ void vclip(const float* sourceP, int sourceStride, const float* lowThresholdP, c
     }
 }
 
+void conv(const float* sourceP, const float* kernelP, float* destP, size_t framesToProcess, size_t kernelSize)
+{
+    // Each tap is broadcast once and multiplied into a block of consecutive outputs read with unaligned loads.
+    // The blocks span several registers so that the independent accumulators keep the multiply-add pipeline busy.
+    size_t i = 0;
+#if defined(__AVX__)
+    for (; i + 32 <= framesToProcess; i += 32) {
+        const float* x = sourceP + i;
+        __m256 sum0 = _mm256_setzero_ps();
+        __m256 sum1 = _mm256_setzero_ps();
+        __m256 sum2 = _mm256_setzero_ps();
+        __m256 sum3 = _mm256_setzero_ps();
+        for (size_t j = 0; j < kernelSize; ++j, --x) {
+            __m256 k = _mm256_broadcast_ss(kernelP + j);
+#if defined(__FMA__)
+            sum0 = _mm256_fmadd_ps(k, _mm256_loadu_ps(x), sum0);
+            sum1 = _mm256_fmadd_ps(k, _mm256_loadu_ps(x + 8), sum1);
+            sum2 = _mm256_fmadd_ps(k, _mm256_loadu_ps(x + 16), sum2);
+            sum3 = _mm256_fmadd_ps(k, _mm256_loadu_ps(x + 24), sum3);
+#else
+            sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(k, _mm256_loadu_ps(x)));
+            sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(k, _mm256_loadu_ps(x + 8)));
+            sum2 = _mm256_add_ps(sum2, _mm256_mul_ps(k, _mm256_loadu_ps(x + 16)));
+            sum3 = _mm256_add_ps(sum3, _mm256_mul_ps(k, _mm256_loadu_ps(x + 24)));
+#endif
+        }
+        _mm256_storeu_ps(destP + i, sum0);
+        _mm256_storeu_ps(destP + i + 8, sum1);
+        _mm256_storeu_ps(destP + i + 16, sum2);
+        _mm256_storeu_ps(destP + i + 24, sum3);
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 16 <= framesToProcess; i += 16) {
+        const float* x = sourceP + i;
+        __m128 sum0 = _mm_setzero_ps();
+        __m128 sum1 = _mm_setzero_ps();
+        __m128 sum2 = _mm_setzero_ps();
+        __m128 sum3 = _mm_setzero_ps();
+        for (size_t j = 0; j < kernelSize; ++j, --x) {
+            __m128 k = _mm_set1_ps(kernelP[j]);
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(k, _mm_loadu_ps(x)));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(k, _mm_loadu_ps(x + 4)));
+            sum2 = _mm_add_ps(sum2, _mm_mul_ps(k, _mm_loadu_ps(x + 8)));
+            sum3 = _mm_add_ps(sum3, _mm_mul_ps(k, _mm_loadu_ps(x + 12)));
+        }
+        _mm_storeu_ps(destP + i, sum0);
+        _mm_storeu_ps(destP + i + 4, sum1);
+        _mm_storeu_ps(destP + i + 8, sum2);
+        _mm_storeu_ps(destP + i + 12, sum3);
+    }
+#elif defined(ARM_NEON_INTRINSICS)
+    for (; i + 16 <= framesToProcess; i += 16) {
+        const float* x = sourceP + i;
+        float32x4_t sum0 = vdupq_n_f32(0);
+        float32x4_t sum1 = vdupq_n_f32(0);
+        float32x4_t sum2 = vdupq_n_f32(0);
+        float32x4_t sum3 = vdupq_n_f32(0);
+        for (size_t j = 0; j < kernelSize; ++j, --x) {
+            float k = kernelP[j];
+            sum0 = vmlaq_n_f32(sum0, vld1q_f32(x), k);
+            sum1 = vmlaq_n_f32(sum1, vld1q_f32(x + 4), k);
+            sum2 = vmlaq_n_f32(sum2, vld1q_f32(x + 8), k);
+            sum3 = vmlaq_n_f32(sum3, vld1q_f32(x + 12), k);
+        }
+        vst1q_f32(destP + i, sum0);
+        vst1q_f32(destP + i + 4, sum1);
+        vst1q_f32(destP + i + 8, sum2);
+        vst1q_f32(destP + i + 12, sum3);
+    }
+#endif
+    // Remaining outputs one at a time, with four partial sums.
+    for (; i < framesToProcess; ++i) {
+        const float* x = sourceP + i;
+        float sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+        size_t j = 0;
+        for (; j + 4 <= kernelSize; j += 4, x -= 4) {
+            sum0 += kernelP[j] * x[0];
+            sum1 += kernelP[j + 1] * x[-1];
+            sum2 += kernelP[j + 2] * x[-2];
+            sum3 += kernelP[j + 3] * x[-3];
+        }
+        for (; j < kernelSize; ++j, --x)
+            sum0 += kernelP[j] * *x;
+        destP[i] = (sum0 + sum1) + (sum2 + sum3);
+    }
+}
+
 #endif // OS(DARWIN)
 
 void vintlve(const float* realSrcP, const float* imagSrcP, float* destP, size_t framesToProcess) {
@@ -718,6 +885,336 @@ void vdeintlve(const float* sourceP, float* realDestP, float* imagDestP, size_t
 }
 
 
+// The mixing kernels below run on every platform; Accelerate has no fused equivalent. Their loops go over
+// blocks of frames on the outside and sources on the inside, so that a block of the destination is
+// accumulated in registers and written once however many sources are summed into it.
+
+void vma(const float* source1P, const float* source2P, float* destP, size_t framesToProcess)
+{
+    size_t i = 0;
+#if defined(__AVX__)
+    for (; i + 8 <= framesToProcess; i += 8) {
+#if defined(__FMA__)
+        __m256 sum = _mm256_fmadd_ps(_mm256_loadu_ps(source1P + i), _mm256_loadu_ps(source2P + i), _mm256_loadu_ps(destP + i));
+#else
+        __m256 sum = _mm256_add_ps(_mm256_loadu_ps(destP + i), _mm256_mul_ps(_mm256_loadu_ps(source1P + i), _mm256_loadu_ps(source2P + i)));
+#endif
+        _mm256_storeu_ps(destP + i, sum);
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 4 <= framesToProcess; i += 4) {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(destP + i), _mm_mul_ps(_mm_loadu_ps(source1P + i), _mm_loadu_ps(source2P + i)));
+        _mm_storeu_ps(destP + i, sum);
+    }
+#elif defined(ARM_NEON_INTRINSICS)
+    for (; i + 4 <= framesToProcess; i += 4)
+        vst1q_f32(destP + i, vmlaq_f32(vld1q_f32(destP + i), vld1q_f32(source1P + i), vld1q_f32(source2P + i)));
+#endif
+    for (; i < framesToProcess; ++i)
+        destP[i] += source1P[i] * source2P[i];
+}
+
+void vsum(const float* const* sourcePs, size_t sourceCount, float* destP, size_t framesToProcess, bool accumulate)
+{
+    size_t i = 0;
+#if defined(__AVX__)
+    for (; i + 8 <= framesToProcess; i += 8) {
+        __m256 sum = accumulate ? _mm256_loadu_ps(destP + i) : _mm256_setzero_ps();
+        for (size_t k = 0; k < sourceCount; ++k)
+            sum = _mm256_add_ps(sum, _mm256_loadu_ps(sourcePs[k] + i));
+        _mm256_storeu_ps(destP + i, sum);
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 4 <= framesToProcess; i += 4) {
+        __m128 sum = accumulate ? _mm_loadu_ps(destP + i) : _mm_setzero_ps();
+        for (size_t k = 0; k < sourceCount; ++k)
+            sum = _mm_add_ps(sum, _mm_loadu_ps(sourcePs[k] + i));
+        _mm_storeu_ps(destP + i, sum);
+    }
+#elif defined(ARM_NEON_INTRINSICS)
+    for (; i + 4 <= framesToProcess; i += 4) {
+        float32x4_t sum = accumulate ? vld1q_f32(destP + i) : vdupq_n_f32(0);
+        for (size_t k = 0; k < sourceCount; ++k)
+            sum = vaddq_f32(sum, vld1q_f32(sourcePs[k] + i));
+        vst1q_f32(destP + i, sum);
+    }
+#endif
+    for (; i < framesToProcess; ++i) {
+        float sum = accumulate ? destP[i] : 0;
+        for (size_t k = 0; k < sourceCount; ++k)
+            sum += sourcePs[k][i];
+        destP[i] = sum;
+    }
+}
+
+void vrampsum(const float* const* sourcePs, float* gains, const float* targetGains, size_t sourceCount, float ratio, float* destP, size_t framesToProcess, bool accumulate)
+{
+    // Frame i of source k is scaled by targetGains[k] + (gains[k] - targetGains[k]) * ratio^i. The powers of
+    // the ratio are the same for every source, so they are kept in a vector of consecutive powers that is
+    // advanced by one multiply per block, and a source whose gain has settled costs a single multiply-add.
+    size_t i = 0;
+    float power = 1;
+#if defined(__AVX__)
+    if (framesToProcess >= 8) {
+        alignas(32) float lanes[8];
+        lanes[0] = 1;
+        for (int j = 1; j < 8; ++j)
+            lanes[j] = lanes[j - 1] * ratio;
+        const float step = lanes[7] * ratio;
+        const __m256 stepV = _mm256_set1_ps(step);
+        __m256 powers = _mm256_load_ps(lanes);
+
+        for (; i + 8 <= framesToProcess; i += 8) {
+            __m256 sum = accumulate ? _mm256_loadu_ps(destP + i) : _mm256_setzero_ps();
+            for (size_t k = 0; k < sourceCount; ++k) {
+                const float delta = gains[k] - targetGains[k];
+                __m256 gain = _mm256_set1_ps(targetGains[k]);
+                if (delta != 0) {
+#if defined(__FMA__)
+                    gain = _mm256_fmadd_ps(_mm256_set1_ps(delta), powers, gain);
+#else
+                    gain = _mm256_add_ps(gain, _mm256_mul_ps(_mm256_set1_ps(delta), powers));
+#endif
+                }
+#if defined(__FMA__)
+                sum = _mm256_fmadd_ps(_mm256_loadu_ps(sourcePs[k] + i), gain, sum);
+#else
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(sourcePs[k] + i), gain));
+#endif
+            }
+            _mm256_storeu_ps(destP + i, sum);
+            powers = _mm256_mul_ps(powers, stepV);
+            power *= step;
+        }
+    }
+#endif
+#if defined(__SSE2__) || defined(ARM_NEON_INTRINSICS)
+    if (framesToProcess - i >= 4) {
+        float lanes[4] = { power, power * ratio, power * ratio * ratio, power * ratio * ratio * ratio };
+        const float step = ratio * ratio * ratio * ratio;
+#if defined(__SSE2__)
+        const __m128 stepV = _mm_set1_ps(step);
+        __m128 powers = _mm_loadu_ps(lanes);
+
+        for (; i + 4 <= framesToProcess; i += 4) {
+            __m128 sum = accumulate ? _mm_loadu_ps(destP + i) : _mm_setzero_ps();
+            for (size_t k = 0; k < sourceCount; ++k) {
+                const float delta = gains[k] - targetGains[k];
+                __m128 gain = _mm_set1_ps(targetGains[k]);
+                if (delta != 0)
+                    gain = _mm_add_ps(gain, _mm_mul_ps(_mm_set1_ps(delta), powers));
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(sourcePs[k] + i), gain));
+            }
+            _mm_storeu_ps(destP + i, sum);
+            powers = _mm_mul_ps(powers, stepV);
+            power *= step;
+        }
+#else
+        float32x4_t powers = vld1q_f32(lanes);
+
+        for (; i + 4 <= framesToProcess; i += 4) {
+            float32x4_t sum = accumulate ? vld1q_f32(destP + i) : vdupq_n_f32(0);
+            for (size_t k = 0; k < sourceCount; ++k) {
+                const float delta = gains[k] - targetGains[k];
+                float32x4_t gain = vdupq_n_f32(targetGains[k]);
+                if (delta != 0)
+                    gain = vmlaq_n_f32(gain, powers, delta);
+                sum = vmlaq_f32(sum, vld1q_f32(sourcePs[k] + i), gain);
+            }
+            vst1q_f32(destP + i, sum);
+            powers = vmulq_n_f32(powers, step);
+            power *= step;
+        }
+#endif
+    }
+#endif
+    for (; i < framesToProcess; ++i, power *= ratio) {
+        float sum = accumulate ? destP[i] : 0;
+        for (size_t k = 0; k < sourceCount; ++k)
+            sum += sourcePs[k][i] * (targetGains[k] + (gains[k] - targetGains[k]) * power);
+        destP[i] = sum;
+    }
+
+    // Continue each ramp at the frame after the last one processed.
+    for (size_t k = 0; k < sourceCount; ++k)
+        gains[k] = targetGains[k] + (gains[k] - targetGains[k]) * power;
+}
+
+void vrampmul(const float* sourceP, float* gain, float targetGain, float ratio, float* destP, size_t framesToProcess)
+{
+    vrampsum(&sourceP, gain, &targetGain, 1, ratio, destP, framesToProcess, false);
+}
+
+
+// The generators evaluate frame i from its closed form. Lanes start at consecutive frames and each block
+// advances them all by the same step, a single add for ramps and a single multiply for exponentials.
+
+void vramp(float start, float step, float* destP, size_t framesToProcess)
+{
+    size_t i = 0;
+#if defined(__AVX__)
+    if (framesToProcess >= 8) {
+        const __m256 stepV = _mm256_set1_ps(step);
+        const __m256 lanes = _mm256_set_ps(7.f, 6.f, 5.f, 4.f, 3.f, 2.f, 1.f, 0.f);
+        for (; i + 8 <= framesToProcess; i += 8) {
+            // Offsets are recomputed from i so that rounding doesn't accumulate over long ramps.
+#if defined(__FMA__)
+            __m256 value = _mm256_fmadd_ps(_mm256_add_ps(_mm256_set1_ps(static_cast<float>(i)), lanes), stepV, _mm256_set1_ps(start));
+#else
+            __m256 value = _mm256_add_ps(_mm256_set1_ps(start), _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(static_cast<float>(i)), lanes), stepV));
+#endif
+            _mm256_storeu_ps(destP + i, value);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    {
+        const __m128 stepV = _mm_set1_ps(step);
+        const __m128 lanes = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+        for (; i + 4 <= framesToProcess; i += 4) {
+            __m128 value = _mm_add_ps(_mm_set1_ps(start), _mm_mul_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(i)), lanes), stepV));
+            _mm_storeu_ps(destP + i, value);
+        }
+    }
+#elif defined(ARM_NEON_INTRINSICS)
+    {
+        const float laneValues[4] = { 0.f, 1.f, 2.f, 3.f };
+        const float32x4_t lanes = vld1q_f32(laneValues);
+        for (; i + 4 <= framesToProcess; i += 4)
+            vst1q_f32(destP + i, vmlaq_n_f32(vdupq_n_f32(start), vaddq_f32(vdupq_n_f32(static_cast<float>(i)), lanes), step));
+    }
+#endif
+    for (; i < framesToProcess; ++i)
+        destP[i] = start + step * static_cast<float>(i);
+}
+
+void vgeom(float offset, float scale, float ratio, float* destP, size_t framesToProcess)
+{
+    size_t i = 0;
+    float power = scale;
+#if defined(__AVX__)
+    if (framesToProcess >= 8) {
+        alignas(32) float lanes[8];
+        lanes[0] = scale;
+        for (int j = 1; j < 8; ++j)
+            lanes[j] = lanes[j - 1] * ratio;
+        const float ratio2 = ratio * ratio;
+        const float step = ratio2 * ratio2 * ratio2 * ratio2;
+        const __m256 stepV = _mm256_set1_ps(step);
+        const __m256 offsetV = _mm256_set1_ps(offset);
+        __m256 powers = _mm256_load_ps(lanes);
+        for (; i + 8 <= framesToProcess; i += 8) {
+            _mm256_storeu_ps(destP + i, _mm256_add_ps(offsetV, powers));
+            powers = _mm256_mul_ps(powers, stepV);
+            power *= step;
+        }
+    }
+#endif
+#if defined(__SSE2__) || defined(ARM_NEON_INTRINSICS)
+    if (framesToProcess - i >= 4) {
+        float lanes[4] = { power, power * ratio, power * ratio * ratio, power * ratio * ratio * ratio };
+        const float step = ratio * ratio * ratio * ratio;
+#if defined(__SSE2__)
+        const __m128 stepV = _mm_set1_ps(step);
+        const __m128 offsetV = _mm_set1_ps(offset);
+        __m128 powers = _mm_loadu_ps(lanes);
+        for (; i + 4 <= framesToProcess; i += 4) {
+            _mm_storeu_ps(destP + i, _mm_add_ps(offsetV, powers));
+            powers = _mm_mul_ps(powers, stepV);
+            power *= step;
+        }
+#else
+        const float32x4_t offsetV = vdupq_n_f32(offset);
+        float32x4_t powers = vld1q_f32(lanes);
+        for (; i + 4 <= framesToProcess; i += 4) {
+            vst1q_f32(destP + i, vaddq_f32(offsetV, powers));
+            powers = vmulq_n_f32(powers, step);
+            power *= step;
+        }
+#endif
+    }
+#endif
+    for (; i < framesToProcess; ++i, power *= ratio)
+        destP[i] = offset + power;
+}
+
+void vs16tof(const int16_t* sourceP, float scale, float* destP, size_t framesToProcess)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 scaleV = _mm_set1_ps(scale);
+    for (; i + 8 <= framesToProcess; i += 8) {
+        // Each sample is unpacked into the high half of a 32 bit lane, and shifted down with its sign.
+        const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceP + i));
+        const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+        const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+        _mm_storeu_ps(destP + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scaleV));
+        _mm_storeu_ps(destP + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scaleV));
+    }
+#elif defined(ARM_NEON_INTRINSICS)
+    for (; i + 8 <= framesToProcess; i += 8) {
+        const int16x8_t samples = vld1q_s16(sourceP + i);
+        vst1q_f32(destP + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))), scale));
+        vst1q_f32(destP + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))), scale));
+    }
+#endif
+    for (; i < framesToProcess; ++i)
+        destP[i] = sourceP[i] * scale;
+}
+
+void vs24tof(const uint8_t* sourceP, float scale, float* destP, size_t framesToProcess)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 scaleV = _mm_set1_ps(scale);
+#if defined(__SSSE3__)
+    // Each sample's three bytes are shuffled into the top of a 32 bit lane, and shifted down with their sign. The
+    // load reads 16 bytes for the 12 used, so the last samples are left to the loop below.
+    const __m128i spread = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    for (; i + 6 <= framesToProcess; i += 4) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceP + 3 * i));
+        const __m128i samples = _mm_srai_epi32(_mm_shuffle_epi8(bytes, spread), 8);
+        _mm_storeu_ps(destP + i, _mm_mul_ps(_mm_cvtepi32_ps(samples), scaleV));
+    }
+#else
+    // Without a byte shuffle, shifting the whole register left by one, two, and three bytes brings the second, third
+    // and fourth samples to the bottom of their lanes, from where each is masked in. Each sample's three bytes are
+    // then shifted to the top of its lane, and back down with their sign.
+    const __m128i lane0 = _mm_setr_epi32(-1, 0, 0, 0);
+    const __m128i lane1 = _mm_setr_epi32(0, -1, 0, 0);
+    const __m128i lane2 = _mm_setr_epi32(0, 0, -1, 0);
+    const __m128i lane3 = _mm_setr_epi32(0, 0, 0, -1);
+    for (; i + 6 <= framesToProcess; i += 4) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceP + 3 * i));
+        const __m128i packed = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(bytes, lane0), _mm_and_si128(_mm_slli_si128(bytes, 1), lane1)),
+            _mm_or_si128(_mm_and_si128(_mm_slli_si128(bytes, 2), lane2), _mm_and_si128(_mm_slli_si128(bytes, 3), lane3)));
+        const __m128i samples = _mm_srai_epi32(_mm_slli_epi32(packed, 8), 8);
+        _mm_storeu_ps(destP + i, _mm_mul_ps(_mm_cvtepi32_ps(samples), scaleV));
+    }
+#endif
+#elif defined(ARM_NEON_INTRINSICS)
+    for (; i + 8 <= framesToProcess; i += 8) {
+        // Deinterleaves the bytes of eight samples, and zips them back up into the top three bytes of 32 bit lanes.
+        const uint8x8x3_t bytes = vld3_u8(sourceP + 3 * i);
+        const uint16x8_t low = vshlq_n_u16(vmovl_u8(bytes.val[0]), 8);
+        const uint16x8_t high = vorrq_u16(vshlq_n_u16(vmovl_u8(bytes.val[2]), 8), vmovl_u8(bytes.val[1]));
+        const uint16x8x2_t words = vzipq_u16(low, high);
+        const int32x4_t first = vshrq_n_s32(vreinterpretq_s32_u16(words.val[0]), 8);
+        const int32x4_t second = vshrq_n_s32(vreinterpretq_s32_u16(words.val[1]), 8);
+        vst1q_f32(destP + i, vmulq_n_f32(vcvtq_f32_s32(first), scale));
+        vst1q_f32(destP + i + 4, vmulq_n_f32(vcvtq_f32_s32(second), scale));
+    }
+#endif
+    for (; i < framesToProcess; ++i) {
+        const uint8_t* bytes = sourceP + 3 * i;
+        const int32_t sample = static_cast<int32_t>(static_cast<uint32_t>(bytes[0]) << 8 | static_cast<uint32_t>(bytes[1]) << 16 | static_cast<uint32_t>(bytes[2]) << 24) >> 8;
+        destP[i] = sample * scale;
+    }
+}
+
 } // namespace VectorMath
 
 } // namespace lab